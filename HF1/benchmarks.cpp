@@ -0,0 +1,491 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "glm_config.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <context.h>
+#include <job_system.h>
+#include <transform_kernels.h>
+#include <vertex_format.h>
+
+#include "managers/MeshCache.h"
+#include "primitives/Cone.h"
+#include "primitives/Cube.h"
+#include "primitives/Cylinder.h"
+#include "primitives/GpuMeshGenerator.h"
+#include "primitives/Grid.h"
+#include "primitives/Sphere.h"
+
+namespace {
+constexpr uint32_t RUNS = 5;
+
+// keeps the compiler from throwing away the measured work
+volatile float g_sink = 0.0f;
+
+// best of a few runs in milliseconds, the first run also warms up the workers
+template <typename Fn> double BestOf(uint32_t runs, Fn&& fn)
+{
+    double best = 1e30;
+    for (uint32_t run = 0; run < runs; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        best           = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+float Work(const std::vector<float>& values, uint32_t first, uint32_t last)
+{
+    float sum = 0.0f;
+    for (uint32_t idx = first; idx < last; idx++) {
+        sum += std::sqrt(values[idx]) * std::sin(values[idx]);
+    }
+    return sum;
+}
+
+// random tree in parent order, every node picks one of the nodes before it as the parent or becomes a root
+struct TransformScene {
+    std::vector<uint32_t>  parents;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+};
+
+TransformScene MakeTransformScene(const uint32_t nodeCount)
+{
+    std::mt19937                          rng(nodeCount);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+
+    TransformScene scene;
+    for (uint32_t node = 0; node < nodeCount; node++) {
+        const bool root = node == 0 || (rng() % 8) == 0;
+        scene.parents.push_back(root ? UINT32_MAX : rng() % node);
+        scene.positions.push_back(glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f);
+        scene.rotations.push_back(glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+        scene.scales.push_back(glm::vec3(scale(rng), scale(rng), scale(rng)));
+    }
+    return scene;
+}
+
+// a finely tessellated sphere away from the origin, so the quantization has a real box to work with
+struct FloatMesh {
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+    uint32_t           vertexCount;
+};
+
+FloatMesh MakeSphere(const uint32_t rings, const uint32_t segments)
+{
+    const float radius    = 2.0f;
+    const float center[3] = {10.0f, 3.0f, -5.0f};
+
+    FloatMesh mesh;
+    for (uint32_t ring = 0; ring <= rings; ring++) {
+        const float v     = float(ring) / rings;
+        const float theta = v * glm::pi<float>();
+        for (uint32_t segment = 0; segment <= segments; segment++) {
+            const float u      = float(segment) / segments;
+            const float phi    = u * glm::two_pi<float>();
+            const float dir[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                mesh.positions.push_back(center[axis] + dir[axis] * radius);
+                mesh.normals.push_back(dir[axis]);
+            }
+            mesh.texCoords.push_back(u);
+            mesh.texCoords.push_back(v);
+        }
+    }
+    mesh.vertexCount = (rings + 1) * (segments + 1);
+    return mesh;
+}
+
+// what the C++ generators of the primitives make from the same parameters
+struct CpuMesh {
+    std::vector<float>        vertices;
+    std::vector<float>        normals;
+    std::vector<float>        texCoords;
+    std::vector<unsigned int> indices;
+};
+
+void GenerateOnCpu(const MeshGenParams& params, CpuMesh& mesh)
+{
+    // only GenerateSphere and GenerateCubeAtlas clear the vectors themselves
+    mesh.vertices.clear();
+    mesh.normals.clear();
+    mesh.texCoords.clear();
+    mesh.indices.clear();
+
+    const float* values = params.params;
+    const int*   counts = params.counts;
+    switch (params.kind) {
+    case MeshGenParams::Kind::Sphere:
+        GenerateSphere(values[0], counts[0], counts[1], mesh.vertices, mesh.normals, mesh.texCoords, mesh.indices);
+        break;
+    case MeshGenParams::Kind::Cylinder:
+        buildCylinder(values[0], values[1], values[2], counts[0], counts[1], mesh.vertices, mesh.normals,
+                      mesh.texCoords, mesh.indices);
+        break;
+    case MeshGenParams::Kind::Cone:
+        buildCone(values[0], values[1], counts[0], counts[1] != 0, mesh.vertices, mesh.normals, mesh.texCoords,
+                  mesh.indices);
+        break;
+    case MeshGenParams::Kind::Grid:
+        buildGrid(values[0], values[1], counts[1], counts[0], mesh.vertices, mesh.normals, mesh.texCoords,
+                  mesh.indices);
+        break;
+    case MeshGenParams::Kind::Cube:
+        buildCube(values[0], mesh.vertices, mesh.normals, mesh.texCoords, mesh.indices);
+        break;
+    case MeshGenParams::Kind::CubeAtlas:
+        GenerateCubeAtlas(mesh.vertices, mesh.normals, mesh.texCoords, mesh.indices);
+        break;
+    }
+}
+
+float MaxError(const std::vector<float>& values, const std::vector<float>& reference)
+{
+    float error = 0.0f;
+    for (size_t idx = 0; idx < values.size(); idx++) {
+        error = std::max(error, std::abs(values[idx] - reference[idx]));
+    }
+    return error;
+}
+
+struct MeshCase {
+    const char*   name;
+    MeshGenParams params;
+};
+} // namespace
+
+int RunJobSystemBenchmark(JobSystem& jobSystem)
+{
+    printf("Job system benchmark, %u workers, best of %u runs\n", jobSystem.workerCount(), RUNS);
+
+    // cost of Run + execute + counter per job with every worker pulling from the same producer
+    constexpr uint32_t EMPTY_JOBS = 100000;
+
+    const double emptyMs = BestOf(RUNS, [&] {
+        JobCounter counter;
+        for (uint32_t idx = 0; idx < EMPTY_JOBS; idx++) {
+            jobSystem.Run([] {}, &counter);
+        }
+        jobSystem.Wait(counter);
+    });
+    printf("  empty jobs        %10.1f ns/job\n", emptyMs * 1e6 / EMPTY_JOBS);
+
+    // one job per worker and wait, this is what every ParallelFor in a frame pays at least
+    constexpr uint32_t FORK_JOINS = 10000;
+
+    const double forkJoinMs = BestOf(RUNS, [&] {
+        for (uint32_t idx = 0; idx < FORK_JOINS; idx++) {
+            jobSystem.ParallelFor(jobSystem.workerCount(), 1, [](uint32_t, uint32_t) {});
+        }
+    });
+    printf("  fork/join         %10.2f us\n", forkJoinMs * 1e3 / FORK_JOINS);
+
+    // every job depends on the previous one, nothing can run in parallel so this is the continuation overhead
+    constexpr uint32_t CHAIN_LENGTH = 10000;
+
+    const double chainMs = BestOf(RUNS, [&] {
+        std::unique_ptr<JobCounter[]> counters(new JobCounter[CHAIN_LENGTH]);
+        for (uint32_t idx = 0; idx < CHAIN_LENGTH; idx++) {
+            jobSystem.Run([] {}, &counters[idx], idx > 0 ? &counters[idx - 1] : nullptr);
+        }
+        jobSystem.Wait(counters[CHAIN_LENGTH - 1]);
+    });
+    printf("  dependency chain  %10.1f ns/job\n", chainMs * 1e6 / CHAIN_LENGTH);
+
+    // parallel for against a plain loop, small batches show where the overhead starts to dominate
+    constexpr uint32_t ELEMENT_COUNT = 4 * 1024 * 1024;
+    std::vector<float> values(ELEMENT_COUNT);
+    for (uint32_t idx = 0; idx < ELEMENT_COUNT; idx++) {
+        values[idx] = idx * 0.001f;
+    }
+
+    const double serialMs = BestOf(RUNS, [&] { g_sink = Work(values, 0, ELEMENT_COUNT); });
+    printf("  serial loop       %10.2f ms (%u elements)\n", serialMs, ELEMENT_COUNT);
+
+    for (uint32_t batchSize : {256u, 4096u, 65536u, 1048576u}) {
+        std::vector<float> partials((ELEMENT_COUNT + batchSize - 1) / batchSize);
+
+        const double parallelMs = BestOf(RUNS, [&] {
+            jobSystem.ParallelFor(ELEMENT_COUNT, batchSize, [&](uint32_t first, uint32_t last) {
+                partials[first / batchSize] = Work(values, first, last);
+            });
+
+            float sum = 0.0f;
+            for (float partial : partials) {
+                sum += partial;
+            }
+            g_sink = sum;
+        });
+        printf("  parallel for %7u/batch %6.2f ms, %5.2fx\n", batchSize, parallelMs, serialMs / parallelMs);
+    }
+
+    return 0;
+}
+
+int RunTransformBenchmark()
+{
+    printf("Transform benchmark, compose + parent chain, best of %u runs, best isa is %s\n", RUNS,
+           TransformKernels::IsaName(TransformKernels::Best().isa));
+
+    for (uint32_t nodeCount : {1000u, 10000u, 100000u}) {
+        const TransformScene scene = MakeTransformScene(nodeCount);
+        printf("  %u nodes\n", nodeCount);
+
+        // what the store did before the kernels, also the reference for the error
+        std::vector<glm::mat4> glmWorld(nodeCount);
+
+        const double glmMs = BestOf(RUNS, [&] {
+            for (uint32_t node = 0; node < nodeCount; node++) {
+                const glm::mat4 local = glm::translate(glm::mat4(1.0f), scene.positions[node]) *
+                                        glm::mat4_cast(scene.rotations[node]) *
+                                        glm::scale(glm::mat4(1.0f), scene.scales[node]);
+
+                const uint32_t parent = scene.parents[node];
+                glmWorld[node]        = (parent != UINT32_MAX) ? glmWorld[parent] * local : local;
+            }
+            g_sink = glmWorld[nodeCount - 1][3].x;
+        });
+        printf("    glm     %8.2f ns/node\n", glmMs * 1e6 / nodeCount);
+
+        for (TransformKernels::Isa isa :
+             {TransformKernels::Isa::Scalar, TransformKernels::Isa::SSE, TransformKernels::Isa::AVX2}) {
+            if (!TransformKernels::Supported(isa)) {
+                printf("    %-7s not supported\n", TransformKernels::IsaName(isa));
+                continue;
+            }
+
+            const TransformKernels& kernels = TransformKernels::ForIsa(isa);
+            std::vector<Affine3x4>  local(nodeCount);
+            std::vector<Affine3x4>  world(nodeCount);
+
+            const double ms = BestOf(RUNS, [&] {
+                kernels.compose(glm::value_ptr(scene.positions[0]), glm::value_ptr(scene.rotations[0]),
+                                glm::value_ptr(scene.scales[0]), nodeCount, local.data());
+                kernels.chain(scene.parents.data(), nullptr, local.data(), world.data(), 0, nodeCount);
+                g_sink = world[nodeCount - 1].rows[0][3];
+            });
+
+            // relative to the size of the matrix, deep chains grow quite large
+            float maxError = 0.0f;
+            for (uint32_t node = 0; node < nodeCount; node++) {
+                float error = 0.0f;
+                float size  = 1.0f;
+                for (uint32_t row = 0; row < 3; row++) {
+                    for (uint32_t col = 0; col < 4; col++) {
+                        const float expected = glmWorld[node][col][row];
+                        error                = std::max(error, std::abs(world[node].rows[row][col] - expected));
+                        size                 = std::max(size, std::abs(expected));
+                    }
+                }
+                maxError = std::max(maxError, error / size);
+            }
+
+            printf("    %-7s %8.2f ns/node, %5.2fx, max error %.2e\n", TransformKernels::IsaName(isa),
+                   ms * 1e6 / nodeCount, glmMs / ms, maxError);
+        }
+    }
+
+    return 0;
+}
+
+int RunVertexFormatBenchmark()
+{
+    const FloatMesh mesh = MakeSphere(1000, 1000);
+    printf("Vertex format benchmark, %u vertices, encode best of %u runs\n", mesh.vertexCount, RUNS);
+    printf("  the shadow pass and the pre-pass fetch the position stream, the lighting every stream\n");
+
+    const char* formats[] = {"float", "interleaved", "interleaved,half", "interleaved,a2b10g10r10,half",
+                             "interleaved,octahedral,half", "packed"};
+
+    const VertexFormat reference;
+    for (const char* name : formats) {
+        VertexFormat format;
+        VertexFormat::Parse(name, format);
+
+        std::vector<uint8_t> streams[VertexFormat::MAX_STREAMS];
+        for (uint32_t stream = 0; stream < format.streamCount(); stream++) {
+            streams[stream].resize(size_t(mesh.vertexCount) * format.streamStride(stream));
+        }
+
+        PositionDequant dequant = {};
+        const double    ms      = BestOf(RUNS, [&] {
+            dequant = ComputeDequant(format, mesh.positions.data(), mesh.vertexCount);
+            EncodePositions(format, dequant, mesh.positions.data(), mesh.vertexCount, streams[0].data());
+            EncodeTexCoords(format, mesh.texCoords.data(), mesh.vertexCount, streams[1].data());
+            EncodeNormals(format, mesh.normals.data(), mesh.vertexCount, streams[format.normalStream()].data());
+        });
+
+        // absolute for the positions and the texture coordinates, degrees for the normals
+        float positionError = 0.0f;
+        float texCoordError = 0.0f;
+        float normalError   = 0.0f;
+        for (uint32_t idx = 0; idx < mesh.vertexCount; idx++) {
+            float position[3];
+            float texCoord[2];
+            float normal[3];
+            DecodePosition(format, dequant, streams[0].data(), idx, position);
+            DecodeTexCoord(format, streams[1].data(), idx, texCoord);
+            DecodeNormal(format, streams[format.normalStream()].data(), idx, normal);
+
+            // in double, acos of a float close to one is mostly rounding
+            double cosine    = 0.0;
+            double length    = 0.0;
+            double refLength = 0.0;
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                positionError = std::max(positionError, std::abs(position[axis] - mesh.positions[idx * 3 + axis]));
+                cosine += double(normal[axis]) * mesh.normals[idx * 3 + axis];
+                length += double(normal[axis]) * normal[axis];
+                refLength += double(mesh.normals[idx * 3 + axis]) * mesh.normals[idx * 3 + axis];
+            }
+            for (uint32_t axis = 0; axis < 2; axis++) {
+                texCoordError = std::max(texCoordError, std::abs(texCoord[axis] - mesh.texCoords[idx * 2 + axis]));
+            }
+            const double angle = std::acos(std::min(1.0, cosine / std::sqrt(length * refLength)));
+            normalError        = std::max(normalError, float(glm::degrees(angle)));
+        }
+
+        const uint32_t shadowBytes   = format.positionSize();
+        const uint32_t lightingBytes = format.vertexSize();
+        printf("  %-28s shadow %2u B %3.0f%%, lighting %2u B %3.0f%%, %u streams, encode %7.1f MB/s\n", name,
+               shadowBytes, 100.0 * shadowBytes / reference.positionSize(), lightingBytes,
+               100.0 * lightingBytes / reference.vertexSize(), format.streamCount(),
+               (double(mesh.vertexCount) * reference.vertexSize() / (1024.0 * 1024.0)) / (ms / 1000.0));
+        printf("  %-28s max error position %.2e, uv %.2e, normal %.3f deg\n", "", positionError, texCoordError,
+               normalError);
+    }
+
+    printf("  the frame times of a format come from the stress sweep, e.g. --stress-sweep with --vertex-format\n");
+    return 0;
+}
+
+int RunGpuMeshValidation(GpuMeshGenerator& generator)
+{
+    // the sin and cos of the GPU are a bit off, this is far below anything visible
+    constexpr float TOLERANCE = 1e-4f;
+
+    // the edge cases of every generator and a few large ones, where the angles add up the most error
+    const MeshCase cases[] = {
+        {"sphere 1 36 18", MeshGenParams::Sphere(1.0f, 36, 18)},
+        {"sphere 0.5 6 4", MeshGenParams::Sphere(0.5f, 6, 4)},
+        {"sphere 2 3 1", MeshGenParams::Sphere(2.0f, 3, 1)},
+        {"sphere 10 1024 512", MeshGenParams::Sphere(10.0f, 1024, 512)},
+        {"cylinder 1 1 2 36 4", MeshGenParams::Cylinder(1.0f, 1.0f, 2.0f, 36, 4)},
+        {"cylinder 1 0.25 3 7 1", MeshGenParams::Cylinder(1.0f, 0.25f, 3.0f, 7, 1)},
+        {"cylinder 0.5 0.5 8 2048 64", MeshGenParams::Cylinder(0.5f, 0.5f, 8.0f, 2048, 64)},
+        {"cone 1 1 3 capped", MeshGenParams::Cone(1.0f, 1.0f, 3, true)},
+        {"cone 0.5 2 64 open", MeshGenParams::Cone(0.5f, 2.0f, 64, false)},
+        {"grid 10 5 2 2", MeshGenParams::Grid(10.0f, 5.0f, 2, 2)},
+        {"grid 4 4 100 37", MeshGenParams::Grid(4.0f, 4.0f, 100, 37)},
+        {"grid 1 1 1 1", MeshGenParams::Grid(1.0f, 1.0f, 1, 1)},
+        {"cube 1", MeshGenParams::Cube(1.0f, false)},
+        {"cube 3", MeshGenParams::Cube(3.0f, false)},
+        {"cube atlas", MeshGenParams::Cube(1.0f, true)},
+    };
+
+    printf("GPU mesh validation, max errors against the C++ generators, tolerance %.0e\n", TOLERANCE);
+
+    uint32_t failed = 0;
+    for (const MeshCase& meshCase : cases) {
+        CpuMesh reference;
+        GenerateOnCpu(meshCase.params, reference);
+
+        GpuMesh gpuMesh = generator.Generate(meshCase.params);
+        CpuMesh result;
+        generator.Readback(gpuMesh, result.vertices, result.normals, result.texCoords, result.indices);
+        gpuMesh.Destroy(generator.device());
+
+        // the positions relative to the size of the mesh
+        float size = 1.0f;
+        for (float coordinate : reference.vertices) {
+            size = std::max(size, std::abs(coordinate));
+        }
+
+        const bool sameCounts = result.vertices.size() == reference.vertices.size() &&
+                                result.indices.size() == reference.indices.size();
+
+        float    positionError = 0.0f;
+        float    normalError   = 0.0f;
+        float    texCoordError = 0.0f;
+        uint32_t wrongIndices  = 0;
+        if (sameCounts) {
+            positionError = MaxError(result.vertices, reference.vertices) / size;
+            normalError   = MaxError(result.normals, reference.normals);
+            texCoordError = MaxError(result.texCoords, reference.texCoords);
+            for (size_t idx = 0; idx < reference.indices.size(); idx++) {
+                wrongIndices += result.indices[idx] != reference.indices[idx] ? 1 : 0;
+            }
+        }
+
+        const bool ok = sameCounts && wrongIndices == 0 && positionError <= TOLERANCE && normalError <= TOLERANCE &&
+                        texCoordError <= TOLERANCE;
+        failed += ok ? 0 : 1;
+
+        printf("  %-26s %8zu vertices %9zu indices, position %.2e, normal %.2e, uv %.2e, %u wrong indices %s\n",
+               meshCase.name, result.vertices.size() / 3, result.indices.size(), positionError, normalError,
+               texCoordError, wrongIndices, ok ? "ok" : "FAILED");
+        if (!sameCounts) {
+            printf("    expected %zu vertices and %zu indices\n", reference.vertices.size() / 3,
+                   reference.indices.size());
+        }
+    }
+
+    printf("%u of %zu meshes match\n", uint32_t(std::size(cases)) - failed, std::size(cases));
+    return failed == 0 ? 0 : -1;
+}
+
+int RunMeshGenerationBenchmark(const Context& context, GpuMeshGenerator& generator)
+{
+    printf("Mesh generation benchmark, best of %u runs, the mesh cache path is a single run\n", RUNS);
+    printf("  the mesh cache also reorders for the vertex cache and uploads, the GPU allocates and waits\n");
+
+    const MeshCase cases[] = {
+        {"sphere 256 128", MeshGenParams::Sphere(1.0f, 256, 128)},
+        {"sphere 1024 512", MeshGenParams::Sphere(1.0f, 1024, 512)},
+        {"sphere 2048 1024", MeshGenParams::Sphere(1.0f, 2048, 1024)},
+        {"cylinder 2048 1024", MeshGenParams::Cylinder(1.0f, 0.5f, 2.0f, 2048, 1024)},
+        {"grid 2048 2048", MeshGenParams::Grid(10.0f, 10.0f, 2048, 2048)},
+    };
+
+    for (const MeshCase& meshCase : cases) {
+        CpuMesh mesh;
+
+        const double cpuMs = BestOf(RUNS, [&] { GenerateOnCpu(meshCase.params, mesh); });
+
+        // what BasePrimitive::create does without a generator
+        const double cacheMs = BestOf(1, [&] {
+            GenerateOnCpu(meshCase.params, mesh);
+            const Mesh* cached =
+                MeshCache::Get().Add(context, meshCase.name, mesh.vertices, mesh.normals, mesh.texCoords, mesh.indices);
+            MeshCache::Get().Release(context.device(), cached);
+        });
+
+        const double gpuMs = BestOf(RUNS, [&] {
+            GpuMesh gpuMesh = generator.Generate(meshCase.params);
+            gpuMesh.Destroy(context.device());
+        });
+
+        double dispatchMs = 0.0;
+        generator.LastGpuTime(dispatchMs);
+
+        printf("  %-20s %8u vertices, cpu %8.2f ms, mesh cache %8.2f ms, gpu %7.2f ms (dispatch %6.3f ms) %6.1fx\n",
+               meshCase.name, meshCase.params.vertexCount(), cpuMs, cacheMs, gpuMs, dispatchMs, cacheMs / gpuMs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+class Context;
+class GpuMeshGenerator;
+class JobSystem;
+
+// Scheduling overhead of single jobs, fork/join latency and parallel-for scaling against a plain loop.
+int RunJobSystemBenchmark(JobSystem& jobSystem);
+
+// The world transform kernels of every supported instruction set against plain glm matrices.
+int RunTransformBenchmark();
+
+// Bytes every pass fetches per vertex in the vertex formats, what they lose and how fast they encode.
+int RunVertexFormatBenchmark();
+
+// The meshes of mesh_gen.comp against the C++ generators of the primitives, non-zero if one is off.
+int RunGpuMeshValidation(GpuMeshGenerator& generator);
+
+// Large tessellations generated on the CPU, through the mesh cache as the primitives do and on the GPU.
+int RunMeshGenerationBenchmark(const Context& context, GpuMeshGenerator& generator);
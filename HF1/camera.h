@@ -4,6 +4,12 @@
 #include "glm_config.h"
 #include <GLFW/glfw3.h>
 
+#include <buffer.h>
+#include <cassert>
+#include <context.h>
+
+#include "render_passes/SceneInterface.h"
+
 namespace {
 static float ApplyDeadzone(float value, float deadzone = 0.18f) {
     if (value > -deadzone && value < deadzone)
@@ -15,16 +21,40 @@ static float CurveInput(float value, float power = 2.0f) {
     float sign = (value >= 0.0f) ? 1.0f : -1.0f;
     return sign * std::pow(std::abs(value), power);
 };
+
+// radical inverse of index in the given base, (2, 3) gives well spread 2D points for any prefix of the sequence
+static float Halton(uint32_t index, uint32_t base) {
+    float result   = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
 }
 
 class Camera {
 public:
-    struct CameraPushConstant {
+    // std140, the lighting pass reads it from set 3
+    struct CameraUniform {
         glm::vec4 position;
-        glm::mat4 projection;
+        glm::mat4 projection; // jittered with TAA
         glm::mat4 view;
+        glm::mat4 viewProjection;     // without the jitter, the motion vectors are taken between these
+        glm::mat4 prevViewProjection; // viewProjection of the previous frame
     };
 
+    // sub-pixel offset of the given frame in pixels, in [-0.5, 0.5)
+    static glm::vec2 HaltonJitter(uint32_t frame)
+    {
+        constexpr uint32_t SEQUENCE_LENGTH = 8;
+
+        const uint32_t index = frame % SEQUENCE_LENGTH + 1; // Halton(0) is 0 in both bases
+        return glm::vec2(Halton(index, 2), Halton(index, 3)) - 0.5f;
+    }
+
     Camera(VkExtent2D viewport, float fov = 45.0f, float nearPlane = 0.1f, float farPlane = 100.0f)
         : m_aspectRatio(viewport.width / (float)viewport.height)
         , m_projection(glm::perspective(glm::radians(fov), m_aspectRatio, nearPlane, farPlane))
@@ -34,7 +64,16 @@ public:
         , m_front(glm::vec3(0.0f, 1.0f, 1.0f))
         , m_up(glm::vec3(0.0f, -1.0f, 0.0f))
         , m_view(glm::mat4(1.0f))
+        , m_fov(fov)
+        , m_nearPlane(nearPlane)
+        , m_farPlane(farPlane)
+    {
+    }
+
+    void SetViewport(VkExtent2D viewport)
     {
+        m_aspectRatio = viewport.width / (float)viewport.height;
+        m_projection  = glm::perspective(glm::radians(m_fov), m_aspectRatio, m_nearPlane, m_farPlane);
     }
 
     void Forward() { m_position += CAMERA_SPEED * m_front; }
@@ -122,39 +161,95 @@ public:
     const glm::mat4& projection() const { return m_projection; };
     const glm::mat4& view() const { return m_view; };
 
-    void CreateVK(const VkDevice device)
+    // Offsets the projection by pixelOffset pixels of the extent that is rendered, zero turns the jitter off.
+    void SetJitter(glm::vec2 pixelOffset, VkExtent2D renderExtent)
     {
-        const VkPushConstantRange pushConstantRange = {
-            .stageFlags = VK_SHADER_STAGE_ALL,
-            .offset     = 0,
-            .size       = sizeof(CameraPushConstant),
-        };
+        m_jitter = pixelOffset * 2.0f / glm::vec2(renderExtent.width, renderExtent.height);
+    }
 
-        const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .pNext                  = nullptr,
-            .flags                  = 0,
-            .setLayoutCount         = 0,
-            .pSetLayouts            = nullptr,
-            .pushConstantRangeCount = (pushConstantRange.size > 0) ? 1u : 0u,
-            .pPushConstantRanges    = &pushConstantRange,
-        };
+    // the next upload uses the current matrices as the previous ones too, so nothing seems to move
+    void ResetHistory() { m_hasPrevViewProjection = false; }
+
+    void CreateVK(Context& context)
+    {
+        m_uniformBuffer = BufferInfo::Create(context.physicalDevice(), context.device(), sizeof(CameraUniform),
+                                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+        m_descSetLayout = SceneInterface::CreateSetLayout(context, SceneInterface::CAMERA_SET);
+        m_descSet       = context.descriptorPool().CreateSet(m_descSetLayout);
+
+        DescriptorSetMgmt setMgmt(m_descSet);
+        setMgmt.SetBuffer(0, m_uniformBuffer.buffer);
+        setMgmt.Update(context.device());
+    }
 
-        VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout);
-        assert(result == VK_SUCCESS);
+    VkDescriptorSetLayout DescriptorSetLayout() const { return m_descSetLayout; }
+
+    void BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout) const
+    {
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SceneInterface::CAMERA_SET,
+                                1, &m_descSet, 0, nullptr);
     }
 
-    void PushConstants(VkCommandBuffer cmdBuffer) {
-        CameraPushConstant cameraData = {
-            .position = glm::vec4(m_position, 0.0f),
-            .projection = m_projection,
-            .view       = m_view,
+    // Same as LightManager::CmdUpload, the frames in flight keep their own camera. Once per recorded frame,
+    // the matrices of this frame become the previous ones of the next.
+    void CmdUpload(VkCommandBuffer cmdBuffer)
+    {
+        const glm::mat4 viewProjection = m_projection * m_view;
+        if (!m_hasPrevViewProjection) {
+            m_prevViewProjection    = viewProjection;
+            m_hasPrevViewProjection = true;
+        }
+
+        // moving the clip space position by jitter * w moves the projected one by jitter
+        const glm::mat4 jitter = glm::translate(glm::mat4(1.0f), glm::vec3(m_jitter, 0.0f));
+
+        const CameraUniform cameraData = {
+            .position           = glm::vec4(m_position, 0.0f),
+            .projection         = jitter * m_projection,
+            .view               = m_view,
+            .viewProjection     = viewProjection,
+            .prevViewProjection = m_prevViewProjection,
+        };
+        m_prevViewProjection = viewProjection;
+
+        VkBufferMemoryBarrier2 barrier = {
+            .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .pNext               = nullptr,
+            .srcStageMask        = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+            .srcAccessMask       = VK_ACCESS_2_NONE,
+            .dstStageMask        = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            .dstAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer              = m_uniformBuffer.buffer,
+            .offset              = 0,
+            .size                = VK_WHOLE_SIZE,
+        };
+        const VkDependencyInfo dependency = {
+            .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext                    = nullptr,
+            .dependencyFlags          = 0,
+            .memoryBarrierCount       = 0,
+            .pMemoryBarriers          = nullptr,
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers    = &barrier,
+            .imageMemoryBarrierCount  = 0,
+            .pImageMemoryBarriers     = nullptr,
         };
-        vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(cameraData), &cameraData);
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+
+        vkCmdUpdateBuffer(cmdBuffer, m_uniformBuffer.buffer, 0, sizeof(cameraData), &cameraData);
+
+        barrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_UNIFORM_READ_BIT;
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
     }
 
     void Destroy(VkDevice device) {
-        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        m_uniformBuffer.Destroy(device);
     }
 
 private:
@@ -173,5 +268,15 @@ private:
     glm::vec3 m_target;
     glm::mat4 m_view;
 
-    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    float m_fov;
+    float m_nearPlane;
+    float m_farPlane;
+
+    glm::vec2 m_jitter                = glm::vec2(0.0f); // in NDC
+    glm::mat4 m_prevViewProjection    = glm::mat4(1.0f);
+    bool      m_hasPrevViewProjection = false;
+
+    BufferInfo            m_uniformBuffer = {};
+    VkDescriptorSetLayout m_descSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet       m_descSet       = VK_NULL_HANDLE;
 };
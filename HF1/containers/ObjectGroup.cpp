@@ -3,14 +3,17 @@
 void ObjectGroup::addChild(IDrawable* child)
 {
     m_children.push_back(child);
+
+    // the children are placed relative to the group
+    if (ITransformable* transformable = dynamic_cast<ITransformable*>(child)) {
+        transformable->setParent(this);
+    }
 }
 
-void ObjectGroup::draw(const VkCommandBuffer cmdBuffer,bool lightningPass, const glm::mat4& parentModel)
+void ObjectGroup::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    glm::mat4 finalModel = parentModel * getModelMatrix();
-
-    for (auto& child : m_children)
-        child->draw(cmdBuffer, lightningPass, finalModel);
+    for (const auto& child : m_children)
+        child->collect(primitives);
 }
 void ObjectGroup::destroyChildren(const VkDevice device)
 {
@@ -8,7 +8,7 @@
 class ObjectGroup : public ITransformable, public IDrawable{
 public:
     void     addChild(IDrawable *);
-    void     draw(VkCommandBuffer cmdBuffer, bool lightningPass, const glm::mat4& parentModel = glm::mat4(1.0f)) override;
+    void     collect(std::vector<const BasePrimitive*>& primitives) const override;
     void     destroyChildren(VkDevice device);
 
 protected:
@@ -0,0 +1,31 @@
+#include "AnimatedGroup.h"
+
+#include <cmath>
+
+AnimatedGroup::AnimatedGroup(const SceneNode& node)
+    : m_behaviour(node.behaviour)
+    , m_params{node.behaviourParams[0], node.behaviourParams[1], node.behaviourParams[2]}
+    , m_position{node.position[0], node.position[1], node.position[2]}
+    , m_rotation{node.rotation[0], node.rotation[1], node.rotation[2]}
+{
+}
+
+void AnimatedGroup::tick(const float deltaTime)
+{
+    m_time += deltaTime;
+
+    switch (m_behaviour) {
+    case SceneBehaviour::None:
+        break;
+    case SceneBehaviour::Spin:
+        setRotation(m_rotation[0] + m_time * m_params[0], m_rotation[1] + m_time * m_params[1],
+                    m_rotation[2] + m_time * m_params[2]);
+        break;
+    case SceneBehaviour::Bob: {
+        const float TWO_PI = 6.28318530718f;
+        const float offset = m_params[0] * std::sin(TWO_PI * (m_time * m_params[1] + m_params[2]));
+        setPosition(m_position[0], m_position[1] + offset, m_position[2]);
+        break;
+    }
+    }
+}
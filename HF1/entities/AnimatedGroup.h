@@ -0,0 +1,21 @@
+#pragma once
+#include "BaseEntity.h"
+#include "../scene/SceneFile.h"
+
+// A group node of a scene file with a behaviour. The children are separate scene nodes parented to it,
+// so there is nothing to create or collect here, it only moves.
+class AnimatedGroup final : public BaseEntity {
+public:
+    explicit AnimatedGroup(const SceneNode& node);
+    void collect(std::vector<const BasePrimitive*>&) const override {}
+    void create(Context&, LightningPass&, ShadowPass&) override {}
+    void destroy(VkDevice) override {}
+    void tick(float deltaTime) override;
+
+private:
+    float          m_time = 0.0f;
+    SceneBehaviour m_behaviour;
+    float          m_params[3];
+    float          m_position[3];
+    float          m_rotation[3];
+};
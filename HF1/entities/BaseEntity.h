@@ -11,5 +11,6 @@ public:
     virtual ~BaseEntity() = default;
     virtual void create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass) = 0;
     virtual void destroy(VkDevice device) = 0;
-    virtual void tick() = 0;
+    // deltaTime is in seconds, always the fixed step of the simulation
+    virtual void tick(float deltaTime) = 0;
 };
\ No newline at end of file
@@ -11,6 +11,8 @@ OrbitingHelicopter::OrbitingHelicopter()
     m_helicopterMoved =  new ObjectGroup();
     m_helicopterTilted =  new ObjectGroup();
     m_helicopterOrbiting = new ObjectGroup();
+
+    m_helicopterOrbiting->setParent(this);
 }
 
 OrbitingHelicopter::~OrbitingHelicopter()
@@ -18,9 +20,9 @@ OrbitingHelicopter::~OrbitingHelicopter()
     delete m_helicopterOrbiting;
 }
 
-void OrbitingHelicopter::draw(VkCommandBuffer cmdBuffer, bool lightingPass, const glm::mat4& parentModel)
+void OrbitingHelicopter::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    m_helicopterOrbiting->draw(cmdBuffer,lightingPass, parentModel * getModelMatrix());
+    m_helicopterOrbiting->collect(primitives);
 }
 
 void OrbitingHelicopter::destroy(VkDevice device)
@@ -70,9 +72,9 @@ void OrbitingHelicopter::create(Context& context, LightningPass& lightningPass,
     m_helicopterOrbiting->addChild(m_helicopterMoved);
 }
 
-void OrbitingHelicopter::tick()
+void OrbitingHelicopter::tick(const float deltaTime)
 {
-    m_time += 1.0f * m_speed;
+    m_time += deltaTime * m_speed;
 
     m_helicopterRotor1->setRotation(0.0f,m_time * m_rotor1Speed,0.0f);
     m_helicopterRotor2->setRotation(0.0f,0.0f,m_time * m_rotor2Speed);
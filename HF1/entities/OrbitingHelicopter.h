@@ -6,17 +6,18 @@ class OrbitingHelicopter : public BaseEntity {
 public:
     OrbitingHelicopter();
     ~OrbitingHelicopter();
-    void draw(VkCommandBuffer cmdBuffer,bool lightingPass, const glm::mat4& parentModel = glm::mat4(1.0f)) override;
+    void collect(std::vector<const BasePrimitive*>& primitives) const override;
     void create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass) override;
     void destroy(VkDevice device) override;
-    void tick() override;
+    void tick(float deltaTime) override;
 
 private:
     float        m_time = 0.0f;
     float        m_speed = 1.0f;
-    float        m_orbitSpeed = 1.0f;
-    float        m_rotor1Speed = 20.0f;
-    float        m_rotor2Speed = 10.0f;
+    // degrees per second
+    float        m_orbitSpeed = 60.0f;
+    float        m_rotor1Speed = 1200.0f;
+    float        m_rotor2Speed = 600.0f;
 
     ObjectGroup* m_helicopterBody;
     ObjectGroup* m_helicopterRotor1;
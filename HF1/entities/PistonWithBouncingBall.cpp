@@ -8,6 +8,10 @@ PistonWithBouncingBall::PistonWithBouncingBall()
     m_pistonBase = new ObjectGroup();
     m_pistonMovingPart = new ObjectGroup();
     m_ball = new ObjectGroup();
+
+    m_pistonBase->setParent(this);
+    m_pistonMovingPart->setParent(this);
+    m_ball->setParent(this);
 }
 
 PistonWithBouncingBall::~PistonWithBouncingBall()
@@ -17,11 +21,11 @@ PistonWithBouncingBall::~PistonWithBouncingBall()
     delete m_ball;
 }
 
-void PistonWithBouncingBall::draw(const VkCommandBuffer cmdBuffer,bool lightingPass, const glm::mat4& parentModel)
+void PistonWithBouncingBall::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    m_pistonBase->draw(cmdBuffer,lightingPass, parentModel * getModelMatrix());
-    m_pistonMovingPart->draw(cmdBuffer,lightingPass, parentModel * getModelMatrix());
-    m_ball->draw(cmdBuffer,lightingPass, parentModel * getModelMatrix());
+    m_pistonBase->collect(primitives);
+    m_pistonMovingPart->collect(primitives);
+    m_ball->collect(primitives);
 }
 
 void PistonWithBouncingBall::create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass)
@@ -57,9 +61,9 @@ void PistonWithBouncingBall::destroy(const VkDevice device)
     m_ball->destroyChildren(device);
 }
 
-void PistonWithBouncingBall::tick()
+void PistonWithBouncingBall::tick(const float deltaTime)
 {
-    m_animationProgress += 1.0f * m_speed;
+    m_animationProgress += deltaTime * m_speed;
     if (m_animationProgress >= 5 * PI)
         m_animationProgress -= 5 * PI;
 
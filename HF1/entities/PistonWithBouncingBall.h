@@ -6,15 +6,15 @@ class PistonWithBouncingBall : public BaseEntity {
 public:
     PistonWithBouncingBall();
     ~PistonWithBouncingBall() override;
-    void draw(VkCommandBuffer cmdBuffer, bool lightingPass, const glm::mat4& parentModel = glm::mat4(1.0f)) override;
+    void collect(std::vector<const BasePrimitive*>& primitives) const override;
     void create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass) override;
     void destroy(VkDevice device) override;
-    void tick() override;
+    void tick(float deltaTime) override;
 
 private:
     const float PI = 3.14159265359f;
     float        m_animationProgress = 0.0f;
-    float        m_speed = 0.075f;
+    float        m_speed = 4.5f; // per second
 
     ObjectGroup* m_pistonBase;
     ObjectGroup* m_pistonMovingPart;
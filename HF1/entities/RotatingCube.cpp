@@ -5,11 +5,12 @@
 RotatingCube::RotatingCube()
 {
     m_objectGroup = new ObjectGroup();
+    m_objectGroup->setParent(this);
 }
 
-void RotatingCube::draw(const VkCommandBuffer cmdBuffer, bool lightingPass, const glm::mat4& parentModel)
+void RotatingCube::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    m_objectGroup->draw(cmdBuffer,lightingPass, parentModel * getModelMatrix());
+    m_objectGroup->collect(primitives);
 }
 
 void RotatingCube::create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass)
@@ -25,9 +26,9 @@ void RotatingCube::destroy(const VkDevice device)
     m_objectGroup->destroyChildren(device);
 }
 
-void RotatingCube::tick()
+void RotatingCube::tick(const float deltaTime)
 {
-    m_time += 1.0f;
+    m_time += deltaTime;
 
     m_objectGroup->setRotation(m_time * m_speed,0.0f,0.0f);
 }
@@ -6,13 +6,13 @@
 class RotatingCube final: public BaseEntity{
 public:
     RotatingCube();
-    void draw(VkCommandBuffer cmdBuffer, bool lightingPass, const glm::mat4& parentModel = glm::mat4(1.0f)) override;
+    void collect(std::vector<const BasePrimitive*>& primitives) const override;
     void create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass) override;
     void destroy(VkDevice device) override;
-    void tick() override;
+    void tick(float deltaTime) override;
 
 private:
     float        m_time = 0.0f;
-    float        m_speed = 1.0f;
+    float        m_speed = 60.0f; // degrees per second
     ObjectGroup* m_objectGroup;
 };
\ No newline at end of file
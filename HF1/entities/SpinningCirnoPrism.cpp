@@ -6,6 +6,7 @@
 SpinningCirnoPrism::SpinningCirnoPrism()
 {
     m_objectGroup = new ObjectGroup();
+    m_objectGroup->setParent(this);
 }
 
 SpinningCirnoPrism::~SpinningCirnoPrism()
@@ -13,9 +14,9 @@ SpinningCirnoPrism::~SpinningCirnoPrism()
     delete m_objectGroup;
 }
 
-void SpinningCirnoPrism::draw(const VkCommandBuffer cmdBuffer, bool lightingPass, const glm::mat4& parentModel)
+void SpinningCirnoPrism::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    m_objectGroup->draw(cmdBuffer, lightingPass, parentModel * getModelMatrix());
+    m_objectGroup->collect(primitives);
 }
 
 void SpinningCirnoPrism::create(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass)
@@ -30,9 +31,9 @@ void SpinningCirnoPrism::destroy(const VkDevice device)
     m_objectGroup->destroyChildren(device);
 }
 
-void SpinningCirnoPrism::tick()
+void SpinningCirnoPrism::tick(const float deltaTime)
 {
-    m_time += 4.0f;
+    m_time += deltaTime;
 
     m_objectGroup->setRotation(0.0f, m_time * m_speed, 0.0f);
 }
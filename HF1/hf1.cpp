@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <functional>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -6,28 +10,73 @@
 #define GLFW_INCLUDE_NONE
 #include <vulkan/vulkan_core.h>
 
+#include "benchmarks.h"
 #include "camera.h"
 #include "context.h"
 #include "debug.h"
+#include "gpu_timer.h"
 #include "glm_config.h"
 #include "imgui_integration.h"
+#include "job_system.h"
 #include "managers/LightManager.h"
+#include "managers/MeshCache.h"
 #include "managers/ObjectManager.h"
 #include "managers/TextureManager.h"
+#include "options.h"
+#include "parallel_recorder.h"
 #include "primitives/BasePrimitive.h"
+#include "primitives/GpuMeshGenerator.h"
+#include "render_passes/DynamicResolution.h"
 #include "render_passes/LightningPass.h"
 #include "render_passes/PostProcessPass.h"
+#include "render_graph.h"
 #include "render_passes/ShadowPass.h"
+#include "render_targets.h"
+#include "scene/GltfModel.h"
+#include "scene/SceneFile.h"
+#include "scene/StressScene.h"
+#include "shader_hot_reload.h"
+#include "shader_library.h"
+#include "simulation/Simulation.h"
 #include "swapchain.h"
+#include "terrain/Terrain.h"
 #include "wrappers.h"
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <vulkan/vulkan.h>
 
 bool             showInfo        = true;
+bool             parallelRecording = true;
+bool             depthPrepass      = false;
+bool             framebufferResized = false;
 constexpr double press_timeout = 0.5;
 double last_press_time = 0;
 
+// views of the draw list, the shadow lights use the first ones
+constexpr uint32_t PREPASS_VIEW  = MAX_LIGHTS;
+constexpr uint32_t LIGHTING_VIEW = MAX_LIGHTS + 1;
+
+struct AntiAliasingMode {
+    const char*           name;
+    VkSampleCountFlagBits samples;
+    bool                  temporal;
+};
+
+// the msaa modes the device can't do are left out at startup
+std::vector<AntiAliasingMode> AntiAliasingModes(VkSampleCountFlagBits maxSamples)
+{
+    std::vector<AntiAliasingMode> modes = {{"Off", VK_SAMPLE_COUNT_1_BIT, false}};
+    for (const AntiAliasingMode mode : {AntiAliasingMode{"2x MSAA", VK_SAMPLE_COUNT_2_BIT, false},
+                                        AntiAliasingMode{"4x MSAA", VK_SAMPLE_COUNT_4_BIT, false},
+                                        AntiAliasingMode{"8x MSAA", VK_SAMPLE_COUNT_8_BIT, false}}) {
+        if (mode.samples <= maxSamples) {
+            modes.push_back(mode);
+        }
+    }
+    modes.push_back({"TAA", VK_SAMPLE_COUNT_1_BIT, true});
+    return modes;
+}
+
 void KeyCallback(GLFWwindow* window, int key, int /*scancode*/, int /*action*/, int /*mods*/)
 {
     Camera* camera = reinterpret_cast<Camera*>(glfwGetWindowUserPointer(window));
@@ -65,6 +114,12 @@ void KeyCallback(GLFWwindow* window, int key, int /*scancode*/, int /*action*/,
     }
 }
 
+void FramebufferSizeCallback(GLFWwindow* /*window*/, int /*width*/, int /*height*/)
+{
+    // the swapchain is recreated at the end of the frame, acquire/present might not report it on every platform
+    framebufferResized = true;
+}
+
 void HandleJoystick(Camera* camera)
 {
     if (glfwJoystickIsGamepad(GLFW_JOYSTICK_1)) {
@@ -108,7 +163,75 @@ void MouseCallback(GLFWwindow* window, double xposIn, double yposIn)
     }
 }
 
-void RenderImGui(IMGUIIntegration imIntegration, const Camera& camera)
+// Swaps in the shaders the watcher compiled since the last frame. A pass keeps its pipelines when the new code
+// doesn't compile or its pipelines can't be created with it, the code is put back for the next variants then.
+void ReloadShaders(ShaderHotReload& hotReload,
+                   VkDevice         device,
+                   LightningPass&   lightningPass,
+                   ShadowPass&      shadowPass,
+                   PostProcessPass& postProcess)
+{
+    bool idle = false;
+    for (ShaderHotReload::Result& result : hotReload.TakeCompiled()) {
+        if (result.spirv.empty()) {
+            printf("Shader %s failed to compile in %.1f ms, keeping the previous pipelines\n%s", result.name.c_str(),
+                   result.compileMs, result.log.c_str());
+            continue;
+        }
+        if (!ShaderLibrary::Get().Contains(result.name)) {
+            printf("Shader %s compiled in %.1f ms, no pipeline is reloaded with it\n", result.name.c_str(),
+                   result.compileMs);
+            continue;
+        }
+        std::string error;
+        if (!ShaderLibrary::Get().FitsInterface(result.name, result.spirv, error)) {
+            printf("Shader %s compiled in %.1f ms, keeping the previous pipelines, %s\n", result.name.c_str(),
+                   result.compileMs, error.c_str());
+            continue;
+        }
+
+        // the frames in flight still use the pipelines about to be replaced
+        if (!idle) {
+            vkDeviceWaitIdle(device);
+            idle = true;
+        }
+
+        const auto            start    = std::chrono::steady_clock::now();
+        std::vector<uint32_t> previous = ShaderLibrary::Get().Replace(result.name, std::move(result.spirv));
+
+        const bool created = lightningPass.ReloadShader(result.name) && shadowPass.ReloadShader(result.name) &&
+                             postProcess.ReloadShader(result.name);
+        const double pipelineMs =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (created) {
+            printf("Shader %s compiled in %.1f ms, pipelines recreated in %.1f ms\n", result.name.c_str(),
+                   result.compileMs, pipelineMs);
+        } else {
+            ShaderLibrary::Get().Replace(result.name, std::move(previous));
+            printf("Shader %s compiled in %.1f ms, but creating its pipelines failed after %.1f ms, keeping the "
+                   "previous ones\n",
+                   result.name.c_str(), result.compileMs, pipelineMs);
+        }
+    }
+}
+
+void RenderImGui(IMGUIIntegration                     imIntegration,
+                 const Camera&                        camera,
+                 const Simulation&                    simulation,
+                 const Swapchain&                     swapchain,
+                 uint32_t                             framesInFlight,
+                 DynamicResolution&                   dynamicResolution,
+                 const LightningPass&                 lightningPass,
+                 const DrawList::Stats&               drawStats,
+                 const Terrain*                       terrain,
+                 const std::vector<AntiAliasingMode>& aaModes,
+                 uint32_t&                            aaModeIdx,
+                 LightningPass::ShadingOptions&       shading,
+                 const PostProcessPass&               postProcess,
+                 uint32_t&                            postProcessMode,
+                 bool&                                postChainFused,
+                 uint32_t&                            blurRadius)
 {
     ImGuiIO& io                = ImGui::GetIO();
     ImGui::GetIO().IniFilename = nullptr;
@@ -116,13 +239,86 @@ void RenderImGui(IMGUIIntegration imIntegration, const Camera& camera)
     ImGui::NewFrame();
     if (showInfo) {
         ImGui::SetNextWindowPos(ImVec2(15, 20), ImGuiCond_FirstUseEver);
-        ImGui::SetNextWindowSize(ImVec2(358, 97), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(358, 140), ImGuiCond_FirstUseEver);
         ImGui::Begin("Info");
         const glm::vec3& cameraPosition = camera.position();
         ImGui::Text("Camera position x: %.3f y: %.3f z: %.3f", cameraPosition.x, cameraPosition.y, cameraPosition.z);
         const glm::vec3& targetPosition = camera.lookAtPosition();
         ImGui::Text("Target position x: %.3f y: %.3f z: %.3f", targetPosition.x, targetPosition.y, targetPosition.z);
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+        ImGui::Text("Simulation %.0f Hz, last tick %.3f ms, %llu ticks dropped", simulation.tickRate(),
+                    simulation.lastTickMs(), static_cast<unsigned long long>(simulation.droppedTicks()));
+        ImGui::Text("Present mode %s, %zu images, %u frames in flight",
+                    Swapchain::PresentModeName(swapchain.presentMode()), swapchain.images().size(), framesInFlight);
+        ImGui::Checkbox("Record passes on worker threads", &parallelRecording);
+        ImGui::Text("%u draws, binds issued/skipped: pipeline %u/%u, texture %u/%u, mesh %u/%u", drawStats.draws,
+                    drawStats.pipelineBinds, drawStats.pipelineSkips, drawStats.textureBinds, drawStats.textureSkips,
+                    drawStats.meshBinds, drawStats.meshSkips);
+        ImGui::Text("Vertex fetch %.1f MB per frame, %s", drawStats.vertexBytes / (1024.0 * 1024.0),
+                    MeshCache::Get().vertexFormat().Name().c_str());
+        ImGui::Text("%.2f M triangles per frame over every pass", drawStats.triangles / 1e6);
+        if (terrain != nullptr) {
+            const Terrain::Stats& terrainStats = terrain->stats();
+            ImGui::Text("Terrain %u chunks drawn, %.2f M triangles, %u/%u resident (%.1f MB), %u generating",
+                        terrainStats.drawn, terrainStats.triangles / 1e6, terrainStats.resident, terrainStats.capacity,
+                        terrainStats.residentBytes / (1024.0 * 1024.0), terrainStats.pending);
+        }
+
+        const VkExtent2D renderExtent = lightningPass.renderExtent();
+        ImGui::Text("GPU %.2f ms, lighting at %.0f%% (%ux%u)", dynamicResolution.smoothedMs(),
+                    lightningPass.renderScale() * 100.0f, renderExtent.width, renderExtent.height);
+        if (ImGui::BeginCombo("Anti-aliasing", aaModes[aaModeIdx].name)) {
+            for (uint32_t idx = 0; idx < aaModes.size(); idx++) {
+                if (ImGui::Selectable(aaModes[idx].name, idx == aaModeIdx)) {
+                    aaModeIdx = idx;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+
+        // every combination is a specialized pipeline, created the first time it is picked
+        bool pcf = shading.shadowFilter == LightningPass::ShadowFilter::Pcf;
+        if (ImGui::Checkbox("PCF shadows", &pcf)) {
+            shading.shadowFilter = pcf ? LightningPass::ShadowFilter::Pcf : LightningPass::ShadowFilter::Hard;
+        }
+        if (pcf) {
+            int radius = static_cast<int>(shading.pcfRadius);
+            if (ImGui::SliderInt("PCF radius", &radius, 1, static_cast<int>(LightningPass::MAX_PCF_RADIUS))) {
+                shading.pcfRadius = static_cast<uint32_t>(radius);
+            }
+        }
+        if (ImGui::BeginCombo("Post process", PostProcessPass::MODE_NAMES[postProcessMode])) {
+            for (uint32_t mode = 0; mode < PostProcessPass::MODE_COUNT; mode++) {
+                if (ImGui::Selectable(PostProcessPass::MODE_NAMES[mode], mode == postProcessMode)) {
+                    postProcessMode = mode;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        const PostProcessChain& chain = postProcess.chain();
+        ImGui::Text("Post chain %s, %u dispatches", PostProcessChain::Name(chain.effects()).c_str(),
+                    chain.dispatchCount());
+        if (!chain.effects().empty()) {
+            ImGui::Checkbox("Fuse per-pixel effects", &postChainFused);
+            int radius = static_cast<int>(blurRadius);
+            if (ImGui::SliderInt("Blur radius", &radius, 1, static_cast<int>(PostProcessChain::MAX_BLUR_RADIUS))) {
+                blurRadius = static_cast<uint32_t>(radius);
+            }
+        }
+        ImGui::Text("Pipeline variants: %zu lighting, %zu post process, %zu post chain", lightningPass.variantCount(),
+                    postProcess.variantCount(), chain.variantCount());
+
+        ImGui::Checkbox("Dynamic resolution", &dynamicResolution.settings.enabled);
+        if (dynamicResolution.settings.enabled) {
+            ImGui::SliderFloat("Target ms", &dynamicResolution.settings.targetMs, 4.0f, 50.0f, "%.1f");
+        } else {
+            float scale = dynamicResolution.scale();
+            if (ImGui::SliderFloat("Render scale", &scale, dynamicResolution.settings.minScale,
+                                   dynamicResolution.settings.maxScale, "%.2f")) {
+                dynamicResolution.SetScale(scale);
+            }
+        }
         ImGui::Text("Press the key h to hide/show infos");
         ImGui::End();
 
@@ -157,8 +353,115 @@ void RenderImGui(IMGUIIntegration imIntegration, const Camera& camera)
     ImGui::Render();
 }
 
-int main(int /*argc*/, char** /*argv*/)
+// Every shadow light gets its own secondary, the lighting pass is split into chunks of the sorted draw list.
+// With the depth pre-pass its chunks come first, the lighting chunks only test against the finished depth.
+// The terrain goes into the first lighting chunk. The passes only begin the rendering and execute these in the
+// primary.
+void RecordSecondaries(ParallelRecorder&                           recorder,
+                       uint32_t                                    frameSlot,
+                       ShadowPass&                                 shadowPass,
+                       LightningPass&                              lightningPass,
+                       DrawList&                                   drawList,
+                       const Terrain*                              terrain,
+                       const std::function<void(VkCommandBuffer)>& bindLightningState)
+{
+    const uint32_t lightCount = shadowPass.lightCount();
+    const uint32_t drawCount  = drawList.packetCount();
+    const uint32_t chunkCount = std::max(std::min(recorder.workerCount(), drawCount), 1u);
+    const uint32_t chunkSize  = (drawCount + chunkCount - 1) / chunkCount;
+
+    std::vector<ParallelRecorder::Job> jobs;
+    for (uint32_t light = 0; light < lightCount; light++) {
+        jobs.push_back({
+            .renderingInfo = shadowPass.InheritanceRenderingInfo(),
+            .record =
+                [&, light](VkCommandBuffer cmd) {
+                    shadowPass.RecordNthPass(cmd, light, [&](VkCommandBuffer secondary, uint8_t n) {
+                        drawList.Record(secondary, DrawPass::Shadow, n, 0, drawCount);
+                    });
+                },
+        });
+    }
+
+    std::vector<DrawPass> lightningDrawPasses = {DrawPass::Lighting};
+    if (lightningPass.depthPrepass()) {
+        lightningDrawPasses.insert(lightningDrawPasses.begin(), DrawPass::DepthPrepass);
+    }
+
+    for (const DrawPass pass : lightningDrawPasses) {
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+            jobs.push_back({
+                .renderingInfo = lightningPass.InheritanceRenderingInfo(),
+                .record =
+                    [&, pass, chunk](VkCommandBuffer cmd) {
+                        lightningPass.RecordPass(cmd, [&](VkCommandBuffer secondary) {
+                            bindLightningState(secondary);
+                            if (terrain != nullptr && pass == DrawPass::Lighting && chunk == 0) {
+                                terrain->Record(secondary, lightningPass.terrainPipeline(),
+                                                lightningPass.terrainPipelineLayout(),
+                                                lightningPass.pushConstantStages());
+                            }
+                            const uint32_t view = (pass == DrawPass::DepthPrepass) ? PREPASS_VIEW : LIGHTING_VIEW;
+                            drawList.Record(secondary, pass, view, chunk * chunkSize, chunkSize);
+                        });
+                    },
+            });
+        }
+    }
+
+    recorder.BeginFrame(frameSlot);
+    std::vector<VkCommandBuffer> secondaries = recorder.Record(jobs);
+
+    shadowPass.SetSecondaryCommandBuffers({secondaries.begin(), secondaries.begin() + lightCount});
+    lightningPass.SetSecondaryCommandBuffers({secondaries.begin() + lightCount, secondaries.end()});
+}
+
+int main(int argc, char** argv)
 {
+    const Options options = ParseOptions(argc, argv);
+    if (options.benchTransforms) {
+        return RunTransformBenchmark();
+    }
+    if (options.benchVertexFormats) {
+        return RunVertexFormatBenchmark();
+    }
+
+    if (options.sceneCompileInput != nullptr) {
+        SceneFile scene;
+        if (!scene.Load(options.sceneCompileInput) || !scene.WriteBinary(options.sceneCompileOutput)) {
+            return -1;
+        }
+        printf("Compiled %s into %s, %u nodes, %u textures\n", options.sceneCompileInput, options.sceneCompileOutput,
+               scene.nodeCount(), scene.textureCount());
+        return 0;
+    }
+
+    JobSystem jobSystem(options.workerCount);
+    if (options.benchJobs) {
+        return RunJobSystemBenchmark(jobSystem);
+    }
+
+    // loaded before the window opens, a broken file exits right away
+    SceneFile                    scene;
+    std::unique_ptr<StressSweep> sweep;
+    if (options.stress.objectCount > 0) {
+        if (options.stressSweepPath != nullptr) {
+            sweep = std::make_unique<StressSweep>(options.stress, options.stressSweepPath);
+        }
+
+        const uint32_t objectCount = sweep ? sweep->objectCount() : options.stress.objectCount;
+        GenerateStressScene(options.stress, objectCount, scene);
+        printf("Stress scene: %u objects, %u nodes, seed %u\n", objectCount, scene.nodeCount(), options.stress.seed);
+    } else if (options.scenePath != nullptr) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!scene.Load(options.scenePath)) {
+            return -1;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        printf("Scene %s: %u nodes, %s in %.3f ms\n", options.scenePath, scene.nodeCount(),
+               scene.isMapped() ? "mapped" : "parsed", std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
     if (glfwVulkanSupported()) {
         printf("Failed to look up minimal Vulkan loader/ICD\n!");
         return -1;
@@ -170,7 +473,7 @@ int main(int /*argc*/, char** /*argv*/)
     }
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     uint32_t     count          = 0;
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
@@ -192,7 +495,9 @@ int main(int /*argc*/, char** /*argv*/)
     uint32_t    windowHeight = 900;
     GLFWwindow* window       = glfwCreateWindow(windowWidth, windowHeight, "hf1 - h257398", NULL, NULL);
 
-    Camera camera({windowWidth, windowHeight}, 45.0f, 0.1f, 100.0f);
+    // the terrain is seen from much further away than the scene
+    const float farPlane = options.terrain ? std::max(options.terrainSettings.viewDistance, 100.0f) : 100.0f;
+    Camera      camera({windowWidth, windowHeight}, 45.0f, 0.1f, farPlane);
 
     IMGUIIntegration imIntegration;
     imIntegration.Init(window);
@@ -200,6 +505,7 @@ int main(int /*argc*/, char** /*argv*/)
     glfwSetWindowUserPointer(window, &camera);
     glfwSetKeyCallback(window, KeyCallback);
     glfwSetCursorPosCallback(window, MouseCallback);
+    glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
 
     // We have the window, the instance, create a surface from the window to draw onto.
     // Create a Vulkan Surface using GLFW.
@@ -215,63 +521,399 @@ int main(int /*argc*/, char** /*argv*/)
     uint32_t         queueFamilyIdx = context.queueFamilyIdx();
     VkQueue          queue          = context.queue();
 
-    Swapchain swapchain(instance, phyDevice, device, surface, {windowWidth, windowHeight});
+    Swapchain swapchain(instance, phyDevice, device, surface, {windowWidth, windowHeight}, options.presentMode,
+                        options.swapchainImages);
     VkResult  swapchainCreated = swapchain.Create();
     assert(swapchainCreated == VK_SUCCESS);
 
+    printf("Present mode: %s (requested %s), %zu swapchain images\n",
+           Swapchain::PresentModeName(swapchain.presentMode()), Swapchain::PresentModeName(options.presentMode),
+           swapchain.images().size());
+
+    // the CPU records the next frames while the GPU works on the previous ones, it only waits for the
+    // fence of a frame when it wants to reuse its command buffers
+    const uint32_t framesInFlight = std::min(options.framesInFlight, static_cast<uint32_t>(swapchain.images().size()));
+
     VkCommandPool cmdPool = context.CreateCommandPool();
 
-    std::vector<VkCommandBuffer> cmdBuffers = AllocateCommandBuffers(device, cmdPool, swapchain.images().size());
+    if (options.validateGpuMeshes || options.benchMeshGen) {
+        GpuMeshGenerator generator(context);
+
+        int result = options.validateGpuMeshes ? RunGpuMeshValidation(generator) : 0;
+        if (result == 0 && options.benchMeshGen) {
+            result = RunMeshGenerationBenchmark(context, generator);
+        }
+        generator.Destroy();
+        return result;
+    }
 
-    VkFence     imageFence       = CreateFence(device);
-    VkSemaphore presentSemaphore = CreateSemaphore(device);
+    std::vector<VkCommandBuffer> cmdBuffers = AllocateCommandBuffers(device, cmdPool, framesInFlight);
+
+    std::vector<VkFence>     frameFences;
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+        frameFences.push_back(CreateFence(device));
+        imageAvailableSemaphores.push_back(CreateSemaphore(device));
+    }
+
+    // present waits on these, one per image so a semaphore is never reused while a present might still wait on it
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    for (size_t idx = 0; idx < swapchain.images().size(); idx++) {
+        renderFinishedSemaphores.push_back(CreateSemaphore(device));
+    }
 
     imIntegration.CreateContext(context, swapchain);
 
-    camera.CreateVK(context.device());
+    camera.CreateVK(context);
 
     VkFormat              depthFormat = VK_FORMAT_D32_SFLOAT;
-    VkSampleCountFlagBits msaaLevel   = context.GetMaxSampleCountFlagBit();
-    // VkSampleCountFlagBits msaaLevel = VK_SAMPLE_COUNT_1_BIT;
+    VkSampleCountFlagBits maxSamples  = context.GetMaxSampleCountFlagBit();
 
-    TextureManager textureManager(context);
-    LightManager   lightManager(context);
+    const std::vector<AntiAliasingMode> aaModes = AntiAliasingModes(maxSamples);
+
+    // the requested sample count or the closest one below it, the last msaa mode is the best the device has
+    uint32_t aaModeIdx = options.taa ? uint32_t(aaModes.size() - 1) : uint32_t(aaModes.size() - 2);
+    if (!options.taa && options.aaSamples != 0) {
+        while (aaModeIdx > 0 && aaModes[aaModeIdx].samples > options.aaSamples) {
+            aaModeIdx--;
+        }
+    }
+    VkSampleCountFlagBits msaaLevel = aaModes[aaModeIdx].samples;
+
+    // the passes build their vertex input from the format of the meshes, so it is set before any of them
+    VertexFormat vertexFormat = options.vertexFormat;
+    if (!vertexFormat.IsSupported(phyDevice) && vertexFormat.normal == VertexFormat::Normal::A2B10G10R10) {
+        printf("The device can't fetch A2B10G10R10 normals, using octahedral ones instead\n");
+        vertexFormat.normal = VertexFormat::Normal::Octahedral;
+    }
+    if (!vertexFormat.IsSupported(phyDevice)) {
+        printf("The device can't fetch the vertex format %s\n", vertexFormat.Name().c_str());
+        return -1;
+    }
+    MeshCache::Get().SetVertexFormat(vertexFormat);
+    printf("Vertex format %s: %u bytes per vertex for the lighting, %u for the shadows and the pre-pass\n",
+           vertexFormat.Name().c_str(), vertexFormat.vertexSize(), vertexFormat.positionSize());
+
+    std::unique_ptr<GpuMeshGenerator> meshGenerator;
+    if (options.gpuMeshes) {
+        meshGenerator = std::make_unique<GpuMeshGenerator>(context);
+        MeshCache::Get().SetGenerator(meshGenerator.get());
+        if (vertexFormat.Name() != VertexFormat().Name()) {
+            printf("The compute shader only writes float vertices, the primitives are generated on the CPU\n");
+        }
+    }
+
+    TextureManager textureManager(context, jobSystem);
+    LightManager   lightManager(context, options.lightCount);
+
+    RenderTargetAllocator renderTargets(phyDevice, device);
 
     uint32_t   shadowResolution = 2 * 1024;
-    ShadowPass shadowPass(context, lightManager, depthFormat, {shadowResolution, shadowResolution});
+    ShadowPass shadowPass(context, lightManager, renderTargets, depthFormat, {shadowResolution, shadowResolution});
 
-    LightningPass lightningPass(context, textureManager, lightManager, shadowPass, swapchain.format(), msaaLevel,
-                                depthFormat, swapchain.surfaceExtent());
+    LightningPass lightningPass(context, textureManager, lightManager, shadowPass, renderTargets, swapchain.format(),
+                                msaaLevel, depthFormat, swapchain.surfaceExtent());
 
-    ObjectManager objectManager(context, lightningPass, shadowPass);
+    std::unique_ptr<ShaderHotReload> hotReload;
+    if (options.hotReload && !ShaderHotReload::Available()) {
+        printf("Built without glslang, the shaders are not reloaded\n");
+    } else if (options.hotReload) {
+        hotReload = std::make_unique<ShaderHotReload>(HF1_SHADER_DIR);
+        printf("Watching %s for shader changes\n", hotReload->directory().c_str());
+    }
+
+    // Receives the shadows but doesn't cast any, the shadow maps only cover the scene anyway.
+    std::unique_ptr<Terrain> terrain;
+    if (options.terrain) {
+        terrain = std::make_unique<Terrain>(context, jobSystem, textureManager, options.terrainSettings,
+                                            framesInFlight);
+        lightningPass.EnableTerrain();
+    }
+
+    // the meshes go straight into device local memory, that needs the queue
+    GltfModel model;
+    if (options.gltfPath != nullptr && !model.Load(context, textureManager, options.gltfPath)) {
+        return -1;
+    }
+    const GltfModel* useModel = options.gltfPath != nullptr ? &model : nullptr;
+
+    const bool    useScene = options.scenePath != nullptr || options.stress.objectCount > 0;
+    ObjectManager objectManager(context, jobSystem, lightningPass, shadowPass, useScene ? &scene : nullptr, useModel);
+    {
+        // the ACMR of a 16 entry FIFO cache, before and after the triangles were reordered
+        const IndexStats& stats     = MeshCache::Get().indexStats();
+        const double      triangles = std::max<double>(stats.triangles, 1.0);
+        printf("Meshes: %u, %u with 16 bit indices, %u generated on the GPU, ACMR %.3f -> %.3f over %llu triangles\n",
+               stats.meshes, stats.index16Meshes, MeshCache::Get().generatedCount(), stats.missesBefore / triangles,
+               stats.missesAfter / triangles, static_cast<unsigned long long>(stats.triangles));
+    }
 
     PostProcessPass postProcess(swapchain.format(), swapchain.surfaceExtent());
-    postProcess.Create(context);
+    postProcess.Create(context, options.postProcessMode);
+    uint32_t postProcessMode = postProcess.mode();
+    postProcess.chain().SetBlurRadius(options.blurRadius);
+    if (!postProcess.SetChain(renderTargets, options.postChain, options.postChainFused)) {
+        printf("Creating the pipelines of the post process chain failed, running without it\n");
+    }
+    bool     postChainFused = postProcess.chain().fused();
+    uint32_t blurRadius     = postProcess.chain().blurRadius();
+
+    lightningPass.SetAntiAliasing(renderTargets, msaaLevel, aaModes[aaModeIdx].temporal);
+    postProcess.EnableTemporalResolve(renderTargets, aaModes[aaModeIdx].temporal);
+
+    depthPrepass = options.depthPrepass;
+    lightningPass.SetDepthPrepass(depthPrepass);
+
+    lightningPass.SetShading({
+        .shadowFilter = options.pcfShadows ? LightningPass::ShadowFilter::Pcf : LightningPass::ShadowFilter::Hard,
+        .pcfRadius    = options.pcfRadius,
+    });
+    LightningPass::ShadingOptions shading = lightningPass.shading();
+
+    const auto bindLightningState = [&](VkCommandBuffer cmd) {
+        lightManager.BindDescriptorSets(cmd, lightningPass.pipelineLayout());
+        shadowPass.BindDescriptorSets(cmd, lightningPass.pipelineLayout());
+        camera.BindDescriptorSets(cmd, lightningPass.pipelineLayout());
+    };
+
+    // the graph refers to the render targets, it is built again whenever they are recreated
+    RenderGraph             frameGraph;
+    RenderGraph::ResourceId swapchainTarget = 0;
+
+    const auto buildFrameGraph = [&]() {
+        frameGraph.Reset();
+
+        swapchainTarget = frameGraph.ImportImage("swapchain", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT);
+        frameGraph.MarkOutput(swapchainTarget, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        const std::vector<RenderGraph::ResourceId> shadowMaps =
+            shadowPass.AddToGraph(frameGraph, [&](VkCommandBuffer cmd, uint8_t light) {
+                DrawList& drawList = objectManager.drawList();
+                drawList.Record(cmd, DrawPass::Shadow, light, 0, drawList.packetCount());
+            });
+
+        const LightningPass::GraphOutputs lit =
+            lightningPass.AddToGraph(frameGraph, shadowMaps, [&](VkCommandBuffer cmd) {
+                DrawList& drawList = objectManager.drawList();
+                bindLightningState(cmd);
+                if (lightningPass.depthPrepass()) {
+                    drawList.Record(cmd, DrawPass::DepthPrepass, PREPASS_VIEW, 0, drawList.packetCount());
+                }
+                // not in the pre-pass, it writes its own depth and hides the objects behind it from the EQUAL test
+                if (terrain) {
+                    terrain->Record(cmd, lightningPass.terrainPipeline(), lightningPass.terrainPipelineLayout(),
+                                    lightningPass.pushConstantStages());
+                }
+                drawList.Record(cmd, DrawPass::Lighting, LIGHTING_VIEW, 0, drawList.packetCount());
+            });
+
+        RenderGraph::ResourceId postInput = lit.color;
+        if (postProcess.temporalResolve()) {
+            postInput = postProcess.AddTemporalResolve(frameGraph, lit.color, lit.velocity);
+        }
+
+        postProcess.AddToGraph(frameGraph, postInput, swapchainTarget,
+                               [&](VkCommandBuffer cmd) { imIntegration.Draw(cmd); });
+
+        frameGraph.Compile();
+        frameGraph.ApplyLifetimes(renderTargets);
+
+        VkResult renderTargetsAllocated = renderTargets.Allocate();
+        assert(renderTargetsAllocated == VK_SUCCESS);
+
+        postProcess.BindInputImages(context.device(), lightningPass.colorOutput(),
+                                    lightningPass.temporal() ? &lightningPass.velocityOutput() : nullptr);
+    };
+    buildFrameGraph();
+
+    // Switching between msaa and TAA recreates the lighting pipeline and the targets, fine for benchmarking.
+    const auto setAntiAliasing = [&](const AntiAliasingMode& mode) {
+        vkDeviceWaitIdle(device);
+
+        lightningPass.SetAntiAliasing(renderTargets, mode.samples, mode.temporal);
+        postProcess.EnableTemporalResolve(renderTargets, mode.temporal);
+        buildFrameGraph();
+
+        camera.ResetHistory();
+    };
+
+    // Only the swapchain and the targets that depend on its size are recreated, pipelines and assets stay.
+    const auto recreateSwapchain = [&]() {
+        int width  = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        // a minimized window has no size, there is nothing to render until it comes back
+        while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+            glfwWaitEvents();
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        // every frame in flight still uses the old images and the descriptors of the targets
+        vkDeviceWaitIdle(device);
+
+        VkResult swapchainRecreated = swapchain.Recreate({uint32_t(width), uint32_t(height)});
+        assert(swapchainRecreated == VK_SUCCESS);
+
+        const VkExtent2D extent = swapchain.surfaceExtent();
+        lightningPass.Resize(renderTargets, extent);
+        postProcess.Resize(renderTargets, extent);
+        buildFrameGraph();
+
+        camera.SetViewport(extent);
+        camera.ResetHistory();
+        imIntegration.UpdateImageCount(swapchain);
+
+        // the image count can change with the swapchain
+        for (VkSemaphore semaphore : renderFinishedSemaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        renderFinishedSemaphores.clear();
+        for (size_t idx = 0; idx < swapchain.images().size(); idx++) {
+            renderFinishedSemaphores.push_back(CreateSemaphore(device));
+        }
+
+        framebufferResized = false;
+    };
 
-    postProcess.BindInputImage(context.device(), lightningPass.colorOutput());
+    ParallelRecorder recorder(jobSystem, device, queueFamilyIdx, framesInFlight);
+
+    GpuTimer          gpuTimer(phyDevice, device, queueFamilyIdx, framesInFlight);
+    DynamicResolution dynamicResolution(1000.0f / options.targetFps);
+
+    // everything is created, from now on the transforms belong to the simulation thread
+    Simulation simulation(60.0, [&](float deltaTime) { objectManager.Tick(deltaTime); });
+    simulation.Start();
 
     // glfwShowWindow(window);
 
+    uint32_t frameIdx     = 0;
+    uint32_t jitterIdx    = 0;
+    uint32_t appliedAAIdx = aaModeIdx;
+
+    auto lastFrameStart = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window)) {
+        // wait before sampling the input, so what ends up on the screen is as fresh as possible
+        vkWaitForFences(device, 1, &frameFences[frameIdx], VK_TRUE, UINT64_MAX);
+
+        // the fence also means the timestamps of the frame are written
+        double     gpuMs   = 0.0;
+        const bool gpuRead = gpuTimer.Read(frameIdx, gpuMs);
+        if (gpuRead) {
+            dynamicResolution.Update(gpuMs);
+        }
+
+        // the whole loop from one frame to the next, with the present waits and everything
+        const auto   frameStart = std::chrono::steady_clock::now();
+        const double frameMs    = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+        lastFrameStart          = frameStart;
+
+        if (sweep && sweep->AddFrame(frameMs, gpuRead ? gpuMs : -1.0, simulation.lastTickMs(),
+                                     objectManager.drawList().stats().draws)) {
+            // the next step gets a new scene, nothing may use the old one anymore
+            vkDeviceWaitIdle(device);
+            simulation.Stop();
+            objectManager.Destroy(device);
+            if (sweep->finished()) {
+                break;
+            }
+
+            GenerateStressScene(options.stress, sweep->objectCount(), scene);
+            objectManager.Load(context, lightningPass, shadowPass, &scene, useModel);
+            simulation.Start();
+            lastFrameStart = std::chrono::steady_clock::now();
+        }
+        lightningPass.SetRenderScale(dynamicResolution.scale());
+        postProcess.SetRenderScale(lightningPass.renderScale());
+
         glfwPollEvents();
         camera.Update();
         HandleJoystick(&camera);
 
-        objectManager.Tick();
-        lightManager.Tick(0.6f);
-        // lightManager.Tick(0.0f);
+        // every frame samples a different position inside the pixel, the resolve accumulates them
+        if (lightningPass.temporal()) {
+            camera.SetJitter(Camera::HaltonJitter(jitterIdx++), lightningPass.renderExtent());
+        } else {
+            camera.SetJitter(glm::vec2(0.0f), lightningPass.renderExtent());
+        }
 
-        RenderImGui(imIntegration, camera);
+        const double simTime = simulation.Interpolate();
+        lightManager.Update(simTime);
 
-        // Get new image to render to
-        vkResetFences(device, 1, &imageFence);
+        RenderImGui(imIntegration, camera, simulation, swapchain, framesInFlight, dynamicResolution, lightningPass,
+                    objectManager.drawList().stats(), terrain.get(), aaModes, aaModeIdx, shading, postProcess,
+                    postProcessMode, postChainFused, blurRadius);
+        if (aaModeIdx != appliedAAIdx) {
+            setAntiAliasing(aaModes[aaModeIdx]);
+            appliedAAIdx = aaModeIdx;
+        }
+        if (depthPrepass != lightningPass.depthPrepass()) {
+            vkDeviceWaitIdle(device);
+            lightningPass.SetDepthPrepass(depthPrepass);
+        }
+        // the pipelines of the previous variants may still be in flight, they stay in the caches
+        if (shading != lightningPass.shading()) {
+            lightningPass.SetShading(shading);
+        }
+        if (postProcessMode != postProcess.mode()) {
+            postProcess.SetMode(postProcessMode);
+        }
+        // a failed variant keeps the previous pipelines, the controls go back to what is in use
+        if (blurRadius != postProcess.chain().blurRadius() && !postProcess.chain().SetBlurRadius(blurRadius)) {
+            printf("Creating the blur pipelines of radius %u failed\n", blurRadius);
+            blurRadius = postProcess.chain().blurRadius();
+        }
+        // the dispatches and the intermediate images change with it
+        if (postChainFused != postProcess.chain().fused()) {
+            vkDeviceWaitIdle(device);
+            if (postProcess.SetChain(renderTargets, postProcess.chain().effects(), postChainFused)) {
+                buildFrameGraph();
+            } else {
+                printf("Creating the pipelines of the post process chain failed, keeping the previous ones\n");
+                postChainFused = postProcess.chain().fused();
+            }
+        }
+        if (hotReload) {
+            ReloadShaders(*hotReload, device, lightningPass, shadowPass, postProcess);
+        }
 
-        const Swapchain::Image& swapchainImage = swapchain.AquireNextImage(imageFence);
+        // Every view gets its own levels of detail and its own order, the pre-pass and the lighting sort with their
+        // own pipelines. The shadows are coarser, their silhouette is blurred by the filtering anyway.
+        objectManager.BuildDrawList();
+        DrawList& drawList = objectManager.drawList();
+        for (uint8_t light = 0; light < lightManager.lightCount(); light++) {
+            const LightManager::Light lightView = lightManager.light(light);
+            drawList.SelectLods(light, lightView.view, lightView.projection, options.lodBias + options.shadowLodBias);
+            drawList.Sort(light, DrawPass::Shadow, lightView.view);
+        }
+        drawList.SelectLods(LIGHTING_VIEW, camera.view(), camera.projection(), options.lodBias);
+        if (lightningPass.depthPrepass()) {
+            drawList.ShareLods(PREPASS_VIEW, LIGHTING_VIEW);
+            drawList.Sort(PREPASS_VIEW, DrawPass::DepthPrepass, camera.view());
+        }
+        drawList.Sort(LIGHTING_VIEW, DrawPass::Lighting, camera.view());
+        if (terrain) {
+            terrain->Update(camera.position(), camera.projection() * camera.view());
+        }
+
+        // Get new image to render to, the GPU waits for it instead of the CPU
+        const VkResult acquireResult = swapchain.AquireNextImage(imageAvailableSemaphores[frameIdx]);
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing was acquired, so the semaphore and the fence of the frame are untouched
+            recreateSwapchain();
+            continue;
+        }
+        // suboptimal still acquired an image, it is recreated after the present
+        assert(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+
+        // only reset when there is going to be a submit to signal it again
+        vkResetFences(device, 1, &frameFences[frameIdx]);
 
-        vkWaitForFences(device, 1, &imageFence, VK_TRUE, UINT64_MAX);
+        const Swapchain::Image& swapchainImage = swapchain.currentImage();
 
-        // Get command buffer based on swapchain image index
-        VkCommandBuffer cmdBuffer = cmdBuffers[swapchainImage.idx];
+        VkCommandBuffer cmdBuffer = cmdBuffers[frameIdx];
 
         // Begin command buffer record
         const VkCommandBufferBeginInfo beginInfo = {
@@ -282,46 +924,73 @@ int main(int /*argc*/, char** /*argv*/)
         };
         vkBeginCommandBuffer(cmdBuffer, &beginInfo);
 
-        swapchain.CmdTransitionToRender(cmdBuffer, swapchainImage, queueFamilyIdx);
+        // Taken once the acquire wait is over, with FIFO the time spent waiting for the image would otherwise
+        // look like GPU work to the resolution controller.
+        gpuTimer.CmdBegin(cmdBuffer, frameIdx, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
 
-        shadowPass.DoPass(cmdBuffer, [&](VkCommandBuffer cmd) { objectManager.Draw(cmd, false); });
-
-        lightningPass.DoPass(cmdBuffer, [&](VkCommandBuffer cmd) {
-            lightManager.BindDescriptorSets(cmd, lightningPass.pipelineLayout());
-            shadowPass.BindDescriptorSets(cmd, lightningPass.pipelineLayout());
+        if (parallelRecording) {
+            RecordSecondaries(recorder, frameIdx, shadowPass, lightningPass, drawList, terrain.get(),
+                              bindLightningState);
+        } else {
+            shadowPass.SetSecondaryCommandBuffers({});
+            lightningPass.SetSecondaryCommandBuffers({});
+        }
 
-            camera.PushConstants(cmd);
-            objectManager.Draw(cmd, true);
-        });
+        lightManager.CmdUpload(cmdBuffer);
+        camera.CmdUpload(cmdBuffer);
+        if (terrain) {
+            terrain->CmdUpload(cmdBuffer, frameIdx);
+        }
 
-        postProcess.DoPass(cmdBuffer, swapchainImage, [&](VkCommandBuffer cmd) { imIntegration.Draw(cmd); });
+        frameGraph.SetImage(swapchainTarget, swapchainImage.image);
+        postProcess.SetTargetView(swapchainImage.view);
+        postProcess.BeginFrame(frameGraph);
+        frameGraph.Execute(cmdBuffer);
 
+        gpuTimer.CmdEnd(cmdBuffer, frameIdx);
         vkEndCommandBuffer(cmdBuffer);
 
-        // Execute recorded commands
-        const VkSubmitInfo submitInfo = {
+        // Execute recorded commands, only the writes to the swapchain image have to wait for the acquire
+        const VkPipelineStageFlags waitStage        = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        const VkSemaphore          presentSemaphore = renderFinishedSemaphores[swapchainImage.idx];
+        const VkSubmitInfo         submitInfo       = {
             .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext                = nullptr,
-            .waitSemaphoreCount   = 0,
-            .pWaitSemaphores      = nullptr,
-            .pWaitDstStageMask    = nullptr,
+            .waitSemaphoreCount   = 1,
+            .pWaitSemaphores      = &imageAvailableSemaphores[frameIdx],
+            .pWaitDstStageMask    = &waitStage,
             .commandBufferCount   = 1,
             .pCommandBuffers      = &cmdBuffer,
             .signalSemaphoreCount = 1,
             .pSignalSemaphores    = &presentSemaphore,
         };
-        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueSubmit(queue, 1, &submitInfo, frameFences[frameIdx]);
 
         // Present current image
-        swapchain.QueuePresent(queue, presentSemaphore);
+        const VkResult presentResult = swapchain.QueuePresent(queue, presentSemaphore);
 
-        vkDeviceWaitIdle(device);
+        frameIdx = (frameIdx + 1) % framesInFlight;
+
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR ||
+            acquireResult == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            recreateSwapchain();
+        }
     }
 
+    vkDeviceWaitIdle(device);
+
+    simulation.Stop();
+    recorder.Destroy();
+    gpuTimer.Destroy();
     imIntegration.Destroy(context);
 
-    vkDestroyFence(device, imageFence, nullptr);
-    vkDestroySemaphore(device, presentSemaphore, nullptr);
+    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+        vkDestroyFence(device, frameFences[frame], nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphores[frame], nullptr);
+    }
+    for (VkSemaphore semaphore : renderFinishedSemaphores) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
 
     vkDestroyCommandPool(device, cmdPool, nullptr);
 
@@ -329,9 +998,17 @@ int main(int /*argc*/, char** /*argv*/)
     postProcess.Destroy(context);
     lightningPass.Destroy();
     shadowPass.Destroy(device);
+    renderTargets.Destroy();
     lightManager.Destroy();
+    if (terrain) {
+        terrain->Destroy();
+    }
     textureManager.Destroy();
     objectManager.Destroy(device);
+    model.Destroy(device);
+    if (meshGenerator) {
+        meshGenerator->Destroy();
+    }
     swapchain.Destroy();
     context.Destroy();
 
@@ -0,0 +1,183 @@
+#include "DrawList.h"
+
+#include "../primitives/BasePrimitive.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// 8 bits pipeline, 16 bits texture, 16 bits mesh, 24 bits depth bucket
+constexpr uint32_t DEPTH_BITS     = 24;
+constexpr uint32_t MESH_SHIFT     = DEPTH_BITS;
+constexpr uint32_t TEXTURE_SHIFT  = MESH_SHIFT + 16;
+constexpr uint32_t PIPELINE_SHIFT = TEXTURE_SHIFT + 16;
+
+// Positive floats compare the same way as their bits, the top 24 bits (without the sign) are the bucket.
+// Everything behind the view ends up in bucket 0, it is most likely culled anyway.
+uint64_t DepthBucket(const float depth)
+{
+    const float clamped = std::max(depth, 0.0f);
+    uint32_t    bits    = 0;
+    memcpy(&bits, &clamped, sizeof(bits));
+    return bits >> (31 - DEPTH_BITS);
+}
+} // namespace
+
+void DrawList::Clear()
+{
+    m_stats = {
+        .draws         = m_draws.exchange(0),
+        .pipelineBinds = m_pipelineBinds.exchange(0),
+        .pipelineSkips = m_pipelineSkips.exchange(0),
+        .textureBinds  = m_textureBinds.exchange(0),
+        .textureSkips  = m_textureSkips.exchange(0),
+        .meshBinds     = m_meshBinds.exchange(0),
+        .meshSkips     = m_meshSkips.exchange(0),
+        .vertexBytes   = m_vertexBytes.exchange(0),
+        .triangles     = m_triangles.exchange(0),
+    };
+
+    m_packets.clear();
+    for (std::vector<uint32_t>& order : m_views) {
+        order.clear();
+    }
+}
+
+void DrawList::Add(const BasePrimitive* primitive, const glm::mat4& model, const glm::mat4& prevModel)
+{
+    m_packets.push_back({primitive, model, prevModel});
+}
+
+std::vector<uint8_t>& DrawList::ViewLods(const uint32_t view)
+{
+    if (view >= m_lods.size()) {
+        m_lods.resize(view + 1);
+    }
+    // a changed scene starts from whatever was picked for the packet with the same index, it settles in a frame
+    std::vector<uint8_t>& lods = m_lods[view];
+    lods.resize(m_packets.size(), 0);
+    return lods;
+}
+
+void DrawList::SelectLods(const uint32_t   view,
+                          const glm::mat4& viewMatrix,
+                          const glm::mat4& projection,
+                          const float      bias)
+{
+    std::vector<uint8_t>& lods = ViewLods(view);
+
+    for (uint32_t idx = 0; idx < m_packets.size(); idx++) {
+        const Packet&        packet    = m_packets[idx];
+        const BasePrimitive& primitive = *packet.primitive;
+        if (primitive.lodCount() == 1 || primitive.radius() <= 0.0f) {
+            lods[idx] = 0;
+            continue;
+        }
+
+        // The radius grows with the largest scale of the model. The diameter in view heights is radius * p11 / w,
+        // w is the distance along the view for perspective projections and 1 for orthographic ones.
+        const float scale = std::sqrt(std::max({glm::dot(packet.model[0], packet.model[0]),
+                                                glm::dot(packet.model[1], packet.model[1]),
+                                                glm::dot(packet.model[2], packet.model[2])}));
+        const glm::vec4 clip = projection * (viewMatrix * packet.model[3]);
+        const float     w    = std::max(std::fabs(clip.w), 1e-3f);
+        const float     size = primitive.radius() * scale * std::fabs(projection[1][1]) / w;
+
+        // continuous level, the current one is kept while it stays within the hysteresis around its range
+        const float    level    = std::log2(LOD_FULL_SIZE / std::max(size, 1e-6f)) + bias;
+        const uint32_t maxLevel = primitive.lodCount() - 1;
+        const uint32_t current  = std::min<uint32_t>(lods[idx], maxLevel);
+        if (level >= current - LOD_HYSTERESIS && level < current + 1 + LOD_HYSTERESIS) {
+            lods[idx] = static_cast<uint8_t>(current);
+        } else {
+            lods[idx] = static_cast<uint8_t>(std::clamp(level, 0.0f, float(maxLevel)));
+        }
+    }
+}
+
+void DrawList::ShareLods(const uint32_t view, const uint32_t source)
+{
+    const std::vector<uint8_t> lods = ViewLods(source);
+    ViewLods(view)                  = lods;
+}
+
+void DrawList::Sort(const uint32_t view, const DrawPass pass, const glm::mat4& viewMatrix)
+{
+    if (view >= m_views.size()) {
+        m_views.resize(view + 1);
+    }
+
+    // there are only a handful of pipelines, they get dense ids in the order they show up
+    std::vector<VkPipeline>     pipelines;
+    const std::vector<uint8_t>& lods = ViewLods(view);
+
+    struct Entry {
+        uint64_t key;
+        uint32_t packet;
+    };
+    std::vector<Entry> entries;
+    entries.reserve(m_packets.size());
+
+    for (uint32_t idx = 0; idx < m_packets.size(); idx++) {
+        const Packet&        packet    = m_packets[idx];
+        const BasePrimitive& primitive = *packet.primitive;
+
+        const VkPipeline pipeline = primitive.pipeline(pass);
+        auto             it       = std::find(pipelines.begin(), pipelines.end(), pipeline);
+        if (it == pipelines.end()) {
+            it = pipelines.insert(pipelines.end(), pipeline);
+        }
+        const uint64_t pipelineId = static_cast<uint64_t>(it - pipelines.begin());
+
+        // only the lighting binds the textures, the other passes ignore them in the key
+        const uint64_t textureId = (pass == DrawPass::Lighting) ? primitive.textureId() : 0;
+
+        // the view looks down -z, the origin of the primitive is close enough for the ordering
+        const float depth = -(viewMatrix * packet.model[3]).z;
+
+        const uint64_t key = (pipelineId & 0xff) << PIPELINE_SHIFT | (textureId & 0xffff) << TEXTURE_SHIFT |
+                             (uint64_t(primitive.meshId(lods[idx])) & 0xffff) << MESH_SHIFT | DepthBucket(depth);
+        entries.push_back({key, idx});
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.key < rhs.key; });
+
+    std::vector<uint32_t>& order = m_views[view];
+    order.resize(entries.size());
+    for (uint32_t idx = 0; idx < entries.size(); idx++) {
+        order[idx] = entries[idx].packet;
+    }
+}
+
+void DrawList::Record(const VkCommandBuffer cmdBuffer,
+                      const DrawPass        pass,
+                      const uint32_t        view,
+                      const uint32_t        first,
+                      const uint32_t        count)
+{
+    assert(view < m_views.size());
+    assert(view < m_lods.size() && m_lods[view].size() == m_packets.size());
+    const std::vector<uint32_t>& order = m_views[view];
+    const std::vector<uint8_t>&  lods  = m_lods[view];
+
+    DrawRecordState state;
+
+    const uint32_t last = std::min<uint32_t>(first + count, static_cast<uint32_t>(order.size()));
+    for (uint32_t idx = first; idx < last; idx++) {
+        const uint32_t packetIdx = order[idx];
+        const Packet&  packet    = m_packets[packetIdx];
+        packet.primitive->record(cmdBuffer, pass, lods[packetIdx], packet.model, packet.prevModel, state);
+    }
+
+    m_draws += last > first ? last - first : 0;
+    m_pipelineBinds += state.pipelineBinds;
+    m_pipelineSkips += state.pipelineSkips;
+    m_textureBinds += state.textureBinds;
+    m_textureSkips += state.textureSkips;
+    m_meshBinds += state.meshBinds;
+    m_meshSkips += state.meshSkips;
+    m_vertexBytes += state.vertexBytes;
+    m_triangles += state.triangles;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "../primitives/IDrawable.h"
+#include "glm_config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class BasePrimitive;
+
+// What is bound in a command buffer at the moment, the primitives only bind what differs.
+// A secondary command buffer starts with nothing bound.
+struct DrawRecordState {
+    VkPipeline      pipeline   = VK_NULL_HANDLE;
+    VkDescriptorSet textureSet = VK_NULL_HANDLE;
+    uint32_t        mesh       = UINT32_MAX;
+
+    // the binds a naive recording would have done, split by whether they were issued
+    uint32_t pipelineBinds = 0;
+    uint32_t pipelineSkips = 0;
+    uint32_t textureBinds  = 0;
+    uint32_t textureSkips  = 0;
+    uint32_t meshBinds     = 0;
+    uint32_t meshSkips     = 0;
+
+    // vertex data the draws read, see BasePrimitive::record
+    uint64_t vertexBytes = 0;
+    uint64_t triangles   = 0;
+};
+
+// The scene flattened into one packet per primitive with its final transforms. Every view sorts the packets
+// by a 64 bit key (pipeline, texture, mesh, depth bucket), so draws sharing state end up next to each other and
+// the same state is drawn front to back, then records them skipping the binds that would not change anything.
+//
+// Before sorting, every view picks a level of detail for every packet from the projected size of its bounding
+// sphere. The level a view picked last frame is kept until the size moves past it by LOD_HYSTERESIS levels, so an
+// object sitting on a threshold does not switch every frame.
+class DrawList {
+public:
+    struct Packet {
+        const BasePrimitive* primitive;
+        glm::mat4            model;
+        glm::mat4            prevModel;
+    };
+
+    // counts of the last finished frame
+    struct Stats {
+        uint32_t draws;
+        uint32_t pipelineBinds;
+        uint32_t pipelineSkips;
+        uint32_t textureBinds;
+        uint32_t textureSkips;
+        uint32_t meshBinds;
+        uint32_t meshSkips;
+        uint64_t vertexBytes;
+        uint64_t triangles;
+    };
+
+    // projected bounding sphere diameter, in view heights, that is drawn with level 0, every level halves it
+    static constexpr float LOD_FULL_SIZE  = 0.25f;
+    static constexpr float LOD_HYSTERESIS = 0.2f;
+
+    // render thread, between two frames
+    void Clear();
+    void Add(const BasePrimitive* primitive, const glm::mat4& model, const glm::mat4& prevModel);
+
+    // Picks the levels of detail of a view, bias is added to the level and positive values are coarser. Views
+    // that never pick one draw level 0.
+    void SelectLods(uint32_t view, const glm::mat4& viewMatrix, const glm::mat4& projection, float bias);
+    // takes the levels of another view, the pre-pass has to lay down the same triangles as the lighting
+    void ShareLods(uint32_t view, uint32_t source);
+
+    // Sorts the packets for a view, the order is kept until the next Clear. Views are small indices chosen by the
+    // caller, different views can be recorded in parallel.
+    void Sort(uint32_t view, DrawPass pass, const glm::mat4& viewMatrix);
+
+    // records [first, first + count) of the sorted view, thread safe as long as nobody sorts or adds
+    void Record(VkCommandBuffer cmdBuffer, DrawPass pass, uint32_t view, uint32_t first, uint32_t count);
+
+    uint32_t     packetCount() const { return static_cast<uint32_t>(m_packets.size()); }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    std::vector<Packet>                m_packets;
+    std::vector<std::vector<uint32_t>> m_views; // packet indices in draw order
+    // Level of every packet per view, indexed like the packets. Kept across Clear for the hysteresis, the
+    // packets come in the same order every frame as long as the scene does not change.
+    std::vector<std::vector<uint8_t>> m_lods;
+
+    std::vector<uint8_t>& ViewLods(uint32_t view);
+
+    // summed up by the recordings of the current frame, moved into m_stats by Clear
+    std::atomic<uint32_t> m_draws{0};
+    std::atomic<uint32_t> m_pipelineBinds{0};
+    std::atomic<uint32_t> m_pipelineSkips{0};
+    std::atomic<uint32_t> m_textureBinds{0};
+    std::atomic<uint32_t> m_textureSkips{0};
+    std::atomic<uint32_t> m_meshBinds{0};
+    std::atomic<uint32_t> m_meshSkips{0};
+    std::atomic<uint64_t> m_vertexBytes{0};
+    std::atomic<uint64_t> m_triangles{0};
+    Stats                 m_stats = {};
+};
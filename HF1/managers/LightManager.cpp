@@ -1,40 +1,35 @@
 #include "LightManager.h"
+#include "../render_passes/SceneInterface.h"
 
+#include <algorithm>
 #include <buffer.h>
+#include <cmath>
 #include <context.h>
 
+namespace {
+// the first three are the original red, green and blue
+const glm::vec3 LIGHT_COLORS[MAX_LIGHTS] = {
+    {1.5f, 0.0f, 0.0f}, {0.0f, 1.5f, 0.0f}, {0.0f, 0.0f, 1.5f},  {1.5f, 1.5f, 0.0f},
+    {0.0f, 1.5f, 1.5f}, {1.5f, 0.0f, 1.5f}, {1.5f, 0.75f, 0.0f}, {1.0f, 1.0f, 1.0f},
+};
+} // namespace
 
-LightManager::LightManager(Context& context) : m_device(context.device())
+LightManager::LightManager(Context& context, const uint32_t lightCount) : m_device(context.device())
 {
     float lightFov = 40;
 
-    m_lights[0].position = glm::vec3(10000,-10000,10000);
-    m_lights[0].color = glm::vec3(1.5, 0.0, 0.0);
-    m_lights[0].projection = glm::perspective(glm::radians(lightFov), 1.0f, 0.1f, 100.0f);
-
-
-    m_lights[1].position = glm::vec3(10000,-10000,10000);
-    m_lights[1].color = glm::vec3(0.0, 1.5, 0.0);
-    m_lights[1].projection = glm::perspective(glm::radians(lightFov), 1.0f, 0.1f, 100.0f);
-
-    m_lights[2].position = glm::vec3(10000,-10000,10000);
-    m_lights[2].color = glm::vec3(0.0, 0.0, 1.5);
-    m_lights[2].projection = glm::perspective(glm::radians(lightFov), 1.0f, 0.1f, 100.0f);
-
-
-
-    m_lightInfo = BufferInfo::Create(context.physicalDevice(), context.device(), sizeof(m_lights), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    m_lightInfo.Update(context.device(), &m_lights, sizeof(m_lights));
+    m_uniform.count = std::clamp(lightCount, 1u, uint32_t(MAX_LIGHTS));
+    for (uint32_t idx = 0; idx < m_uniform.count; idx++) {
+        m_uniform.lights[idx].position   = glm::vec3(10000, -10000, 10000);
+        m_uniform.lights[idx].color      = LIGHT_COLORS[idx];
+        m_uniform.lights[idx].projection = glm::perspective(glm::radians(lightFov), 1.0f, 0.1f, 100.0f);
+    }
 
-    VkDescriptorSetLayoutBinding descSetLayoutBinding ={
-        .binding            = 0,
-        .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount    = 1,
-        .stageFlags         = VK_SHADER_STAGE_ALL,
-        .pImmutableSamplers = nullptr,
-    };
+    m_lightInfo = BufferInfo::Create(context.physicalDevice(), context.device(), sizeof(m_uniform),
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_lightInfo.Update(context.device(), &m_uniform, sizeof(m_uniform));
 
-    m_descSetLayout = context.descriptorPool().CreateLayout({descSetLayoutBinding});
+    m_descSetLayout = SceneInterface::CreateSetLayout(context, SceneInterface::LIGHTS_SET);
     m_descSet       = context.descriptorPool().CreateSet(m_descSetLayout);
 
     DescriptorSetMgmt setMgmt(m_descSet);
@@ -44,7 +39,8 @@ LightManager::LightManager(Context& context) : m_device(context.device())
 
 void LightManager::BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout) const
 {
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &m_descSet, 0,nullptr);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SceneInterface::LIGHTS_SET, 1,
+                            &m_descSet, 0, nullptr);
 }
 
 void LightManager::Destroy()
@@ -52,46 +48,67 @@ void LightManager::Destroy()
     m_lightInfo.Destroy(m_device);
 }
 
-void LightManager::Tick(float amount)
+void LightManager::Update(const double simTime)
 {
-    m_animationProgress += amount;
-    while (m_animationProgress >= 360.0f) m_animationProgress -= 360.0f;
+    constexpr double START_ANGLE        = 60.0;
+    constexpr double DEGREES_PER_SECOND = 36.0;
+
+    m_animationProgress = static_cast<float>(std::fmod(START_ANGLE + DEGREES_PER_SECOND * simTime, 360.0));
     SetPosition();
 }
 
 void LightManager::SetPosition()
 {
+    // The lights are the corners of a regular polygon that turns with the animation, on the circle around
+    // the triangle with 20 long sides the three lights always were.
     float s = 20.0f;
     float angleDeg = m_animationProgress;
     float angleRad = angleDeg * M_PI / 180.0f;
 
-    float h = s * std::sqrt(3.0f) / 2.0f;
-    float c = std::cos(angleRad);
-    float si = std::sin(angleRad);
+    const float radius = s / std::sqrt(3.0f);
+    for (uint32_t idx = 0; idx < m_uniform.count; idx++) {
+        Light&      light  = m_uniform.lights[idx];
+        const float corner = angleRad + glm::radians(210.0f + 360.0f * idx / m_uniform.count);
 
-    glm::vec2 A(-s/2, -h/3);
-    glm::vec2 B( s/2, -h/3);
-    glm::vec2 C( 0.0f, 2*h/3);
-
-    A = { A.x * c - A.y * si,
-          A.x * si + A.y * c};
-
-    B = { B.x * c - B.y * si,
-          B.x * si + B.y * c};
-
-    C = { C.x * c - C.y * si,
-          C.x * si + C.y * c };
+        light.position = glm::vec3(radius * std::cos(corner), 10.0f, radius * std::sin(corner));
+        light.view     = glm::lookAt(light.position, glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    }
+}
 
-    m_lights[0].position = glm::vec3(A.x, 10.0f, A.y);
-    m_lights[1].position = glm::vec3(B.x, 10.0f, B.y);
-    m_lights[2].position = glm::vec3(C.x, 10.0f, C.y);
+void LightManager::CmdUpload(VkCommandBuffer cmdBuffer) const
+{
+    // the previous frame might still read the buffer, writing it from the host would race with that
+    VkBufferMemoryBarrier2 barrier = {
+        .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .dstAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer              = m_lightInfo.buffer,
+        .offset              = 0,
+        .size                = VK_WHOLE_SIZE,
+    };
+    const VkDependencyInfo dependency = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers    = &barrier,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmdBuffer, &dependency);
 
-    for (auto & m_light : m_lights) {
-        m_light.view = glm::lookAt(
-            glm::vec3(m_light.position),
-            glm::vec3(0.0f),
-            glm::vec3(0.0f, -1.0f, 0.0f));
-    }
+    vkCmdUpdateBuffer(cmdBuffer, m_lightInfo.buffer, 0, sizeof(m_uniform), &m_uniform);
 
-    m_lightInfo.Update(m_device, &m_lights, sizeof(m_lights));
+    barrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_UNIFORM_READ_BIT;
+    vkCmdPipelineBarrier2(cmdBuffer, &dependency);
 }
@@ -4,7 +4,8 @@
 #include "glm_config.h"
 
 
-#define NUM_LIGHTS 3
+// the shaders are built for this many, the ones in use are in the uniform buffer
+#define MAX_LIGHTS 8
 class Context;
 class LightManager {
 public:
@@ -18,26 +19,38 @@ public:
         glm::mat4 view;
     };
 
-    explicit LightManager(Context& context);
+    // every light has a shadow map, so the count is fixed for the lifetime of the passes
+    LightManager(Context& context, uint32_t lightCount);
 
-    static uint8_t NumberOfLights(){return NUM_LIGHTS;}
-    Light light(const uint8_t i) const { return m_lights[i];}
+    uint32_t lightCount() const { return m_uniform.count; }
+    Light light(const uint8_t i) const { return m_uniform.lights[i];}
 
     void BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout) const;
     void Destroy();
 
-    void Tick(float amount);
+    // the lights are a function of the (interpolated) simulation time in seconds
+    void Update(double simTime);
+    // Copies the lights into the uniform buffer on the GPU timeline, the frames still in flight keep
+    // reading the previous values. Has to be recorded outside of a rendering scope.
+    void CmdUpload(VkCommandBuffer cmdBuffer) const;
 
     VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descSetLayout;}
 
 private:
+    // same layout as LightsUBO in lightning_pass.frag
+    struct Uniform {
+        uint32_t count;
+        uint32_t padding[3];
+        Light    lights[MAX_LIGHTS];
+    };
+
     void SetPosition();
 
-    Light m_lights[NUM_LIGHTS]{};
+    Uniform m_uniform{};
     VkDevice m_device;
     VkDescriptorSetLayout m_descSetLayout;
     VkDescriptorSet       m_descSet;
     BufferInfo            m_lightInfo;
 
-    float   m_animationProgress = 60.0f;
+    float   m_animationProgress = 60.0f; // degrees
 };
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "MeshCache.h"
+
+#include <context.h>
+#include <mesh_optimizer.h>
+
+#include "../primitives/GpuMeshGenerator.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace {
+template <typename T>
+BufferInfo UploadToGPU(const Context& context, const std::vector<T>& data, const VkBufferUsageFlags usageBits)
+{
+    const uint32_t dataSize = data.size() * sizeof(T);
+
+    BufferInfo bufferInfo = BufferInfo::Create(context.physicalDevice(), context.device(), dataSize,
+                                               usageBits | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    void* dataPtr = bufferInfo.Map(context.device());
+    memcpy(dataPtr, data.data(), dataSize);
+    bufferInfo.Unmap(context.device());
+
+    return bufferInfo;
+}
+
+BufferInfo CreateVertexBuffer(const Context& context, const VkDeviceSize size)
+{
+    return BufferInfo::Create(context.physicalDevice(), context.device(), size,
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+}
+} // namespace
+
+MeshCache& MeshCache::Get()
+{
+    static MeshCache cache;
+    return cache;
+}
+
+void MeshCache::SetVertexFormat(const VertexFormat& format)
+{
+    assert(m_meshes.empty());
+    m_format = format;
+}
+
+const Mesh* MeshCache::Acquire(const std::string& key)
+{
+    auto it = m_meshes.find(key);
+    if (it == m_meshes.end()) {
+        return nullptr;
+    }
+
+    it->second->users++;
+    return it->second.get();
+}
+
+void MeshCache::OptimizeIndices(std::vector<uint32_t>& indices, const uint32_t vertexCount)
+{
+    m_indexStats.triangles += indices.size() / 3;
+    m_indexStats.missesBefore += CountCacheMisses(indices.data(), indices.size(), vertexCount);
+    OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    m_indexStats.missesAfter += CountCacheMisses(indices.data(), indices.size(), vertexCount);
+}
+
+const Mesh* MeshCache::Add(const Context&                   context,
+                           const std::string&               key,
+                           const std::vector<float>&        vertices,
+                           const std::vector<float>&        normals,
+                           const std::vector<float>&        texCoords,
+                           const std::vector<unsigned int>& indices)
+{
+    const VkDevice device      = context.device();
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size() / 3);
+
+    // the triangles in cache order first, then the vertices in the order those triangles reach them
+    std::vector<uint32_t> optimized(indices.begin(), indices.end());
+    std::vector<uint32_t> order;
+    OptimizeIndices(optimized, vertexCount);
+    OptimizeVertexFetch(optimized.data(), optimized.size(), vertexCount, order);
+
+    std::vector<float> orderedVertices(vertices.size());
+    std::vector<float> orderedNormals(normals.size());
+    std::vector<float> orderedTexCoords(texCoords.size());
+    RemapVertices(vertices.data(), 3, order, orderedVertices.data());
+    RemapVertices(normals.data(), 3, order, orderedNormals.data());
+    RemapVertices(texCoords.data(), 2, order, orderedTexCoords.data());
+
+    const PositionDequant dequant = ComputeDequant(m_format, orderedVertices.data(), vertexCount);
+
+    // encoded straight into the mapped buffers
+    BufferInfo streams[VertexFormat::MAX_STREAMS] = {};
+    void*      mapped[VertexFormat::MAX_STREAMS]  = {};
+    for (uint32_t stream = 0; stream < m_format.streamCount(); stream++) {
+        streams[stream] = CreateVertexBuffer(context, VkDeviceSize(vertexCount) * m_format.streamStride(stream));
+        mapped[stream]  = streams[stream].Map(device);
+    }
+
+    EncodePositions(m_format, dequant, orderedVertices.data(), vertexCount, mapped[0]);
+    EncodeTexCoords(m_format, orderedTexCoords.data(), vertexCount, mapped[1]);
+    EncodeNormals(m_format, orderedNormals.data(), vertexCount, mapped[m_format.normalStream()]);
+
+    for (uint32_t stream = 0; stream < m_format.streamCount(); stream++) {
+        streams[stream].Unmap(device);
+    }
+
+    const uint32_t indexCount = static_cast<uint32_t>(optimized.size());
+    if (FitsIndex16(vertexCount)) {
+        const std::vector<uint16_t> narrow(optimized.begin(), optimized.end());
+        return Adopt(key, indexCount, vertexCount, dequant, streams,
+                     UploadToGPU(context, narrow, VK_BUFFER_USAGE_INDEX_BUFFER_BIT), VK_INDEX_TYPE_UINT16);
+    }
+    return Adopt(key, indexCount, vertexCount, dequant, streams,
+                 UploadToGPU(context, optimized, VK_BUFFER_USAGE_INDEX_BUFFER_BIT), VK_INDEX_TYPE_UINT32);
+}
+
+const Mesh* MeshCache::Generate(const std::string& key, const MeshGenParams& params)
+{
+    const VertexFormat floatFormat;
+    if (m_generator == nullptr || m_format.position != floatFormat.position || m_format.normal != floatFormat.normal ||
+        m_format.texCoord != floatFormat.texCoord || m_format.interleaved) {
+        return nullptr;
+    }
+
+    const GpuMesh mesh = m_generator->Generate(params);
+    m_generatedCount++;
+
+    // the identity, float positions need no dequantization
+    const PositionDequant dequant                            = ComputeDequant(m_format, nullptr, 0);
+    const BufferInfo      streams[VertexFormat::MAX_STREAMS] = {mesh.positions, mesh.texCoords, mesh.normals};
+    return Adopt(key, mesh.indexCount, mesh.vertexCount, dequant, streams, mesh.indices, VK_INDEX_TYPE_UINT32);
+}
+
+const Mesh* MeshCache::Adopt(const std::string&     key,
+                             const uint32_t         indexCount,
+                             const uint32_t         vertexCount,
+                             const PositionDequant& dequant,
+                             const BufferInfo*      streams,
+                             const BufferInfo       indexBuffer,
+                             const VkIndexType      indexType)
+{
+    assert(m_meshes.find(key) == m_meshes.end());
+
+    std::unique_ptr<Mesh> mesh(new Mesh{
+        .key         = key,
+        .id          = m_nextId++,
+        .indexCount  = indexCount,
+        .vertexCount = vertexCount,
+        .users       = 1,
+        .dequant     = dequant,
+        .indexType   = indexType,
+        .streams     = {},
+        .indexBuffer = indexBuffer,
+    });
+    for (uint32_t stream = 0; stream < m_format.streamCount(); stream++) {
+        mesh->streams[stream] = streams[stream];
+    }
+    m_vertexCount += vertexCount;
+    m_indexStats.meshes++;
+    m_indexStats.index16Meshes += indexType == VK_INDEX_TYPE_UINT16 ? 1 : 0;
+
+    const Mesh* result = mesh.get();
+    m_meshes.insert({key, std::move(mesh)});
+    return result;
+}
+
+void MeshCache::Release(const VkDevice device, const Mesh* mesh)
+{
+    auto it = m_meshes.find(mesh->key);
+    assert(it != m_meshes.end() && it->second->users > 0);
+
+    Mesh& entry = *it->second;
+    if (--entry.users > 0) {
+        return;
+    }
+
+    for (uint32_t stream = 0; stream < m_format.streamCount(); stream++) {
+        entry.streams[stream].Destroy(device);
+    }
+    entry.indexBuffer.Destroy(device);
+    m_vertexCount -= entry.vertexCount;
+    m_meshes.erase(it);
+}
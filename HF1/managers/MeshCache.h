@@ -0,0 +1,97 @@
+#pragma once
+
+#include <buffer.h>
+#include <vertex_format.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Context;
+class GpuMeshGenerator;
+struct MeshGenParams;
+
+// GPU buffers of one generated mesh, shared by every primitive with the same geometry.
+struct Mesh {
+    std::string     key;
+    uint32_t        id;
+    uint32_t        indexCount;
+    uint32_t        vertexCount;
+    uint32_t        users;
+    PositionDequant dequant;
+    VkIndexType     indexType;
+
+    // one per stream of the vertex format of the cache, the positions first
+    BufferInfo streams[VertexFormat::MAX_STREAMS];
+    BufferInfo indexBuffer;
+};
+
+// What the index post-processing of the added meshes did, the ACMR is misses per triangle.
+struct IndexStats {
+    uint32_t meshes;
+    uint32_t index16Meshes;
+    uint64_t triangles;
+    uint64_t missesBefore;
+    uint64_t missesAfter;
+};
+
+// Primitives are looked up by a key built from their type and parameters, so a scene with a thousand of the
+// same sphere generates and uploads it once and the draw list sees one mesh id for all of them.
+class MeshCache {
+public:
+    static MeshCache& Get();
+
+    // one more user of the mesh, nullptr if it was not added yet
+    const Mesh* Acquire(const std::string& key);
+    // Every mesh is kept in this format and the passes build their vertex input from it, so it can only be
+    // changed while the cache is empty.
+    void                SetVertexFormat(const VertexFormat& format);
+    const VertexFormat& vertexFormat() const { return m_format; }
+
+    // Reorders the triangles for the post-transform cache of the GPU and counts the cache misses before and after
+    // into the stats. The vertices stay where they are.
+    void OptimizeIndices(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+    // Optimizes the index order, renumbers the vertices in the order they are drawn, encodes and uploads the
+    // mesh. The indices are 16 bit when the vertex count allows. The first user is the caller.
+    const Mesh* Add(const Context&                   context,
+                    const std::string&               key,
+                    const std::vector<float>&        vertices,
+                    const std::vector<float>&        normals,
+                    const std::vector<float>&        texCoords,
+                    const std::vector<unsigned int>& indices);
+    // The procedural primitives are generated by it from now on, nullptr goes back to the CPU. It only writes float
+    // streams, so it is ignored with any other vertex format.
+    void SetGenerator(GpuMeshGenerator* generator) { m_generator = generator; }
+    // Generated straight into device local buffers, nullptr when there is no usable generator. The indices stay in
+    // the order of the C++ generators and 32 bit, the CPU never sees them. The first user is the caller.
+    const Mesh* Generate(const std::string& key, const MeshGenParams& params);
+    // For meshes uploaded somewhere else in vertexFormat, streams has one buffer per stream. The cache owns the
+    // buffers from now on and the caller is the first user.
+    const Mesh* Adopt(const std::string&     key,
+                      uint32_t               indexCount,
+                      uint32_t               vertexCount,
+                      const PositionDequant& dequant,
+                      const BufferInfo*      streams,
+                      BufferInfo             indexBuffer,
+                      VkIndexType            indexType);
+    // the buffers are destroyed with the last user
+    void Release(VkDevice device, const Mesh* mesh);
+
+    uint32_t meshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+    uint64_t vertexCount() const { return m_vertexCount; }
+    uint32_t generatedCount() const { return m_generatedCount; }
+    // over every mesh added since the start, released ones included
+    const IndexStats& indexStats() const { return m_indexStats; }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Mesh>> m_meshes;
+    uint32_t                                               m_nextId      = 0;
+    uint64_t                                               m_vertexCount = 0;
+    VertexFormat                                           m_format;
+    IndexStats                                             m_indexStats     = {};
+    GpuMeshGenerator*                                      m_generator      = nullptr;
+    uint32_t                                               m_generatedCount = 0; // by the GPU, since the start
+};
@@ -1,12 +1,108 @@
 #include "ObjectManager.h"
 
+#include "../entities/AnimatedGroup.h"
 #include "../entities/OrbitingHelicopter.h"
 #include "../entities/PistonWithBouncingBall.h"
 #include "../entities/RotatingCube.h"
 #include "../entities/SpinningCirnoPrism.h"
+#include "../primitives/CirnoPrism.h"
+#include "../primitives/Cone.h"
+#include "../primitives/Cube.h"
+#include "../primitives/Cylinder.h"
+#include "../primitives/GltfPrimitive.h"
 #include "../primitives/Grid.h"
+#include "../primitives/Sphere.h"
+#include "../scene/GltfModel.h"
+#include "../scene/SceneFile.h"
+#include "MeshCache.h"
+#include "job_system.h"
 
-ObjectManager::ObjectManager(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass)
+#include <chrono>
+#include <cstdio>
+
+namespace {
+BasePrimitive* CreatePrimitive(const SceneNode& node)
+{
+    const float* params = node.params;
+    switch (node.kind) {
+    case SceneNodeKind::Grid:
+        return new Grid(params[0], params[1], static_cast<int>(params[2]), static_cast<int>(params[3]));
+    case SceneNodeKind::Cube:
+        return new Cube(params[0] != 0.0f);
+    case SceneNodeKind::Sphere:
+        return new Sphere(params[0], static_cast<int>(params[1]), static_cast<int>(params[2]));
+    case SceneNodeKind::Cylinder:
+        return new Cylinder(params[0], params[1], params[2], static_cast<int>(params[3]), static_cast<int>(params[4]));
+    case SceneNodeKind::Cone:
+        return new Cone(params[0], params[1], static_cast<int>(params[2]), params[3] != 0.0f);
+    case SceneNodeKind::CirnoPrism:
+        return new CirnoPrism();
+    default:
+        return nullptr;
+    }
+}
+
+BaseEntity* CreateEntity(const SceneNode& node)
+{
+    switch (node.kind) {
+    case SceneNodeKind::Group:
+        return new AnimatedGroup(node);
+    case SceneNodeKind::RotatingCube:
+        return new RotatingCube();
+    case SceneNodeKind::SpinningCirnoPrism:
+        return new SpinningCirnoPrism();
+    case SceneNodeKind::PistonWithBouncingBall:
+        return new PistonWithBouncingBall();
+    case SceneNodeKind::OrbitingHelicopter:
+        return new OrbitingHelicopter();
+    default:
+        return nullptr;
+    }
+}
+} // namespace
+
+ObjectManager::ObjectManager(Context&         context,
+                             JobSystem&       jobSystem,
+                             LightningPass&   lightningPass,
+                             ShadowPass&      shadowPass,
+                             const SceneFile* scene,
+                             const GltfModel* model)
+    : m_jobSystem(jobSystem)
+{
+    Load(context, lightningPass, shadowPass, scene, model);
+}
+
+void ObjectManager::Load(Context&         context,
+                         LightningPass&   lightningPass,
+                         ShadowPass&      shadowPass,
+                         const SceneFile* scene,
+                         const GltfModel* model)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    if (scene != nullptr) {
+        CreateScene(context, lightningPass, shadowPass, *scene);
+    } else {
+        CreateBuiltinScene(context, lightningPass, shadowPass);
+    }
+    if (model != nullptr) {
+        CreateModel(context, lightningPass, shadowPass, *model);
+    }
+
+    m_drawables.insert(m_drawables.end(), m_entities.begin(), m_entities.end());
+    m_drawables.insert(m_drawables.end(), m_objectGroups.begin(), m_objectGroups.end());
+    m_drawables.insert(m_drawables.end(), m_primitives.begin(), m_primitives.end());
+
+    for (const IDrawable* drawable : m_drawables) {
+        drawable->collect(m_renderPrimitives);
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    printf("Objects: %zu primitives sharing %u meshes created in %.2f ms\n", m_renderPrimitives.size(),
+           MeshCache::Get().meshCount(), std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+void ObjectManager::CreateBuiltinScene(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass)
 {
     Grid* grid = new Grid(1, 1, 1, 1);
     // grid->create(context, "grass2");
@@ -34,29 +130,101 @@ ObjectManager::ObjectManager(Context& context, LightningPass& lightningPass, Sha
     m_entities.push_back(orbiting_helicopter);
 }
 
-void ObjectManager::Draw(VkCommandBuffer cmd, bool lightPass)
+void ObjectManager::CreateScene(Context&         context,
+                                LightningPass&   lightningPass,
+                                ShadowPass&      shadowPass,
+                                const SceneFile& scene)
 {
-    for (BaseEntity* object : m_entities) {
-        object->draw(cmd,lightPass);
-    }
-    for (ObjectGroup* object : m_objectGroups) {
-        object->draw(cmd,lightPass);
+    std::vector<ITransformable*> objects(scene.nodeCount());
+
+    for (uint32_t idx = 0; idx < scene.nodeCount(); idx++) {
+        const SceneNode& node   = scene.nodes()[idx];
+        ITransformable*  object = nullptr;
+
+        if (node.kind == SceneNodeKind::Group && node.behaviour == SceneBehaviour::None) {
+            ObjectGroup* group = new ObjectGroup();
+            m_objectGroups.push_back(group);
+            object = group;
+        } else if (BasePrimitive* primitive = CreatePrimitive(node)) {
+            primitive->create(context, lightningPass, shadowPass, scene.textureName(node.texture));
+            m_primitives.push_back(primitive);
+            object = primitive;
+        } else {
+            BaseEntity* entity = CreateEntity(node);
+            entity->create(context, lightningPass, shadowPass);
+            m_entities.push_back(entity);
+            object = entity;
+        }
+
+        object->setPosition(node.position[0], node.position[1], node.position[2]);
+        object->setRotation(node.rotation[0], node.rotation[1], node.rotation[2]);
+        object->setScale(node.scale[0], node.scale[1], node.scale[2]);
+        if (node.parent != SCENE_NO_PARENT) {
+            object->setParent(objects[node.parent]);
+        }
+        objects[idx] = object;
     }
-    for (BasePrimitive* object : m_primitives) {
-        object->draw(cmd,lightPass);
+}
+
+void ObjectManager::CreateModel(Context&         context,
+                                LightningPass&   lightningPass,
+                                ShadowPass&      shadowPass,
+                                const GltfModel& model)
+{
+    const std::vector<GltfModel::Node>& nodes = model.nodes();
+    std::vector<ObjectGroup*>           groups(nodes.size());
+
+    for (uint32_t idx = 0; idx < nodes.size(); idx++) {
+        const GltfModel::Node& node  = nodes[idx];
+        ObjectGroup*           group = new ObjectGroup();
+        group->setPosition(node.position.x, node.position.y, node.position.z);
+        group->setRotation(node.rotation);
+        group->setScale(node.scale.x, node.scale.y, node.scale.z);
+        if (node.parent != GltfModel::NO_PARENT) {
+            group->setParent(groups[node.parent]);
+        }
+        m_objectGroups.push_back(group);
+        groups[idx] = group;
+
+        for (uint32_t prim = node.firstPrimitive; prim < node.firstPrimitive + node.primitiveCount; prim++) {
+            const GltfModel::Primitive& primitive = model.primitives()[prim];
+
+            GltfPrimitive* object = new GltfPrimitive(primitive.meshKey);
+            object->create(context, lightningPass, shadowPass, primitive.texture.c_str());
+            object->setParent(group);
+            m_primitives.push_back(object);
+        }
     }
 }
 
-void ObjectManager::Tick()
+void ObjectManager::BuildDrawList()
 {
-    for (BaseEntity* object : m_entities) {
-        object->tick();
+    m_drawList.Clear();
+    for (const BasePrimitive* primitive : m_renderPrimitives) {
+        m_drawList.Add(primitive, primitive->getModelMatrix(), primitive->getPrevModelMatrix());
     }
 }
 
+void ObjectManager::Tick(const float deltaTime)
+{
+    // entities only touch their own state, a batch is big enough to be worth a job
+    constexpr uint32_t TICK_BATCH_SIZE = 32;
+
+    m_jobSystem.ParallelFor(static_cast<uint32_t>(m_entities.size()), TICK_BATCH_SIZE,
+                            [this, deltaTime](uint32_t first, uint32_t last) {
+                                for (uint32_t idx = first; idx < last; idx++) {
+                                    m_entities[idx]->tick(deltaTime);
+                                }
+                            });
+}
+
 
 void ObjectManager::Destroy(const VkDevice device)
 {
+    m_drawables.clear();
+    m_renderPrimitives.clear();
+    m_drawList.Clear();
+
     for (BaseEntity* object : m_entities) {
         object->destroy(device);
         delete object;
@@ -2,19 +2,56 @@
 #include "../containers/ObjectGroup.h"
 #include "../entities/BaseEntity.h"
 #include "../primitives/BasePrimitive.h"
+#include "DrawList.h"
 
 #include <context.h>
 
+class GltfModel;
+class JobSystem;
+class SceneFile;
+
 class ObjectManager {
 public:
-    explicit ObjectManager(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass);
+    // without a scene file the built-in scene is created, the model is added to either of them
+    explicit ObjectManager(Context&         context,
+                           JobSystem&       jobSystem,
+                           LightningPass&   lightningPass,
+                           ShadowPass&      shadowPass,
+                           const SceneFile* scene = nullptr,
+                           const GltfModel* model = nullptr);
+
+    // Creates the objects of the scene, only after Destroy when there were some already.
+    // The simulation must not be running and the GPU must be done with the old objects.
+    void Load(Context&         context,
+              LightningPass&   lightningPass,
+              ShadowPass&      shadowPass,
+              const SceneFile* scene,
+              const GltfModel* model = nullptr);
 
-    void Draw(VkCommandBuffer cmd, bool lightPass);
-    void Tick();
+    // render thread: one packet per primitive with the world matrices of the frame, the views are sorted from it
+    void      BuildDrawList();
+    DrawList& drawList() { return m_drawList; }
+    // simulation thread
+    void Tick(float deltaTime);
     void Destroy(VkDevice device);
 
 private:
+    void CreateBuiltinScene(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass);
+    // every node is owned directly by the manager, the hierarchy is only in the transforms
+    void CreateScene(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass, const SceneFile& scene);
+    // a group for every node of the model, the primitives are parented to them
+    void CreateModel(Context& context, LightningPass& lightningPass, ShadowPass& shadowPass, const GltfModel& model);
+
     std::vector<BasePrimitive*> m_primitives   = std::vector<BasePrimitive*>();
     std::vector<ObjectGroup*>   m_objectGroups = std::vector<ObjectGroup*>();
     std::vector<BaseEntity*>    m_entities     = std::vector<BaseEntity*>();
+
+    // every top level object in draw order
+    std::vector<IDrawable*> m_drawables;
+
+    // every primitive of the scene, flattened once after the setup
+    std::vector<const BasePrimitive*> m_renderPrimitives;
+    DrawList                          m_drawList;
+
+    JobSystem& m_jobSystem;
 };
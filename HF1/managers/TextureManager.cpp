@@ -1,7 +1,12 @@
 #include "TextureManager.h"
+#include "../render_passes/SceneInterface.h"
+#include <chrono>
 #include <context.h>
 #include <filesystem>
+#include <job_system.h>
+#include <stb_image.h>
 #include <string>
+#include <vector>
 
 
 namespace fs = std::filesystem;
@@ -10,15 +15,7 @@ const char* TEXTURE_DIRECTORY = "./HF1/textures/";
 
 void TextureManager::CreateDsetLayout()
 {
-    auto descSetLayoutBinding = VkDescriptorSetLayoutBinding{
-        .binding            = 0,
-        .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount    = 1,
-        .stageFlags         = VK_SHADER_STAGE_ALL,
-        .pImmutableSamplers = nullptr,
-    };
-
-    m_descSetLayout = m_context->descriptorPool().CreateLayout({descSetLayoutBinding});
+    m_descSetLayout = SceneInterface::CreateSetLayout(*m_context, SceneInterface::TEXTURE_SET);
 }
 void TextureManager::LoadTextures()
 {
@@ -29,27 +26,68 @@ void TextureManager::LoadTextures()
         exit(-1);
     }
 
+    struct DecodedImage {
+        std::string name;
+        std::string filePath;
+        uint8_t*    data;
+        int32_t     width;
+        int32_t     height;
+    };
+
+    std::vector<DecodedImage> images;
     for (const auto& entry : fs::directory_iterator(TEXTURE_DIRECTORY)) {
         if (entry.is_regular_file()) {
             std::string extension = entry.path().extension().string();
 
             if (extension == ".jpg" || extension == ".png") {
-                std::string filePath = entry.path().string();
-                std::string nameOnly = entry.path().stem().string();
+                images.push_back({entry.path().stem().string(), entry.path().string(), nullptr, 0, 0});
+            }
+        }
+    }
 
-                printf("Loading texture : %s \n", filePath.c_str());
-                Texture* texture = LoadTexture(filePath);
+    const auto decodeStart = std::chrono::steady_clock::now();
 
-                m_textures.insert({nameOnly, texture});
-            }
+    // decoding is the slow part and needs no vulkan, every file is a job
+    m_jobSystem->ParallelFor(static_cast<uint32_t>(images.size()), 1, [&images](uint32_t first, uint32_t last) {
+        for (uint32_t idx = first; idx < last; idx++) {
+            DecodedImage& image    = images[idx];
+            int32_t       channels = 0;
+            image.data             = stbi_load(image.filePath.c_str(), &image.width, &image.height, &channels, 4);
+        }
+    });
+
+    const auto decodeEnd = std::chrono::steady_clock::now();
+
+    // the uploads share the queue and the command pool, those stay on this thread
+    for (DecodedImage& image : images) {
+        if (image.data == nullptr) {
+            printf("[ERROR] Was unable to create texture %s\n", image.filePath.c_str());
+            exit(-1);
         }
+
+        printf("Loading texture : %s (%dx%d)\n", image.filePath.c_str(), image.width, image.height);
+        Texture* texture = Texture::LoadFromData(m_context->physicalDevice(), m_context->device(), m_context->queue(),
+                                                 m_context->commandPool(), image.data, image.width, image.height,
+                                                 VK_FORMAT_R8G8B8A8_UNORM,
+                                                 VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        stbi_image_free(image.data);
+
+        m_textures.insert({image.name, texture});
+        m_textureIds.insert({image.name, static_cast<uint32_t>(m_textureIds.size())});
     }
+
+    const auto uploadEnd = std::chrono::steady_clock::now();
+    printf("Textures: %zu decoded in %.2f ms on %u workers, uploaded in %.2f ms\n", images.size(),
+           std::chrono::duration<double, std::milli>(decodeEnd - decodeStart).count(), m_jobSystem->workerCount(),
+           std::chrono::duration<double, std::milli>(uploadEnd - decodeEnd).count());
 }
 
-TextureManager::TextureManager(Context& context)
+TextureManager::TextureManager(Context& context, JobSystem& jobSystem)
 {
     m_textures = std::unordered_map<std::string, Texture*>();
     m_context = &context;
+    m_jobSystem = &jobSystem;
 
     CreateDsetLayout();
     LoadTextures();
@@ -62,23 +100,67 @@ void TextureManager::Destroy()
     }
 }
 
-Texture* TextureManager::GetTexture(std::string name)
+VkDescriptorSet TextureManager::DescriptorSet(const std::string& name)
 {
-    auto it = m_textures.find(name);
-    if (it == m_textures.end()) {
+    auto it = m_descSets.find(name);
+    if (it != m_descSets.end()) {
+        return it->second;
+    }
+
+    Texture*        texture = GetTexture(name);
+    VkDescriptorSet descSet = m_context->descriptorPool().CreateSet(m_descSetLayout);
+
+    DescriptorSetMgmt setMgmt(descSet);
+    setMgmt.SetImage(0, texture->view(), texture->sampler(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    setMgmt.Update(m_context->device());
+
+    m_descSets.insert({name, descSet});
+    return descSet;
+}
+
+bool TextureManager::AddEncoded(const std::string& name, const void* encoded, const size_t size)
+{
+    if (m_textures.find(name) != m_textures.end()) {
+        return true;
+    }
+
+    int32_t  width    = 0;
+    int32_t  height   = 0;
+    int32_t  channels = 0;
+    uint8_t* data     = stbi_load_from_memory(static_cast<const stbi_uc*>(encoded), static_cast<int>(size), &width,
+                                              &height, &channels, 4);
+    if (data == nullptr) {
+        printf("[ERROR] Was unable to decode texture %s: %s\n", name.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    Texture* texture = Texture::LoadFromData(m_context->physicalDevice(), m_context->device(), m_context->queue(),
+                                             m_context->commandPool(), data, width, height, VK_FORMAT_R8G8B8A8_UNORM,
+                                             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    stbi_image_free(data);
+
+    m_textures.insert({name, texture});
+    m_textureIds.insert({name, static_cast<uint32_t>(m_textureIds.size())});
+    return true;
+}
+
+uint32_t TextureManager::TextureId(const std::string& name) const
+{
+    auto it = m_textureIds.find(name);
+    if (it == m_textureIds.end()) {
         printf("Texture not found: %s \n", name.c_str());
         exit(-1);
     }
     return it->second;
 }
 
-Texture* TextureManager::LoadTexture(const std::string& filePath)
+Texture* TextureManager::GetTexture(std::string name)
 {
-    Texture *texture = Texture::LoadFromFile(m_context->physicalDevice(), m_context->device(), m_context->queue(), m_context->commandPool(), filePath, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-    if (texture == nullptr) {
-        printf("[ERROR] Was unable to create texture %s\n", filePath.c_str());
+    auto it = m_textures.find(name);
+    if (it == m_textures.end()) {
+        printf("Texture not found: %s \n", name.c_str());
         exit(-1);
     }
-
-    return texture;
-}
\ No newline at end of file
+    return it->second;
+}
@@ -1,24 +1,38 @@
 #pragma once
+#include <string>
 #include <texture.h>
 #include <unordered_map>
 
 class Context;
+class JobSystem;
 
 class TextureManager {
 public:
-    TextureManager(Context& context);
+    TextureManager(Context& context, JobSystem& jobSystem);
 
     void Create(Context &context);
     void Destroy();
     Texture* GetTexture(std::string name);
     VkDescriptorSetLayout& DescriptorSetLayout(){return m_descSetLayout;};
 
+    // One set for each texture, shared by everything drawn with it, so the draw list can skip rebinding it.
+    // Created on the first request.
+    VkDescriptorSet DescriptorSet(const std::string& name);
+    // small dense index of the texture, goes into the draw sort keys
+    uint32_t TextureId(const std::string& name) const;
+
+    // Decodes and uploads a png or jpg from memory, for the textures that are not in the texture directory.
+    // Nothing happens if the name is already taken, false if the image can't be decoded.
+    bool AddEncoded(const std::string& name, const void* encoded, size_t size);
+
 private:
     void CreateDsetLayout();
     void LoadTextures();
-    Texture *LoadTexture(const std::string &filePath);
 
     Context *m_context;
+    JobSystem *m_jobSystem;
     VkDescriptorSetLayout m_descSetLayout;
     std::unordered_map<std::string, Texture*> m_textures;
+    std::unordered_map<std::string, uint32_t> m_textureIds;
+    std::unordered_map<std::string, VkDescriptorSet> m_descSets;
 };
@@ -0,0 +1,243 @@
+#include "options.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "render_passes/LightningPass.h"
+#include "render_passes/PostProcessPass.h"
+#include "swapchain.h"
+
+namespace {
+void PrintUsage(const char* program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  --workers <count>          number of job system workers, including the main thread\n");
+    printf("  --present-mode <mode>      fifo, fifo_relaxed, mailbox or immediate\n");
+    printf("  --swapchain-images <count> number of swapchain images to ask for\n");
+    printf("  --frames-in-flight <count> frames the CPU may record ahead of the GPU\n");
+    printf("  --target-fps <fps>         frame rate the dynamic resolution scales the lighting pass for\n");
+    printf("  --aa <1|2|4|8|taa>         msaa sample count or temporal anti-aliasing, can be changed at runtime\n");
+    printf("  --depth-prepass            lay down the depth before the lighting to avoid shading overdraw\n");
+    printf("  --shadow-filter <filter>   hard or pcf, can be changed at runtime\n");
+    printf("  --pcf-radius <1-4>         the pcf filter takes (2 * radius + 1)^2 taps\n");
+    printf("  --post-process <mode>      none, edges, blur, sepia or grain, can be changed at runtime\n");
+    printf("  --post-chain <list>        comma separated compute effects before it, up to 8 of blur, edges, sepia,\n");
+    printf("                             vignette and grain, use --post-process none to see only them\n");
+    printf("  --post-chain-unfused       run every per-pixel effect of the chain as a dispatch of its own\n");
+    printf("  --blur-radius <1-16>       radius of the blur of the chain in pixels, 4 by default\n");
+    printf("  --hot-reload               recompile the shaders when their sources change, needs glslang\n");
+    printf("  --scene <file>             load the scene from a text or compiled scene file\n");
+    printf("  --scene-compile <in> <out> compile a text scene into the binary form and exit\n");
+    printf("  --gltf <file>              add a glTF 2.0 model (.gltf or .glb) to the scene\n");
+    printf("  --stress <count>           generate a scene with this many objects instead\n");
+    printf("  --stress-seed <seed>       seed of the generated scene, the same seed gives the same scene\n");
+    printf("  --stress-textures <count>  number of different textures in the generated scene\n");
+    printf("  --stress-depth <levels>    levels of groups above every generated object\n");
+    printf("  --stress-animated <0-100>  percent of the generated objects that are animated entities\n");
+    printf("  --stress-sweep <file>      measure frame times from 100 objects up to --stress into a csv and exit\n");
+    printf("  --lights <1-8>             number of shadow casting lights\n");
+    printf("  --vertex-format <list>     comma separated: float (default), packed, interleaved, separate,\n");
+    printf("                             snorm16 positions, a2b10g10r10 or octahedral normals, half uvs\n");
+    printf("  --gpu-meshes               generate the procedural primitives in a compute shader, float format only\n");
+    printf("  --lod-bias <levels>        added to the level of detail of every object, positive is coarser\n");
+    printf("  --shadow-lod-bias <levels> added on top of it for the shadow maps, 1 by default\n");
+    printf("  --terrain                  stream a generated terrain around the camera\n");
+    printf("  --terrain-distance <m>     view distance of the terrain, 1000 by default\n");
+    printf("  --terrain-budget <MB>      heightmap memory the resident terrain chunks may take, 32 by default\n");
+    printf("  --terrain-seed <seed>      seed of the terrain heights\n");
+    printf("  --bench-jobs               measure the scheduling overhead of the job system and exit\n");
+    printf("  --bench-transforms         compare the world transform kernels against glm and exit\n");
+    printf("  --bench-vertex-formats     compare the sizes and the errors of the vertex formats and exit\n");
+    printf("  --validate-gpu-meshes      compare the meshes of the compute shader against the C++ ones and exit\n");
+    printf("  --bench-mesh-gen           compare generating large meshes on the CPU and on the GPU and exit\n");
+    printf("  --help                     show this text\n");
+}
+
+const char* ParseValue(int argc, char** argv, int& idx)
+{
+    if (idx + 1 >= argc) {
+        printf("Missing value for %s\n", argv[idx]);
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+
+    idx++;
+    return argv[idx];
+}
+
+uint32_t ParseCount(int argc, char** argv, int& idx)
+{
+    return static_cast<uint32_t>(strtoul(ParseValue(argc, argv, idx), nullptr, 10));
+}
+
+VkPresentModeKHR ParsePresentMode(int argc, char** argv, int& idx)
+{
+    if (idx + 1 < argc) {
+        idx++;
+        for (const VkPresentModeKHR mode : {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                            VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}) {
+            if (strcmp(argv[idx], Swapchain::PresentModeName(mode)) == 0) {
+                return mode;
+            }
+        }
+    }
+
+    printf("Invalid or missing present mode\n");
+    PrintUsage(argv[0]);
+    exit(-1);
+}
+
+void ParseAntiAliasing(int argc, char** argv, int& idx, Options& options)
+{
+    if (idx + 1 < argc) {
+        idx++;
+        if (strcmp(argv[idx], "taa") == 0) {
+            options.taa = true;
+            return;
+        }
+
+        const uint32_t samples = static_cast<uint32_t>(strtoul(argv[idx], nullptr, 10));
+        if (samples == 1 || samples == 2 || samples == 4 || samples == 8) {
+            options.aaSamples = samples;
+            options.taa       = false;
+            return;
+        }
+    }
+
+    printf("Invalid or missing anti-aliasing mode\n");
+    PrintUsage(argv[0]);
+    exit(-1);
+}
+
+uint32_t ParsePostProcessMode(int argc, char** argv, int& idx)
+{
+    if (idx + 1 < argc) {
+        idx++;
+        for (uint32_t mode = 0; mode < PostProcessPass::MODE_COUNT; mode++) {
+            if (strcmp(argv[idx], PostProcessPass::MODE_NAMES[mode]) == 0) {
+                return mode;
+            }
+        }
+    }
+
+    printf("Invalid or missing post process mode\n");
+    PrintUsage(argv[0]);
+    exit(-1);
+}
+} // namespace
+
+Options ParseOptions(int argc, char** argv)
+{
+    Options options;
+
+    for (int idx = 1; idx < argc; idx++) {
+        const char* arg = argv[idx];
+
+        if (strcmp(arg, "--workers") == 0) {
+            options.workerCount = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--present-mode") == 0) {
+            options.presentMode = ParsePresentMode(argc, argv, idx);
+        } else if (strcmp(arg, "--swapchain-images") == 0) {
+            options.swapchainImages = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--frames-in-flight") == 0) {
+            options.framesInFlight = std::max(ParseCount(argc, argv, idx), 1u);
+        } else if (strcmp(arg, "--target-fps") == 0) {
+            options.targetFps = std::max(ParseCount(argc, argv, idx), 1u);
+        } else if (strcmp(arg, "--aa") == 0) {
+            ParseAntiAliasing(argc, argv, idx, options);
+        } else if (strcmp(arg, "--depth-prepass") == 0) {
+            options.depthPrepass = true;
+        } else if (strcmp(arg, "--shadow-filter") == 0) {
+            const char* filter = ParseValue(argc, argv, idx);
+            if (strcmp(filter, "hard") != 0 && strcmp(filter, "pcf") != 0) {
+                printf("Invalid shadow filter: %s\n", filter);
+                PrintUsage(argv[0]);
+                exit(-1);
+            }
+            options.pcfShadows = strcmp(filter, "pcf") == 0;
+        } else if (strcmp(arg, "--pcf-radius") == 0) {
+            options.pcfRadius = std::clamp(ParseCount(argc, argv, idx), 1u, LightningPass::MAX_PCF_RADIUS);
+        } else if (strcmp(arg, "--post-process") == 0) {
+            options.postProcessMode = ParsePostProcessMode(argc, argv, idx);
+        } else if (strcmp(arg, "--post-chain") == 0) {
+            if (!PostProcessChain::Parse(ParseValue(argc, argv, idx), options.postChain)) {
+                printf("Invalid post process chain: %s\n", argv[idx]);
+                PrintUsage(argv[0]);
+                exit(-1);
+            }
+        } else if (strcmp(arg, "--post-chain-unfused") == 0) {
+            options.postChainFused = false;
+        } else if (strcmp(arg, "--blur-radius") == 0) {
+            options.blurRadius = std::clamp(ParseCount(argc, argv, idx), 1u, PostProcessChain::MAX_BLUR_RADIUS);
+        } else if (strcmp(arg, "--hot-reload") == 0) {
+            options.hotReload = true;
+        } else if (strcmp(arg, "--scene") == 0) {
+            options.scenePath = ParseValue(argc, argv, idx);
+        } else if (strcmp(arg, "--scene-compile") == 0) {
+            options.sceneCompileInput  = ParseValue(argc, argv, idx);
+            options.sceneCompileOutput = ParseValue(argc, argv, idx);
+        } else if (strcmp(arg, "--gltf") == 0) {
+            options.gltfPath = ParseValue(argc, argv, idx);
+        } else if (strcmp(arg, "--stress") == 0) {
+            options.stress.objectCount = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--stress-seed") == 0) {
+            options.stress.seed = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--stress-textures") == 0) {
+            options.stress.textureCount = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--stress-depth") == 0) {
+            options.stress.depth = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--stress-animated") == 0) {
+            options.stress.animatedPercent = std::min(ParseCount(argc, argv, idx), 100u);
+        } else if (strcmp(arg, "--stress-sweep") == 0) {
+            options.stressSweepPath = ParseValue(argc, argv, idx);
+        } else if (strcmp(arg, "--lights") == 0) {
+            options.lightCount = std::clamp(ParseCount(argc, argv, idx), 1u, 8u);
+        } else if (strcmp(arg, "--vertex-format") == 0) {
+            if (!VertexFormat::Parse(ParseValue(argc, argv, idx), options.vertexFormat)) {
+                printf("Invalid vertex format: %s\n", argv[idx]);
+                PrintUsage(argv[0]);
+                exit(-1);
+            }
+        } else if (strcmp(arg, "--gpu-meshes") == 0) {
+            options.gpuMeshes = true;
+        } else if (strcmp(arg, "--lod-bias") == 0) {
+            options.lodBias = strtof(ParseValue(argc, argv, idx), nullptr);
+        } else if (strcmp(arg, "--shadow-lod-bias") == 0) {
+            options.shadowLodBias = strtof(ParseValue(argc, argv, idx), nullptr);
+        } else if (strcmp(arg, "--terrain") == 0) {
+            options.terrain = true;
+        } else if (strcmp(arg, "--terrain-distance") == 0) {
+            options.terrainSettings.viewDistance = std::max(strtof(ParseValue(argc, argv, idx), nullptr), 1.0f);
+        } else if (strcmp(arg, "--terrain-budget") == 0) {
+            options.terrainSettings.budgetMB = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--terrain-seed") == 0) {
+            options.terrainSettings.seed = ParseCount(argc, argv, idx);
+        } else if (strcmp(arg, "--bench-jobs") == 0) {
+            options.benchJobs = true;
+        } else if (strcmp(arg, "--bench-transforms") == 0) {
+            options.benchTransforms = true;
+        } else if (strcmp(arg, "--bench-vertex-formats") == 0) {
+            options.benchVertexFormats = true;
+        } else if (strcmp(arg, "--validate-gpu-meshes") == 0) {
+            options.validateGpuMeshes = true;
+        } else if (strcmp(arg, "--bench-mesh-gen") == 0) {
+            options.benchMeshGen = true;
+        } else if (strcmp(arg, "--help") == 0) {
+            PrintUsage(argv[0]);
+            exit(0);
+        } else {
+            printf("Unknown option: %s\n", arg);
+            PrintUsage(argv[0]);
+            exit(-1);
+        }
+    }
+
+    // a sweep needs something to sweep up to
+    if (options.stressSweepPath != nullptr && options.stress.objectCount == 0) {
+        options.stress.objectCount = 10000;
+    }
+
+    return options;
+}
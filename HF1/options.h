@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vertex_format.h>
+#include <vulkan/vulkan_core.h>
+
+#include "render_passes/PostProcessChain.h"
+#include "scene/StressScene.h"
+#include "terrain/Terrain.h"
+
+struct Options {
+    uint32_t workerCount = 0; // 0 means one worker per hardware thread
+
+    // falls back to what the surface supports, see Swapchain
+    VkPresentModeKHR presentMode     = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t         swapchainImages = 0; // 0 means one more than the surface minimum
+    uint32_t         framesInFlight  = 2;
+
+    // GPU frame time the dynamic resolution aims for
+    uint32_t targetFps = 60;
+
+    // msaa sample count, 0 means the most the device supports, ignored with taa
+    uint32_t aaSamples = 0;
+    bool     taa       = false;
+
+    // starts with the depth pre-pass, can be toggled at runtime
+    bool depthPrepass = false;
+
+    // specialization constants the pipelines start with, every variant picked at runtime gets its own pipeline
+    bool     pcfShadows      = false;
+    uint32_t pcfRadius       = 1;
+    uint32_t postProcessMode = 4; // index into PostProcessPass::MODE_NAMES
+
+    // compute effects before the post process mode, the per-pixel ones fused into the dispatches of the kernels
+    std::vector<PostProcessChain::Effect> postChain;
+    bool                                  postChainFused = true;
+    uint32_t                              blurRadius     = 4;
+
+    // recompiles the sources in HF1/shaders when they change and recreates the pipelines using them, needs glslang
+    bool hotReload = false;
+
+    // text or binary scene file, the built-in scene without one
+    const char* scenePath = nullptr;
+    // compiles the text scene and exits
+    const char* sceneCompileInput  = nullptr;
+    const char* sceneCompileOutput = nullptr;
+    // glTF 2.0 model added to the scene
+    const char* gltfPath = nullptr;
+
+    // generated instead of loaded when it has an object count
+    StressSceneSettings stress;
+    // steps the stress scene up to its object count and writes the frame times, then exits
+    const char* stressSweepPath = nullptr;
+
+    // every light has its own shadow map, at most MAX_LIGHTS
+    uint32_t lightCount = 3;
+
+    // how the meshes keep their vertices, fixed for the whole run
+    VertexFormat vertexFormat;
+    // the procedural primitives come from a compute shader, the other vertex formats stay on the CPU
+    bool gpuMeshes = false;
+
+    // levels of detail added to what the projected size picks, positive is coarser, the shadows add theirs on top
+    float lodBias       = 0.0f;
+    float shadowLodBias = 1.0f;
+
+    // streamed around the camera, under the scene
+    bool            terrain = false;
+    TerrainSettings terrainSettings;
+
+    // benchmarks run without opening a window and exit afterwards
+    bool benchJobs          = false;
+    bool benchTransforms    = false;
+    bool benchVertexFormats = false;
+
+    // these need the device, they exit right after creating it
+    bool validateGpuMeshes = false;
+    bool benchMeshGen      = false;
+};
+
+// Prints the usage and exits on --help or on anything it does not know.
+Options ParseOptions(int argc, char** argv);
@@ -1,84 +1,182 @@
 #include "BasePrimitive.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "../render_passes/ShadowPass.h"
 #include "../managers/TextureManager.h"
 #include "context.h"
 
+#include <algorithm>
+#include <cassert>
 #include <texture.h>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #include "../render_passes/LightningPass.h"
+#include "../render_passes/SceneInterface.h"
+#include "../managers/DrawList.h"
+#include "../managers/MeshCache.h"
+#include "GpuMeshGenerator.h"
 
 VkResult BasePrimitive::create(Context& context,LightningPass& lightningPass, ShadowPass& shadowPass,  const char* texture_name)
 {
-    m_lightningPassPipeline = lightningPass.pipeline();
+    m_lightningPass = &lightningPass;
     m_lightningPassPipelineLayout = lightningPass.pipelineLayout();
     m_lightningPassConstantOffset = lightningPass.modelPushConstantOffset();
 
-    m_shadowPassPipeline = shadowPass.pipeline();
+    m_shadowPass = &shadowPass;
     m_shadowPassPipelineLayout = shadowPass.pipelineLayout();
     m_shadowPassConstantOffset = shadowPass.modelPushConstantOffset();
 
-    m_vertexCount = static_cast<uint32_t>(m_indices.size());
+    m_lodCount = std::clamp(levelCount(), 1u, MAX_LODS);
+    m_radius   = boundingRadius();
+    for (uint32_t lod = 0; lod < m_lodCount; lod++) {
+        const std::string key = meshKey(lod);
+        m_lods[lod]           = MeshCache::Get().Acquire(key);
+
+        MeshGenParams params;
+        if (m_lods[lod] == nullptr && gpuParams(lod, params)) {
+            m_lods[lod] = MeshCache::Get().Generate(key, params);
+        }
+        if (m_lods[lod] == nullptr) {
+            std::vector<float>        vertices;
+            std::vector<float>        normals;
+            std::vector<float>        texCoords;
+            std::vector<unsigned int> indices;
+            generate(lod, vertices, normals, texCoords, indices);
+
+            m_lods[lod] = MeshCache::Get().Add(context, key, vertices, normals, texCoords, indices);
+        }
+    }
 
-    m_vertexBuffer = UploadToGPU(context, m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    m_texCoordBuffer = UploadToGPU(context, m_texCoords, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    m_indexBuffer = UploadToGPU(context, m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    m_normalBuffer = UploadToGPU(context, m_normals, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    m_modelSet  = lightningPass.textureManager().DescriptorSet(texture_name);
+    m_textureId = lightningPass.textureManager().TextureId(texture_name);
 
+    return VK_SUCCESS;
+}
 
-    Texture *texture = lightningPass.textureManager().GetTexture(texture_name);
+void BasePrimitive::destroy(const VkDevice device)
+{
+    for (uint32_t lod = 0; lod < m_lodCount; lod++) {
+        MeshCache::Get().Release(device, m_lods[lod]);
+        m_lods[lod] = nullptr;
+    }
+    m_lodCount = 0;
+}
 
-    m_modelSet = context.descriptorPool().CreateSet(lightningPass.textureManager().DescriptorSetLayout());// !
+uint32_t BasePrimitive::meshId(const uint32_t lod) const
+{
+    assert(lod < m_lodCount);
+    return m_lods[lod]->id;
+}
 
-    DescriptorSetMgmt setMgmt(m_modelSet);
-    setMgmt.SetImage(0, texture->view(), texture->sampler(),VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    setMgmt.Update(context.device());
+int BasePrimitive::LodTessellation(const int count, const uint32_t lod, const int minimum)
+{
+    return std::max(count >> lod, std::min(count, minimum));
+}
 
-    return VK_SUCCESS;
+uint32_t BasePrimitive::LodLevels(const int count, const int minimum)
+{
+    uint32_t levels = 1;
+    while (levels < MAX_LODS && LodTessellation(count, levels, minimum) < LodTessellation(count, levels - 1, minimum)) {
+        levels++;
+    }
+    return levels;
 }
 
-void BasePrimitive::destroy(const VkDevice device)
+void BasePrimitive::collect(std::vector<const BasePrimitive*>& primitives) const
 {
-    m_vertexBuffer.Destroy(device);
-    m_indexBuffer.Destroy(device);
-    m_texCoordBuffer.Destroy(device);
-    m_normalBuffer.Destroy(device);
+    primitives.push_back(this);
 }
 
-void BasePrimitive::draw(const VkCommandBuffer cmdBuffer,bool lightningPass, const glm::mat4& parentModel)
+VkPipeline BasePrimitive::pipeline(const DrawPass pass) const
 {
-    const ModelPushConstant modelData = {
-        .model = parentModel * getModelMatrix(),
-    };
+    switch (pass) {
+    case DrawPass::Shadow:
+        return m_shadowPass->pipeline();
+    case DrawPass::DepthPrepass:
+        return m_lightningPass->prepassPipeline();
+    case DrawPass::Lighting:
+        return m_lightningPass->pipeline();
+    }
+    return VK_NULL_HANDLE;
+}
 
-    if (lightningPass) {
-        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_lightningPassPipeline);
-        vkCmdPushConstants(cmdBuffer, m_lightningPassPipelineLayout, VK_SHADER_STAGE_ALL, m_lightningPassConstantOffset,
-                           sizeof(ModelPushConstant), &modelData);
+void BasePrimitive::record(const VkCommandBuffer cmdBuffer,
+                           const DrawPass        pass,
+                           const uint32_t        lod,
+                           const glm::mat4&      model,
+                           const glm::mat4&      prevModel,
+                           DrawRecordState&      state) const
+{
+    assert(lod < m_lodCount);
+    const Mesh&     mesh           = *m_lods[lod];
+    const glm::vec4 positionScale  = glm::make_vec4(mesh.dequant.scale);
+    const glm::vec4 positionOffset = glm::make_vec4(mesh.dequant.offset);
+
+    const VkPipeline passPipeline = pipeline(pass);
+    if (passPipeline != state.pipeline) {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, passPipeline);
+        state.pipeline = passPipeline;
+        state.pipelineBinds++;
+    } else {
+        state.pipelineSkips++;
+    }
 
-        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_lightningPassPipelineLayout, 0, 1, &m_modelSet, 0,
-                                nullptr);
+    if (pass == DrawPass::Shadow) {
+        const ShadowModelPushConstant modelData = {
+            .model          = model,
+            .positionScale  = positionScale,
+            .positionOffset = positionOffset,
+        };
+        vkCmdPushConstants(cmdBuffer, m_shadowPassPipelineLayout, m_shadowPass->pushConstantStages(),
+                           m_shadowPassConstantOffset, sizeof(modelData), &modelData);
+    } else {
+        // the pre-pass uses the lighting layout, it only reads the positions
+        const ModelPushConstant modelData = {
+            .model          = model,
+            .prevModel      = prevModel,
+            .positionScale  = positionScale,
+            .positionOffset = positionOffset,
+        };
+        vkCmdPushConstants(cmdBuffer, m_lightningPassPipelineLayout, m_lightningPass->pushConstantStages(),
+                           m_lightningPassConstantOffset, sizeof(modelData), &modelData);
+    }
 
-        VkBuffer     vertexBuffers[] = {m_vertexBuffer.buffer, m_texCoordBuffer.buffer, m_normalBuffer.buffer};
-        VkDeviceSize offsets[]       = {0, 0, 0};
-        vkCmdBindVertexBuffers(cmdBuffer, 0, 3, vertexBuffers, offsets);
+    if (pass == DrawPass::Lighting) {
+        if (m_modelSet != state.textureSet) {
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_lightningPassPipelineLayout,
+                                    SceneInterface::TEXTURE_SET, 1, &m_modelSet, 0, nullptr);
+            state.textureSet = m_modelSet;
+            state.textureBinds++;
+        } else {
+            state.textureSkips++;
+        }
+    }
 
-        vkCmdBindIndexBuffer(cmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(cmdBuffer, m_vertexCount, 1, 0, 0, 0);
+    // the shadow and the pre-pass only read the positions, the pass doesn't change within one recording
+    const VertexFormat& format = MeshCache::Get().vertexFormat();
+    if (mesh.id != state.mesh) {
+        const uint32_t streamCount = (pass == DrawPass::Lighting) ? format.streamCount() : 1;
+
+        VkBuffer     vertexBuffers[VertexFormat::MAX_STREAMS];
+        VkDeviceSize offsets[VertexFormat::MAX_STREAMS] = {};
+        for (uint32_t stream = 0; stream < streamCount; stream++) {
+            vertexBuffers[stream] = mesh.streams[stream].buffer;
+        }
+        vkCmdBindVertexBuffers(cmdBuffer, 0, streamCount, vertexBuffers, offsets);
+
+        vkCmdBindIndexBuffer(cmdBuffer, mesh.indexBuffer.buffer, 0, mesh.indexType);
+        state.mesh = mesh.id;
+        state.meshBinds++;
+    } else {
+        state.meshSkips++;
     }
-    else {
-        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPassPipeline);
-        vkCmdPushConstants(cmdBuffer, m_shadowPassPipelineLayout, VK_SHADER_STAGE_ALL, m_shadowPassConstantOffset,
-                           sizeof(ModelPushConstant), &modelData);
 
-        VkBuffer     vertexBuffers[] = {m_vertexBuffer.buffer};
-        VkDeviceSize offsets[]       = {0};
-        vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertexBuffers, offsets);
+    // every vertex is fetched at least once, more often when it falls out of the post-transform cache
+    const uint32_t vertexSize = (pass == DrawPass::Lighting) ? format.vertexSize() : format.positionSize();
+    state.vertexBytes += uint64_t(mesh.vertexCount) * vertexSize;
+    state.triangles += mesh.indexCount / 3;
 
-        vkCmdBindIndexBuffer(cmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(cmdBuffer, m_vertexCount, 1, 0, 0, 0);
-    }
-}
\ No newline at end of file
+    vkCmdDrawIndexed(cmdBuffer, mesh.indexCount, 1, 0, 0, 0);
+}
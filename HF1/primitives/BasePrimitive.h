@@ -10,30 +10,35 @@
 #include "glm_config.h"
 
 #include <context.h>
-#include <string.h>
+#include <string>
 #include <vector>
 
 class ShadowPass;
 class LightningPass;
 class Context;
+struct DrawRecordState;
+struct Mesh;
+struct MeshGenParams;
 
 class BasePrimitive : public ITransformable, public IDrawable {
 public:
-    static VkDescriptorSetLayout CreateVertexDataDescSetLayout(Context& context)
-    {
-        VkDescriptorSetLayoutBinding descSetLayoutBinding{
-            .binding            = 0,
-            .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount    = 1,
-            .stageFlags         = VK_SHADER_STAGE_ALL,
-            .pImmutableSamplers = nullptr,
-        };
-
-        return context.descriptorPool().CreateLayout({descSetLayoutBinding});
-    }
+    // level 0 is the tessellation the primitive was made with, every further level is about half as dense
+    static constexpr uint32_t MAX_LODS = 4;
 
+    // The previous model is for the motion vectors of the lighting pass. The dequantization of the mesh turns
+    // the fetched positions back into object space, see VertexFormat.
     struct ModelPushConstant {
         glm::mat4 model;
+        glm::mat4 prevModel;
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+    };
+
+    // what the shadow pass gets after its light matrices
+    struct ShadowModelPushConstant {
+        glm::mat4 model;
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
     };
 
     BasePrimitive() {}
@@ -44,45 +49,63 @@ public:
                     ShadowPass&    shadowPass,
                     const char*    texture_name = "default");
     void     destroy(VkDevice device);
-    void draw(VkCommandBuffer cmdBuffer, bool lightningPass, const glm::mat4& parentModel = glm::mat4(1.0f)) override;
+    void     collect(std::vector<const BasePrimitive*>& primitives) const override;
+
+    // Records the draw of the level of detail with the final transforms, binds only what differs from state and
+    // updates it.
+    void record(VkCommandBuffer  cmdBuffer,
+                DrawPass         pass,
+                uint32_t         lod,
+                const glm::mat4& model,
+                const glm::mat4& prevModel,
+                DrawRecordState& state) const;
+
+    VkPipeline pipeline(DrawPass pass) const;
+    uint32_t   textureId() const { return m_textureId; }
+    uint32_t   meshId(uint32_t lod) const;
+    uint32_t   lodCount() const { return m_lodCount; }
+    // around the origin of the object space, 0 when unknown
+    float      radius() const { return m_radius; }
 
 protected:
-    VkPipelineLayout m_lightningPassPipelineLayout;
-    VkPipeline       m_lightningPassPipeline;
-    uint32_t         m_lightningPassConstantOffset;
-
-    VkPipelineLayout m_shadowPassPipelineLayout;
-    VkPipeline       m_shadowPassPipeline;
-    uint32_t         m_shadowPassConstantOffset;
-
-    BufferInfo m_vertexBuffer   = {};
-    BufferInfo m_indexBuffer    = {};
-    BufferInfo m_texCoordBuffer = {};
-    BufferInfo m_normalBuffer   = {};
-
-    std::vector<float>        m_vertices;
-    std::vector<float>        m_normals;
-    std::vector<float>        m_texCoords;
-    std::vector<unsigned int> m_indices;
-
-    uint32_t m_vertexCount;
-
-    VkDescriptorSet m_modelSet;
-
-private:
-    template <typename T>
-    static BufferInfo
-    UploadToGPU(const Context& context, const std::vector<T>& data, const VkBufferUsageFlagBits usageBits)
-    {
-        const uint32_t dataSize = data.size() * sizeof(T);
-
-        BufferInfo buffer_info = BufferInfo::Create(context.physicalDevice(), context.device(), dataSize,
-                                                    usageBits | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-
-        void* dataPtr = buffer_info.Map(context.device());
-        memcpy(dataPtr, data.data(), dataSize);
-        buffer_info.Unmap(context.device());
-
-        return buffer_info;
-    }
+    // The geometry of every level is only generated when the mesh cache has nothing with the same key yet,
+    // the key has to tell apart everything the generation depends on.
+    virtual std::string meshKey(uint32_t lod) const = 0;
+    virtual void        generate(uint32_t                   lod,
+                                 std::vector<float>&        vertices,
+                                 std::vector<float>&        normals,
+                                 std::vector<float>&        texCoords,
+                                 std::vector<unsigned int>& indices) const = 0;
+    // The same mesh for mesh_gen.comp, used instead of generate when the mesh cache has a GPU generator. False
+    // for primitives the shader doesn't know.
+    virtual bool gpuParams(uint32_t /*lod*/, MeshGenParams& /*params*/) const { return false; }
+
+    // Primitives with a tessellation count override these to get coarser levels, the draw list picks one from
+    // the projected size of the bounding sphere.
+    virtual uint32_t levelCount() const { return 1; }
+    virtual float    boundingRadius() const { return 0.0f; }
+
+    // A tessellation count of the level, halved for every level but not below minimum. The levels of a count
+    // are the ones until it stops changing, at most MAX_LODS.
+    static int      LodTessellation(int count, uint32_t lod, int minimum);
+    static uint32_t LodLevels(int count, int minimum);
+
+    // the pipelines are looked up when drawing, they are recreated when the anti-aliasing mode changes or a
+    // shader is reloaded
+    const LightningPass* m_lightningPass;
+    VkPipelineLayout     m_lightningPassPipelineLayout;
+    uint32_t             m_lightningPassConstantOffset;
+
+    const ShadowPass* m_shadowPass;
+    VkPipelineLayout  m_shadowPassPipelineLayout;
+    uint32_t          m_shadowPassConstantOffset;
+
+    // shared with the other primitives of the same geometry, see MeshCache
+    const Mesh* m_lods[MAX_LODS] = {};
+    uint32_t    m_lodCount       = 0;
+    float       m_radius         = 0.0f;
+
+    uint32_t m_textureId = 0;
+
+    VkDescriptorSet m_modelSet; // shared with the other primitives using the texture
 };
\ No newline at end of file
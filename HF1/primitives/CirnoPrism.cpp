@@ -112,7 +112,11 @@ void buildCirnoPrism(
     }
 }
 
-CirnoPrism::CirnoPrism() : BasePrimitive()
+void CirnoPrism::generate(uint32_t,
+                          std::vector<float>&        vertices,
+                          std::vector<float>&        normals,
+                          std::vector<float>&        texCoords,
+                          std::vector<unsigned int>& indices) const
 {
-    buildCirnoPrism(m_vertices,m_normals,m_texCoords,m_indices);
+    buildCirnoPrism(vertices, normals, texCoords, indices);
 }
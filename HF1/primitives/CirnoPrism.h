@@ -3,5 +3,13 @@
 
 class CirnoPrism : public BasePrimitive {
 public:
-    CirnoPrism();
+    CirnoPrism() = default;
+
+protected:
+    std::string meshKey(uint32_t) const override { return "cirno_prism"; }
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
 };
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include "Cone.h"
+#include "GpuMeshGenerator.h"
+
+#include <cmath>
+#include <cstdio>
 
 void buildCone(float baseRadius, float height, int sectorCount, bool capBase,
                std::vector<float>& vertices,
@@ -67,7 +71,50 @@ void buildCone(float baseRadius, float height, int sectorCount, bool capBase,
     }
 }
 
-Cone::Cone(const float baseRadius, const float height, const int sectorCount, const bool capBase) : BasePrimitive()
+Cone::Cone(const float baseRadius, const float height, const int sectorCount, const bool capBase)
+    : BasePrimitive()
+    , m_baseRadius(baseRadius)
+    , m_height(height)
+    , m_sectorCount(sectorCount)
+    , m_capBase(capBase)
+{
+}
+
+namespace {
+constexpr int MIN_SECTORS = 6;
+} // namespace
+
+std::string Cone::meshKey(const uint32_t lod) const
+{
+    char key[64];
+    snprintf(key, sizeof(key), "cone %.9g %.9g %d %d", m_baseRadius, m_height,
+             LodTessellation(m_sectorCount, lod, MIN_SECTORS), m_capBase ? 1 : 0);
+    return key;
+}
+
+void Cone::generate(const uint32_t             lod,
+                    std::vector<float>&        vertices,
+                    std::vector<float>&        normals,
+                    std::vector<float>&        texCoords,
+                    std::vector<unsigned int>& indices) const
+{
+    buildCone(m_baseRadius, m_height, LodTessellation(m_sectorCount, lod, MIN_SECTORS), m_capBase, vertices, normals,
+              texCoords, indices);
+}
+
+bool Cone::gpuParams(const uint32_t lod, MeshGenParams& params) const
+{
+    params = MeshGenParams::Cone(m_baseRadius, m_height, LodTessellation(m_sectorCount, lod, MIN_SECTORS), m_capBase);
+    return true;
+}
+
+uint32_t Cone::levelCount() const
+{
+    return LodLevels(m_sectorCount, MIN_SECTORS);
+}
+
+// the apex and the base are half the height away from the origin
+float Cone::boundingRadius() const
 {
-    buildCone(baseRadius, height, sectorCount, capBase,m_vertices,m_normals,m_texCoords,m_indices);
+    return std::sqrt(m_baseRadius * m_baseRadius + 0.25f * m_height * m_height);
 }
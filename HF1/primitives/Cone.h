@@ -1,7 +1,30 @@
 #pragma once
 #include "BasePrimitive.h"
 
+void buildCone(float baseRadius, float height, int sectorCount, bool capBase,
+               std::vector<float>& vertices,
+               std::vector<float>& normals,
+               std::vector<float>& texCoords,
+               std::vector<unsigned int>& indices);
+
 class Cone : public BasePrimitive {
 public:
     Cone(float baseRadius = 1.0f, float height = 1.0f, int sectorCount = 3, bool capBase = true);
+
+protected:
+    std::string meshKey(uint32_t lod) const override;
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+    bool        gpuParams(uint32_t lod, MeshGenParams& params) const override;
+    uint32_t    levelCount() const override;
+    float       boundingRadius() const override;
+
+private:
+    float m_baseRadius;
+    float m_height;
+    int   m_sectorCount;
+    bool  m_capBase;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Cube.h"
+#include "GpuMeshGenerator.h"
 #include <vector>
 
 void buildCube(float size,
@@ -177,8 +178,29 @@ void GenerateCubeAtlas(std::vector<float>& vertices,
 }
 
 
-Cube::Cube(bool atlas): BasePrimitive()
+Cube::Cube(bool atlas)
+    : BasePrimitive()
+    , m_atlas(atlas)
 {
-    if (atlas) GenerateCubeAtlas(m_vertices,m_normals,m_texCoords,m_indices);
-    else buildCube(1,m_vertices,m_normals,m_texCoords,m_indices);
+}
+
+std::string Cube::meshKey(uint32_t) const
+{
+    return m_atlas ? "cube atlas" : "cube";
+}
+
+void Cube::generate(uint32_t,
+                    std::vector<float>&        vertices,
+                    std::vector<float>&        normals,
+                    std::vector<float>&        texCoords,
+                    std::vector<unsigned int>& indices) const
+{
+    if (m_atlas) GenerateCubeAtlas(vertices, normals, texCoords, indices);
+    else buildCube(1, vertices, normals, texCoords, indices);
+}
+
+bool Cube::gpuParams(uint32_t, MeshGenParams& params) const
+{
+    params = MeshGenParams::Cube(1, m_atlas);
+    return true;
 }
@@ -1,7 +1,30 @@
 #pragma once
 #include "BasePrimitive.h"
 
+void buildCube(float size,
+               std::vector<float>& vertices,
+               std::vector<float>& normals,
+               std::vector<float>& texCoords,
+               std::vector<unsigned int>& indices);
+// the unit cube with every face in its own part of a 3 x 2 atlas
+void GenerateCubeAtlas(std::vector<float>& vertices,
+                       std::vector<float>& normals,
+                       std::vector<float>& texCoords,
+                       std::vector<unsigned int>& indices);
+
 class Cube : public BasePrimitive {
 public:
     Cube(bool atlas = false);
+
+protected:
+    std::string meshKey(uint32_t lod) const override;
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+    bool        gpuParams(uint32_t lod, MeshGenParams& params) const override;
+
+private:
+    bool m_atlas;
 };
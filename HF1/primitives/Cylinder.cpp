@@ -1,5 +1,8 @@
 #include "Cylinder.h"
+#include "GpuMeshGenerator.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <vector>
 
 void buildCylinder(float baseRadius,
@@ -74,7 +77,56 @@ Cylinder::Cylinder(float baseRadius,
                    float topRadius,
                    float height,
                    int   sectorCount,
-                   int   stackCount) : BasePrimitive()
+                   int   stackCount)
+    : BasePrimitive()
+    , m_baseRadius(baseRadius)
+    , m_topRadius(topRadius)
+    , m_height(height)
+    , m_sectorCount(sectorCount)
+    , m_stackCount(stackCount)
 {
-    buildCylinder(baseRadius, topRadius, height, sectorCount, stackCount,m_vertices,m_normals,m_texCoords,m_indices);
+}
+
+namespace {
+// the stacks only matter for the lighting along the side, one is enough far away
+constexpr int MIN_SECTORS = 6;
+constexpr int MIN_STACKS  = 1;
+} // namespace
+
+std::string Cylinder::meshKey(const uint32_t lod) const
+{
+    char key[96];
+    snprintf(key, sizeof(key), "cylinder %.9g %.9g %.9g %d %d", m_baseRadius, m_topRadius, m_height,
+             LodTessellation(m_sectorCount, lod, MIN_SECTORS), LodTessellation(m_stackCount, lod, MIN_STACKS));
+    return key;
+}
+
+void Cylinder::generate(const uint32_t             lod,
+                        std::vector<float>&        vertices,
+                        std::vector<float>&        normals,
+                        std::vector<float>&        texCoords,
+                        std::vector<unsigned int>& indices) const
+{
+    buildCylinder(m_baseRadius, m_topRadius, m_height, LodTessellation(m_sectorCount, lod, MIN_SECTORS),
+                  LodTessellation(m_stackCount, lod, MIN_STACKS), vertices, normals, texCoords, indices);
+}
+
+bool Cylinder::gpuParams(const uint32_t lod, MeshGenParams& params) const
+{
+    params = MeshGenParams::Cylinder(m_baseRadius, m_topRadius, m_height,
+                                     LodTessellation(m_sectorCount, lod, MIN_SECTORS),
+                                     LodTessellation(m_stackCount, lod, MIN_STACKS));
+    return true;
+}
+
+uint32_t Cylinder::levelCount() const
+{
+    return std::max(LodLevels(m_sectorCount, MIN_SECTORS), LodLevels(m_stackCount, MIN_STACKS));
+}
+
+// centered about the origin along z
+float Cylinder::boundingRadius() const
+{
+    const float radius = std::max(std::fabs(m_baseRadius), std::fabs(m_topRadius));
+    return std::sqrt(radius * radius + 0.25f * m_height * m_height);
 }
@@ -1,6 +1,17 @@
 #pragma once
 #include "BasePrimitive.h"
 
+// the side only, centered about the origin along z
+void buildCylinder(float baseRadius,
+                   float topRadius,
+                   float height,
+                   int sectorCount,
+                   int stackCount,
+                   std::vector<float>& vertices,
+                   std::vector<float>& normals,
+                   std::vector<float>& texCoords,
+                   std::vector<unsigned int>& indices);
+
 class Cylinder : public BasePrimitive {
 public:
     Cylinder(float baseRadius,
@@ -8,4 +19,22 @@ public:
                    float height,
                    int sectorCount,
                    int stackCount);
+
+protected:
+    std::string meshKey(uint32_t lod) const override;
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+    bool        gpuParams(uint32_t lod, MeshGenParams& params) const override;
+    uint32_t    levelCount() const override;
+    float       boundingRadius() const override;
+
+private:
+    float m_baseRadius;
+    float m_topRadius;
+    float m_height;
+    int   m_sectorCount;
+    int   m_stackCount;
 };
\ No newline at end of file
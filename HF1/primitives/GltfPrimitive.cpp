@@ -0,0 +1,18 @@
+#include "GltfPrimitive.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+GltfPrimitive::GltfPrimitive(std::string meshKey)
+    : m_meshKey(std::move(meshKey))
+{
+}
+
+void GltfPrimitive::generate(uint32_t, std::vector<float>&, std::vector<float>&, std::vector<float>&,
+                             std::vector<unsigned int>&) const
+{
+    // nothing to generate, the model was destroyed before its objects
+    printf("glTF mesh %s is not loaded\n", m_meshKey.c_str());
+    exit(-1);
+}
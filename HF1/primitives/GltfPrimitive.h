@@ -0,0 +1,20 @@
+#pragma once
+#include "BasePrimitive.h"
+
+// One primitive of a glTF mesh. The geometry was already streamed into the mesh cache by GltfModel,
+// which keeps it there for as long as the model is loaded.
+class GltfPrimitive : public BasePrimitive {
+public:
+    explicit GltfPrimitive(std::string meshKey);
+
+protected:
+    std::string meshKey(uint32_t) const override { return m_meshKey; }
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+
+private:
+    std::string m_meshKey;
+};
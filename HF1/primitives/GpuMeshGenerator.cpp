@@ -0,0 +1,406 @@
+#include "GpuMeshGenerator.h"
+
+#include <context.h>
+#include <wrappers.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "shaders/mesh_gen.comp_include.h"
+
+namespace {
+// has to match mesh_gen.comp
+constexpr uint32_t WORKGROUP_SIZE = 64;
+
+struct PushConstant {
+    float    params[4];
+    int32_t  counts[4];
+    uint32_t kind;
+    uint32_t vertexCount;
+    uint32_t unitCount;
+};
+
+// Vulkan has no empty buffers, a sphere with a single stack has no triangles
+BufferInfo CreateOutputBuffer(const VkPhysicalDevice   phyDevice,
+                              const VkDevice           device,
+                              const VkDeviceSize       size,
+                              const VkBufferUsageFlags usage)
+{
+    return BufferInfo::Create(phyDevice, device, std::max<VkDeviceSize>(size, 4),
+                              usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+} // namespace
+
+MeshGenParams MeshGenParams::Sphere(const float radius, const int sectorCount, const int stackCount)
+{
+    return {
+        .kind   = Kind::Sphere,
+        .params = {radius, 0.0f, 0.0f, 0.0f},
+        .counts = {sectorCount, stackCount, 0, 0},
+    };
+}
+
+MeshGenParams MeshGenParams::Cylinder(const float baseRadius,
+                                      const float topRadius,
+                                      const float height,
+                                      const int   sectorCount,
+                                      const int   stackCount)
+{
+    return {
+        .kind   = Kind::Cylinder,
+        .params = {baseRadius, topRadius, height, 0.0f},
+        .counts = {sectorCount, stackCount, 0, 0},
+    };
+}
+
+MeshGenParams MeshGenParams::Cone(const float baseRadius, const float height, const int sectorCount, const bool capBase)
+{
+    return {
+        .kind   = Kind::Cone,
+        .params = {baseRadius, height, 0.0f, 0.0f},
+        .counts = {sectorCount, capBase ? 1 : 0, 0, 0},
+    };
+}
+
+// buildGrid never goes below two vertices in a direction
+MeshGenParams MeshGenParams::Grid(const float width, const float depth, const int rows, const int cols)
+{
+    return {
+        .kind   = Kind::Grid,
+        .params = {width, depth, 0.0f, 0.0f},
+        .counts = {std::max(2, cols), std::max(2, rows), 0, 0},
+    };
+}
+
+// the atlas is always the unit cube
+MeshGenParams MeshGenParams::Cube(const float size, const bool atlas)
+{
+    return {
+        .kind   = atlas ? Kind::CubeAtlas : Kind::Cube,
+        .params = {atlas ? 1.0f : size, 0.0f, 0.0f, 0.0f},
+        .counts = {0, 0, 0, 0},
+    };
+}
+
+uint32_t MeshGenParams::vertexCount() const
+{
+    const uint32_t first  = static_cast<uint32_t>(counts[0]);
+    const uint32_t second = static_cast<uint32_t>(counts[1]);
+
+    switch (kind) {
+    case Kind::Sphere:
+    case Kind::Cylinder:
+        return (first + 1) * (second + 1);
+    case Kind::Cone:
+        return first + 2 + second; // the apex, the closed ring of the base and its center
+    case Kind::Grid:
+        return first * second;
+    case Kind::Cube:
+    case Kind::CubeAtlas:
+        return 24;
+    }
+    return 0;
+}
+
+uint32_t MeshGenParams::indexCount() const
+{
+    const uint32_t first  = static_cast<uint32_t>(counts[0]);
+    const uint32_t second = static_cast<uint32_t>(counts[1]);
+
+    switch (kind) {
+    case Kind::Sphere:
+        return 6 * first * (second - 1); // the quads touching the poles are single triangles
+    case Kind::Cylinder:
+        return 6 * first * second;
+    case Kind::Cone:
+        return 3 * first * (1 + second);
+    case Kind::Grid:
+        return 6 * (first - 1) * (second - 1);
+    case Kind::Cube:
+    case Kind::CubeAtlas:
+        return 36;
+    }
+    return 0;
+}
+
+uint32_t MeshGenParams::unitCount() const
+{
+    const uint32_t first  = static_cast<uint32_t>(counts[0]);
+    const uint32_t second = static_cast<uint32_t>(counts[1]);
+
+    switch (kind) {
+    case Kind::Sphere:
+    case Kind::Cylinder:
+        return first * second;
+    case Kind::Cone:
+        return first;
+    case Kind::Grid:
+        return (first - 1) * (second - 1);
+    case Kind::Cube:
+    case Kind::CubeAtlas:
+        return 6;
+    }
+    return 0;
+}
+
+void GpuMesh::Destroy(const VkDevice device)
+{
+    positions.Destroy(device);
+    texCoords.Destroy(device);
+    normals.Destroy(device);
+    indices.Destroy(device);
+}
+
+GpuMeshGenerator::GpuMeshGenerator(Context& context)
+    : m_phyDevice(context.physicalDevice())
+    , m_device(context.device())
+    , m_queue(context.queue())
+    , m_timer(context.physicalDevice(), context.device(), context.queueFamilyIdx(), 1)
+{
+    // positions, texture coordinates, normals and indices
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (uint32_t binding = 0; binding < 4; binding++) {
+        bindings.push_back({
+            .binding            = binding,
+            .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount    = 1,
+            .stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr,
+        });
+    }
+    m_descSetLayout  = context.descriptorPool().CreateLayout(bindings);
+    m_descSet        = context.descriptorPool().CreateSet(m_descSetLayout);
+    m_pipelineLayout = CreatePipelineLayout(m_device, {m_descSetLayout}, sizeof(PushConstant));
+
+    const VkShaderModule shaderModule = CreateShaderModule(m_device, SPV_mesh_gen_comp, sizeof(SPV_mesh_gen_comp));
+
+    const VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage =
+            {
+                .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext               = nullptr,
+                .flags               = 0,
+                .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module              = shaderModule,
+                .pName               = "main",
+                .pSpecializationInfo = nullptr,
+            },
+        .layout             = m_pipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex  = -1,
+    };
+    vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+
+    m_cmdBuffer = AllocateCommandBuffers(m_device, context.commandPool(), 1)[0];
+    m_fence     = CreateFence(m_device);
+}
+
+template <typename RecordFn> void GpuMeshGenerator::Submit(RecordFn&& record)
+{
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+    vkResetCommandBuffer(m_cmdBuffer, 0);
+    vkBeginCommandBuffer(m_cmdBuffer, &beginInfo);
+    record(m_cmdBuffer);
+    vkEndCommandBuffer(m_cmdBuffer);
+
+    const VkSubmitInfo submitInfo = {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = nullptr,
+        .waitSemaphoreCount   = 0,
+        .pWaitSemaphores      = nullptr,
+        .pWaitDstStageMask    = nullptr,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = &m_cmdBuffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores    = nullptr,
+    };
+    vkResetFences(m_device, 1, &m_fence);
+    vkQueueSubmit(m_queue, 1, &submitInfo, m_fence);
+    vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+}
+
+GpuMesh GpuMeshGenerator::Generate(const MeshGenParams& params)
+{
+    GpuMesh mesh = {
+        .positions   = {},
+        .texCoords   = {},
+        .normals     = {},
+        .indices     = {},
+        .vertexCount = params.vertexCount(),
+        .indexCount  = params.indexCount(),
+    };
+    const VkDeviceSize vertexCount = mesh.vertexCount;
+
+    mesh.positions = CreateOutputBuffer(m_phyDevice, m_device, vertexCount * 3 * sizeof(float),
+                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    mesh.texCoords = CreateOutputBuffer(m_phyDevice, m_device, vertexCount * 2 * sizeof(float),
+                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    mesh.normals   = CreateOutputBuffer(m_phyDevice, m_device, vertexCount * 3 * sizeof(float),
+                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    mesh.indices   = CreateOutputBuffer(m_phyDevice, m_device, VkDeviceSize(mesh.indexCount) * sizeof(uint32_t),
+                                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    const VkDescriptorBufferInfo bufferInfos[] = {
+        {mesh.positions.buffer, 0, VK_WHOLE_SIZE},
+        {mesh.texCoords.buffer, 0, VK_WHOLE_SIZE},
+        {mesh.normals.buffer, 0, VK_WHOLE_SIZE},
+        {mesh.indices.buffer, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet writes[4];
+    for (uint32_t binding = 0; binding < 4; binding++) {
+        writes[binding] = {
+            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext            = nullptr,
+            .dstSet           = m_descSet,
+            .dstBinding       = binding,
+            .dstArrayElement  = 0,
+            .descriptorCount  = 1,
+            .descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo       = nullptr,
+            .pBufferInfo      = &bufferInfos[binding],
+            .pTexelBufferView = nullptr,
+        };
+    }
+    vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+
+    PushConstant constants = {
+        .params      = {},
+        .counts      = {},
+        .kind        = static_cast<uint32_t>(params.kind),
+        .vertexCount = mesh.vertexCount,
+        .unitCount   = params.unitCount(),
+    };
+    memcpy(constants.params, params.params, sizeof(constants.params));
+    memcpy(constants.counts, params.counts, sizeof(constants.counts));
+
+    // one invocation per vertex, the first unitCount ones also write the indices of a unit
+    const uint32_t invocations = std::max(constants.vertexCount, constants.unitCount);
+
+    Submit([&](const VkCommandBuffer cmdBuffer) {
+        m_timer.CmdBegin(cmdBuffer, 0);
+
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descSet, 0,
+                                nullptr);
+        vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDispatch(cmdBuffer, (invocations + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+        // drawn from later, or copied back by the validation
+        const VkMemoryBarrier2 barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .pNext         = nullptr,
+            .srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+            .dstAccessMask =
+                VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT,
+        };
+        const VkDependencyInfo dependencyInfo = {
+            .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext                    = nullptr,
+            .dependencyFlags          = 0,
+            .memoryBarrierCount       = 1,
+            .pMemoryBarriers          = &barrier,
+            .bufferMemoryBarrierCount = 0,
+            .pBufferMemoryBarriers    = nullptr,
+            .imageMemoryBarrierCount  = 0,
+            .pImageMemoryBarriers     = nullptr,
+        };
+        vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+
+        m_timer.CmdEnd(cmdBuffer, 0);
+    });
+
+    return mesh;
+}
+
+void GpuMeshGenerator::Readback(const GpuMesh&             mesh,
+                                std::vector<float>&        vertices,
+                                std::vector<float>&        normals,
+                                std::vector<float>&        texCoords,
+                                std::vector<unsigned int>& indices)
+{
+    vertices.resize(size_t(mesh.vertexCount) * 3);
+    texCoords.resize(size_t(mesh.vertexCount) * 2);
+    normals.resize(size_t(mesh.vertexCount) * 3);
+    indices.resize(mesh.indexCount);
+
+    // in the order of the bindings
+    const BufferInfo*  sources[]      = {&mesh.positions, &mesh.texCoords, &mesh.normals, &mesh.indices};
+    void*              destinations[] = {vertices.data(), texCoords.data(), normals.data(), indices.data()};
+    const VkDeviceSize sizes[]        = {
+        vertices.size() * sizeof(float),
+        texCoords.size() * sizeof(float),
+        normals.size() * sizeof(float),
+        indices.size() * sizeof(unsigned int),
+    };
+
+    VkDeviceSize offsets[4];
+    VkDeviceSize totalSize = 0;
+    for (uint32_t idx = 0; idx < 4; idx++) {
+        offsets[idx] = totalSize;
+        totalSize += sizes[idx];
+    }
+
+    const VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    BufferInfo readback = BufferInfo::Create(m_phyDevice, m_device, std::max<VkDeviceSize>(totalSize, 4),
+                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryFlags);
+
+    Submit([&](const VkCommandBuffer cmdBuffer) {
+        for (uint32_t idx = 0; idx < 4; idx++) {
+            if (sizes[idx] > 0) {
+                const VkBufferCopy region = {.srcOffset = 0, .dstOffset = offsets[idx], .size = sizes[idx]};
+                vkCmdCopyBuffer(cmdBuffer, sources[idx]->buffer, readback.buffer, 1, &region);
+            }
+        }
+
+        const VkMemoryBarrier2 barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .pNext         = nullptr,
+            .srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+            .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+        };
+        const VkDependencyInfo dependencyInfo = {
+            .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext                    = nullptr,
+            .dependencyFlags          = 0,
+            .memoryBarrierCount       = 1,
+            .pMemoryBarriers          = &barrier,
+            .bufferMemoryBarrierCount = 0,
+            .pBufferMemoryBarriers    = nullptr,
+            .imageMemoryBarrierCount  = 0,
+            .pImageMemoryBarriers     = nullptr,
+        };
+        vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+    });
+
+    const uint8_t* mapped = static_cast<const uint8_t*>(readback.Map(m_device));
+    for (uint32_t idx = 0; idx < 4; idx++) {
+        if (sizes[idx] > 0) {
+            memcpy(destinations[idx], mapped + offsets[idx], sizes[idx]);
+        }
+    }
+    readback.Unmap(m_device);
+    readback.Destroy(m_device);
+}
+
+void GpuMeshGenerator::Destroy()
+{
+    vkDestroyFence(m_device, m_fence, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    m_timer.Destroy();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <buffer.h>
+#include <gpu_timer.h>
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+class Context;
+
+// The parameters the constructors of the primitives take, for generating their mesh with mesh_gen.comp. The
+// counts are the ones the C++ generators end up with, so the GPU writes the same vertices in the same order.
+struct MeshGenParams {
+    enum class Kind : uint32_t {
+        Sphere,
+        Cylinder,
+        Cone,
+        Grid,
+        Cube,
+        CubeAtlas,
+    };
+
+    Kind    kind;
+    float   params[4]; // radii, height, width and depth, see the factories
+    int32_t counts[4]; // sectors, stacks, rows, columns and the cap of the cone
+
+    static MeshGenParams Sphere(float radius, int sectorCount, int stackCount);
+    static MeshGenParams Cylinder(float baseRadius, float topRadius, float height, int sectorCount, int stackCount);
+    static MeshGenParams Cone(float baseRadius, float height, int sectorCount, bool capBase);
+    static MeshGenParams Grid(float width, float depth, int rows, int cols);
+    static MeshGenParams Cube(float size, bool atlas);
+
+    uint32_t vertexCount() const;
+    uint32_t indexCount() const;
+    // quads, sectors or faces, the shader writes the indices of one per invocation
+    uint32_t unitCount() const;
+};
+
+// Device local float3 positions, float2 texture coordinates, float3 normals and 32 bit indices, the streams of
+// the float vertex format.
+struct GpuMesh {
+    BufferInfo positions;
+    BufferInfo texCoords;
+    BufferInfo normals;
+    BufferInfo indices;
+    uint32_t   vertexCount;
+    uint32_t   indexCount;
+
+    void Destroy(VkDevice device);
+};
+
+// Generates the meshes of the procedural primitives with a compute shader straight into device local buffers,
+// the CPU never touches the vertices. Every Generate is a submit and a wait on the queue of the context, so it
+// stays on the thread that owns the queue and the command pool.
+class GpuMeshGenerator {
+public:
+    explicit GpuMeshGenerator(Context& context);
+
+    // the buffers can be bound as vertex and index buffers when it returns
+    GpuMesh Generate(const MeshGenParams& params);
+
+    // Copies a generated mesh back into the vectors the C++ generators fill, for the validation.
+    void Readback(const GpuMesh&             mesh,
+                  std::vector<float>&        vertices,
+                  std::vector<float>&        normals,
+                  std::vector<float>&        texCoords,
+                  std::vector<unsigned int>& indices);
+
+    // GPU time of the dispatch of the last Generate, false without timestamp support
+    bool LastGpuTime(double& outMs) { return m_timer.Read(0, outMs); }
+
+    void Destroy();
+
+    VkDevice device() const { return m_device; }
+
+private:
+    // records into the command buffer of the generator, submits and waits for it
+    template <typename RecordFn> void Submit(RecordFn&& record);
+
+    VkPhysicalDevice m_phyDevice;
+    VkDevice         m_device;
+    VkQueue          m_queue;
+
+    VkDescriptorSetLayout m_descSetLayout;
+    VkDescriptorSet       m_descSet; // rewritten for every mesh, nothing is in flight by then
+    VkPipelineLayout      m_pipelineLayout;
+    VkPipeline            m_pipeline;
+
+    VkCommandBuffer m_cmdBuffer;
+    VkFence         m_fence;
+    GpuTimer        m_timer;
+};
@@ -1,6 +1,8 @@
 #include "Grid.h"
+#include "GpuMeshGenerator.h"
 
 #include "context.h"
+#include <cstdio>
 #include <vector>
 
 
@@ -64,7 +66,33 @@ void buildGrid(float width, float depth, int rows, int cols,
 }
 
 
-Grid::Grid(float width, float depth, int rows, int cols) : BasePrimitive()
+Grid::Grid(float width, float depth, int rows, int cols)
+    : BasePrimitive()
+    , m_width(width)
+    , m_depth(depth)
+    , m_rows(rows)
+    , m_cols(cols)
 {
-    buildGrid(width, depth, rows, cols,m_vertices, m_normals, m_texCoords, m_indices);
-}
\ No newline at end of file
+}
+
+std::string Grid::meshKey(uint32_t) const
+{
+    char key[64];
+    snprintf(key, sizeof(key), "grid %.9g %.9g %d %d", m_width, m_depth, m_rows, m_cols);
+    return key;
+}
+
+void Grid::generate(uint32_t,
+                    std::vector<float>&        vertices,
+                    std::vector<float>&        normals,
+                    std::vector<float>&        texCoords,
+                    std::vector<unsigned int>& indices) const
+{
+    buildGrid(m_width, m_depth, m_rows, m_cols, vertices, normals, texCoords, indices);
+}
+
+bool Grid::gpuParams(uint32_t, MeshGenParams& params) const
+{
+    params = MeshGenParams::Grid(m_width, m_depth, m_rows, m_cols);
+    return true;
+}
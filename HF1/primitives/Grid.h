@@ -1,7 +1,29 @@
 #pragma once
 #include "BasePrimitive.h"
 
+// rows * cols vertices on the xz plane centered on the origin, two triangles per quad
+void buildGrid(float width, float depth, int rows, int cols,
+               std::vector<float>& vertices,
+               std::vector<float>& normals,
+               std::vector<float>& texCoords,
+               std::vector<unsigned int>& indices);
+
 class Grid : public BasePrimitive {
 public:
     Grid(float width = 1,float depth = 1, int rows = 1, int cols = 1);
+
+protected:
+    std::string meshKey(uint32_t lod) const override;
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+    bool        gpuParams(uint32_t lod, MeshGenParams& params) const override;
+
+private:
+    float m_width;
+    float m_depth;
+    int   m_rows;
+    int   m_cols;
 };
\ No newline at end of file
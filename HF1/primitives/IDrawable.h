@@ -1,10 +1,21 @@
 #pragma once
 #include <glm/fwd.hpp>
 #include <glm_config.h>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
+enum class DrawPass {
+    Shadow,
+    DepthPrepass, // position only, the lighting pass tests against this depth with EQUAL afterwards
+    Lighting,
+};
+
+class BasePrimitive;
+
 class IDrawable {
 public:
-    virtual void draw(VkCommandBuffer cmdBuffer, bool lightningPass, const glm::mat4& parentModel = glm::mat4(1.0f)) = 0;
+    // Adds every primitive below it to the list. Called once after the scene is set up, the world matrices
+    // come from the TransformStore, so the flat list is all the draw list needs every frame.
+    virtual void collect(std::vector<const BasePrimitive*>& primitives) const = 0;
     virtual ~IDrawable() = default;
 };
\ No newline at end of file
@@ -1,17 +1,24 @@
 #include "ITransformable.h"
+#include "../simulation/TransformStore.h"
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/quaternion.hpp>
+ITransformable::ITransformable()
+    : m_transformSlot(TransformStore::Get().Register(this))
+{
+}
 
+ITransformable::~ITransformable()
+{
+    TransformStore::Get().Unregister(m_transformSlot);
+}
 
 void ITransformable::setScale(const float x, const float y, const float z)
 {
-    m_scale =  glm::scale(glm::mat4(1.0f), glm::vec3(x, y, z));
+    m_scale = glm::vec3(x, y, z);
 }
 
 void ITransformable::setPosition(const float x, const float y, const float z)
 {
-    m_position = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+    m_position = glm::vec3(x, y, z);
 }
 
 void ITransformable::setRotation(float rx, float ry, float rz)
@@ -20,11 +27,26 @@ void ITransformable::setRotation(float rx, float ry, float rz)
     ry                    = glm::radians(ry);
     rz                    = glm::radians(rz);
     const glm::vec3 angle = glm::vec3(rx, ry, rz);
-    const glm::quat q     = glm::quat(angle);
-    m_rotation            = glm::toMat4(q);
+    m_rotation            = glm::quat(angle);
+}
+
+void ITransformable::setRotation(const glm::quat& rotation)
+{
+    m_rotation = rotation;
+}
+
+void ITransformable::setParent(const ITransformable* parent)
+{
+    TransformStore::Get().SetParent(m_transformSlot,
+                                    parent != nullptr ? parent->m_transformSlot : TransformStore::NO_PARENT);
+}
+
+const glm::mat4& ITransformable::getModelMatrix() const
+{
+    return TransformStore::Get().World(m_transformSlot);
 }
 
-glm::mat4 ITransformable::getModelMatrix() const
+const glm::mat4& ITransformable::getPrevModelMatrix() const
 {
-    return m_position * m_rotation * m_scale;
+    return TransformStore::Get().PrevWorld(m_transformSlot);
 }
@@ -1,18 +1,39 @@
 #pragma once
 #include "glm/fwd.hpp"
 #include "glm_config.h"
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
 
 class ITransformable {
 public:
-    virtual ~ITransformable() = default;
+    ITransformable();
+    virtual ~ITransformable();
+
+    ITransformable(const ITransformable&)            = delete;
+    ITransformable& operator=(const ITransformable&) = delete;
 
+    // setters belong to the simulation, the renderer only sees them after the next published snapshot
     void setScale(float x, float y, float z);
     void setPosition(float x, float y, float z);
     void setRotation(float rx, float ry, float rz);
-    glm::mat4 getModelMatrix() const;
+    void setRotation(const glm::quat& rotation);
+
+    // the transform becomes relative to the parent, nullptr makes it a root again.
+    // Only while the simulation is not running, see TransformStore
+    void setParent(const ITransformable* parent);
+
+    // world matrix interpolated between the last two snapshots, only valid on the render thread
+    const glm::mat4& getModelMatrix() const;
+    // the world matrix of the previous rendered frame, for the motion vectors
+    const glm::mat4& getPrevModelMatrix() const;
 
 private:
-    glm::mat4        m_scale          = glm::mat4(1.0f);
-    glm::mat4        m_position       = glm::mat4(1.0f);
-    glm::mat4        m_rotation       = glm::mat4(1.0f);
-};
\ No newline at end of file
+    friend class TransformStore;
+
+    glm::vec3 m_position = glm::vec3(0.0f);
+    glm::quat m_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 m_scale    = glm::vec3(1.0f);
+
+    uint32_t m_transformSlot = 0;
+};
@@ -1,5 +1,8 @@
 #include "Sphere.h"
+#include "GpuMeshGenerator.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <vector>
 
 #ifndef M_PI
@@ -103,7 +106,52 @@ void GenerateSphere(float radius,
     }
 }
 
-Sphere::Sphere(float radius, int sectorCount, int stackCount) : BasePrimitive()
+Sphere::Sphere(float radius, int sectorCount, int stackCount)
+    : BasePrimitive()
+    , m_radius(radius)
+    , m_sectorCount(sectorCount)
+    , m_stackCount(stackCount)
 {
-    GenerateSphere(radius,sectorCount,stackCount,m_vertices,m_normals,m_texCoords,m_indices);
+}
+
+namespace {
+// below this the silhouette stops looking round
+constexpr int MIN_SECTORS = 6;
+constexpr int MIN_STACKS  = 4;
+} // namespace
+
+// a coarser level is just a sphere with fewer sectors and stacks, it shares the mesh with such spheres
+std::string Sphere::meshKey(const uint32_t lod) const
+{
+    char key[64];
+    snprintf(key, sizeof(key), "sphere %.9g %d %d", m_radius, LodTessellation(m_sectorCount, lod, MIN_SECTORS),
+             LodTessellation(m_stackCount, lod, MIN_STACKS));
+    return key;
+}
+
+void Sphere::generate(const uint32_t             lod,
+                      std::vector<float>&        vertices,
+                      std::vector<float>&        normals,
+                      std::vector<float>&        texCoords,
+                      std::vector<unsigned int>& indices) const
+{
+    GenerateSphere(m_radius, LodTessellation(m_sectorCount, lod, MIN_SECTORS),
+                   LodTessellation(m_stackCount, lod, MIN_STACKS), vertices, normals, texCoords, indices);
+}
+
+bool Sphere::gpuParams(const uint32_t lod, MeshGenParams& params) const
+{
+    params = MeshGenParams::Sphere(m_radius, LodTessellation(m_sectorCount, lod, MIN_SECTORS),
+                                   LodTessellation(m_stackCount, lod, MIN_STACKS));
+    return true;
+}
+
+uint32_t Sphere::levelCount() const
+{
+    return std::max(LodLevels(m_sectorCount, MIN_SECTORS), LodLevels(m_stackCount, MIN_STACKS));
+}
+
+float Sphere::boundingRadius() const
+{
+    return m_radius;
 }
@@ -1,7 +1,32 @@
 #pragma once
 #include "BasePrimitive.h"
 
+// the reference for mesh_gen.comp, the validation compares the two
+void GenerateSphere(float radius,
+                    int sectorCount,
+                    int stackCount,
+                    std::vector<float>& vertices,
+                    std::vector<float>& normals,
+                    std::vector<float>& texCoords,
+                    std::vector<unsigned int>& indices);
+
 class Sphere : public BasePrimitive {
 public:
     Sphere(float radius, int sectorCount, int stackCount);
+
+protected:
+    std::string meshKey(uint32_t lod) const override;
+    void        generate(uint32_t                   lod,
+                         std::vector<float>&        vertices,
+                         std::vector<float>&        normals,
+                         std::vector<float>&        texCoords,
+                         std::vector<unsigned int>& indices) const override;
+    bool        gpuParams(uint32_t lod, MeshGenParams& params) const override;
+    uint32_t    levelCount() const override;
+    float       boundingRadius() const override;
+
+private:
+    float m_radius;
+    int   m_sectorCount;
+    int   m_stackCount;
 };
\ No newline at end of file
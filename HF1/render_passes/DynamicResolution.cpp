@@ -0,0 +1,42 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// weight of the newest sample, a few frames of history are enough to hide the noise of the timestamps
+constexpr double SMOOTHING = 0.1;
+// relative error the controller ignores
+constexpr double DEADBAND = 0.05;
+// largest change per frame, a sudden jump in resolution is more visible than a few slow frames
+constexpr float MAX_STEP = 0.02f;
+} // namespace
+
+DynamicResolution::DynamicResolution(const float targetMs)
+{
+    settings.targetMs = targetMs;
+    m_scale           = settings.maxScale;
+}
+
+float DynamicResolution::Update(const double gpuMs)
+{
+    m_smoothedMs = (m_smoothedMs == 0.0) ? gpuMs : m_smoothedMs + (gpuMs - m_smoothedMs) * SMOOTHING;
+
+    if (!settings.enabled || m_smoothedMs <= 0.0) {
+        return m_scale;
+    }
+
+    const double ratio = settings.targetMs / m_smoothedMs;
+    if (std::abs(ratio - 1.0) > DEADBAND) {
+        const float wanted = m_scale * static_cast<float>(std::sqrt(ratio));
+        m_scale += std::clamp(wanted - m_scale, -MAX_STEP, MAX_STEP);
+    }
+
+    m_scale = std::clamp(m_scale, settings.minScale, settings.maxScale);
+    return m_scale;
+}
+
+void DynamicResolution::SetScale(const float scale)
+{
+    m_scale = std::clamp(scale, settings.minScale, settings.maxScale);
+}
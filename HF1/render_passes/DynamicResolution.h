@@ -0,0 +1,30 @@
+#pragma once
+
+// Picks the render scale of the lighting pass from the measured GPU frame time.
+// The cost of the pass is roughly proportional to the pixel count, so the scale moves with the square root
+// of the ratio between the target and the measured time. Small errors are ignored so the scale doesn't
+// oscillate around the target.
+class DynamicResolution {
+public:
+    struct Settings {
+        bool  enabled  = true;
+        float targetMs = 1000.0f / 60.0f;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+    } settings;
+
+    explicit DynamicResolution(float targetMs);
+
+    // GPU time of a finished frame, returns the scale for the next one
+    float Update(double gpuMs);
+
+    // only used while the controller is disabled
+    void SetScale(float scale);
+
+    float  scale() const { return m_scale; }
+    double smoothedMs() const { return m_smoothedMs; }
+
+private:
+    float  m_scale      = 1.0f;
+    double m_smoothedMs = 0.0;
+};
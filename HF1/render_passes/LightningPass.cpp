@@ -1,31 +1,55 @@
 #include "LightningPass.h"
 
-#include "../camera.h"
 #include "ShadowPass.h"
 
 #include "glm_config.h"
+#include <algorithm>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+#include "../managers/MeshCache.h"
 #include "../managers/TextureManager.h"
 #include "../primitives/BasePrimitive.h"
-#include "shaders/lightning_pass.frag_include.h"
-#include "shaders/lightning_pass.vert_include.h"
+#include "render_targets.h"
+#include "SceneInterface.h"
+#include <cassert>
+#include <shader_library.h>
 #include <wrappers.h>
 
+namespace {
+enum class PipelineKind {
+    Lighting,
+    LightingAfterPrepass, // depth is already there, only the visible fragments are shaded
+    DepthPrepass,         // positions only, no fragment shader and no color writes
+    Terrain,              // lit like the rest, the positions come from the heightmap instead of vertex buffers
+};
+} // namespace
+
+// With velocity the second format is the one of the motion vector attachment. Both stages get the same
+// specialization, see LightningPass::Variant.
 static VkPipeline CreatePipeline(const VkDevice         device,
                                  const VkPipelineLayout pipelineLayout,
-                                 const VkFormat         colorFormat,
+                                 const VkFormat*        colorFormats,
+                                 const bool             velocity,
                                  // const VkFormat         depthFormat,
-                                 const VkSampleCountFlagBits vkSampleCountFlagBits)
+                                 const VkSampleCountFlagBits vkSampleCountFlagBits,
+                                 const PipelineKind          kind,
+                                 const VkSpecializationInfo* specInfo)
 {
-    const uint32_t* m_shaderVertData = SPV_shader_in_vert;
-    size_t          m_shaderVertSize = sizeof(SPV_shader_in_vert);
-    const uint32_t* m_shaderFragData = SPV_shader_in_frag;
-    size_t          m_shaderFragSize = sizeof(SPV_shader_in_frag);
+    const bool prepass = (kind == PipelineKind::DepthPrepass);
+    const bool terrain = (kind == PipelineKind::Terrain);
 
-    const VkShaderModule shaderVertex   = CreateShaderModule(device, m_shaderVertData, m_shaderVertSize);
-    const VkShaderModule shaderFragment = CreateShaderModule(device, m_shaderFragData, m_shaderFragSize);
+    const char* vertexShader = prepass ? "depth_prepass.vert" : "lightning_pass.vert";
+    if (terrain) {
+        vertexShader = "terrain.vert";
+    }
+
+    const ShaderLibrary& library        = ShaderLibrary::Get();
+    const VkShaderModule shaderVertex   = library.CreateModule(device, vertexShader);
+    const VkShaderModule shaderFragment =
+        prepass ? VK_NULL_HANDLE : library.CreateModule(device, "lightning_pass.frag");
+
+    const VertexFormat& vertexFormat = MeshCache::Get().vertexFormat();
 
     // shader stages
     const VkPipelineShaderStageCreateInfo shaders[] = {
@@ -36,7 +60,7 @@ static VkPipeline CreatePipeline(const VkDevice         device,
             .stage               = VK_SHADER_STAGE_VERTEX_BIT,
             .module              = shaderVertex,
             .pName               = "main",
-            .pSpecializationInfo = nullptr,
+            .pSpecializationInfo = specInfo,
         },
         {
             .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -45,48 +69,17 @@ static VkPipeline CreatePipeline(const VkDevice         device,
             .stage               = VK_SHADER_STAGE_FRAGMENT_BIT,
             .module              = shaderFragment,
             .pName               = "main",
-            .pSpecializationInfo = nullptr,
+            .pSpecializationInfo = specInfo,
         },
     };
 
-    // buffer binding
-    VkVertexInputBindingDescription bindingDescriptions[3] = {
-        {0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // Binding 0: Position
-        {1, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX}, // Binding 1: UV
-        {2, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX}  // Binding 2: Normal
-    };
-
-    VkVertexInputAttributeDescription vertexAttributes[3] = {{
-                                                                 // position
-                                                                 .location = 0,
-                                                                 .binding  = 0,
-                                                                 .format   = VK_FORMAT_R32G32B32_SFLOAT,
-                                                                 .offset   = 0,
-                                                             },
-                                                             {
-                                                                 // uv
-                                                                 .location = 1,
-                                                                 .binding  = 1,
-                                                                 .format   = VK_FORMAT_R32G32_SFLOAT,
-                                                                 .offset   = 0,
-                                                             },
-                                                             {
-                                                                 // normal
-                                                                 .location = 2,
-                                                                 .binding  = 2,
-                                                                 .format   = VK_FORMAT_R32G32B32_SFLOAT,
-                                                                 .offset   = 0,
-                                                             }};
-
-    const VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext                           = 0,
-        .flags                           = 0,
-        .vertexBindingDescriptionCount   = 3u,
-        .pVertexBindingDescriptions      = bindingDescriptions,
-        .vertexAttributeDescriptionCount = 3u,
-        .pVertexAttributeDescriptions    = vertexAttributes,
-    };
+    // the pre-pass only reads binding 0, the same position stream the shadow pass uses
+    const VertexInputLayout              vertexInput     = vertexFormat.Layout(prepass);
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = vertexInput.createInfo();
+    if (terrain) {
+        vertexInputInfo.vertexBindingDescriptionCount   = 0;
+        vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    }
 
     // input assembly
     const VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
@@ -155,8 +148,8 @@ static VkPipeline CreatePipeline(const VkDevice         device,
         .pNext                 = nullptr,
         .flags                 = 0,
         .depthTestEnable       = VK_TRUE,
-        .depthWriteEnable      = VK_TRUE,
-        .depthCompareOp        = VK_COMPARE_OP_LESS,
+        .depthWriteEnable      = kind == PipelineKind::LightingAfterPrepass ? VK_FALSE : VK_TRUE,
+        .depthCompareOp        = kind == PipelineKind::LightingAfterPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
         .depthBoundsTestEnable = VK_FALSE,
         .stencilTestEnable     = VK_FALSE,
         .front                 = emptyStencilOp,
@@ -166,7 +159,7 @@ static VkPipeline CreatePipeline(const VkDevice         device,
     };
 
     // color blend
-    VkPipelineColorBlendAttachmentState blendAttachment = {
+    VkPipelineColorBlendAttachmentState blendAttachments[2] = {{
         .blendEnable = VK_TRUE,
         // as blend is disabled fill these with default values,
         .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
@@ -178,7 +171,26 @@ static VkPipeline CreatePipeline(const VkDevice         device,
         // Important!
         .colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
+    }, {
+        // the motion vectors are never blended
+        .blendEnable         = VK_FALSE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .colorBlendOp        = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp        = VK_BLEND_OP_ADD,
+        .colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT,
+    }};
+
+    // the pre-pass runs in the same rendering scope, the attachments are there but it doesn't write them
+    if (prepass) {
+        blendAttachments[0].blendEnable    = VK_FALSE;
+        blendAttachments[0].colorWriteMask = 0;
+        blendAttachments[1].colorWriteMask = 0;
+    }
+
+    const uint32_t colorAttachmentCount = velocity ? 2u : 1u;
 
     const VkPipelineColorBlendStateCreateInfo colorBlendInfo = {
         .sType         = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
@@ -187,8 +199,8 @@ static VkPipeline CreatePipeline(const VkDevice         device,
         .logicOpEnable = VK_FALSE,
         .logicOp       = VK_LOGIC_OP_CLEAR, // Disabled
         // Important!
-        .attachmentCount = 1,
-        .pAttachments    = &blendAttachment,
+        .attachmentCount = colorAttachmentCount,
+        .pAttachments    = blendAttachments,
         .blendConstants  = {1.0f, 1.0f, 1.0f, 1.0f}, // Ignored
     };
 
@@ -196,8 +208,8 @@ static VkPipeline CreatePipeline(const VkDevice         device,
         .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
         .pNext                   = nullptr,
         .viewMask                = 0,
-        .colorAttachmentCount    = 1,
-        .pColorAttachmentFormats = &colorFormat,
+        .colorAttachmentCount    = colorAttachmentCount,
+        .pColorAttachmentFormats = colorFormats,
         .depthAttachmentFormat   = VK_FORMAT_D32_SFLOAT,
         .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
     };
@@ -219,7 +231,7 @@ static VkPipeline CreatePipeline(const VkDevice         device,
         .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .pNext               = &renderingInfo,
         .flags               = 0,
-        .stageCount          = 2,
+        .stageCount          = prepass ? 1u : 2u,
         .pStages             = shaders,
         .pVertexInputState   = &vertexInputInfo,
         .pInputAssemblyState = &inputAssemblyInfo,
@@ -239,18 +251,21 @@ static VkPipeline CreatePipeline(const VkDevice         device,
 
     VkPipeline pipeline = VK_NULL_HANDLE;
     VkResult   result   = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
-    assert(result == VK_SUCCESS);
 
     vkDestroyShaderModule(device, shaderVertex, nullptr);
-    vkDestroyShaderModule(device, shaderFragment, nullptr);
+    if (shaderFragment != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, shaderFragment, nullptr);
+    }
 
-    return pipeline;
+    // a reloaded shader may not fit the rest of the pipeline, the caller keeps its previous one then
+    return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
 }
 
 LightningPass::LightningPass(Context&                    context,
                              TextureManager&             textureManager,
                              LightManager&               lightManager,
                              ShadowPass&                 shadowPass,
+                             RenderTargetAllocator&      renderTargets,
                              const VkFormat              colorFormat,
                              const VkSampleCountFlagBits msaaLevel,
                              const VkFormat              depthFormat,
@@ -258,54 +273,249 @@ LightningPass::LightningPass(Context&                    context,
     : m_device(context.device())
     , m_phyDevice(context.physicalDevice())
     , m_colorFormat(colorFormat)
+    , m_attachmentFormats{colorFormat, VELOCITY_FORMAT}
     , m_depthFormat(depthFormat)
     , m_extent(extent)
+    , m_renderExtent(extent)
     , m_sampleCountFlagBits(msaaLevel)
+    , m_descriptorPool(context.descriptorPool())
     , m_textureManager(textureManager)
     , m_lightManager(lightManager)
     , m_shadowPass(shadowPass)
 {
-    // const auto vertexDataDescSetLayout = BasePrimitive::CreateVertexDataDescSetLayout(context);
-    const auto textureDescSetLayout   = textureManager.DescriptorSetLayout();
-    const auto lightDescSetLayout     = lightManager.GetDescriptorSetLayout();
-    const auto shadowMapDescSetLayout = shadowPass.ShadowMapDescSetLayout();
-
-    // vertexDataDescSetLayout,
-    const std::vector<VkDescriptorSetLayout> layouts = {textureDescSetLayout, lightDescSetLayout,
-                                                        shadowMapDescSetLayout};
-    const u_int32_t pushConstantSize = sizeof(Camera::CameraPushConstant) + sizeof(BasePrimitive::ModelPushConstant);
-
-    m_modelPushConstantOffset = sizeof(Camera::CameraPushConstant);
-    m_pipelineLayout          = CreatePipelineLayout(m_device, layouts, pushConstantSize);
-    m_pipeline                = CreatePipeline(m_device, m_pipelineLayout, colorFormat, m_sampleCountFlagBits);
-
-    m_colorOutput     = Texture::Create2D(m_phyDevice, m_device, m_colorFormat, m_extent,
-                                          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-                                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-                                          VK_SAMPLE_COUNT_1_BIT);
-    m_colorOutputMsaa = Texture::Create2D(m_phyDevice, m_device, m_colorFormat, m_extent,
-                                          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
-                                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-                                          m_sampleCountFlagBits);
-
-    m_depthOutput     = Texture::Create2D(m_phyDevice, m_device, m_depthFormat, m_extent,
-                                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-    m_depthOutputMsaa = Texture::Create2D(m_phyDevice, m_device, m_depthFormat, m_extent,
-                                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                          m_sampleCountFlagBits);
+    // The sets of the scene without the heightmap, the same layouts the texture, light, shadow map and camera
+    // sets were allocated with. The terrain pushes its chunk into the first bytes of the same range.
+    const PipelineReflection& scene = SceneInterface::Reflection();
+    assert(scene.pushConstantRange().size == sizeof(BasePrimitive::ModelPushConstant));
+
+    m_modelPushConstantOffset = 0;
+    m_pushConstantStages      = scene.pushConstantRange().stageFlags;
+    m_pipelineLayout = scene.CreatePipelineLayout(m_device, m_descriptorPool, SceneInterface::HEIGHTMAP_SET);
+    CreatePipelines();
+
+    CreateTargets(renderTargets);
+}
+
+// constant 0 unfolds the normals of the vertex format, the rest are the ShadingOptions and the light count
+ShaderVariant LightningPass::Variant() const
+{
+    return {{
+        MeshCache::Get().vertexFormat().normalEncoding(),
+        static_cast<uint32_t>(m_shading.shadowFilter),
+        m_shading.pcfRadius,
+        m_lightManager.lightCount(),
+    }};
 }
-void LightningPass::Destroy() const
+
+void LightningPass::CreatePipelines()
 {
-    vkDestroyPipeline(m_device, m_pipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    // the pre-pass only has the vertex shader, its specialization never changes
+    const ShaderVariant  variant = Variant();
+    const Specialization specialization(variant);
+    m_prepassPipeline = m_depthPrepass ? CreatePipeline(m_device, m_pipelineLayout, m_attachmentFormats, m_temporal,
+                                                        m_sampleCountFlagBits, PipelineKind::DepthPrepass,
+                                                        specialization.info())
+                                       : VK_NULL_HANDLE;
+    SelectVariant();
+}
 
-    m_colorOutput->Destroy(m_device);
-    m_colorOutputMsaa->Destroy(m_device);
-    m_depthOutput->Destroy(m_device);
-    m_depthOutputMsaa->Destroy(m_device);
+void LightningPass::SelectVariant()
+{
+    const PipelineKind  lightingKind = m_depthPrepass ? PipelineKind::LightingAfterPrepass : PipelineKind::Lighting;
+    const ShaderVariant variant      = Variant();
+
+    m_pipeline = m_variants.Get(variant, [&](const VkSpecializationInfo* specInfo) {
+        return CreatePipeline(m_device, m_pipelineLayout, m_attachmentFormats, m_temporal, m_sampleCountFlagBits,
+                              lightingKind, specInfo);
+    });
+    if (m_terrainPipelineLayout != VK_NULL_HANDLE) {
+        m_terrainPipeline = m_terrainVariants.Get(variant, [&](const VkSpecializationInfo* specInfo) {
+            return CreatePipeline(m_device, m_terrainPipelineLayout, m_attachmentFormats, m_temporal,
+                                  m_sampleCountFlagBits, PipelineKind::Terrain, specInfo);
+        });
+    }
+}
+
+void LightningPass::SetShading(const ShadingOptions& shading)
+{
+    m_shading           = shading;
+    m_shading.pcfRadius = std::clamp(shading.pcfRadius, 1u, MAX_PCF_RADIUS);
+    SelectVariant();
 }
 
-void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer) const
+void LightningPass::EnableTerrain()
+{
+    // the same sets and push constants first, so what is bound for the rest stays bound for the terrain
+    m_terrainPipelineLayout = SceneInterface::Reflection().CreatePipelineLayout(m_device, m_descriptorPool);
+    SelectVariant();
+}
+
+// the variants were created for the old sample count or depth test, none of them can be reused
+void LightningPass::DestroyPipelines()
+{
+    m_variants.Clear(m_device);
+    m_terrainVariants.Clear(m_device);
+    m_pipeline        = VK_NULL_HANDLE;
+    m_terrainPipeline = VK_NULL_HANDLE;
+    if (m_prepassPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_prepassPipeline, nullptr);
+        m_prepassPipeline = VK_NULL_HANDLE;
+    }
+}
+
+bool LightningPass::ReloadShader(const std::string& name)
+{
+    if (name != "lightning_pass.vert" && name != "lightning_pass.frag" && name != "depth_prepass.vert" &&
+        name != "terrain.vert") {
+        return true;
+    }
+
+    // only the current variant is created again, the others follow when they are picked
+    const VkPipeline     oldPipeline        = m_pipeline;
+    const VkPipeline     oldPrepassPipeline = m_prepassPipeline;
+    const VkPipeline     oldTerrainPipeline = m_terrainPipeline;
+    PipelineVariantCache oldVariants        = std::exchange(m_variants, {});
+    PipelineVariantCache oldTerrainVariants = std::exchange(m_terrainVariants, {});
+
+    CreatePipelines();
+
+    const bool created = m_pipeline != VK_NULL_HANDLE && (!m_depthPrepass || m_prepassPipeline != VK_NULL_HANDLE) &&
+                         (m_terrainPipelineLayout == VK_NULL_HANDLE || m_terrainPipeline != VK_NULL_HANDLE);
+    if (!created) {
+        DestroyPipelines();
+        std::swap(m_variants, oldVariants);
+        std::swap(m_terrainVariants, oldTerrainVariants);
+        m_pipeline        = oldPipeline;
+        m_prepassPipeline = oldPrepassPipeline;
+        m_terrainPipeline = oldTerrainPipeline;
+        return false;
+    }
+
+    oldVariants.Clear(m_device);
+    oldTerrainVariants.Clear(m_device);
+    if (oldPrepassPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, oldPrepassPipeline, nullptr);
+    }
+    return true;
+}
+
+void LightningPass::SetDepthPrepass(const bool enabled)
+{
+    if (enabled == m_depthPrepass) {
+        return;
+    }
+
+    m_depthPrepass = enabled;
+
+    DestroyPipelines();
+    CreatePipelines();
+}
+
+void LightningPass::Resize(RenderTargetAllocator& renderTargets, const VkExtent2D extent)
+{
+    ReleaseTargets(renderTargets);
+
+    m_extent = extent;
+    CreateTargets(renderTargets);
+    SetRenderScale(m_renderScale);
+}
+
+void LightningPass::SetAntiAliasing(RenderTargetAllocator&      renderTargets,
+                                    const VkSampleCountFlagBits samples,
+                                    const bool                  temporal)
+{
+    // TAA accumulates single samples over the frames
+    const VkSampleCountFlagBits sampleCount = temporal ? VK_SAMPLE_COUNT_1_BIT : samples;
+    if (sampleCount == m_sampleCountFlagBits && temporal == m_temporal) {
+        return;
+    }
+
+    m_sampleCountFlagBits = sampleCount;
+    m_temporal            = temporal;
+
+    DestroyPipelines();
+    CreatePipelines();
+
+    ReleaseTargets(renderTargets);
+    CreateTargets(renderTargets);
+}
+
+void LightningPass::ReleaseTargets(RenderTargetAllocator& renderTargets)
+{
+    renderTargets.Release(m_colorOutput);
+    renderTargets.Release(m_depthOutput);
+    if (m_colorOutputMsaa != nullptr) {
+        renderTargets.Release(m_colorOutputMsaa);
+        m_colorOutputMsaa = nullptr;
+    }
+    if (m_velocityOutput != nullptr) {
+        renderTargets.Release(m_velocityOutput);
+        m_velocityOutput = nullptr;
+    }
+}
+
+void LightningPass::SetRenderScale(const float scale)
+{
+    m_renderScale  = std::clamp(scale, 0.0f, 1.0f);
+    m_renderExtent = {
+        std::max(uint32_t(m_extent.width * m_renderScale), 1u),
+        std::max(uint32_t(m_extent.height * m_renderScale), 1u),
+    };
+}
+
+void LightningPass::CreateTargets(RenderTargetAllocator& renderTargets)
+{
+    const bool msaa = (m_sampleCountFlagBits != VK_SAMPLE_COUNT_1_BIT);
+
+    m_colorOutput = renderTargets.Create({
+        .name   = "LightningPass color",
+        .format = m_colorFormat,
+        .extent = m_extent,
+        .usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    });
+
+    // the msaa color is resolved into m_colorOutput and the depth is never read after the pass,
+    // so neither of them has to outlive the pass
+    if (msaa) {
+        m_colorOutputMsaa = renderTargets.Create({
+            .name      = "LightningPass color msaa",
+            .format    = m_colorFormat,
+            .extent    = m_extent,
+            .usage     = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            .samples   = m_sampleCountFlagBits,
+            .transient = true,
+        });
+    }
+
+    // read by the temporal resolve of the post process
+    if (m_temporal) {
+        m_velocityOutput = renderTargets.Create({
+            .name   = "LightningPass velocity",
+            .format = VELOCITY_FORMAT,
+            .extent = m_extent,
+            .usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        });
+    }
+
+    m_depthOutput = renderTargets.Create({
+        .name      = "LightningPass depth",
+        .format    = m_depthFormat,
+        .extent    = m_extent,
+        .usage     = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        .samples   = m_sampleCountFlagBits,
+        .transient = true,
+    });
+}
+void LightningPass::Destroy()
+{
+    DestroyPipelines();
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    if (m_terrainPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(m_device, m_terrainPipelineLayout, nullptr);
+    }
+}
+
+void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer, const VkRenderingFlags flags) const
 {
     const bool             msaa       = (m_sampleCountFlagBits != VK_SAMPLE_COUNT_1_BIT);
     constexpr VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
@@ -318,7 +528,7 @@ void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer) const
 
     const VkImageLayout resolveLayout = msaa ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
 
-    VkRenderingAttachmentInfoKHR colorAttachment = {
+    VkRenderingAttachmentInfoKHR colorAttachments[2] = {{
         .sType              = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
         .pNext              = nullptr,
         .imageView          = targetView,
@@ -327,18 +537,28 @@ void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer) const
         .resolveImageView   = resolveView,
         .resolveImageLayout = resolveLayout,
         .loadOp             = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp            = VK_ATTACHMENT_STORE_OP_STORE,
+        .storeOp            = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
         .clearValue         = clearColor,
-    };
+    }, {
+        // nothing drawn there did not move
+        .sType              = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .pNext              = nullptr,
+        .imageView          = m_temporal ? m_velocityOutput->view() : VK_NULL_HANDLE,
+        .imageLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode        = VK_RESOLVE_MODE_NONE,
+        .resolveImageView   = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp             = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp            = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue         = {{{0.0f, 0.0f, 0.0f, 0.0f}}},
+    }};
 
     constexpr VkClearDepthStencilValue depthClear = {1.0f, 0u};
 
-    const VkImageView depthTargetView = msaa ? m_depthOutputMsaa->view() : m_depthOutput->view();
-
     const VkRenderingAttachmentInfoKHR depthAttachment = {
         .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
         .pNext       = nullptr,
-        .imageView   = depthTargetView,
+        .imageView   = m_depthOutput->view(),
         .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 
         .resolveMode        = VK_RESOLVE_MODE_NONE,
@@ -346,27 +566,30 @@ void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer) const
         .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 
         .loadOp     = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp    = VK_ATTACHMENT_STORE_OP_STORE,
+        .storeOp    = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .clearValue = {.depthStencil = depthClear},
     };
 
     const VkRenderingInfoKHR renderInfo = {.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
                                            .pNext                = nullptr,
-                                           .flags                = 0,
-                                           .renderArea           = {.offset = {0, 0}, .extent = {m_extent}},
+                                           .flags                = flags,
+                                           .renderArea           = {.offset = {0, 0}, .extent = {m_renderExtent}},
                                            .layerCount           = 1,
                                            .viewMask             = 0,
-                                           .colorAttachmentCount = 1,
-                                           .pColorAttachments    = &colorAttachment,
+                                           .colorAttachmentCount = m_temporal ? 2u : 1u,
+                                           .pColorAttachments    = colorAttachments,
                                            .pDepthAttachment     = &depthAttachment,
                                            .pStencilAttachment   = nullptr};
     vkCmdBeginRendering(cmdBuffer, &renderInfo);
+}
 
+void LightningPass::SetupPass(const VkCommandBuffer cmdBuffer) const
+{
     const VkViewport viewport = {
         .x        = 0,
         .y        = 0,
-        .width    = float(m_extent.width),
-        .height   = float(m_extent.height),
+        .width    = float(m_renderExtent.width),
+        .height   = float(m_renderExtent.height),
         .minDepth = 0.0f,
         .maxDepth = 1.0f,
     };
@@ -374,7 +597,7 @@ void LightningPass::BeginPass(const VkCommandBuffer cmdBuffer) const
 
     const VkRect2D scissor = {
         .offset = {0, 0},
-        .extent = m_extent,
+        .extent = m_renderExtent,
     };
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 }
@@ -384,101 +607,50 @@ void LightningPass::EndPass(const VkCommandBuffer cmdBuffer) const
     vkCmdEndRendering(cmdBuffer);
 }
 
-void LightningPass::TransitionForRender(const VkCommandBuffer cmdBuffer) const
+VkCommandBufferInheritanceRenderingInfo LightningPass::InheritanceRenderingInfo() const
 {
-    VkImageMemoryBarrier2 msaaBarrier = {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                         .pNext               = nullptr,
-                                         .srcStageMask        = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                         .srcAccessMask       = VK_ACCESS_2_NONE,
-                                         .dstStageMask        = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                         .dstAccessMask       = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-                                         .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED, // Discard old data
-                                         .newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                         .image               = m_colorOutputMsaa->image(),
-                                         .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
-
-    VkImageMemoryBarrier2 depthMsaaBarrier = {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                              .pNext               = nullptr,
-                                              .srcStageMask        = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                              .srcAccessMask       = VK_ACCESS_2_NONE,
-                                              .dstStageMask        = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-                                              .dstAccessMask       = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                              .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED, // Discard old data
-                                              .newLayout           = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                                              .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                              .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                              .image               = m_depthOutputMsaa->image(),
-                                              .subresourceRange    = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1}};
-
-    VkImageMemoryBarrier2 resolveBarrier = {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                            .pNext               = nullptr,
-                                            .srcStageMask        = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                            .srcAccessMask       = VK_ACCESS_2_NONE,
-                                            .dstStageMask        = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                            .dstAccessMask       = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-                                            .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
-                                            .newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                            .image               = m_colorOutput->image(),
-                                            .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
-
-    VkImageMemoryBarrier2 depthBarrier = {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                          .pNext               = nullptr,
-                                          .srcStageMask        = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                          .srcAccessMask       = VK_ACCESS_2_NONE,
-                                          .dstStageMask        = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-                                          .dstAccessMask       = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                          .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
-                                          .newLayout           = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                                          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                          .image               = m_depthOutput->image(),
-                                          .subresourceRange    = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1}};
-
-    VkImageMemoryBarrier2 barriers[] = {msaaBarrier, depthMsaaBarrier, resolveBarrier, depthBarrier};
-
-    VkDependencyInfo depInfo = {.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-                                .pNext                    = nullptr,
-                                .dependencyFlags          = 0,
-                                .memoryBarrierCount       = 0,
-                                .pMemoryBarriers          = nullptr,
-                                .bufferMemoryBarrierCount = 0,
-                                .pBufferMemoryBarriers    = nullptr,
-                                .imageMemoryBarrierCount  = 4,
-                                .pImageMemoryBarriers     = barriers};
-
-    vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+    return {
+        .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .viewMask                = 0,
+        .colorAttachmentCount    = m_temporal ? 2u : 1u,
+        .pColorAttachmentFormats = m_attachmentFormats,
+        .depthAttachmentFormat   = m_depthFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples    = m_sampleCountFlagBits,
+    };
 }
 
-void LightningPass::TransitionForRead(const VkCommandBuffer cmdBuffer) const
+LightningPass::GraphOutputs LightningPass::AddToGraph(RenderGraph&                                graph,
+                                                     const std::vector<RenderGraph::ResourceId>& shadowMaps,
+                                                     RenderGraph::ExecuteFn                      drawScene)
 {
-    const VkImageMemoryBarrier2 colorBarrier = {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                                .pNext               = nullptr,
-                                                .srcStageMask        = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                                .srcAccessMask       = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-                                                .dstStageMask        = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-                                                .dstAccessMask       = VK_ACCESS_2_SHADER_READ_BIT,
-                                                .oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                                .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
-                                                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                .image               = m_colorOutput->image(),
-                                                .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
-
-    const VkDependencyInfo depInfo = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = 1,
-        .pImageMemoryBarriers     = &colorBarrier,
+    std::vector<RenderGraph::Access> reads;
+    for (RenderGraph::ResourceId shadowMap : shadowMaps) {
+        reads.push_back({shadowMap, RenderGraph::Usage::SampledFragment});
+    }
+
+    const RenderGraph::ResourceId color = graph.ImportTexture("lightning color", m_colorOutput, false);
+    const RenderGraph::ResourceId depth = graph.ImportTexture("lightning depth", m_depthOutput, true);
+
+    std::vector<RenderGraph::Access> writes = {
+        {color, RenderGraph::Usage::ColorAttachment},
+        {depth, RenderGraph::Usage::DepthAttachment},
     };
+    if (m_colorOutputMsaa != nullptr) {
+        const RenderGraph::ResourceId msaa = graph.ImportTexture("lightning color msaa", m_colorOutputMsaa, true);
+        writes.push_back({msaa, RenderGraph::Usage::ColorAttachment});
+    }
+
+    GraphOutputs outputs = {.color = color, .velocity = 0};
+    if (m_velocityOutput != nullptr) {
+        outputs.velocity = graph.ImportTexture("lightning velocity", m_velocityOutput, false);
+        writes.push_back({outputs.velocity, RenderGraph::Usage::ColorAttachment});
+    }
 
-    vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
-}
\ No newline at end of file
+    graph.AddPass("lightning", reads, writes,
+                  [this, drawScene](VkCommandBuffer cmdBuffer) { DoPass(cmdBuffer, drawScene); });
+
+    return outputs;
+}
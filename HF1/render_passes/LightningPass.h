@@ -1,19 +1,49 @@
 #pragma once
 #include "../managers/LightManager.h"
 #include "glm_config.h"
+#include "pipeline_variants.h"
+#include "render_graph.h"
 #include "texture.h"
 #include <vulkan/vulkan_core.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 class ShadowPass;
 class Context;
+class DescriptorPool;
 class TextureManager;
+class RenderTargetAllocator;
 
 class LightningPass {
 public:
+    static constexpr VkFormat VELOCITY_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+    static constexpr uint32_t MAX_PCF_RADIUS  = 4;
+
+    enum class ShadowFilter : uint32_t {
+        Hard,
+        Pcf,
+    };
+
+    // specialization constants of lightning_pass.frag
+    struct ShadingOptions {
+        ShadowFilter shadowFilter = ShadowFilter::Hard;
+        uint32_t     pcfRadius    = 1; // (2 * radius + 1)^2 taps, at most MAX_PCF_RADIUS
+
+        bool operator==(const ShadingOptions& other) const = default;
+    };
+
+    struct GraphOutputs {
+        RenderGraph::ResourceId color;
+        RenderGraph::ResourceId velocity; // only with temporal anti-aliasing
+    };
+
     LightningPass(Context&              context,
                   TextureManager&       textureManager,
                   LightManager&         lightManager,
                   ShadowPass&           shadowPass,
+                  RenderTargetAllocator& renderTargets,
                   VkFormat              colorFormat,
                   VkSampleCountFlagBits msaaLevel,
                   VkFormat              depthFormat,
@@ -21,44 +51,135 @@ public:
 
     template <typename DrawFn> void DoPass(VkCommandBuffer cmdBuffer, DrawFn&& drawScene)
     {
-        TransitionForRender(cmdBuffer);
-        BeginPass(cmdBuffer);
-        drawScene(cmdBuffer);
+        if (m_secondaryCmdBuffers.empty()) {
+            BeginPass(cmdBuffer, 0);
+            RecordPass(cmdBuffer, drawScene);
+        } else {
+            BeginPass(cmdBuffer, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+            vkCmdExecuteCommands(cmdBuffer, static_cast<uint32_t>(m_secondaryCmdBuffers.size()),
+                                 m_secondaryCmdBuffers.data());
+        }
         EndPass(cmdBuffer);
-        TransitionForRead(cmdBuffer);
     }
 
-    void Destroy() const;
+    // Everything inside the rendering scope, can go into a secondary command buffer.
+    template <typename DrawFn> void RecordPass(VkCommandBuffer cmdBuffer, DrawFn&& drawScene)
+    {
+        SetupPass(cmdBuffer);
+        drawScene(cmdBuffer);
+    }
+
+    // Secondaries recorded with RecordPass, executed in order. Empty means the pass records inline.
+    void SetSecondaryCommandBuffers(std::vector<VkCommandBuffer> cmdBuffers)
+    {
+        m_secondaryCmdBuffers = std::move(cmdBuffers);
+    }
+
+    VkCommandBufferInheritanceRenderingInfo InheritanceRenderingInfo() const;
+
+    // the color output is the resolved one with msaa
+    GraphOutputs AddToGraph(RenderGraph&                                graph,
+                            const std::vector<RenderGraph::ResourceId>& shadowMaps,
+                            RenderGraph::ExecuteFn                      drawScene);
+
+    // Recreates the pipeline and the targets for the sample count, temporal renders a single sample with motion
+    // vectors for PostProcessPass to resolve. The GPU must be idle, the graph has to be rebuilt afterwards.
+    void SetAntiAliasing(RenderTargetAllocator& renderTargets, VkSampleCountFlagBits samples, bool temporal);
+
+    // Lays down the depth with a position only pipeline first, the lighting then tests with EQUAL and shades every
+    // pixel once. Recreates the pipelines, the GPU must be idle.
+    void SetDepthPrepass(bool enabled);
+
+    // Picks the pipelines of the variant, they are created the first time it is used. The ones of the earlier
+    // variants stay alive, so there is no wait for the GPU, it takes effect with the next recording.
+    void SetShading(const ShadingOptions& shading);
+
+    // Recreates the pipelines using the shader with the code now in ShaderLibrary, the GPU must be idle. False
+    // when one of them could not be created, the previous ones are kept then.
+    bool ReloadShader(const std::string& name);
+
+    // Creates the pipeline of Terrain, its layout has the heightmap as set 4 after the ones of the scene
+    void EnableTerrain();
+
+    // Renders into the top left part of the targets, they keep their size. Takes effect with the next recording.
+    void SetRenderScale(float scale);
+
+    // Replaces the extent dependent targets, they still have to be allocated and the graph has to be rebuilt.
+    void Resize(RenderTargetAllocator& renderTargets, VkExtent2D extent);
+
+    void Destroy();
 
     VkPipelineLayout pipelineLayout() const { return m_pipelineLayout; }
     VkPipeline       pipeline() const { return m_pipeline; }
+    VkPipeline       prepassPipeline() const { return m_prepassPipeline; }
+    VkPipelineLayout terrainPipelineLayout() const { return m_terrainPipelineLayout; }
+    VkPipeline       terrainPipeline() const { return m_terrainPipeline; }
+    bool             depthPrepass() const { return m_depthPrepass; }
     uint32_t         modelPushConstantOffset() const { return m_modelPushConstantOffset; }
+    // the stages of the push constants of the lighting, pre-pass and terrain layouts, they are the same range
+    VkShaderStageFlags pushConstantStages() const { return m_pushConstantStages; }
     TextureManager&  textureManager() const { return m_textureManager; }
 
-    Texture& colorOutput() const { return *m_colorOutput; }
+    const ShadingOptions& shading() const { return m_shading; }
+    // lighting and terrain pipelines created for the shading variants so far
+    size_t variantCount() const { return m_variants.size() + m_terrainVariants.size(); }
+
+    VkSampleCountFlagBits sampleCount() const { return m_sampleCountFlagBits; }
+    bool                  temporal() const { return m_temporal; }
+
+    Texture&          colorOutput() const { return *m_colorOutput; }
+    Texture&          velocityOutput() const { return *m_velocityOutput; }
+    const VkExtent2D& renderExtent() const { return m_renderExtent; }
+    float             renderScale() const { return m_renderScale; }
 
 private:
-    void BeginPass(VkCommandBuffer cmdBuffer) const;
+    void CreatePipelines();
+    void DestroyPipelines();
+    void SelectVariant();
+    ShaderVariant Variant() const;
+    void CreateTargets(RenderTargetAllocator& renderTargets);
+    void ReleaseTargets(RenderTargetAllocator& renderTargets);
+    void BeginPass(VkCommandBuffer cmdBuffer, VkRenderingFlags flags) const;
+    void SetupPass(VkCommandBuffer cmdBuffer) const;
     void EndPass(VkCommandBuffer cmdBuffer) const;
-    void TransitionForRender(VkCommandBuffer cmdBuffer) const;
-    void TransitionForRead(VkCommandBuffer cmdBuffer) const;
 
     VkDevice         m_device;
     VkPhysicalDevice m_phyDevice;
     VkPipelineLayout m_pipelineLayout;
     VkPipeline       m_pipeline;
-    glm::uint32_t    m_modelPushConstantOffset;
+    VkPipeline       m_prepassPipeline = VK_NULL_HANDLE; // only with the depth pre-pass
+    ShadingOptions   m_shading;
+
+    // m_pipeline and m_terrainPipeline are the ones of m_shading, the pre-pass has no fragment shader to specialize
+    PipelineVariantCache m_variants;
+    PipelineVariantCache m_terrainVariants;
+
+    bool               m_depthPrepass = false;
+    glm::uint32_t      m_modelPushConstantOffset;
+    VkShaderStageFlags m_pushConstantStages;
+
+    // only with the terrain
+    VkPipelineLayout m_terrainPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline       m_terrainPipeline       = VK_NULL_HANDLE;
 
     VkFormat              m_colorFormat;
+    VkFormat              m_attachmentFormats[2]; // color and velocity, for the pipeline and the secondaries
     VkFormat              m_depthFormat;
     VkExtent2D            m_extent;
+    VkExtent2D            m_renderExtent;
+    float                 m_renderScale = 1.0f;
     VkSampleCountFlagBits m_sampleCountFlagBits;
+    bool                  m_temporal = false;
+
+    // owned by the RenderTargetAllocator, m_colorOutputMsaa is only created with msaa, m_velocityOutput with TAA
+    Texture* m_colorOutput     = nullptr;
+    Texture* m_colorOutputMsaa = nullptr;
+    Texture* m_velocityOutput  = nullptr;
+    Texture* m_depthOutput     = nullptr;
 
-    Texture* m_colorOutput;
-    Texture* m_colorOutputMsaa;
-    Texture* m_depthOutput;
-    Texture* m_depthOutputMsaa;
+    std::vector<VkCommandBuffer> m_secondaryCmdBuffers;
 
+    DescriptorPool& m_descriptorPool; // the cache of the set layouts
     TextureManager& m_textureManager;
     LightManager&   m_lightManager;
     ShadowPass&     m_shadowPass;
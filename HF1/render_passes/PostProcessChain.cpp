@@ -0,0 +1,430 @@
+#include "PostProcessChain.h"
+
+#include "context.h"
+#include "descriptors.h"
+#include "render_targets.h"
+#include "shader_library.h"
+#include "texture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace {
+#include "shaders/post_chain.comp_include.h"
+
+// KERNEL and the ops of post_chain.comp
+constexpr uint32_t KERNEL_NONE    = 0;
+constexpr uint32_t KERNEL_BLUR_X  = 1;
+constexpr uint32_t KERNEL_BLUR_Y  = 2;
+constexpr uint32_t KERNEL_LAPLACE = 3;
+
+constexpr uint32_t OP_SEPIA    = 1;
+constexpr uint32_t OP_VIGNETTE = 2;
+constexpr uint32_t OP_GRAIN    = 3;
+
+// 0 for the kernels
+uint32_t OpOf(const PostProcessChain::Effect effect)
+{
+    switch (effect) {
+    case PostProcessChain::Effect::Sepia:
+        return OP_SEPIA;
+    case PostProcessChain::Effect::Vignette:
+        return OP_VIGNETTE;
+    case PostProcessChain::Effect::Grain:
+        return OP_GRAIN;
+    default:
+        return 0;
+    }
+}
+
+// into the first free 4 bits, the shader runs them from the lowest ones
+uint32_t AppendOp(const uint32_t ops, const uint32_t op)
+{
+    uint32_t shift = 0;
+    while (((ops >> shift) & 0xFu) != 0) {
+        shift += 4;
+    }
+    assert(shift < 32);
+    return ops | (op << shift);
+}
+
+void WriteSet(const VkDevice        device,
+              const VkDescriptorSet set,
+              const Texture&        input,
+              const VkImageLayout   inputLayout,
+              const Texture&        output)
+{
+    const VkDescriptorImageInfo inputInfo  = {input.sampler(), input.view(), inputLayout};
+    const VkDescriptorImageInfo outputInfo = {VK_NULL_HANDLE, output.view(), VK_IMAGE_LAYOUT_GENERAL};
+
+    const VkWriteDescriptorSet writes[] = {
+        {
+            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext            = nullptr,
+            .dstSet           = set,
+            .dstBinding       = 0,
+            .dstArrayElement  = 0,
+            .descriptorCount  = 1,
+            .descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo       = &inputInfo,
+            .pBufferInfo      = nullptr,
+            .pTexelBufferView = nullptr,
+        },
+        {
+            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext            = nullptr,
+            .dstSet           = set,
+            .dstBinding       = 1,
+            .dstArrayElement  = 0,
+            .descriptorCount  = 1,
+            .descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo       = &outputInfo,
+            .pBufferInfo      = nullptr,
+            .pTexelBufferView = nullptr,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+}
+} // namespace
+
+bool PostProcessChain::Parse(const char* text, std::vector<Effect>& out)
+{
+    std::vector<Effect> result;
+
+    const char* word = text;
+    while (true) {
+        const char*  end    = strchr(word, ',');
+        const size_t length = end != nullptr ? static_cast<size_t>(end - word) : strlen(word);
+
+        bool known = false;
+        for (uint32_t effect = 0; effect < EFFECT_COUNT; effect++) {
+            if (strlen(EFFECT_NAMES[effect]) == length && strncmp(EFFECT_NAMES[effect], word, length) == 0) {
+                result.push_back(static_cast<Effect>(effect));
+                known = true;
+                break;
+            }
+        }
+        if (!known || result.size() > MAX_EFFECTS) {
+            return false;
+        }
+
+        if (end == nullptr) {
+            break;
+        }
+        word = end + 1;
+    }
+
+    out = std::move(result);
+    return true;
+}
+
+std::string PostProcessChain::Name(const std::vector<Effect>& effects)
+{
+    if (effects.empty()) {
+        return "none";
+    }
+
+    std::string name;
+    for (const Effect effect : effects) {
+        if (!name.empty()) {
+            name += ",";
+        }
+        name += EFFECT_NAMES[static_cast<uint32_t>(effect)];
+    }
+    return name;
+}
+
+void PostProcessChain::Create(Context& context, const VkExtent2D extent)
+{
+    m_device         = context.device();
+    m_descriptorPool = &context.descriptorPool();
+    m_extent         = extent;
+
+    ShaderLibrary& library = ShaderLibrary::Get();
+    library.Register("post_chain.comp", SPV_post_chain_comp, sizeof(SPV_post_chain_comp));
+
+    const PipelineReflection reflection = library.Reflect({"post_chain.comp"});
+    assert(reflection.pushConstantRange().size == sizeof(PushConstants));
+
+    m_descSetLayout      = reflection.CreateSetLayouts(*m_descriptorPool, 1)[0];
+    m_pipelineLayout     = reflection.CreatePipelineLayout(m_device, *m_descriptorPool);
+    m_pushConstantStages = reflection.pushConstantRange().stageFlags;
+
+    for (VkDescriptorSet& set : m_inputSets) {
+        set = m_descriptorPool->CreateSet(m_descSetLayout);
+    }
+}
+
+void PostProcessChain::Destroy(Context& context)
+{
+    m_variants.Clear(context.device());
+    m_dispatches.clear();
+    vkDestroyPipelineLayout(context.device(), m_pipelineLayout, nullptr);
+}
+
+bool PostProcessChain::SetEffects(RenderTargetAllocator& renderTargets, std::vector<Effect> effects, const bool fused)
+{
+    assert(effects.size() <= MAX_EFFECTS);
+    std::vector<Effect>   oldEffects    = std::exchange(m_effects, std::move(effects));
+    const bool            oldFused      = std::exchange(m_fused, fused);
+    std::vector<Dispatch> oldDispatches = m_dispatches;
+
+    Plan();
+    if (!SelectPipelines()) {
+        m_effects    = std::move(oldEffects);
+        m_fused      = oldFused;
+        m_dispatches = std::move(oldDispatches);
+        return false;
+    }
+
+    // the pool can't free single sets, the ones of a longer chain earlier are reused
+    while (m_descSets.size() < m_dispatches.size()) {
+        m_descSets.push_back(m_descSets.empty() ? VK_NULL_HANDLE : m_descriptorPool->CreateSet(m_descSetLayout));
+    }
+
+    ReleaseImages(renderTargets);
+    CreateImages(renderTargets);
+    return true;
+}
+
+// The per-pixel effects before the first kernel run on its loads, the ones after a kernel on its stores, so only the
+// kernels are dispatches of their own. Without a kernel the per-pixel effects are a single dispatch.
+void PostProcessChain::Plan()
+{
+    m_dispatches.clear();
+
+    const auto addDispatch = [&](const uint32_t kernel, const uint32_t loadOps) {
+        m_dispatches.push_back({.kernel = kernel, .loadOps = loadOps, .storeOps = 0, .pipeline = VK_NULL_HANDLE});
+    };
+
+    uint32_t leadingOps = 0;
+    for (const Effect effect : m_effects) {
+        switch (effect) {
+        case Effect::Blur:
+            addDispatch(KERNEL_BLUR_X, leadingOps);
+            addDispatch(KERNEL_BLUR_Y, 0);
+            leadingOps = 0;
+            break;
+        case Effect::Edges:
+            addDispatch(KERNEL_LAPLACE, leadingOps);
+            leadingOps = 0;
+            break;
+        default:
+            if (!m_fused) {
+                addDispatch(KERNEL_NONE, OpOf(effect));
+            } else if (m_dispatches.empty()) {
+                leadingOps = AppendOp(leadingOps, OpOf(effect));
+            } else {
+                m_dispatches.back().storeOps = AppendOp(m_dispatches.back().storeOps, OpOf(effect));
+            }
+            break;
+        }
+    }
+
+    if (leadingOps != 0) {
+        addDispatch(KERNEL_NONE, leadingOps);
+    }
+}
+
+bool PostProcessChain::SelectPipelines()
+{
+    bool created = true;
+    for (Dispatch& dispatch : m_dispatches) {
+        // the radius only matters to the blur, the other kernels share their pipelines across it
+        const bool     blur   = dispatch.kernel == KERNEL_BLUR_X || dispatch.kernel == KERNEL_BLUR_Y;
+        const uint32_t radius = blur ? m_blurRadius : 0;
+
+        dispatch.pipeline = m_variants.Get({{dispatch.kernel, dispatch.loadOps, dispatch.storeOps, radius}},
+                                           [&](const VkSpecializationInfo* specInfo) {
+                                               return CreatePipeline(specInfo);
+                                           });
+        created &= dispatch.pipeline != VK_NULL_HANDLE;
+    }
+    return created;
+}
+
+VkPipeline PostProcessChain::CreatePipeline(const VkSpecializationInfo* specInfo) const
+{
+    const VkShaderModule shaderModule = ShaderLibrary::Get().CreateModule(m_device, "post_chain.comp");
+
+    const VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage =
+            {
+                .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext               = nullptr,
+                .flags               = 0,
+                .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module              = shaderModule,
+                .pName               = "main",
+                .pSpecializationInfo = specInfo,
+            },
+        .layout             = m_pipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex  = -1,
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+    return pipeline;
+}
+
+bool PostProcessChain::SetBlurRadius(const uint32_t radius)
+{
+    const uint32_t              oldRadius     = std::exchange(m_blurRadius, std::clamp(radius, 1u, MAX_BLUR_RADIUS));
+    const std::vector<Dispatch> oldDispatches = m_dispatches;
+    if (!SelectPipelines()) {
+        m_blurRadius = oldRadius;
+        m_dispatches = oldDispatches;
+        return false;
+    }
+    return true;
+}
+
+bool PostProcessChain::ReloadShader(const std::string& name)
+{
+    if (name != "post_chain.comp") {
+        return true;
+    }
+
+    PipelineVariantCache        oldVariants   = std::exchange(m_variants, {});
+    const std::vector<Dispatch> oldDispatches = m_dispatches;
+    if (!SelectPipelines()) {
+        m_variants.Clear(m_device);
+        m_variants   = std::move(oldVariants);
+        m_dispatches = oldDispatches;
+        return false;
+    }
+
+    oldVariants.Clear(m_device);
+    return true;
+}
+
+void PostProcessChain::CreateImages(RenderTargetAllocator& renderTargets)
+{
+    const size_t count = std::min<size_t>(m_dispatches.size(), 2);
+    for (size_t idx = 0; idx < count; idx++) {
+        m_images[idx] = renderTargets.Create({
+            .name      = "PostProcessChain image",
+            .format    = FORMAT,
+            .extent    = m_extent,
+            .usage     = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            .transient = true,
+        });
+    }
+}
+
+void PostProcessChain::ReleaseImages(RenderTargetAllocator& renderTargets)
+{
+    for (Texture*& image : m_images) {
+        if (image != nullptr) {
+            renderTargets.Release(image);
+            image = nullptr;
+        }
+    }
+}
+
+void PostProcessChain::Resize(RenderTargetAllocator& renderTargets, const VkExtent2D extent)
+{
+    m_extent = extent;
+
+    ReleaseImages(renderTargets);
+    CreateImages(renderTargets);
+}
+
+const Texture& PostProcessChain::output() const
+{
+    assert(!m_dispatches.empty());
+    return *m_images[(m_dispatches.size() - 1) % 2];
+}
+
+RenderGraph::ResourceId PostProcessChain::AddToGraph(RenderGraph& graph, const RenderGraph::ResourceId input)
+{
+    if (m_dispatches.empty()) {
+        return input;
+    }
+
+    // The dispatches are a single pass that keeps the images in GENERAL and puts a barrier between them. The graph
+    // orders every reader of a resource after all of its writers, an image written twice in a frame can't be one.
+    // The images are transient, they only live from the chain to the draw of PostProcessPass, so they can share
+    // the memory of the lighting targets.
+    std::vector<RenderGraph::Access> writes;
+    RenderGraph::ResourceId          ids[2] = {0, 0};
+    for (uint32_t idx = 0; idx < 2 && m_images[idx] != nullptr; idx++) {
+        ids[idx] = graph.ImportTexture(idx == 0 ? "post chain ping" : "post chain pong", m_images[idx], true);
+        writes.push_back({ids[idx], RenderGraph::Usage::StorageCompute});
+    }
+
+    graph.AddPass("post chain", {{input, RenderGraph::Usage::SampledCompute}}, std::move(writes),
+                  [this](VkCommandBuffer cmdBuffer) { Record(cmdBuffer); });
+
+    return ids[(m_dispatches.size() - 1) % 2];
+}
+
+void PostProcessChain::BindInputImages(const VkDevice device, const Texture& input0, const Texture& input1)
+{
+    if (m_dispatches.empty()) {
+        return;
+    }
+
+    WriteSet(device, m_inputSets[0], input0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, *m_images[0]);
+    WriteSet(device, m_inputSets[1], input1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, *m_images[0]);
+    for (size_t idx = 1; idx < m_dispatches.size(); idx++) {
+        WriteSet(device, m_descSets[idx], *m_images[(idx - 1) % 2], VK_IMAGE_LAYOUT_GENERAL, *m_images[idx % 2]);
+    }
+}
+
+void PostProcessChain::BeginFrame(const uint32_t slot)
+{
+    m_inputSlot = slot;
+    m_frame++;
+}
+
+void PostProcessChain::Record(const VkCommandBuffer cmdBuffer) const
+{
+    // the lighting pass rounds its render extent down
+    const PushConstants constants = {
+        .size  = {std::max(int32_t(m_extent.width * m_renderScale), 1),
+                  std::max(int32_t(m_extent.height * m_renderScale), 1)},
+        .frame = m_frame,
+    };
+    const uint32_t groupsX = (uint32_t(constants.size[0]) + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t groupsY = (uint32_t(constants.size[1]) + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (size_t idx = 0; idx < m_dispatches.size(); idx++) {
+        if (idx > 0) {
+            // the input of this dispatch was written by the previous one, which also read the image written now
+            const VkMemoryBarrier2 barrier = {
+                .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                .pNext         = nullptr,
+                .srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                .dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            };
+            const VkDependencyInfo dependency = {
+                .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .pNext                    = nullptr,
+                .dependencyFlags          = 0,
+                .memoryBarrierCount       = 1,
+                .pMemoryBarriers          = &barrier,
+                .bufferMemoryBarrierCount = 0,
+                .pBufferMemoryBarriers    = nullptr,
+                .imageMemoryBarrierCount  = 0,
+                .pImageMemoryBarriers     = nullptr,
+            };
+            vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+        }
+
+        const VkDescriptorSet set = idx == 0 ? m_inputSets[m_inputSlot] : m_descSets[idx];
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_dispatches[idx].pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, m_pipelineLayout, m_pushConstantStages, 0, sizeof(PushConstants), &constants);
+        vkCmdDispatch(cmdBuffer, groupsX, groupsY, 1);
+    }
+}
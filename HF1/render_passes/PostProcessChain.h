@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "pipeline_variants.h"
+#include "render_graph.h"
+
+#include <string>
+#include <vector>
+
+class Context;
+class DescriptorPool;
+class RenderTargetAllocator;
+class Texture;
+
+// Full screen effects as compute dispatches between the scene color and the final draw of PostProcessPass. The
+// neighbourhood stages load their tile and its apron into shared memory once, the per-pixel stages are fused into
+// the dispatch of a neighbouring kernel. Only the kernels ping-pong between the two intermediate images.
+class PostProcessChain {
+public:
+    static constexpr VkFormat FORMAT          = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static constexpr uint32_t TILE_SIZE       = 16; // the local size of post_chain.comp
+    static constexpr uint32_t MAX_BLUR_RADIUS = 16; // MAX_RADIUS of post_chain.comp
+    static constexpr uint32_t MAX_EFFECTS     = 8;  // the per-pixel ops of a dispatch are 4 bits each
+
+    enum class Effect : uint32_t {
+        Blur, // separable gaussian, a horizontal and a vertical dispatch
+        Edges,
+        Sepia,
+        Vignette,
+        Grain,
+    };
+
+    // indexed with Effect
+    static constexpr const char* EFFECT_NAMES[] = {"blur", "edges", "sepia", "vignette", "grain"};
+    static constexpr uint32_t    EFFECT_COUNT   = sizeof(EFFECT_NAMES) / sizeof(EFFECT_NAMES[0]);
+
+    // Comma separated EFFECT_NAMES applied in that order. Returns false on anything unknown or on more than
+    // MAX_EFFECTS of them.
+    static bool        Parse(const char* text, std::vector<Effect>& out);
+    static std::string Name(const std::vector<Effect>& effects);
+
+    void Create(Context& context, VkExtent2D extent);
+    void Destroy(Context& context);
+
+    // Replaces the effects, unfused every per-pixel stage is a dispatch of its own. Creates or releases the
+    // transient intermediate images, they still have to be allocated and the graph rebuilt, the GPU must be idle.
+    // False when a pipeline could not be created, the previous effects are kept then.
+    bool SetEffects(RenderTargetAllocator& renderTargets, std::vector<Effect> effects, bool fused);
+
+    // Picks the blur pipelines of the radius, at most MAX_BLUR_RADIUS. Like PostProcessPass::SetMode the ones of
+    // the earlier radii are kept, it takes effect with the next recording. False when a pipeline could not be
+    // created, the previous radius is kept then.
+    bool SetBlurRadius(uint32_t radius);
+
+    // Recreates the pipelines using the shader with the code now in ShaderLibrary, the GPU must be idle. False
+    // when one of them could not be created, the previous ones are kept then.
+    bool ReloadShader(const std::string& name);
+
+    void Resize(RenderTargetAllocator& renderTargets, VkExtent2D extent);
+    // only the top left part of the input was rendered, the chain keeps to it
+    void SetRenderScale(float scale) { m_renderScale = scale; }
+
+    // A single pass with every dispatch, returns the resource of the image the last one writes. Returns input
+    // without any effect.
+    RenderGraph::ResourceId AddToGraph(RenderGraph& graph, RenderGraph::ResourceId input);
+
+    // The input alternates like the history of the temporal resolve, input0 is read in the frames BeginFrame gets
+    // slot 0 for, input1 in the others.
+    void BindInputImages(VkDevice device, const Texture& input0, const Texture& input1);
+
+    // once per recorded frame, also moves the grain
+    void BeginFrame(uint32_t slot);
+
+    const std::vector<Effect>& effects() const { return m_effects; }
+    bool                       fused() const { return m_fused; }
+    uint32_t                   blurRadius() const { return m_blurRadius; }
+    uint32_t                   dispatchCount() const { return static_cast<uint32_t>(m_dispatches.size()); }
+    size_t                     variantCount() const { return m_variants.size(); }
+
+    // the image of the last dispatch, only with effects
+    const Texture& output() const;
+
+private:
+    struct PushConstants {
+        int32_t  size[2]; // the rendered part of the images
+        uint32_t frame;
+    };
+
+    // the specialization constants of post_chain.comp
+    struct Dispatch {
+        uint32_t   kernel;
+        uint32_t   loadOps;
+        uint32_t   storeOps;
+        VkPipeline pipeline;
+    };
+
+    void       Plan();
+    bool       SelectPipelines();
+    VkPipeline CreatePipeline(const VkSpecializationInfo* specInfo) const;
+    void       CreateImages(RenderTargetAllocator& renderTargets);
+    void       ReleaseImages(RenderTargetAllocator& renderTargets);
+    void       Record(VkCommandBuffer cmdBuffer) const;
+
+    VkDevice              m_device             = VK_NULL_HANDLE;
+    DescriptorPool*       m_descriptorPool     = nullptr; // the sets are allocated as the chain grows
+    VkDescriptorSetLayout m_descSetLayout      = VK_NULL_HANDLE;
+    VkPipelineLayout      m_pipelineLayout     = VK_NULL_HANDLE;
+    VkShaderStageFlags    m_pushConstantStages = 0;
+
+    PipelineVariantCache m_variants;
+
+    std::vector<Effect>   m_effects;
+    bool                  m_fused      = true;
+    uint32_t              m_blurRadius = 4;
+    std::vector<Dispatch> m_dispatches;
+
+    VkExtent2D m_extent      = {};
+    float      m_renderScale = 1.0f;
+    uint32_t   m_frame       = 0;
+
+    // transient targets of the RenderTargetAllocator, dispatch i writes m_images[i % 2], the second one only with
+    // two or more
+    Texture* m_images[2] = {nullptr, nullptr};
+
+    // the first dispatch reads the input, with one set per slot, the later ones read the image of the one before
+    VkDescriptorSet              m_inputSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    std::vector<VkDescriptorSet> m_descSets; // by dispatch, the first entry is not used
+    uint32_t                     m_inputSlot = 0;
+};
@@ -1,19 +1,25 @@
 #include "PostProcessPass.h"
 
+#include "render_targets.h"
+#include "shader_library.h"
 #include "wrappers.h"
 
+#include <algorithm>
 #include <cassert>
+#include <utility>
 
 namespace {
 #include "shaders/post_process.frag_include.h"
 #include "shaders/post_process.vert_include.h"
+#include "shaders/taa_resolve.frag_include.h"
 } // namespace
 
-static VkPipeline CreatePipeline(const VkDevice         device,
-                                 const VkPipelineLayout pipelineLayout,
-                                 const VkFormat         colorFormat,
-                                 const VkShaderModule   shaderVertex,
-                                 const VkShaderModule   shaderFragment)
+static VkPipeline CreatePipeline(const VkDevice              device,
+                                 const VkPipelineLayout      pipelineLayout,
+                                 const VkFormat              colorFormat,
+                                 const VkShaderModule        shaderVertex,
+                                 const VkShaderModule        shaderFragment,
+                                 const VkSpecializationInfo* specInfo = nullptr)
 {
 
     // shader stages
@@ -34,7 +40,7 @@ static VkPipeline CreatePipeline(const VkDevice         device,
             .stage               = VK_SHADER_STAGE_FRAGMENT_BIT,
             .module              = shaderFragment,
             .pName               = "main",
-            .pSpecializationInfo = nullptr,
+            .pSpecializationInfo = specInfo,
         },
     };
 
@@ -202,46 +208,198 @@ PostProcessPass::PostProcessPass(VkFormat colorFormat, VkExtent2D extent)
 {
 }
 
-bool PostProcessPass::Create(Context& context)
+bool PostProcessPass::Create(Context& context, const uint32_t mode)
 {
     const VkDevice device = context.device();
+    m_device              = device;
+
+    ShaderLibrary& library = ShaderLibrary::Get();
+    library.Register("post_process.vert", SPV_post_process_vert, sizeof(SPV_post_process_vert));
+    library.Register("post_process.frag", SPV_post_process_frag, sizeof(SPV_post_process_frag));
+    library.Register("taa_resolve.frag", SPV_taa_resolve_frag, sizeof(SPV_taa_resolve_frag));
+
+    // the input, then scene color, velocity and the history of the previous frame for the resolve
+    const PipelineReflection reflection        = library.Reflect({"post_process.vert", "post_process.frag"});
+    const PipelineReflection resolveReflection = library.Reflect({"post_process.vert", "taa_resolve.frag"});
+    assert(reflection.pushConstantRange().size == sizeof(PostProcessOptions));
+    assert(resolveReflection.pushConstantRange().size == sizeof(TemporalOptions));
+
+    DescriptorPool&             pool                 = context.descriptorPool();
+    const VkDescriptorSetLayout descSetLayout        = reflection.CreateSetLayouts(pool, 1)[0];
+    const VkDescriptorSetLayout resolveDescSetLayout = resolveReflection.CreateSetLayouts(pool, 1)[0];
+
+    m_pipelineLayout            = reflection.CreatePipelineLayout(device, pool);
+    m_pushConstantStages        = reflection.pushConstantRange().stageFlags;
+    m_resolvePipelineLayout     = resolveReflection.CreatePipelineLayout(device, pool);
+    m_resolvePushConstantStages = resolveReflection.pushConstantRange().stageFlags;
+
+    m_resolvePipeline = CreateResolvePipeline();
+    SetMode(mode);
+    m_chain.Create(context, m_extent);
+
+    for (uint32_t idx = 0; idx < 2; idx++) {
+        m_descSets[idx]        = context.descriptorPool().CreateSet(descSetLayout);
+        m_resolveDescSets[idx] = context.descriptorPool().CreateSet(resolveDescSetLayout);
+    }
 
-    const std::vector<VkDescriptorSetLayoutBinding> layoutBindingsBase = {
-        VkDescriptorSetLayoutBinding{
-            .binding            = 0,
-            .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount    = 1,
-            .stageFlags         = VK_SHADER_STAGE_ALL,
-            .pImmutableSamplers = nullptr,
-        },
-    };
+    return VK_SUCCESS;
+}
+
+VkPipeline PostProcessPass::CreateResolvePipeline() const
+{
+    const VkShaderModule shaderVertex   = ShaderLibrary::Get().CreateModule(m_device, "post_process.vert");
+    const VkShaderModule shaderFragment = ShaderLibrary::Get().CreateModule(m_device, "taa_resolve.frag");
 
-    VkDescriptorSetLayout descSetLayout = context.descriptorPool().CreateLayout(layoutBindingsBase);
+    // the resolve writes alpha 1, so the blending of the shared pipeline setup is a plain copy
+    const VkPipeline pipeline =
+        CreatePipeline(m_device, m_resolvePipelineLayout, HISTORY_FORMAT, shaderVertex, shaderFragment);
 
-    m_pipelineLayout = CreatePipelineLayout(device, {descSetLayout}, sizeof(PostProcessOptions));
-    {
-        VkShaderModule shaders[] = {
-            CreateShaderModule(device, SPV_post_process_vert, sizeof(SPV_post_process_vert)),
-            CreateShaderModule(device, SPV_post_process_frag, sizeof(SPV_post_process_frag)),
-        };
+    vkDestroyShaderModule(m_device, shaderVertex, nullptr);
+    vkDestroyShaderModule(m_device, shaderFragment, nullptr);
+    return pipeline;
+}
 
-        m_pipeline = CreatePipeline(device, m_pipelineLayout, m_colorFormat, shaders[0], shaders[1]);
+void PostProcessPass::SetMode(const uint32_t mode)
+{
+    m_mode     = std::min(mode, MODE_COUNT - 1);
+    m_pipeline = m_variants.Get({{m_mode}}, [&](const VkSpecializationInfo* specInfo) {
+        const VkShaderModule shaderVertex   = ShaderLibrary::Get().CreateModule(m_device, "post_process.vert");
+        const VkShaderModule shaderFragment = ShaderLibrary::Get().CreateModule(m_device, "post_process.frag");
+
+        const VkPipeline pipeline =
+            CreatePipeline(m_device, m_pipelineLayout, m_colorFormat, shaderVertex, shaderFragment, specInfo);
+
+        vkDestroyShaderModule(m_device, shaderVertex, nullptr);
+        vkDestroyShaderModule(m_device, shaderFragment, nullptr);
+        return pipeline;
+    });
+}
 
-        vkDestroyShaderModule(device, shaders[0], nullptr);
-        vkDestroyShaderModule(device, shaders[1], nullptr);
+bool PostProcessPass::ReloadShader(const std::string& name)
+{
+    if (!m_chain.ReloadShader(name)) {
+        return false;
     }
 
-    m_descSet = context.descriptorPool().CreateSet(descSetLayout);
+    const bool post    = name == "post_process.vert" || name == "post_process.frag";
+    const bool resolve = name == "post_process.vert" || name == "taa_resolve.frag";
 
-    return VK_SUCCESS;
+    // both are created before anything is replaced, the previous ones stay when either fails
+    const VkPipeline     resolvePipeline = resolve ? CreateResolvePipeline() : m_resolvePipeline;
+    const VkPipeline     oldPipeline     = m_pipeline;
+    PipelineVariantCache oldVariants;
+    if (post) {
+        oldVariants = std::exchange(m_variants, {});
+        SetMode(m_mode);
+    }
+
+    if (resolvePipeline == VK_NULL_HANDLE || m_pipeline == VK_NULL_HANDLE) {
+        if (post) {
+            m_variants.Clear(m_device);
+            m_variants = std::move(oldVariants);
+            m_pipeline = oldPipeline;
+        }
+        if (resolve && resolvePipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(m_device, resolvePipeline, nullptr);
+        }
+        return false;
+    }
+
+    oldVariants.Clear(m_device);
+    if (resolve) {
+        vkDestroyPipeline(m_device, m_resolvePipeline, nullptr);
+        m_resolvePipeline = resolvePipeline;
+    }
+    return true;
 }
 
 void PostProcessPass::Destroy(Context& context)
 {
-    vkDestroyPipeline(context.device(), m_pipeline, nullptr);
+    m_chain.Destroy(context);
+    vkDestroyPipeline(context.device(), m_resolvePipeline, nullptr);
+    vkDestroyPipelineLayout(context.device(), m_resolvePipelineLayout, nullptr);
+    m_variants.Clear(context.device());
+    m_pipeline = VK_NULL_HANDLE;
     vkDestroyPipelineLayout(context.device(), m_pipelineLayout, nullptr);
 }
 
+bool PostProcessPass::SetChain(RenderTargetAllocator&                renderTargets,
+                               std::vector<PostProcessChain::Effect> effects,
+                               const bool                            fused)
+{
+    return m_chain.SetEffects(renderTargets, std::move(effects), fused);
+}
+
+void PostProcessPass::EnableTemporalResolve(RenderTargetAllocator& renderTargets, const bool enable)
+{
+    if (enable == temporalResolve()) {
+        return;
+    }
+
+    if (enable) {
+        CreateHistory(renderTargets);
+    } else {
+        renderTargets.Release(m_history[0]);
+        renderTargets.Release(m_history[1]);
+        m_history[0] = nullptr;
+        m_history[1] = nullptr;
+    }
+
+    // the resolve moves the chain to another pass, its bound transient images can't change their lifetime
+    m_chain.Resize(renderTargets, m_extent);
+}
+
+void PostProcessPass::CreateHistory(RenderTargetAllocator& renderTargets)
+{
+    for (Texture*& history : m_history) {
+        history = renderTargets.Create({
+            .name   = "PostProcess history",
+            .format = HISTORY_FORMAT,
+            .extent = m_extent,
+            .usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        });
+    }
+
+    // fresh images, nothing to blend with and not even in a layout the resolve can sample
+    m_historyInitialized         = false;
+    temporalOptions.historyValid = 0;
+}
+
+void PostProcessPass::Resize(RenderTargetAllocator& renderTargets, const VkExtent2D extent)
+{
+    m_extent = extent;
+
+    if (temporalResolve()) {
+        renderTargets.Release(m_history[0]);
+        renderTargets.Release(m_history[1]);
+        CreateHistory(renderTargets);
+    }
+    m_chain.Resize(renderTargets, extent);
+}
+
+void PostProcessPass::SetRenderScale(const float scale)
+{
+    if (temporalResolve()) {
+        temporalOptions.renderScale = scale;
+        options.renderScale         = 1.0f;
+    } else {
+        options.renderScale = scale;
+    }
+    m_chain.SetRenderScale(options.renderScale);
+}
+
+void PostProcessPass::BeginFrame(RenderGraph& graph)
+{
+    if (temporalResolve()) {
+        m_historyIdx = 1 - m_historyIdx;
+        graph.SetImage(m_historyCurrId, m_history[m_historyIdx]->image());
+        graph.SetImage(m_historyPrevId, m_history[1 - m_historyIdx]->image());
+    }
+
+    // the chain reads the history written this frame
+    m_chain.BeginFrame(m_historyIdx);
+}
+
 void PostProcessPass::BeginPass(const VkCommandBuffer cmdBuffer, VkImageView colorOutputView)
 {
     const VkClearValue                 clearColor      = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
@@ -288,8 +446,9 @@ void PostProcessPass::BeginPass(const VkCommandBuffer cmdBuffer, VkImageView col
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descSet, 0, nullptr);
-    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(PostProcessOptions), &options);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                            &m_descSets[m_historyIdx], 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, m_pushConstantStages, 0, sizeof(PostProcessOptions), &options);
 }
 
 void PostProcessPass::Draw(const VkCommandBuffer cmdBuffer)
@@ -302,89 +461,164 @@ void PostProcessPass::EndPass(const VkCommandBuffer cmdBuffer)
     vkCmdEndRendering(cmdBuffer);
 }
 
-void PostProcessPass::BindInputImage(const VkDevice device, const Texture& texture)
+void PostProcessPass::BindInputImages(const VkDevice device, const Texture& color, const Texture* velocity)
 {
-    DescriptorSetMgmt descSetMgmt(m_descSet);
-    descSetMgmt.SetImage(0, texture.view(), texture.sampler());
-    descSetMgmt.Update(device);
+    constexpr VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    const Texture* inputs[2] = {&color, &color};
+    if (temporalResolve()) {
+        inputs[0] = m_history[0];
+        inputs[1] = m_history[1];
+    }
+    // the draw only upsamples what the chain wrote
+    if (m_chain.dispatchCount() > 0) {
+        m_chain.BindInputImages(device, *inputs[0], *inputs[1]);
+        inputs[0] = &m_chain.output();
+        inputs[1] = &m_chain.output();
+    }
+
+    for (uint32_t idx = 0; idx < 2; idx++) {
+        const Texture& input = *inputs[idx];
+
+        DescriptorSetMgmt descSetMgmt(m_descSets[idx]);
+        descSetMgmt.SetImage(0, input.view(), input.sampler(), layout);
+        descSetMgmt.Update(device);
+
+        if (temporalResolve()) {
+            assert(velocity != nullptr);
+            const Texture& history = *m_history[1 - idx];
+
+            DescriptorSetMgmt resolveSetMgmt(m_resolveDescSets[idx]);
+            resolveSetMgmt.SetImage(0, color.view(), color.sampler(), layout);
+            resolveSetMgmt.SetImage(1, velocity->view(), velocity->sampler(), layout);
+            resolveSetMgmt.SetImage(2, history.view(), history.sampler(), layout);
+            resolveSetMgmt.Update(device);
+        }
+    }
 }
 
-void PostProcessPass::TransitionForRender(VkCommandBuffer cmdBuffer,VkImage vk_image) const
+RenderGraph::ResourceId PostProcessPass::AddTemporalResolve(RenderGraph&            graph,
+                                                            RenderGraph::ResourceId color,
+                                                            RenderGraph::ResourceId velocity)
 {
-    VkImageMemoryBarrier2 swapchainBarrier = {
-        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .pNext               = nullptr,
-        .srcStageMask        = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-        .srcAccessMask       = VK_ACCESS_2_NONE,
-        .dstStageMask        = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstAccessMask       = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image               = vk_image,
-        .subresourceRange =
-            {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = 1,
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        },
-};
+    assert(temporalResolve());
+
+    // the images are swapped every frame in BeginFrame, the previous one comes with its content
+    m_historyCurrId = graph.ImportImage("history", m_history[m_historyIdx]->image(), VK_IMAGE_ASPECT_COLOR_BIT);
+    m_historyPrevId =
+        graph.ImportImage("previous history", m_history[1 - m_historyIdx]->image(), VK_IMAGE_ASPECT_COLOR_BIT);
+    graph.PreserveContent(m_historyPrevId, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    graph.AddPass("temporal resolve",
+                  {
+                      {color, RenderGraph::Usage::SampledFragment},
+                      {velocity, RenderGraph::Usage::SampledFragment},
+                      {m_historyPrevId, RenderGraph::Usage::SampledFragment},
+                  },
+                  {{m_historyCurrId, RenderGraph::Usage::ColorAttachment}},
+                  [this](VkCommandBuffer cmdBuffer) { DoResolvePass(cmdBuffer); });
+
+    return m_historyCurrId;
+}
 
-    VkImageMemoryBarrier2 barriers[] = {swapchainBarrier};
+void PostProcessPass::DoResolvePass(const VkCommandBuffer cmdBuffer)
+{
+    // the read history needs a layout even on the first frame when its content is not used
+    if (!m_historyInitialized) {
+        const VkImageMemoryBarrier2 barrier = {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .pNext               = nullptr,
+            .srcStageMask        = VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask       = VK_ACCESS_2_NONE,
+            .dstStageMask        = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            .dstAccessMask       = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = m_history[1 - m_historyIdx]->image(),
+            .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        const VkDependencyInfo dependency = {
+            .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext                    = nullptr,
+            .dependencyFlags          = 0,
+            .memoryBarrierCount       = 0,
+            .pMemoryBarriers          = nullptr,
+            .bufferMemoryBarrierCount = 0,
+            .pBufferMemoryBarriers    = nullptr,
+            .imageMemoryBarrierCount  = 1,
+            .pImageMemoryBarriers     = &barrier,
+        };
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+        m_historyInitialized = true;
+    }
 
-    const VkDependencyInfo dependencyInfo = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = 1,
-        .pImageMemoryBarriers     = barriers,
+    const VkRenderingAttachmentInfoKHR colorAttachment = {
+        .sType              = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .pNext              = nullptr,
+        .imageView          = m_history[m_historyIdx]->view(),
+        .imageLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode        = VK_RESOLVE_MODE_NONE,
+        .resolveImageView   = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp             = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp            = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue         = {},
+    };
+    const VkRenderingInfoKHR renderInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .pNext                = nullptr,
+        .flags                = 0,
+        .renderArea           = {.offset = {0, 0}, .extent = m_extent},
+        .layerCount           = 1,
+        .viewMask             = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachments    = &colorAttachment,
+        .pDepthAttachment     = nullptr,
+        .pStencilAttachment   = nullptr,
+    };
+    vkCmdBeginRendering(cmdBuffer, &renderInfo);
+
+    const VkViewport viewport = {
+        .x        = 0,
+        .y        = 0,
+        .width    = float(m_extent.width),
+        .height   = float(m_extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
+    const VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = m_extent,
     };
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_resolvePipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_resolvePipelineLayout, 0, 1,
+                            &m_resolveDescSets[m_historyIdx], 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, m_resolvePipelineLayout, m_resolvePushConstantStages, 0, sizeof(TemporalOptions),
+                       &temporalOptions);
 
-    vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
-};
-void PostProcessPass::TransitionForRead(VkCommandBuffer cmdBuffer,VkImage vk_image) const
+    Draw(cmdBuffer);
+    EndPass(cmdBuffer);
+
+    // from the next frame on there is something to blend with
+    temporalOptions.historyValid = 1;
+}
+
+void PostProcessPass::AddToGraph(RenderGraph&            graph,
+                                 RenderGraph::ResourceId input,
+                                 RenderGraph::ResourceId target,
+                                 RenderGraph::ExecuteFn  postPostprocessDraws)
 {
-    const VkImageMemoryBarrier2 renderEndBarrier = {
-        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .pNext               = nullptr,
-        .srcStageMask        = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask       = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstStageMask        = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
-        .dstAccessMask       = VK_ACCESS_2_NONE,
-        .oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .newLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image               = vk_image,
-        .subresourceRange =
-            {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = 1,
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        },
-};
-
-    const VkDependencyInfo endDependency = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = 1,
-        .pImageMemoryBarriers     = &renderEndBarrier,
-    };
+    input = m_chain.AddToGraph(graph, input);
 
-    vkCmdPipelineBarrier2(cmdBuffer, &endDependency);
-};
\ No newline at end of file
+    graph.AddPass("post process", {{input, RenderGraph::Usage::SampledFragment}},
+                  {{target, RenderGraph::Usage::ColorAttachment}},
+                  [this, postPostprocessDraws](VkCommandBuffer cmdBuffer) {
+                      DoPass(cmdBuffer, m_targetView, postPostprocessDraws);
+                  });
+}
@@ -2,33 +2,94 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include "PostProcessChain.h"
 #include "context.h"
+#include "pipeline_variants.h"
+#include "render_graph.h"
 #include "texture.h"
 
 #include <swapchain.h>
 
+#include <string>
+#include <vector>
+
+class RenderTargetAllocator;
+
 class PostProcessPass {
 public:
+    static constexpr VkFormat HISTORY_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    // indexed with the MODE specialization constant of post_process.frag
+    static constexpr const char* MODE_NAMES[] = {"none", "edges", "blur", "sepia", "grain"};
+    static constexpr uint32_t    MODE_COUNT   = sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]);
+
     struct PostProcessOptions {
-        uint32_t mode = 4;
+        float renderScale = 1.0f; // the input is upsampled from this part of it
     } options;
 
+    struct TemporalOptions {
+        float    renderScale  = 1.0f;
+        uint32_t historyValid = 0;
+        float    feedback     = 0.9f;
+    } temporalOptions;
+
     PostProcessPass(VkFormat colorFormat, VkExtent2D extent);
 
-    bool Create(Context& context);
+    bool Create(Context& context, uint32_t mode);
     void Destroy(Context& context);
 
-    template <typename DrawFn> void DoPass(VkCommandBuffer cmdBuffer,const Swapchain::Image  &img,DrawFn&& postPostprocessDraws)
+    // Picks the pipeline of the mode, it is created the first time the mode is used and kept until Destroy, so
+    // there is no wait for the GPU. Takes effect with the next recording.
+    void     SetMode(uint32_t mode);
+    uint32_t mode() const { return m_mode; }
+    size_t   variantCount() const { return m_variants.size(); }
+
+    // Recreates the pipelines using the shader with the code now in ShaderLibrary, the GPU must be idle. False
+    // when one of them could not be created, the previous ones are kept then.
+    bool ReloadShader(const std::string& name);
+
+    // The compute effects run before the draw of the mode, which then only upsamples their result. The GPU must be
+    // idle, the graph has to be rebuilt afterwards. False when its pipelines could not be created, the previous
+    // chain is kept then.
+    bool SetChain(RenderTargetAllocator& renderTargets, std::vector<PostProcessChain::Effect> effects, bool fused);
+    PostProcessChain&       chain() { return m_chain; }
+    const PostProcessChain& chain() const { return m_chain; }
+
+    template <typename DrawFn> void DoPass(VkCommandBuffer cmdBuffer, VkImageView targetView, DrawFn&& postPostprocessDraws)
     {
-        TransitionForRender(cmdBuffer,img.image);
-        BeginPass(cmdBuffer,img.view);
+        BeginPass(cmdBuffer, targetView);
         Draw(cmdBuffer);
         postPostprocessDraws(cmdBuffer);
         EndPass(cmdBuffer);
-        TransitionForRead(cmdBuffer, img.image);
     }
 
-    void BindInputImage(VkDevice device, const Texture& texture);
+    // the target view is only known once the swapchain image is acquired, see SetTargetView, the dispatches of the
+    // chain come before the draw
+    void AddToGraph(RenderGraph&            graph,
+                    RenderGraph::ResourceId input,
+                    RenderGraph::ResourceId target,
+                    RenderGraph::ExecuteFn  postPostprocessDraws);
+    void SetTargetView(VkImageView targetView) { m_targetView = targetView; }
+
+    // Blends the jittered color with the history reprojected along the velocity into a full extent image,
+    // returns that as the input of AddToGraph. Only with the temporal resolve enabled.
+    RenderGraph::ResourceId AddTemporalResolve(RenderGraph&            graph,
+                                               RenderGraph::ResourceId color,
+                                               RenderGraph::ResourceId velocity);
+
+    // Creates or releases the two history images, they still have to be allocated and the graph rebuilt.
+    void EnableTemporalResolve(RenderTargetAllocator& renderTargets, bool enable);
+    bool temporalResolve() const { return m_history[0] != nullptr; }
+
+    // Swaps the history images and moves the chain on, once per recorded frame before the graph is executed.
+    void BeginFrame(RenderGraph& graph);
+
+    void Resize(RenderTargetAllocator& renderTargets, VkExtent2D extent);
+    // the temporal resolve is the one upsampling when it is enabled
+    void SetRenderScale(float scale);
+
+    // velocity is only read by the temporal resolve
+    void BindInputImages(VkDevice device, const Texture& color, const Texture* velocity);
 
     VkPipeline       Pipeline() const { return m_pipeline; }
     VkPipelineLayout PipelineLayout() const { return m_pipelineLayout; }
@@ -37,13 +98,36 @@ private:
     void BeginPass(VkCommandBuffer cmdBuffer, VkImageView colorOutputView);
     void Draw(VkCommandBuffer cmdBuffer);
     void EndPass(VkCommandBuffer cmdBuffer);
-    void TransitionForRender(VkCommandBuffer cmdBuffer, VkImage vk_image) const;
-    void TransitionForRead(VkCommandBuffer cmdBuffer, VkImage vk_image) const;
+    void DoResolvePass(VkCommandBuffer cmdBuffer);
+    void CreateHistory(RenderTargetAllocator& renderTargets);
+    VkPipeline CreateResolvePipeline() const;
 
+    VkDevice   m_device      = VK_NULL_HANDLE;
     VkFormat   m_colorFormat = {};
     VkExtent2D m_extent      = {};
+    VkImageView m_targetView = VK_NULL_HANDLE;
+
+    // indexed with m_historyIdx, with the temporal resolve the post process reads the history written this frame
+    VkDescriptorSet    m_descSets[2]        = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkPipelineLayout   m_pipelineLayout     = VK_NULL_HANDLE;
+    VkShaderStageFlags m_pushConstantStages = 0;
+    VkPipeline         m_pipeline           = VK_NULL_HANDLE; // the one of m_mode
+    uint32_t           m_mode               = 0;
+
+    PipelineVariantCache m_variants;
+
+    VkDescriptorSet    m_resolveDescSets[2]        = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkPipelineLayout   m_resolvePipelineLayout     = VK_NULL_HANDLE;
+    VkShaderStageFlags m_resolvePushConstantStages = 0;
+    VkPipeline         m_resolvePipeline           = VK_NULL_HANDLE;
+
+    // owned by the RenderTargetAllocator, m_history[m_historyIdx] is written this frame, the other one is read
+    Texture*                m_history[2]         = {nullptr, nullptr};
+    uint32_t                m_historyIdx         = 0;
+    bool                    m_historyInitialized = false;
+    RenderGraph::ResourceId m_historyCurrId      = 0;
+    RenderGraph::ResourceId m_historyPrevId      = 0;
 
-    VkDescriptorSet  m_descSet        = VK_NULL_HANDLE;
-    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
-    VkPipeline       m_pipeline       = VK_NULL_HANDLE;
+    // empty unless SetChain gave it effects
+    PostProcessChain m_chain;
 };
@@ -0,0 +1,32 @@
+#include "SceneInterface.h"
+
+#include "shaders/depth_prepass.vert_include.h"
+#include "shaders/lightning_pass.frag_include.h"
+#include "shaders/lightning_pass.vert_include.h"
+#include "shaders/terrain.vert_include.h"
+#include <context.h>
+#include <shader_library.h>
+
+#include <cassert>
+
+const PipelineReflection& SceneInterface::Reflection()
+{
+    static const PipelineReflection reflection = [] {
+        ShaderLibrary& library = ShaderLibrary::Get();
+        library.Register("lightning_pass.vert", SPV_shader_in_vert, sizeof(SPV_shader_in_vert));
+        library.Register("lightning_pass.frag", SPV_shader_in_frag, sizeof(SPV_shader_in_frag));
+        library.Register("depth_prepass.vert", SPV_depth_prepass_vert, sizeof(SPV_depth_prepass_vert));
+        library.Register("terrain.vert", SPV_terrain_vert, sizeof(SPV_terrain_vert));
+
+        return library.Reflect({"lightning_pass.vert", "lightning_pass.frag", "depth_prepass.vert", "terrain.vert"});
+    }();
+    return reflection;
+}
+
+VkDescriptorSetLayout SceneInterface::CreateSetLayout(Context& context, const uint32_t set)
+{
+    const std::vector<VkDescriptorSetLayoutBinding> bindings = Reflection().SetBindings(set);
+    assert(!bindings.empty());
+
+    return context.descriptorPool().CreateLayout(bindings);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <spirv_reflection.h>
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+
+class Context;
+
+// The descriptor sets the shaders of LightningPass read, reflected from their SPIR-V. The resources bound to
+// them create the layouts of their sets from here, so they get the handles the pipeline layouts were made with.
+class SceneInterface {
+public:
+    static constexpr uint32_t TEXTURE_SET    = 0;
+    static constexpr uint32_t LIGHTS_SET     = 1;
+    static constexpr uint32_t SHADOW_MAP_SET = 2;
+    static constexpr uint32_t CAMERA_SET     = 3;
+    static constexpr uint32_t HEIGHTMAP_SET  = 4; // only the terrain pipeline has it
+
+    // lightning_pass.vert and .frag, depth_prepass.vert and terrain.vert together, the first call registers them
+    // in ShaderLibrary
+    static const PipelineReflection& Reflection();
+
+    static VkDescriptorSetLayout CreateSetLayout(Context& context, uint32_t set);
+};
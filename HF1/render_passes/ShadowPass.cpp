@@ -1,8 +1,15 @@
 #include "ShadowPass.h"
+#include "../managers/MeshCache.h"
 #include "../primitives/BasePrimitive.h"
+#include "SceneInterface.h"
 #include "context.h"
+#include "render_targets.h"
+#include "shader_library.h"
 #include "wrappers.h"
 
+#include <cassert>
+#include <string>
+
 namespace {
 #include "shaders/shadow_map.frag_include.h"
 #include "shaders/shadow_map.vert_include.h"
@@ -10,8 +17,8 @@ namespace {
 
 VkPipeline BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineLayout, const VkFormat depthFormat)
 {
-    VkShaderModule shaderVertex   = CreateShaderModule(device, SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert));
-    VkShaderModule shaderFragment = CreateShaderModule(device, SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag));
+    VkShaderModule shaderVertex   = ShaderLibrary::Get().CreateModule(device, "shadow_map.vert");
+    VkShaderModule shaderFragment = ShaderLibrary::Get().CreateModule(device, "shadow_map.frag");
 
     // shader stages
     VkPipelineShaderStageCreateInfo shaders[] = {
@@ -35,28 +42,10 @@ VkPipeline BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineL
         },
     };
 
-    VkVertexInputBindingDescription bindingDescriptions = {
-        0,
-        sizeof(glm::vec3),
-        VK_VERTEX_INPUT_RATE_VERTEX,
-    };
+    // only the position stream of the meshes
+    const VertexInputLayout vertexInput = MeshCache::Get().vertexFormat().Layout(true);
 
-    VkVertexInputAttributeDescription vertexAttributes = {
-        .location = 0,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset   = 0,
-    };
-    
-    const VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext                           = 0,
-        .flags                           = 0,
-        .vertexBindingDescriptionCount   = 1u,
-        .pVertexBindingDescriptions      = &bindingDescriptions,
-        .vertexAttributeDescriptionCount = 1u,
-        .pVertexAttributeDescriptions    = &vertexAttributes,
-    };
+    const VkPipelineVertexInputStateCreateInfo vertexInputInfo = vertexInput.createInfo();
 
     const VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
         .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -201,48 +190,59 @@ VkPipeline BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineL
     vkDestroyShaderModule(device, shaderVertex, nullptr);
     vkDestroyShaderModule(device, shaderFragment, nullptr);
 
-    assert(result == VK_SUCCESS);
-
-    return pipeline;
+    // a reloaded shader may not fit the rest of the pipeline, the caller keeps its previous one then
+    return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
 }
 
-ShadowPass::ShadowPass(Context& context, LightManager& lightManager, VkFormat depthFormat, VkExtent2D extent)
+ShadowPass::ShadowPass(Context&               context,
+                       LightManager&          lightManager,
+                       RenderTargetAllocator& renderTargets,
+                       VkFormat               depthFormat,
+                       VkExtent2D             extent)
     : m_depthFormat(depthFormat)
     , m_lightManager(lightManager)
     , m_extent(extent)
 
 {
-    VkPhysicalDevice phyDevice = context.physicalDevice();
-    VkDevice         device    = context.device();
-
-    for (int i = 0; i < LightManager::NumberOfLights(); i++) {
-        Texture* t = Texture::Create2D(phyDevice, device, m_depthFormat, m_extent,
-                                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    VkDevice device = context.device();
+    m_device        = device;
+
+    ShaderLibrary& library = ShaderLibrary::Get();
+    library.Register("shadow_map.vert", SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert));
+    library.Register("shadow_map.frag", SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag));
+
+    for (uint32_t i = 0; i < lightManager.lightCount(); i++) {
+        Texture* t = renderTargets.Create({
+            .name   = "ShadowPass depth " + std::to_string(i),
+            .format = m_depthFormat,
+            .extent = m_extent,
+            .usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        });
         assert(t->IsValid());
         m_shadowDepths.push_back(t);
     }
 
-    uint32_t pushConstantSize = sizeof(LightInfoPushConstant) + sizeof(BasePrimitive::ModelPushConstant);
+    // the light matrices for the whole pass, then the model and the dequantization of every draw, no sets
+    const PipelineReflection reflection = library.Reflect({"shadow_map.vert", "shadow_map.frag"});
+    assert(reflection.pushConstantRange().size ==
+           sizeof(LightInfoPushConstant) + sizeof(BasePrimitive::ShadowModelPushConstant));
     m_modelPushConstantOffset = sizeof(LightInfoPushConstant);
-    m_pipelineLayout =
-        CreatePipelineLayout(device, {BasePrimitive::CreateVertexDataDescSetLayout(context)}, pushConstantSize);
-    m_pipeline = BuildPipeline(device, m_pipelineLayout, depthFormat);
-
-    VkDescriptorSetLayoutBinding shadowMapDescSetLayoutBinding{
-        .binding            = 0,
-        .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount    = LightManager::NumberOfLights(),
-        .stageFlags         = VK_SHADER_STAGE_ALL,
-        .pImmutableSamplers = nullptr,
-    };
-    m_shadowMapDescSetLayout = context.descriptorPool().CreateLayout({shadowMapDescSetLayoutBinding});
+    m_pushConstantStages      = reflection.pushConstantRange().stageFlags;
+    m_pipelineLayout          = reflection.CreatePipelineLayout(device, context.descriptorPool());
+    m_pipeline                = BuildPipeline(device, m_pipelineLayout, depthFormat);
+    assert(m_pipeline != VK_NULL_HANDLE);
+
+    // read by the lighting, the layout is the one of its pipelines
+    m_shadowMapDescSetLayout = SceneInterface::CreateSetLayout(context, SceneInterface::SHADOW_MAP_SET);
     m_shadowMapDescSet       = context.descriptorPool().CreateSet(m_shadowMapDescSetLayout);
 
-    std::vector<VkDescriptorImageInfo> shadowImageInfos(LightManager::NumberOfLights());
-    for (int i = 0; i < LightManager::NumberOfLights(); i++) {
+    // every slot of the array has to be valid, the unused ones are never sampled
+    std::vector<VkDescriptorImageInfo> shadowImageInfos(MAX_LIGHTS);
+    for (uint32_t i = 0; i < MAX_LIGHTS; i++) {
+        const Texture* shadowDepth      = m_shadowDepths[i < m_shadowDepths.size() ? i : 0];
         shadowImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        shadowImageInfos[i].imageView   = m_shadowDepths[i]->view();
-        shadowImageInfos[i].sampler     = m_shadowDepths[i]->sampler();
+        shadowImageInfos[i].imageView   = shadowDepth->view();
+        shadowImageInfos[i].sampler     = shadowDepth->sampler();
     }
 
     VkWriteDescriptorSet descriptorWrite = {};
@@ -260,101 +260,49 @@ ShadowPass::ShadowPass(Context& context, LightManager& lightManager, VkFormat de
 
 void ShadowPass::Destroy(VkDevice device) const
 {
-    for (auto element : m_shadowDepths) {
-        element->Destroy(device);
-        delete element;
-    }
-
     vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
     vkDestroyPipeline(device, m_pipeline, nullptr);
 }
 
-void ShadowPass::BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout)
+bool ShadowPass::ReloadShader(const std::string& name)
 {
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &m_shadowMapDescSet, 0,
-                            nullptr);
-}
+    if (name != "shadow_map.vert" && name != "shadow_map.frag") {
+        return true;
+    }
 
-void ShadowPass::TransitionForRender(const VkCommandBuffer cmdBuffer)
-{
-    std::vector<VkImageMemoryBarrier2> imageMemoryBarriers;
-    for (auto element : m_shadowDepths) {
-        const VkImageMemoryBarrier2 renderStartBarrier = {.sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                                          .pNext         = nullptr,
-                                                          .srcStageMask  = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                                          .srcAccessMask = VK_ACCESS_2_NONE,
-                                                          .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                                                          .dstAccessMask =
-                                                              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                                          .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
-                                                          .newLayout           = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-                                                          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                          .image               = element->image(),
-                                                          .subresourceRange    = {
-                                                                 .aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT,
-                                                                 .baseMipLevel   = 0,
-                                                                 .levelCount     = 1,
-                                                                 .baseArrayLayer = 0,
-                                                                 .layerCount     = 1,
-                                                          }};
-        imageMemoryBarriers.push_back(renderStartBarrier);
+    const VkPipeline pipeline = BuildPipeline(m_device, m_pipelineLayout, m_depthFormat);
+    if (pipeline == VK_NULL_HANDLE) {
+        return false;
     }
 
-    const VkDependencyInfo startDependency = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = static_cast<uint32_t>(imageMemoryBarriers.size()),
-        .pImageMemoryBarriers     = imageMemoryBarriers.data(),
-    };
-    vkCmdPipelineBarrier2(cmdBuffer, &startDependency);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_pipeline = pipeline;
+    return true;
+}
+
+void ShadowPass::BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout)
+{
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                            SceneInterface::SHADOW_MAP_SET, 1, &m_shadowMapDescSet, 0, nullptr);
 }
 
-void ShadowPass::TransitionForRead(const VkCommandBuffer cmdBuffer)
+std::vector<RenderGraph::ResourceId> ShadowPass::AddToGraph(RenderGraph& graph, DrawSceneFn drawScene)
 {
-    std::vector<VkImageMemoryBarrier2> imageMemoryBarriers;
-    for (auto element : m_shadowDepths) {
-        const VkImageMemoryBarrier2 renderEndBarrier = {.sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                                                        .pNext         = nullptr,
-                                                        .srcStageMask  = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                                                        .srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                                        .dstStageMask  = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-                                                        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-                                                        .oldLayout     = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-                                                        .newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                                                        .image               = element->image(),
-                                                        .subresourceRange    = {
-                                                               .aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT,
-                                                               .baseMipLevel   = 0,
-                                                               .levelCount     = 1,
-                                                               .baseArrayLayer = 0,
-                                                               .layerCount     = 1,
-                                                        }};
-        imageMemoryBarriers.push_back(renderEndBarrier);
+    std::vector<RenderGraph::ResourceId> shadowMaps;
+    std::vector<RenderGraph::Access>     writes;
+    for (size_t i = 0; i < m_shadowDepths.size(); i++) {
+        const RenderGraph::ResourceId id =
+            graph.ImportTexture("shadow map " + std::to_string(i), m_shadowDepths[i], false);
+        shadowMaps.push_back(id);
+        writes.push_back({id, RenderGraph::Usage::DepthAttachment});
     }
 
-    const VkDependencyInfo startDependency = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = static_cast<uint32_t>(imageMemoryBarriers.size()),
-        .pImageMemoryBarriers     = imageMemoryBarriers.data(),
-    };
-    vkCmdPipelineBarrier2(cmdBuffer, &startDependency);
+    graph.AddPass("shadow", {}, writes, [this, drawScene](VkCommandBuffer cmdBuffer) { DoPass(cmdBuffer, drawScene); });
+
+    return shadowMaps;
 }
 
-void ShadowPass::BeginNthPass(VkCommandBuffer cmdBuffer, const uint8_t n)
+void ShadowPass::BeginNthPass(VkCommandBuffer cmdBuffer, const uint8_t n, const VkRenderingFlags flags)
 {
     const VkClearDepthStencilValue     depthClear      = {1.0f, 0u};
     const VkRenderingAttachmentInfoKHR depthAttachment = {
@@ -372,7 +320,7 @@ void ShadowPass::BeginNthPass(VkCommandBuffer cmdBuffer, const uint8_t n)
     const VkRenderingInfoKHR renderInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
         .pNext = nullptr,
-        .flags = 0,
+        .flags = flags,
         .renderArea =
             {
                 .offset = {0, 0},
@@ -386,7 +334,11 @@ void ShadowPass::BeginNthPass(VkCommandBuffer cmdBuffer, const uint8_t n)
         .pStencilAttachment   = nullptr,
     };
     vkCmdBeginRendering(cmdBuffer, &renderInfo);
+}
 
+void ShadowPass::SetupNthPass(VkCommandBuffer cmdBuffer, const uint8_t n)
+{
+    // dynamic state is not inherited by secondaries, so all of this is set inside the rendering scope
     const VkViewport viewport = {
         .x        = 0,
         .y        = 0,
@@ -403,16 +355,30 @@ void ShadowPass::BeginNthPass(VkCommandBuffer cmdBuffer, const uint8_t n)
     };
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-
+    // the pipeline is bound by the first draw of the DrawList, where its bind counters see it
     const LightInfoPushConstant lightInfo = {
         m_lightManager.light(n).projection,
         m_lightManager.light(n).view,
     };
-    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(lightInfo), &lightInfo);
+    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, m_pushConstantStages, 0, sizeof(lightInfo), &lightInfo);
 }
 
 void ShadowPass::EndNthPass(VkCommandBuffer cmdBuffer)
 {
     vkCmdEndRendering(cmdBuffer);
 }
+
+VkCommandBufferInheritanceRenderingInfo ShadowPass::InheritanceRenderingInfo() const
+{
+    return {
+        .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .viewMask                = 0,
+        .colorAttachmentCount    = 0,
+        .pColorAttachmentFormats = nullptr,
+        .depthAttachmentFormat   = m_depthFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT,
+    };
+}
@@ -1,30 +1,68 @@
 #pragma once
 #include "../managers/LightManager.h"
 #include "glm_config.h"
+#include "render_graph.h"
 #include "texture.h"
 #include <vulkan/vulkan_core.h>
 
+#include <functional>
+#include <string>
+#include <utility>
 #include <vector>
 
 class Context;
 class LightManager;
+class RenderTargetAllocator;
 class ShadowPass {
 public:
-    ShadowPass(Context& context, LightManager& lightManager, VkFormat depthFormat, VkExtent2D extent);
+    // draws the scene as seen by the light, every light sorts its draws on its own
+    using DrawSceneFn = std::function<void(VkCommandBuffer cmdBuffer, uint8_t light)>;
+
+    ShadowPass(Context&               context,
+               LightManager&          lightManager,
+               RenderTargetAllocator& renderTargets,
+               VkFormat               depthFormat,
+               VkExtent2D             extent);
 
     template <typename DrawFn> void DoPass(VkCommandBuffer cmdBuffer, DrawFn&& drawScene)
     {
-        TransitionForRender(cmdBuffer);
-        for (int i = 0; i < LightManager::NumberOfLights(); i++) {
-            BeginNthPass(cmdBuffer, i);
-            drawScene(cmdBuffer);
+        for (uint32_t i = 0; i < lightCount(); i++) {
+            if (m_secondaryCmdBuffers.empty()) {
+                BeginNthPass(cmdBuffer, i, 0);
+                RecordNthPass(cmdBuffer, i, drawScene);
+            } else {
+                BeginNthPass(cmdBuffer, i, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+                vkCmdExecuteCommands(cmdBuffer, 1, &m_secondaryCmdBuffers[i]);
+            }
             EndNthPass(cmdBuffer);
         }
-        TransitionForRead(cmdBuffer);
     }
 
+    // Everything inside the rendering scope of the nth light, can go into a secondary command buffer.
+    template <typename DrawFn> void RecordNthPass(VkCommandBuffer cmdBuffer, uint8_t n, DrawFn&& drawScene)
+    {
+        SetupNthPass(cmdBuffer, n);
+        drawScene(cmdBuffer, n);
+    }
+
+    // One secondary for each light, recorded with RecordNthPass. Empty means the pass records inline.
+    void SetSecondaryCommandBuffers(std::vector<VkCommandBuffer> cmdBuffers)
+    {
+        m_secondaryCmdBuffers = std::move(cmdBuffers);
+    }
+
+    VkCommandBufferInheritanceRenderingInfo InheritanceRenderingInfo() const;
+
+    // returns the shadow maps, one for each light
+    std::vector<RenderGraph::ResourceId> AddToGraph(RenderGraph& graph, DrawSceneFn drawScene);
+
     void Destroy(VkDevice device) const;
 
+    // Recreates the pipeline with the shader now in ShaderLibrary, the GPU must be idle. Keeps the previous one
+    // when it could not be created.
+    bool ReloadShader(const std::string& name);
+
+    uint32_t   lightCount() const { return static_cast<uint32_t>(m_shadowDepths.size()); }
     VkExtent2D Extent() const { return m_extent; }
     uint32_t   Width() const { return m_extent.width; }
     uint32_t   Height() const { return m_extent.height; }
@@ -32,6 +70,7 @@ public:
     VkPipelineLayout      pipelineLayout() const { return m_pipelineLayout; }
     VkPipeline            pipeline() const { return m_pipeline; }
     uint32_t              modelPushConstantOffset() const { return m_modelPushConstantOffset; }
+    VkShaderStageFlags    pushConstantStages() const { return m_pushConstantStages; }
     VkDescriptorSetLayout ShadowMapDescSetLayout() const { return m_shadowMapDescSetLayout; }
 
     void BindDescriptorSets(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout);
@@ -42,11 +81,11 @@ private:
         glm::mat4 view;
     };
 
-    void TransitionForRender(VkCommandBuffer cmdBuffer);
-    void TransitionForRead(VkCommandBuffer cmdBuffer);
-    void BeginNthPass(VkCommandBuffer cmdBuffer, uint8_t n);
+    void BeginNthPass(VkCommandBuffer cmdBuffer, uint8_t n, VkRenderingFlags flags);
+    void SetupNthPass(VkCommandBuffer cmdBuffer, uint8_t n);
     void EndNthPass(VkCommandBuffer cmdBuffer);
 
+    VkDevice      m_device;
     VkFormat      m_depthFormat; // = VK_FORMAT_D32_SFLOAT_S8_UINT;
     LightManager& m_lightManager;
 
@@ -54,7 +93,10 @@ private:
     VkPipelineLayout      m_pipelineLayout = VK_NULL_HANDLE;
     VkPipeline            m_pipeline       = VK_NULL_HANDLE;
     uint32_t              m_modelPushConstantOffset;
+    VkShaderStageFlags    m_pushConstantStages; // the stages of the push constants in shadow_map.vert and .frag
     VkDescriptorSetLayout m_shadowMapDescSetLayout;
     VkDescriptorSet       m_shadowMapDescSet;
-    std::vector<Texture*> m_shadowDepths;
+    std::vector<Texture*> m_shadowDepths; // owned by the RenderTargetAllocator
+
+    std::vector<VkCommandBuffer> m_secondaryCmdBuffers;
 };
\ No newline at end of file
@@ -0,0 +1,841 @@
+#include "GltfModel.h"
+
+#include "../managers/MeshCache.h"
+#include "../managers/TextureManager.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <buffer.h>
+#include <context.h>
+#include <json.h>
+#include <mapped_file.h>
+#include <mesh_optimizer.h>
+#include <staging_ring.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+namespace {
+constexpr uint32_t GLB_MAGIC      = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+constexpr uint32_t GLB_CHUNK_BIN  = 0x004E4942;
+
+constexpr uint32_t GL_UNSIGNED_BYTE  = 5121;
+constexpr uint32_t GL_UNSIGNED_SHORT = 5123;
+constexpr uint32_t GL_UNSIGNED_INT   = 5125;
+constexpr uint32_t GL_FLOAT          = 5126;
+constexpr uint32_t GL_TRIANGLES      = 4;
+
+// the copies run on the GPU while the next segment is filled
+constexpr VkDeviceSize STAGING_SEGMENT_SIZE  = 4 << 20;
+constexpr uint32_t     STAGING_SEGMENT_COUNT = 4;
+
+// primitives without a texture
+const char* UNTEXTURED = "white";
+
+struct Span {
+    const uint8_t* data;
+    size_t         size;
+};
+
+// An accessor resolved to memory, data is nullptr for accessors without a buffer view, those are all zeros.
+struct Accessor {
+    const uint8_t* data;
+    uint32_t       count;
+    uint32_t       componentType;
+    uint32_t       components;
+    uint32_t       stride;
+    bool           normalized;
+};
+
+uint32_t ComponentSize(const uint32_t componentType)
+{
+    switch (componentType) {
+    case 5120: // BYTE
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case 5122: // SHORT
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+uint32_t ComponentCount(const std::string& type)
+{
+    static const struct {
+        const char* name;
+        uint32_t    count;
+    } TYPES[] = {{"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4}, {"MAT2", 4}, {"MAT3", 9}, {"MAT4", 16}};
+
+    for (const auto& entry : TYPES) {
+        if (type == entry.name) {
+            return entry.count;
+        }
+    }
+    return 0;
+}
+
+bool ReadFloats(const JsonValue& array, float* out, const uint32_t count)
+{
+    if (array.size() != count) {
+        return false;
+    }
+    for (uint32_t idx = 0; idx < count; idx++) {
+        if (!array[idx].isNumber()) {
+            return false;
+        }
+        out[idx] = static_cast<float>(array[idx].asNumber());
+    }
+    return true;
+}
+
+// the uris may have spaces and such escaped
+std::string DecodeUri(const std::string& uri)
+{
+    std::string result;
+    for (size_t idx = 0; idx < uri.size(); idx++) {
+        if (uri[idx] == '%' && idx + 2 < uri.size() && isxdigit(uri[idx + 1]) && isxdigit(uri[idx + 2])) {
+            result += static_cast<char>(strtol(uri.substr(idx + 1, 2).c_str(), nullptr, 16));
+            idx += 2;
+        } else {
+            result += uri[idx];
+        }
+    }
+    return result;
+}
+
+// Reads count elements starting at first as floats. Tightly packed floats are one copy, anything else
+// goes element by element.
+void CopyFloats(const Accessor& accessor, float* out, const uint32_t first, const uint32_t count)
+{
+    const uint32_t components = accessor.components;
+    if (accessor.data == nullptr) {
+        memset(out, 0, size_t(count) * components * sizeof(float));
+        return;
+    }
+
+    const uint8_t* src = accessor.data + size_t(first) * accessor.stride;
+    if (accessor.componentType == GL_FLOAT && accessor.stride == components * sizeof(float)) {
+        memcpy(out, src, size_t(count) * components * sizeof(float));
+        return;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++, src += accessor.stride) {
+        for (uint32_t component = 0; component < components; component++) {
+            float& value = out[idx * components + component];
+            switch (accessor.componentType) {
+            case GL_FLOAT:
+                memcpy(&value, src + component * sizeof(float), sizeof(float));
+                break;
+            case GL_UNSIGNED_SHORT: {
+                uint16_t raw;
+                memcpy(&raw, src + component * sizeof(uint16_t), sizeof(raw));
+                value = raw / 65535.0f;
+                break;
+            }
+            case GL_UNSIGNED_BYTE:
+                value = src[component] / 255.0f;
+                break;
+            }
+        }
+    }
+}
+
+// the missing normals point up, so the lighting is not black
+void CopyNormals(const Accessor& accessor, float* out, const uint32_t first, const uint32_t count)
+{
+    if (accessor.data != nullptr) {
+        CopyFloats(accessor, out, first, count);
+        return;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++, out += 3) {
+        out[0] = 0.0f;
+        out[1] = 1.0f;
+        out[2] = 0.0f;
+    }
+}
+
+uint32_t ReadIndex(const Accessor& accessor, const uint8_t* src)
+{
+    switch (accessor.componentType) {
+    case GL_UNSIGNED_BYTE:
+        return *src;
+    case GL_UNSIGNED_SHORT: {
+        uint16_t index;
+        memcpy(&index, src, sizeof(index));
+        return index;
+    }
+    default: {
+        uint32_t index;
+        memcpy(&index, src, sizeof(index));
+        return index;
+    }
+    }
+}
+
+// Fills count elements of elementSize bytes of dst through the ring, fill writes [first, first + n) to out.
+template <typename Fn>
+void Stream(StagingRing& ring, const VkBuffer dst, const uint32_t count, const uint32_t elementSize, Fn fill)
+{
+    const uint32_t chunkSize = static_cast<uint32_t>(ring.segmentSize() / elementSize);
+    for (uint32_t first = 0; first < count; first += chunkSize) {
+        const uint32_t chunk = std::min(chunkSize, count - first);
+        void* out = ring.Reserve(dst, VkDeviceSize(first) * elementSize, VkDeviceSize(chunk) * elementSize);
+        fill(out, first, chunk);
+    }
+}
+
+BufferInfo CreateDeviceBuffer(const Context& context, const VkDeviceSize size, const VkBufferUsageFlags usage)
+{
+    return BufferInfo::Create(context.physicalDevice(), context.device(), size,
+                              usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+} // namespace
+
+// The state of one Load, the mapped files only live as long as it does.
+class GltfLoader {
+public:
+    GltfLoader(const Context& context, TextureManager& textureManager, const char* path, GltfModel& model)
+        : m_context(context)
+        , m_textureManager(textureManager)
+        , m_path(path)
+        , m_directory(std::filesystem::path(path).parent_path())
+        , m_model(model)
+        , m_ring(context, STAGING_SEGMENT_SIZE, STAGING_SEGMENT_COUNT)
+    {
+    }
+
+    ~GltfLoader() { m_ring.Destroy(); }
+
+    bool Load()
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        if (!m_file.Open(m_path)) {
+            printf("Unable to open glTF %s\n", m_path);
+            return false;
+        }
+        if (!ReadDocument() || !ReadBuffers() || !ReadBufferViews()) {
+            return false;
+        }
+        ReadMaterials();
+
+        const auto meshStart = std::chrono::steady_clock::now();
+        if (!ReadMeshes()) {
+            return false;
+        }
+        m_ring.Flush();
+        const auto meshEnd = std::chrono::steady_clock::now();
+
+        if (!ReadNodes()) {
+            return false;
+        }
+
+        const auto   end      = std::chrono::steady_clock::now();
+        const double meshMs   = std::chrono::duration<double, std::milli>(meshEnd - meshStart).count();
+        const double streamMB = m_ring.uploadedBytes() / (1024.0 * 1024.0);
+        printf("glTF %s: %u meshes with %zu primitives, %u textures, %zu nodes\n", m_path, m_doc.count("meshes"),
+               m_model.m_primitives.size(), m_textureCount, m_model.m_nodes.size());
+        printf("glTF %s: %.2f MB of geometry streamed in %.2f ms (%.1f MB/s), %.2f ms in total\n", m_path, streamMB,
+               meshMs, meshMs > 0.0 ? streamMB / (meshMs / 1000.0) : 0.0,
+               std::chrono::duration<double, std::milli>(end - start).count());
+        return true;
+    }
+
+private:
+    bool Error(const char* format, ...) const
+    {
+        printf("glTF %s: ", m_path);
+
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+
+        printf("\n");
+        return false;
+    }
+
+    // the JSON of a .gltf is the whole file, a .glb has it in its first chunk and the first buffer after it
+    bool ReadDocument()
+    {
+        const uint8_t* data = static_cast<const uint8_t*>(m_file.data());
+        const size_t   size = m_file.size();
+
+        const char* json     = reinterpret_cast<const char*>(data);
+        size_t      jsonSize = size;
+
+        // magic, version, length, then the length and the type of the JSON chunk
+        uint32_t header[5] = {};
+        memcpy(header, data, std::min(size, sizeof(header)));
+        if (header[0] == GLB_MAGIC) {
+            if (size < sizeof(header)) {
+                return Error("truncated glb header");
+            }
+            if (header[1] != 2 || header[2] > size || header[4] != GLB_CHUNK_JSON ||
+                header[3] > size - sizeof(header)) {
+                return Error("not a glb version 2 file with a JSON chunk");
+            }
+            json     = reinterpret_cast<const char*>(data + sizeof(header));
+            jsonSize = header[3];
+
+            // the chunks are 4 byte aligned
+            const size_t binHeader = sizeof(header) + ((jsonSize + 3) & ~size_t(3));
+            uint32_t     chunk[2]  = {};
+            if (binHeader + sizeof(chunk) <= size) {
+                memcpy(chunk, data + binHeader, sizeof(chunk));
+                if (chunk[1] == GLB_CHUNK_BIN && chunk[0] <= size - binHeader - sizeof(chunk)) {
+                    m_glbBinary = {data + binHeader + sizeof(chunk), chunk[0]};
+                }
+            }
+        }
+
+        std::string error;
+        if (!JsonValue::Parse(json, jsonSize, m_doc, error)) {
+            return Error("%s", error.c_str());
+        }
+
+        const std::string& version = m_doc["asset"]["version"].asString();
+        if (version.compare(0, 2, "2.") != 0) {
+            return Error("only glTF 2.x is supported");
+        }
+        return true;
+    }
+
+    bool MapUri(const std::string& uri, Span& out)
+    {
+        if (uri.compare(0, 5, "data:") == 0) {
+            return Error("data uris are not supported, convert the model to a .glb");
+        }
+
+        const std::string uriPath = (m_directory / DecodeUri(uri)).string();
+        m_mappedFiles.push_back(std::make_unique<MappedFile>());
+        if (!m_mappedFiles.back()->Open(uriPath.c_str())) {
+            printf("glTF %s: unable to open %s\n", m_path, uriPath.c_str());
+            return false;
+        }
+
+        out = {static_cast<const uint8_t*>(m_mappedFiles.back()->data()), m_mappedFiles.back()->size()};
+        return true;
+    }
+
+    bool ReadBuffers()
+    {
+        const JsonValue& buffers = m_doc["buffers"];
+        for (uint32_t idx = 0; idx < buffers.size(); idx++) {
+            const JsonValue& buffer = buffers[idx];
+
+            Span span = {};
+            if (buffer.has("uri")) {
+                if (!MapUri(buffer["uri"].asString(), span)) {
+                    return false;
+                }
+            } else if (idx == 0 && m_glbBinary.data != nullptr) {
+                span = m_glbBinary;
+            } else {
+                return Error("no data for buffer %u", idx);
+            }
+
+            const int64_t byteLength = buffer.integer("byteLength");
+            if (byteLength < 0 || static_cast<uint64_t>(byteLength) > span.size) {
+                return Error("buffer %u is shorter than its byteLength", idx);
+            }
+            m_buffers.push_back({span.data, static_cast<size_t>(byteLength)});
+        }
+        return true;
+    }
+
+    bool ReadBufferViews()
+    {
+        const JsonValue& views = m_doc["bufferViews"];
+        for (uint32_t idx = 0; idx < views.size(); idx++) {
+            const JsonValue& view   = views[idx];
+            const int64_t    buffer = view.integer("buffer");
+            const int64_t    offset = view.integer("byteOffset", 0);
+            const int64_t    length = view.integer("byteLength");
+            if (buffer < 0 || buffer >= static_cast<int64_t>(m_buffers.size()) || offset < 0 || length < 0 ||
+                static_cast<uint64_t>(offset + length) > m_buffers[buffer].size) {
+                return Error("buffer view %u is out of bounds", idx);
+            }
+
+            m_views.push_back({m_buffers[buffer].data + offset, static_cast<size_t>(length)});
+            m_viewStrides.push_back(static_cast<uint32_t>(view.integer("byteStride", 0)));
+        }
+        return true;
+    }
+
+    bool ReadAccessor(const int64_t index, Accessor& out)
+    {
+        const JsonValue& accessor = m_doc["accessors"][index];
+        if (index < 0 || !accessor.isObject()) {
+            return Error("accessor %lld is missing", static_cast<long long>(index));
+        }
+        if (accessor.has("sparse")) {
+            return Error("accessor %lld is sparse, those are not supported", static_cast<long long>(index));
+        }
+
+        out.count         = static_cast<uint32_t>(accessor.integer("count", 0));
+        out.componentType = static_cast<uint32_t>(accessor.integer("componentType", 0));
+        out.components    = ComponentCount(accessor["type"].asString());
+        out.normalized    = accessor["normalized"].asBool();
+        out.data          = nullptr;
+
+        const uint32_t elementSize = ComponentSize(out.componentType) * out.components;
+        if (elementSize == 0) {
+            return Error("accessor %lld has an unknown type", static_cast<long long>(index));
+        }
+        out.stride = elementSize;
+
+        if (!accessor.has("bufferView")) {
+            return true;
+        }
+
+        const int64_t view = accessor.integer("bufferView");
+        if (view < 0 || view >= static_cast<int64_t>(m_views.size())) {
+            return Error("the buffer view of accessor %lld is missing", static_cast<long long>(index));
+        }
+        if (m_viewStrides[view] != 0) {
+            out.stride = m_viewStrides[view];
+        }
+
+        // the last element only needs its own size, not the whole stride
+        const int64_t offset = accessor.integer("byteOffset", 0);
+        const size_t  needed = out.count > 0 ? size_t(out.count - 1) * out.stride + elementSize : 0;
+        if (offset < 0 || static_cast<size_t>(offset) + needed > m_views[view].size) {
+            return Error("accessor %lld is out of bounds", static_cast<long long>(index));
+        }
+        out.data = m_views[view].data + offset;
+        return true;
+    }
+
+    // texture of the image, decoded on the first use
+    const std::string& ImageTexture(const uint32_t image)
+    {
+        if (m_imageTextures[image].empty()) {
+            const JsonValue& info = m_doc["images"][image];
+
+            Span encoded = {};
+            bool mapped  = false;
+            if (info.has("uri")) {
+                mapped = MapUri(info["uri"].asString(), encoded);
+            } else {
+                const int64_t view = info.integer("bufferView");
+                if (view >= 0 && view < static_cast<int64_t>(m_views.size())) {
+                    encoded = m_views[view];
+                    mapped  = true;
+                }
+            }
+
+            // a broken image is not worth failing the whole model for
+            const std::string name = std::string(m_path) + "#image" + std::to_string(image);
+            if (mapped && m_textureManager.AddEncoded(name, encoded.data, encoded.size)) {
+                m_imageTextures[image] = name;
+                m_textureCount++;
+            } else {
+                printf("glTF %s: image %u is drawn untextured\n", m_path, image);
+                m_imageTextures[image] = UNTEXTURED;
+            }
+        }
+        return m_imageTextures[image];
+    }
+
+    // before the meshes, so the decoding is not counted into their streaming
+    void ReadMaterials()
+    {
+        m_imageTextures.resize(m_doc.count("images"));
+
+        const JsonValue& materials = m_doc["materials"];
+        for (uint32_t idx = 0; idx < materials.size(); idx++) {
+            const JsonValue& baseColor = materials[idx]["pbrMetallicRoughness"]["baseColorTexture"];
+            const int64_t    texture   = baseColor.integer("index");
+            const int64_t    image     = m_doc["textures"][texture].integer("source");
+            if (texture < 0 || image < 0 || image >= static_cast<int64_t>(m_imageTextures.size())) {
+                m_materialTextures.push_back(UNTEXTURED);
+            } else {
+                m_materialTextures.push_back(ImageTexture(static_cast<uint32_t>(image)));
+            }
+        }
+    }
+
+    // the chunks of the attributes that are converted, reused by every mesh
+    float* Scratch(const uint32_t idx, const size_t floatCount)
+    {
+        if (m_scratch[idx].size() < floatCount) {
+            m_scratch[idx].resize(floatCount);
+        }
+        return m_scratch[idx].data();
+    }
+
+    PositionDequant ScanDequant(const VertexFormat& format, const Accessor& positions)
+    {
+        float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+        float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        const uint32_t chunkSize = static_cast<uint32_t>(m_ring.segmentSize() / (3 * sizeof(float)));
+        for (uint32_t first = 0; first < positions.count; first += chunkSize) {
+            const uint32_t count    = std::min(chunkSize, positions.count - first);
+            float*         position = Scratch(0, size_t(count) * 3);
+            CopyFloats(positions, position, first, count);
+
+            for (uint32_t idx = 0; idx < count * 3; idx++) {
+                min[idx % 3] = std::min(min[idx % 3], position[idx]);
+                max[idx % 3] = std::max(max[idx % 3], position[idx]);
+            }
+        }
+        return ComputeDequant(format, min, max);
+    }
+
+    bool ReadPrimitive(const uint32_t meshIdx, const uint32_t primitiveIdx, const JsonValue& primitive)
+    {
+        const std::string key = std::string("gltf:") + m_path + "#" + std::to_string(meshIdx) + "." +
+                                std::to_string(primitiveIdx);
+        const int64_t     material = primitive.integer("material");
+        const std::string texture  = (material >= 0 && material < static_cast<int64_t>(m_materialTextures.size()))
+                                         ? m_materialTextures[material]
+                                         : UNTEXTURED;
+
+        // the same file loaded twice shares the meshes
+        if (const Mesh* mesh = MeshCache::Get().Acquire(key)) {
+            m_model.m_meshes.push_back(mesh);
+            m_model.m_primitives.push_back({key, texture});
+            return true;
+        }
+
+        const JsonValue& attributes = primitive["attributes"];
+
+        Accessor positions = {};
+        if (!ReadAccessor(attributes.integer("POSITION"), positions)) {
+            return false;
+        }
+        if (positions.componentType != GL_FLOAT || positions.components != 3) {
+            return Error("POSITION of mesh %u has to be float3", meshIdx);
+        }
+        const uint32_t vertexCount = positions.count;
+
+        // the missing attributes are zeros, see CopyNormals for the normals
+        Accessor normals   = {nullptr, vertexCount, GL_FLOAT, 3, 12, false};
+        Accessor texCoords = {nullptr, vertexCount, GL_FLOAT, 2, 8, false};
+        if (attributes.has("NORMAL") && !ReadAccessor(attributes.integer("NORMAL"), normals)) {
+            return false;
+        }
+        if (attributes.has("TEXCOORD_0") && !ReadAccessor(attributes.integer("TEXCOORD_0"), texCoords)) {
+            return false;
+        }
+        if (normals.count != vertexCount || texCoords.count != vertexCount) {
+            return Error("the attributes of mesh %u have different counts", meshIdx);
+        }
+        if (normals.componentType != GL_FLOAT || normals.components != 3) {
+            return Error("NORMAL of mesh %u has to be float3", meshIdx);
+        }
+        const bool normalizedTexCoords = texCoords.normalized && (texCoords.componentType == GL_UNSIGNED_BYTE ||
+                                                                  texCoords.componentType == GL_UNSIGNED_SHORT);
+        if ((texCoords.componentType != GL_FLOAT && !normalizedTexCoords) || texCoords.components != 2) {
+            return Error("TEXCOORD_0 of mesh %u has to be float2 or normalized unsigned", meshIdx);
+        }
+
+        Accessor   indices    = {};
+        const bool hasIndices = primitive.has("indices");
+        uint32_t   indexCount = vertexCount - vertexCount % 3;
+        if (hasIndices) {
+            if (!ReadAccessor(primitive.integer("indices"), indices)) {
+                return false;
+            }
+            if (indices.components != 1 || indices.data == nullptr ||
+                (indices.componentType != GL_UNSIGNED_BYTE && indices.componentType != GL_UNSIGNED_SHORT &&
+                 indices.componentType != GL_UNSIGNED_INT)) {
+                return Error("the indices of mesh %u have to be unsigned integers", meshIdx);
+            }
+            indexCount = indices.count;
+        }
+        if (vertexCount == 0 || indexCount == 0) {
+            return Error("mesh %u has nothing to draw", meshIdx);
+        }
+
+        // the vertex format of the cache for the vertices, 16 bit indices when they reach every vertex
+        const VertexFormat& format     = MeshCache::Get().vertexFormat();
+        const VkIndexType   indexType  = FitsIndex16(vertexCount) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        const uint32_t      indexSize  = indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+        const VkDeviceSize  indexBytes = VkDeviceSize(indexCount) * indexSize;
+
+        BufferInfo streams[VertexFormat::MAX_STREAMS] = {};
+        for (uint32_t stream = 0; stream < format.streamCount(); stream++) {
+            streams[stream] = CreateDeviceBuffer(m_context, VkDeviceSize(vertexCount) * format.streamStride(stream),
+                                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        }
+        const BufferInfo indexBuffer = CreateDeviceBuffer(m_context, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+        // The spec wants the bounds of the positions in the accessor, they are only scanned for when a file does
+        // not have them. Float positions don't need them at all.
+        const JsonValue&      positionBounds = m_doc["accessors"][attributes.integer("POSITION")];
+        float                 min[3]         = {};
+        float                 max[3]         = {};
+        const bool            hasBounds      = ReadFloats(positionBounds["min"], min, 3) &&
+                                               ReadFloats(positionBounds["max"], max, 3);
+        const PositionDequant dequant        = (hasBounds || format.position == VertexFormat::Position::Float3)
+                                                   ? ComputeDequant(format, min, max)
+                                                   : ScanDequant(format, positions);
+
+        // Written straight into the staging memory when the format has the same floats as the file, the mapped
+        // file is the only CPU side copy then. Everything else is converted a chunk at a time.
+        Stream(m_ring, streams[0].buffer, vertexCount, format.streamStride(0),
+               [&](void* out, uint32_t first, uint32_t count) {
+                   if (format.position == VertexFormat::Position::Float3) {
+                       CopyFloats(positions, static_cast<float*>(out), first, count);
+                       return;
+                   }
+                   float* scratch = Scratch(0, size_t(count) * 3);
+                   CopyFloats(positions, scratch, first, count);
+                   EncodePositions(format, dequant, scratch, count, out);
+               });
+
+        const bool floatTexCoords = !format.interleaved && format.texCoord == VertexFormat::TexCoord::Float2;
+        const bool floatNormals   = !format.interleaved && format.normal == VertexFormat::Normal::Float3;
+        for (uint32_t stream = 1; stream < format.streamCount(); stream++) {
+            Stream(m_ring, streams[stream].buffer, vertexCount, format.streamStride(stream),
+                   [&](void* out, uint32_t first, uint32_t count) {
+                       if (stream == 1 && floatTexCoords) {
+                           CopyFloats(texCoords, static_cast<float*>(out), first, count);
+                       } else if (stream == 1) {
+                           float* scratch = Scratch(0, size_t(count) * 2);
+                           CopyFloats(texCoords, scratch, first, count);
+                           EncodeTexCoords(format, scratch, count, out);
+                       }
+
+                       if (stream == format.normalStream() && floatNormals) {
+                           CopyNormals(normals, static_cast<float*>(out), first, count);
+                       } else if (stream == format.normalStream()) {
+                           float* scratch = Scratch(1, size_t(count) * 3);
+                           CopyNormals(normals, scratch, first, count);
+                           EncodeNormals(format, scratch, count, out);
+                       }
+                   });
+        }
+
+        // Only the triangles are reordered for the vertex cache, renumbering the vertices would need a copy of
+        // them instead of reading the file a chunk at a time. An index past the vertices would read out of the
+        // buffer on the GPU.
+        bool                  outOfRange = false;
+        std::vector<uint32_t> optimized(indexCount - indexCount % 3);
+        for (uint32_t idx = 0; idx < optimized.size(); idx++) {
+            optimized[idx] = hasIndices ? ReadIndex(indices, indices.data + size_t(idx) * indices.stride) : idx;
+            if (optimized[idx] >= vertexCount) {
+                outOfRange = true;
+                optimized[idx] = 0;
+            }
+        }
+        MeshCache::Get().OptimizeIndices(optimized, vertexCount);
+        // the leftover of an incomplete triangle draws nothing either way
+        optimized.resize(indexCount, 0);
+
+        Stream(m_ring, indexBuffer.buffer, indexCount, indexSize, [&](void* out, uint32_t first, uint32_t count) {
+            if (indexType == VK_INDEX_TYPE_UINT32) {
+                memcpy(out, optimized.data() + first, size_t(count) * sizeof(uint32_t));
+                return;
+            }
+            uint16_t* index = static_cast<uint16_t*>(out);
+            for (uint32_t idx = 0; idx < count; idx++) {
+                index[idx] = static_cast<uint16_t>(optimized[first + idx]);
+            }
+        });
+
+        const Mesh* mesh = MeshCache::Get().Adopt(key, indexCount, vertexCount, dequant, streams, indexBuffer,
+                                                  indexType);
+        m_model.m_meshes.push_back(mesh);
+        m_model.m_primitives.push_back({key, texture});
+
+        if (outOfRange) {
+            return Error("mesh %u has indices past its vertices", meshIdx);
+        }
+        return true;
+    }
+
+    bool ReadMeshes()
+    {
+        const JsonValue& meshes = m_doc["meshes"];
+        m_meshPrimitives.resize(meshes.size());
+
+        for (uint32_t meshIdx = 0; meshIdx < meshes.size(); meshIdx++) {
+            const JsonValue& primitives = meshes[meshIdx]["primitives"];
+            const uint32_t   first      = static_cast<uint32_t>(m_model.m_primitives.size());
+
+            for (uint32_t primitiveIdx = 0; primitiveIdx < primitives.size(); primitiveIdx++) {
+                const JsonValue& primitive = primitives[primitiveIdx];
+                if (primitive.integer("mode", GL_TRIANGLES) != GL_TRIANGLES) {
+                    printf("glTF %s: skipping primitive %u of mesh %u, only triangle lists are drawn\n", m_path,
+                           primitiveIdx, meshIdx);
+                    continue;
+                }
+                if (!ReadPrimitive(meshIdx, primitiveIdx, primitive)) {
+                    return false;
+                }
+            }
+
+            m_meshPrimitives[meshIdx] = {first, static_cast<uint32_t>(m_model.m_primitives.size()) - first};
+        }
+        return true;
+    }
+
+    bool ReadNodeTransform(const JsonValue& node, GltfModel::Node& out)
+    {
+        out.position = glm::vec3(0.0f);
+        out.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        out.scale    = glm::vec3(1.0f);
+
+        if (node.has("matrix")) {
+            float values[16];
+            if (!ReadFloats(node["matrix"], values, 16)) {
+                return false;
+            }
+
+            // column major like glm, decomposed into the TRS the transform store works with
+            const glm::mat4 matrix = glm::make_mat4(values);
+            out.position           = glm::vec3(matrix[3]);
+            out.scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])),
+                                  glm::length(glm::vec3(matrix[2])));
+            if (glm::determinant(glm::mat3(matrix)) < 0.0f) {
+                out.scale.x = -out.scale.x;
+            }
+            if (out.scale.x != 0.0f && out.scale.y != 0.0f && out.scale.z != 0.0f) {
+                out.rotation = glm::quat_cast(glm::mat3(glm::vec3(matrix[0]) / out.scale.x,
+                                                        glm::vec3(matrix[1]) / out.scale.y,
+                                                        glm::vec3(matrix[2]) / out.scale.z));
+            }
+            return true;
+        }
+
+        float rotation[4];
+        if ((node.has("translation") && !ReadFloats(node["translation"], glm::value_ptr(out.position), 3)) ||
+            (node.has("scale") && !ReadFloats(node["scale"], glm::value_ptr(out.scale), 3))) {
+            return false;
+        }
+        if (node.has("rotation")) {
+            if (!ReadFloats(node["rotation"], rotation, 4)) {
+                return false;
+            }
+            // xyzw in the file
+            out.rotation = glm::quat(rotation[3], rotation[0], rotation[1], rotation[2]);
+        }
+        return true;
+    }
+
+    bool ReadNodes()
+    {
+        const JsonValue& nodes     = m_doc["nodes"];
+        const uint32_t   nodeCount = static_cast<uint32_t>(nodes.size());
+
+        // the roots are the ones of the default scene, without scenes every node nobody has as a child
+        std::vector<uint32_t> roots;
+        const JsonValue&      scene = m_doc["scenes"][m_doc.integer("scene", 0)];
+        if (scene.isObject()) {
+            for (uint32_t idx = 0; idx < scene.count("nodes"); idx++) {
+                roots.push_back(static_cast<uint32_t>(scene["nodes"][idx].asNumber(-1)));
+            }
+        } else {
+            std::vector<bool> isChild(nodeCount, false);
+            for (uint32_t idx = 0; idx < nodeCount; idx++) {
+                for (uint32_t child = 0; child < nodes[idx].count("children"); child++) {
+                    const int64_t childIdx = static_cast<int64_t>(nodes[idx]["children"][child].asNumber(-1));
+                    if (childIdx >= 0 && childIdx < nodeCount) {
+                        isChild[childIdx] = true;
+                    }
+                }
+            }
+            for (uint32_t idx = 0; idx < nodeCount; idx++) {
+                if (!isChild[idx]) {
+                    roots.push_back(idx);
+                }
+            }
+        }
+
+        // depth first, a node index and the output index of its parent
+        std::vector<bool>                          visited(nodeCount, false);
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        for (auto it = roots.rbegin(); it != roots.rend(); it++) {
+            stack.push_back({*it, GltfModel::NO_PARENT});
+        }
+
+        while (!stack.empty()) {
+            const auto [nodeIdx, parent] = stack.back();
+            stack.pop_back();
+
+            if (nodeIdx >= nodeCount || visited[nodeIdx]) {
+                return Error("node %u is missing or has more than one parent", nodeIdx);
+            }
+            visited[nodeIdx] = true;
+
+            const JsonValue& node = nodes[nodeIdx];
+            GltfModel::Node  out  = {};
+            out.parent            = parent;
+            if (!ReadNodeTransform(node, out)) {
+                return Error("node %u has a broken transform", nodeIdx);
+            }
+
+            const int64_t mesh = node.integer("mesh");
+            if (mesh >= 0 && mesh < static_cast<int64_t>(m_meshPrimitives.size())) {
+                out.firstPrimitive = m_meshPrimitives[mesh].first;
+                out.primitiveCount = m_meshPrimitives[mesh].second;
+            }
+
+            const uint32_t outIdx = static_cast<uint32_t>(m_model.m_nodes.size());
+            m_model.m_nodes.push_back(out);
+
+            const JsonValue& children = node["children"];
+            for (uint32_t child = children.size(); child-- > 0;) {
+                stack.push_back({static_cast<uint32_t>(children[child].asNumber(-1)), outIdx});
+            }
+        }
+        return true;
+    }
+
+    const Context&        m_context;
+    TextureManager&       m_textureManager;
+    const char*           m_path;
+    std::filesystem::path m_directory;
+    GltfModel&            m_model;
+    StagingRing           m_ring;
+
+    MappedFile                               m_file;
+    std::vector<std::unique_ptr<MappedFile>> m_mappedFiles; // the external buffers and images
+    JsonValue                                m_doc;
+    Span                                     m_glbBinary = {};
+    std::vector<Span>                        m_buffers;
+    std::vector<Span>                        m_views;
+    std::vector<uint32_t>                    m_viewStrides;
+
+    std::vector<std::pair<uint32_t, uint32_t>> m_meshPrimitives; // first and count
+    std::vector<std::string>                   m_imageTextures;
+    std::vector<std::string>                   m_materialTextures;
+    uint32_t                                   m_textureCount = 0;
+    std::vector<float>                         m_scratch[2];
+};
+
+bool GltfModel::Load(const Context& context, TextureManager& textureManager, const char* path)
+{
+    GltfLoader loader(context, textureManager, path, *this);
+    return loader.Load();
+}
+
+void GltfModel::Destroy(const VkDevice device)
+{
+    for (const Mesh* mesh : m_meshes) {
+        MeshCache::Get().Release(device, mesh);
+    }
+    m_meshes.clear();
+    m_primitives.clear();
+    m_nodes.clear();
+}
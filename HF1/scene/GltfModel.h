@@ -0,0 +1,60 @@
+#pragma once
+#include "glm_config.h"
+#include <glm/gtc/quaternion.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Context;
+class TextureManager;
+struct Mesh;
+
+// A glTF 2.0 model, a .gltf with its .bin files or a single .glb. The files are mapped and every accessor is
+// streamed through a StagingRing into device local buffers of the MeshCache, converted on the way where the
+// format differs from what the passes read. The base color images become textures of the TextureManager.
+//
+// Only what the renderer can show is read: triangle lists with POSITION, NORMAL and TEXCOORD_0, the node
+// hierarchy and the base color texture. Skins, morph targets, animations, sparse accessors, data uris and the
+// material factors are ignored or rejected.
+class GltfModel {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    struct Primitive {
+        std::string meshKey;
+        std::string texture;
+    };
+
+    // nodes in parent order like the scene files, the primitives of a node are the ones of its mesh
+    struct Node {
+        uint32_t  parent;
+        uint32_t  firstPrimitive;
+        uint32_t  primitiveCount;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    GltfModel() = default;
+
+    GltfModel(const GltfModel&)            = delete;
+    GltfModel& operator=(const GltfModel&) = delete;
+
+    // Prints what went wrong and returns false, the meshes uploaded until then stay until Destroy.
+    bool Load(const Context& context, TextureManager& textureManager, const char* path);
+    // the objects using the meshes have to be destroyed already
+    void Destroy(VkDevice device);
+
+    const std::vector<Node>&      nodes() const { return m_nodes; }
+    const std::vector<Primitive>& primitives() const { return m_primitives; }
+
+private:
+    friend class GltfLoader;
+
+    std::vector<Node>        m_nodes;
+    std::vector<Primitive>   m_primitives;
+    std::vector<const Mesh*> m_meshes; // the model is a user of every mesh it loaded
+};
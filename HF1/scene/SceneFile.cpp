@@ -0,0 +1,358 @@
+#include "SceneFile.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// the nodes are read straight from the file, the layout must not change without a new VERSION
+static_assert(std::is_trivially_copyable_v<SceneNode>);
+static_assert(sizeof(SceneNode) == 76);
+static_assert(sizeof(SceneTextureName) == SCENE_TEXTURE_NAME_LEN);
+static_assert(sizeof(SceneFile::Header) == 16);
+
+namespace {
+struct KindInfo {
+    const char*   name;
+    SceneNodeKind kind;
+    uint32_t      paramCount;
+    float         defaults[SCENE_MAX_PARAMS];
+};
+
+// the defaults are the ones of the primitive constructors
+constexpr KindInfo KINDS[] = {
+    {"group", SceneNodeKind::Group, 0, {}},
+    {"grid", SceneNodeKind::Grid, 4, {1.0f, 1.0f, 1.0f, 1.0f}},
+    {"cube", SceneNodeKind::Cube, 1, {0.0f}},
+    {"sphere", SceneNodeKind::Sphere, 3, {1.0f, 25.0f, 25.0f}},
+    {"cylinder", SceneNodeKind::Cylinder, 5, {1.0f, 1.0f, 1.0f, 16.0f, 1.0f}},
+    {"cone", SceneNodeKind::Cone, 4, {1.0f, 1.0f, 3.0f, 1.0f}},
+    {"cirno_prism", SceneNodeKind::CirnoPrism, 0, {}},
+    {"rotating_cube", SceneNodeKind::RotatingCube, 0, {}},
+    {"spinning_cirno_prism", SceneNodeKind::SpinningCirnoPrism, 0, {}},
+    {"piston_with_bouncing_ball", SceneNodeKind::PistonWithBouncingBall, 0, {}},
+    {"orbiting_helicopter", SceneNodeKind::OrbitingHelicopter, 0, {}},
+};
+constexpr uint32_t KIND_COUNT = sizeof(KINDS) / sizeof(KINDS[0]);
+
+bool IsEntity(const SceneNodeKind kind)
+{
+    return kind >= SceneNodeKind::RotatingCube;
+}
+
+// comma separated floats, returns how many were read or -1 if there is garbage in it
+int ParseFloats(const char* text, float* values, const uint32_t maxCount)
+{
+    uint32_t count = 0;
+    while (*text != '\0') {
+        if (count == maxCount) {
+            return -1;
+        }
+
+        char* end       = nullptr;
+        values[count++] = strtof(text, &end);
+        if (end == text || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return static_cast<int>(count);
+}
+} // namespace
+
+SceneFile::~SceneFile()
+{
+    Unmap();
+}
+
+bool SceneFile::Load(const char* path)
+{
+    Unmap();
+    m_parsedNodes.clear();
+    m_parsedTextures.clear();
+
+    if (Map(path)) {
+        if (Validate(path)) {
+            return true;
+        }
+        Unmap();
+        return false;
+    }
+    return Parse(path);
+}
+
+void SceneFile::Assign(std::vector<SceneNode> nodes, std::vector<SceneTextureName> textures)
+{
+    Unmap();
+    m_parsedNodes    = std::move(nodes);
+    m_parsedTextures = std::move(textures);
+
+    m_nodes        = m_parsedNodes.data();
+    m_nodeCount    = static_cast<uint32_t>(m_parsedNodes.size());
+    m_textures     = m_parsedTextures.data();
+    m_textureCount = static_cast<uint32_t>(m_parsedTextures.size());
+}
+
+bool SceneFile::Map(const char* path)
+{
+    if (!m_file.Open(path) || m_file.size() < sizeof(Header)) {
+        m_file.Close();
+        return false;
+    }
+
+    if (static_cast<const Header*>(m_file.data())->magic != MAGIC) {
+        // a text scene
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool SceneFile::Validate(const char* path)
+{
+    const Header* header       = static_cast<const Header*>(m_file.data());
+    const size_t  expectedSize = sizeof(Header) + size_t(header->textureCount) * sizeof(SceneTextureName) +
+                                 size_t(header->nodeCount) * sizeof(SceneNode);
+    if (header->version != VERSION || m_file.size() != expectedSize) {
+        printf("%s: binary scene version %u with %zu bytes, expected version %u with %zu bytes\n", path,
+               header->version, m_file.size(), VERSION, expectedSize);
+        return false;
+    }
+
+    m_textureCount = header->textureCount;
+    m_nodeCount    = header->nodeCount;
+    m_textures     = reinterpret_cast<const SceneTextureName*>(header + 1);
+    m_nodes        = reinterpret_cast<const SceneNode*>(m_textures + m_textureCount);
+
+    // the builder trusts the indices, a broken file is rejected here instead of crashing later
+    for (uint32_t idx = 0; idx < m_textureCount; idx++) {
+        if (memchr(m_textures[idx].name, '\0', SCENE_TEXTURE_NAME_LEN) == nullptr) {
+            printf("%s: texture name %u is not terminated\n", path, idx);
+            return false;
+        }
+    }
+    for (uint32_t idx = 0; idx < m_nodeCount; idx++) {
+        const SceneNode& node = m_nodes[idx];
+        if ((node.parent != SCENE_NO_PARENT && node.parent >= idx) || node.texture >= m_textureCount ||
+            static_cast<uint32_t>(node.kind) >= KIND_COUNT) {
+            printf("%s: node %u is broken\n", path, idx);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SceneFile::Unmap()
+{
+    m_file.Close();
+    m_nodes        = nullptr;
+    m_textures     = nullptr;
+    m_nodeCount    = 0;
+    m_textureCount = 0;
+}
+
+bool SceneFile::Parse(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        printf("Unable to open scene %s\n", path);
+        return false;
+    }
+
+    std::unordered_map<std::string, uint32_t> nodeIds;
+    std::unordered_map<std::string, uint16_t> textureIds;
+
+    const auto textureId = [&](const char* name) -> int {
+        auto it = textureIds.find(name);
+        if (it != textureIds.end()) {
+            return it->second;
+        }
+        if (strlen(name) >= SCENE_TEXTURE_NAME_LEN || m_parsedTextures.size() > UINT16_MAX) {
+            return -1;
+        }
+
+        SceneTextureName texture = {};
+        strcpy(texture.name, name);
+        m_parsedTextures.push_back(texture);
+
+        const uint16_t id = static_cast<uint16_t>(m_parsedTextures.size() - 1);
+        textureIds.insert({name, id});
+        return id;
+    };
+    // the primitives without a texture get the same one as in the code
+    textureId("default");
+
+    bool     ok         = true;
+    uint32_t lineNumber = 0;
+    char     line[1024];
+    while (ok && fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+
+        if (char* comment = strchr(line, '#')) {
+            *comment = '\0';
+        }
+
+        // split on whitespace in place
+        char*    tokens[32];
+        uint32_t tokenCount = 0;
+        for (char* cursor = line; *cursor != '\0';) {
+            while (isspace(static_cast<unsigned char>(*cursor))) {
+                *cursor++ = '\0';
+            }
+            if (*cursor == '\0') {
+                break;
+            }
+            if (tokenCount == 32) {
+                printf("%s:%u: too many values, only the first 32 are used\n", path, lineNumber);
+                break;
+            }
+            tokens[tokenCount++] = cursor;
+            while (*cursor != '\0' && !isspace(static_cast<unsigned char>(*cursor))) {
+                cursor++;
+            }
+        }
+
+        if (tokenCount == 0) {
+            continue;
+        }
+
+        const auto fail = [&](const char* message, const char* what) {
+            printf("%s:%u: %s '%s'\n", path, lineNumber, message, what);
+            ok = false;
+        };
+
+        const KindInfo* kind = nullptr;
+        for (const KindInfo& info : KINDS) {
+            if (strcmp(info.name, tokens[0]) == 0) {
+                kind = &info;
+            }
+        }
+        if (kind == nullptr) {
+            fail("unknown node kind", tokens[0]);
+            break;
+        }
+        if (tokenCount < 2) {
+            fail("missing name for", tokens[0]);
+            break;
+        }
+        if (nodeIds.count(tokens[1]) != 0) {
+            fail("duplicate node", tokens[1]);
+            break;
+        }
+
+        SceneNode node = {
+            .parent          = SCENE_NO_PARENT,
+            .texture         = 0,
+            .kind            = kind->kind,
+            .behaviour       = SceneBehaviour::None,
+            .position        = {0.0f, 0.0f, 0.0f},
+            .rotation        = {0.0f, 0.0f, 0.0f},
+            .scale           = {1.0f, 1.0f, 1.0f},
+            .params          = {},
+            .behaviourParams = {0.0f, 0.0f, 0.0f},
+        };
+        memcpy(node.params, kind->defaults, sizeof(node.params));
+
+        for (uint32_t idx = 2; ok && idx < tokenCount; idx++) {
+            char* value = strchr(tokens[idx], '=');
+            if (value == nullptr) {
+                fail("expected key=value instead of", tokens[idx]);
+                break;
+            }
+            *value++ = '\0';
+
+            const char* key = tokens[idx];
+            if (strcmp(key, "parent") == 0) {
+                auto it = nodeIds.find(value);
+                if (it == nodeIds.end()) {
+                    fail("parent has to be defined before its children", value);
+                } else if (IsEntity(m_parsedNodes[it->second].kind)) {
+                    fail("entities can not have children", value);
+                } else {
+                    node.parent = it->second;
+                }
+            } else if (strcmp(key, "texture") == 0) {
+                const int texture = textureId(value);
+                if (texture < 0) {
+                    fail("texture name too long", value);
+                }
+                node.texture = static_cast<uint16_t>(texture);
+            } else if (strcmp(key, "pos") == 0) {
+                if (ParseFloats(value, node.position, 3) != 3) {
+                    fail("expected x,y,z for pos instead of", value);
+                }
+            } else if (strcmp(key, "rot") == 0) {
+                if (ParseFloats(value, node.rotation, 3) != 3) {
+                    fail("expected x,y,z for rot instead of", value);
+                }
+            } else if (strcmp(key, "scale") == 0) {
+                if (ParseFloats(value, node.scale, 3) != 3) {
+                    fail("expected x,y,z for scale instead of", value);
+                }
+            } else if (strcmp(key, "params") == 0) {
+                if (ParseFloats(value, node.params, kind->paramCount) < 0) {
+                    fail("too many or broken params", value);
+                }
+            } else if (strcmp(key, "spin") == 0 || strcmp(key, "bob") == 0) {
+                const bool spin = key[0] == 's';
+                if (kind->kind != SceneNodeKind::Group) {
+                    fail("only groups can have a behaviour, not", tokens[1]);
+                } else if (ParseFloats(value, node.behaviourParams, 3) < (spin ? 3 : 2)) {
+                    fail(spin ? "expected x,y,z for spin instead of"
+                              : "expected amplitude,frequency for bob instead of",
+                         value);
+                }
+                node.behaviour = spin ? SceneBehaviour::Spin : SceneBehaviour::Bob;
+            } else {
+                fail("unknown key", key);
+            }
+        }
+
+        nodeIds.insert({tokens[1], static_cast<uint32_t>(m_parsedNodes.size())});
+        m_parsedNodes.push_back(node);
+    }
+    fclose(file);
+
+    if (!ok) {
+        m_parsedNodes.clear();
+        m_parsedTextures.clear();
+        return false;
+    }
+
+    m_nodes        = m_parsedNodes.data();
+    m_nodeCount    = static_cast<uint32_t>(m_parsedNodes.size());
+    m_textures     = m_parsedTextures.data();
+    m_textureCount = static_cast<uint32_t>(m_parsedTextures.size());
+    return true;
+}
+
+bool SceneFile::WriteBinary(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        printf("Unable to write scene %s\n", path);
+        return false;
+    }
+
+    const Header header = {
+        .magic        = MAGIC,
+        .version      = VERSION,
+        .textureCount = m_textureCount,
+        .nodeCount    = m_nodeCount,
+    };
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok      = ok && fwrite(m_textures, sizeof(SceneTextureName), m_textureCount, file) == m_textureCount;
+    ok      = ok && fwrite(m_nodes, sizeof(SceneNode), m_nodeCount, file) == m_nodeCount;
+    ok      = (fclose(file) == 0) && ok;
+
+    if (!ok) {
+        printf("Unable to write scene %s\n", path);
+    }
+    return ok;
+}
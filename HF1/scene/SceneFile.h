@@ -0,0 +1,109 @@
+#pragma once
+
+#include <mapped_file.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What a scene node turns into, the primitives take their constructor parameters from SceneNode::params.
+enum class SceneNodeKind : uint8_t {
+    Group,
+    Grid,     // width, depth, rows, cols
+    Cube,     // atlas
+    Sphere,   // radius, sectors, stacks
+    Cylinder, // base radius, top radius, height, sectors, stacks
+    Cone,     // base radius, height, sectors, cap
+    CirnoPrism,
+    // the hand written entities, they build their own children
+    RotatingCube,
+    SpinningCirnoPrism,
+    PistonWithBouncingBall,
+    OrbitingHelicopter,
+};
+
+// Animation of a group node, driven by the simulation.
+enum class SceneBehaviour : uint8_t {
+    None,
+    Spin, // degrees per second around x, y and z
+    Bob,  // amplitude, cycles per second, phase in cycles
+};
+
+constexpr uint32_t SCENE_NO_PARENT        = UINT32_MAX;
+constexpr uint32_t SCENE_MAX_PARAMS       = 5;
+constexpr uint32_t SCENE_TEXTURE_NAME_LEN = 48;
+
+// One node of the binary scene, nodes come in parent order so a parent is always created first.
+struct SceneNode {
+    uint32_t       parent; // node index or SCENE_NO_PARENT
+    uint16_t       texture;
+    SceneNodeKind  kind;
+    SceneBehaviour behaviour;
+    float          position[3];
+    float          rotation[3]; // euler angles in degrees, same as ITransformable::setRotation
+    float          scale[3];
+    float          params[SCENE_MAX_PARAMS];
+    float          behaviourParams[3];
+};
+
+struct SceneTextureName {
+    char name[SCENE_TEXTURE_NAME_LEN]; // zero terminated
+};
+
+// The binary form is the header, the texture names and the nodes right after each other, so it can be used
+// straight from the mapped file. The text form is parsed into the same arrays.
+//
+// Text form, one node per line, '#' starts a comment:
+//   <kind> <name> [key=value ...]
+//   kind:   group grid cube sphere cylinder cone cirno_prism
+//           rotating_cube spinning_cirno_prism piston_with_bouncing_ball orbiting_helicopter
+//   keys:   parent=<name> (has to be defined above) texture=<name> pos=x,y,z rot=x,y,z scale=x,y,z
+//           params=a,b,... (in the order listed at SceneNodeKind) spin=x,y,z bob=amplitude,frequency[,phase]
+// Only groups can have a behaviour and the entities can not have children.
+class SceneFile {
+public:
+    static constexpr uint32_t MAGIC   = 0x53314648; // "HF1S"
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t textureCount;
+        uint32_t nodeCount;
+    };
+
+    SceneFile() = default;
+    ~SceneFile();
+
+    SceneFile(const SceneFile&)            = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    // Binary files are mapped, anything else is parsed as text. Prints what went wrong and returns false.
+    bool Load(const char* path);
+    bool WriteBinary(const char* path) const;
+    // generated scenes, the nodes have to follow the same rules as the parsed ones
+    void Assign(std::vector<SceneNode> nodes, std::vector<SceneTextureName> textures);
+
+    bool             isMapped() const { return m_file.isOpen(); }
+    uint32_t         nodeCount() const { return m_nodeCount; }
+    const SceneNode* nodes() const { return m_nodes; }
+    uint32_t         textureCount() const { return m_textureCount; }
+    const char*      textureName(uint32_t texture) const { return m_textures[texture].name; }
+
+private:
+    // true if the file is a binary scene, Validate checks if it is a usable one
+    bool Map(const char* path);
+    bool Validate(const char* path);
+    void Unmap();
+    bool Parse(const char* path);
+
+    const SceneNode*        m_nodes        = nullptr;
+    const SceneTextureName* m_textures     = nullptr;
+    uint32_t                m_nodeCount    = 0;
+    uint32_t                m_textureCount = 0;
+
+    // only one of them is in use
+    std::vector<SceneNode>        m_parsedNodes;
+    std::vector<SceneTextureName> m_parsedTextures;
+    MappedFile                    m_file;
+};
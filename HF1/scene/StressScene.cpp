@@ -0,0 +1,247 @@
+#include "StressScene.h"
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr uint32_t CLUSTER_SIDE    = 4; // clusters are 4x4 objects
+constexpr float    SPACING         = 1.5f;
+constexpr uint32_t WARMUP_FRAMES   = 60;
+constexpr uint32_t MEASURED_FRAMES = 240;
+
+// the ones in HF1/textures that look fine on anything
+const char* const TEXTURES[] = {"default", "white", "cobblestone", "grassblock_FIX", "piston_body", "piston_head"};
+constexpr uint32_t TEXTURE_COUNT = sizeof(TEXTURES) / sizeof(TEXTURES[0]);
+
+// xorshift32, the distributions of <random> differ between the standard libraries
+struct Random {
+    uint32_t state;
+
+    explicit Random(const uint32_t seed) : state(seed * 2654435761u + 1u) {}
+
+    uint32_t Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // [0, 1)
+    float Float() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+    float Range(const float min, const float max) { return min + (max - min) * Float(); }
+};
+
+SceneNode MakeNode(const SceneNodeKind kind, const uint32_t parent, const float x, const float y, const float z)
+{
+    return {
+        .parent          = parent,
+        .texture         = 0,
+        .kind            = kind,
+        .behaviour       = SceneBehaviour::None,
+        .position        = {x, y, z},
+        .rotation        = {0.0f, 0.0f, 0.0f},
+        .scale           = {1.0f, 1.0f, 1.0f},
+        .params          = {},
+        .behaviourParams = {0.0f, 0.0f, 0.0f},
+    };
+}
+
+// fixed parameters per type, so the mesh cache has five meshes to share no matter the count
+SceneNode MakePrimitive(Random& random, const uint32_t parent, const float x, const float z)
+{
+    static const SceneNodeKind KINDS[] = {SceneNodeKind::Cube, SceneNodeKind::Sphere, SceneNodeKind::Cylinder,
+                                          SceneNodeKind::Cone, SceneNodeKind::CirnoPrism};
+
+    const SceneNodeKind kind = KINDS[random.Next() % 5];
+    SceneNode           node = MakeNode(kind, parent, x, 0.5f, z);
+    node.rotation[1]         = random.Range(0.0f, 360.0f);
+
+    switch (kind) {
+    case SceneNodeKind::Cube:
+        node.params[0] = 0.0f;
+        break;
+    case SceneNodeKind::Sphere:
+        node.params[0] = 0.5f;
+        node.params[1] = 16.0f;
+        node.params[2] = 16.0f;
+        break;
+    case SceneNodeKind::Cylinder:
+        node.params[0] = 0.4f;
+        node.params[1] = 0.4f;
+        node.params[2] = 1.0f;
+        node.params[3] = 16.0f;
+        node.params[4] = 1.0f;
+        break;
+    case SceneNodeKind::Cone:
+        node.params[0] = 0.5f;
+        node.params[1] = 1.0f;
+        node.params[2] = 16.0f;
+        node.params[3] = 1.0f;
+        break;
+    default:
+        // the prism is a bit too large next to the others
+        node.scale[0] = 0.4f;
+        node.scale[1] = 0.4f;
+        node.scale[2] = 0.4f;
+        break;
+    }
+    return node;
+}
+} // namespace
+
+void GenerateStressScene(const StressSceneSettings& settings, const uint32_t objectCount, SceneFile& scene)
+{
+    Random random(settings.seed);
+
+    std::vector<SceneTextureName> textures(std::clamp(settings.textureCount, 1u, TEXTURE_COUNT));
+    for (uint32_t idx = 0; idx < textures.size(); idx++) {
+        strcpy(textures[idx].name, TEXTURES[idx]);
+    }
+
+    const uint32_t clusterCount = (objectCount + CLUSTER_SIDE * CLUSTER_SIDE - 1) / (CLUSTER_SIDE * CLUSTER_SIDE);
+    const uint32_t clusterRow   = static_cast<uint32_t>(std::ceil(std::sqrt(double(clusterCount))));
+    const float    clusterSize  = CLUSTER_SIDE * SPACING;
+    const float    sceneSize    = clusterRow * clusterSize;
+
+    std::vector<SceneNode> nodes;
+    nodes.reserve(1 + clusterCount * settings.depth + objectCount * 2);
+
+    SceneNode floor = MakeNode(SceneNodeKind::Grid, SCENE_NO_PARENT, 0.0f, 0.0f, 0.0f);
+    for (uint32_t idx = 0; idx < 4; idx++) {
+        floor.params[idx] = 1.0f;
+    }
+    floor.scale[0] = sceneSize + clusterSize;
+    floor.scale[2] = sceneSize + clusterSize;
+    floor.texture  = textures.size() > 1 ? 1 : 0;
+    nodes.push_back(floor);
+
+    uint32_t placed = 0;
+    for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+        const float centerX = (cluster % clusterRow + 0.5f) * clusterSize - sceneSize * 0.5f;
+        const float centerZ = (cluster / clusterRow + 0.5f) * clusterSize - sceneSize * 0.5f;
+
+        // the chain only costs transform updates, every level sits on its parent
+        uint32_t parent = SCENE_NO_PARENT;
+        for (uint32_t level = 0; level < settings.depth; level++) {
+            const float x = (level == 0) ? centerX : 0.0f;
+            const float z = (level == 0) ? centerZ : 0.0f;
+            nodes.push_back(MakeNode(SceneNodeKind::Group, parent, x, 0.0f, z));
+            parent = static_cast<uint32_t>(nodes.size() - 1);
+        }
+        // without groups the objects are placed in the world directly
+        const float originX = (settings.depth == 0) ? centerX : 0.0f;
+        const float originZ = (settings.depth == 0) ? centerZ : 0.0f;
+
+        for (uint32_t slot = 0; slot < CLUSTER_SIDE * CLUSTER_SIDE && placed < objectCount; slot++, placed++) {
+            const float x = originX + (slot % CLUSTER_SIDE + 0.5f) * SPACING - clusterSize * 0.5f;
+            const float z = originZ + (slot / CLUSTER_SIDE + 0.5f) * SPACING - clusterSize * 0.5f;
+
+            // an animated object is an entity of its own holding the primitive
+            const bool animated = random.Next() % 100 < settings.animatedPercent;
+            if (animated) {
+                SceneNode group = MakeNode(SceneNodeKind::Group, parent, x, 0.0f, z);
+                if (random.Next() % 2 == 0) {
+                    group.behaviour          = SceneBehaviour::Spin;
+                    group.behaviourParams[1] = random.Range(30.0f, 180.0f);
+                } else {
+                    group.behaviour          = SceneBehaviour::Bob;
+                    group.behaviourParams[0] = random.Range(0.2f, 0.6f);
+                    group.behaviourParams[1] = random.Range(0.25f, 1.0f);
+                    group.behaviourParams[2] = random.Float();
+                }
+                nodes.push_back(group);
+            }
+
+            const uint32_t objectParent = animated ? static_cast<uint32_t>(nodes.size() - 1) : parent;
+            SceneNode      object       = MakePrimitive(random, objectParent, animated ? 0.0f : x, animated ? 0.0f : z);
+            object.texture              = static_cast<uint16_t>(random.Next() % textures.size());
+            nodes.push_back(object);
+        }
+    }
+
+    scene.Assign(std::move(nodes), std::move(textures));
+}
+
+StressSweep::StressSweep(const StressSceneSettings& settings, const char* csvPath)
+{
+    for (uint32_t decade = 100; decade < settings.objectCount; decade *= 10) {
+        for (uint32_t factor : {1u, 2u, 5u}) {
+            if (decade * factor < settings.objectCount) {
+                m_counts.push_back(decade * factor);
+            }
+        }
+    }
+    m_counts.push_back(settings.objectCount);
+
+    m_file = fopen(csvPath, "w");
+    if (m_file == nullptr) {
+        printf("Unable to write %s\n", csvPath);
+        exit(-1);
+    }
+    fprintf(m_file, "objects,draws,frame_ms,frame_p95_ms,gpu_ms,tick_ms\n");
+}
+
+StressSweep::~StressSweep()
+{
+    if (m_file != nullptr) {
+        fclose(m_file);
+    }
+}
+
+bool StressSweep::AddFrame(const double frameMs, const double gpuMs, const double tickMs, const uint32_t draws)
+{
+    if (finished()) {
+        return false;
+    }
+
+    m_frame++;
+    if (m_frame <= WARMUP_FRAMES) {
+        return false;
+    }
+
+    m_frameMs.push_back(frameMs);
+    if (gpuMs >= 0.0) {
+        m_gpuMs += gpuMs;
+        m_gpuFrames++;
+    }
+    m_tickMs += tickMs;
+    m_draws = draws;
+
+    if (m_frameMs.size() < MEASURED_FRAMES) {
+        return false;
+    }
+
+    WriteStep();
+
+    m_step++;
+    m_frame     = 0;
+    m_gpuMs     = 0.0;
+    m_gpuFrames = 0;
+    m_tickMs    = 0.0;
+    m_frameMs.clear();
+    return true;
+}
+
+void StressSweep::WriteStep()
+{
+    const size_t frames  = m_frameMs.size();
+    double       frameMs = 0.0;
+    for (double ms : m_frameMs) {
+        frameMs += ms;
+    }
+    frameMs /= frames;
+
+    std::sort(m_frameMs.begin(), m_frameMs.end());
+    const double p95Ms  = m_frameMs[std::min(frames - 1, frames * 95 / 100)];
+    const double gpuMs  = m_gpuFrames > 0 ? m_gpuMs / m_gpuFrames : 0.0;
+    const double tickMs = m_tickMs / frames;
+
+    fprintf(m_file, "%u,%u,%.3f,%.3f,%.3f,%.3f\n", objectCount(), m_draws, frameMs, p95Ms, gpuMs, tickMs);
+    fflush(m_file);
+    printf("Sweep %u objects: %u draws, frame %.2f ms (p95 %.2f), gpu %.2f ms, tick %.3f ms\n", objectCount(),
+           m_draws, frameMs, p95Ms, gpuMs, tickMs);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+class SceneFile;
+
+struct StressSceneSettings {
+    uint32_t objectCount     = 0; // 0 means no stress scene
+    uint32_t seed            = 1;
+    uint32_t textureCount    = 4;  // different textures the objects pick from
+    uint32_t depth           = 2;  // levels of groups above the objects
+    uint32_t animatedPercent = 25; // objects that get their own animated entity
+};
+
+// Fills the scene with objectCount primitives on a square grid around the origin. Every 16 of them share a
+// chain of depth groups. The same settings and count always give the same scene, the random numbers do not
+// depend on the standard library.
+void GenerateStressScene(const StressSceneSettings& settings, uint32_t objectCount, SceneFile& scene);
+
+// Steps the object count from 100 up to the one in the settings on a 1-2-5 series. Every step skips a few
+// frames to settle and averages the rest, the results end up in a csv file.
+class StressSweep {
+public:
+    StressSweep(const StressSceneSettings& settings, const char* csvPath);
+    ~StressSweep();
+
+    uint32_t objectCount() const { return m_counts[m_step]; }
+    bool     finished() const { return m_step >= m_counts.size(); }
+
+    // gpuMs is negative when there was no timestamp for the frame, returns true when the step is over
+    bool AddFrame(double frameMs, double gpuMs, double tickMs, uint32_t draws);
+
+private:
+    void WriteStep();
+
+    std::vector<uint32_t> m_counts;
+    uint32_t              m_step = 0;
+    FILE*                 m_file = nullptr;
+
+    uint32_t            m_frame = 0;
+    std::vector<double> m_frameMs;
+    double              m_gpuMs     = 0.0;
+    uint32_t            m_gpuFrames = 0;
+    double              m_tickMs    = 0.0;
+    uint32_t            m_draws     = 0;
+};
@@ -0,0 +1,28 @@
+#version 450
+
+// position only version of lightning_pass.vert, fills the depth buffer before the lighting
+layout(location = 0) in vec3 in_position;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    mat4 prevModel;
+    vec4 positionScale;
+    vec4 positionOffset;
+} constants;
+
+layout(set = 3, binding = 0) uniform CameraUBO {
+    vec4 position;
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+} camera;
+
+// the lighting pass tests with EQUAL, both shaders have to compute the exact same depth
+invariant gl_Position;
+
+void main() {
+    vec3 position = in_position * constants.positionScale.xyz + constants.positionOffset.xyz;
+
+    gl_Position = camera.projection * camera.view * constants.model * vec4(position, 1.0f);
+}
@@ -1,6 +1,15 @@
 #version 450
 
-#define NUM_LIGHTS 3
+#define MAX_LIGHTS 8
+
+#define SHADOW_FILTER_HARD 0u
+#define SHADOW_FILTER_PCF  1u
+
+// see LightningPass::ShadingOptions, every used combination is its own pipeline and the unused paths fold away,
+// constant 0 is the normal encoding of the vertex shader
+layout(constant_id = 1) const uint SHADOW_FILTER = SHADOW_FILTER_HARD;
+layout(constant_id = 2) const int  PCF_RADIUS    = 1; // (2 * radius + 1)^2 taps
+layout(constant_id = 3) const int  LIGHT_COUNT   = MAX_LIGHTS;
 
 struct Light {
     vec3 position;
@@ -12,22 +21,29 @@ struct Light {
 layout(location = 0) in vec2 in_uv;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec3 in_fragPos;
+layout(location = 3) in vec4 in_currClip;
+layout(location = 4) in vec4 in_prevClip;
 
-layout(push_constant) uniform PushConstants {
-    vec3 cameraPosition;
+layout(set = 3, binding = 0) uniform CameraUBO {
+    vec4 position;
     mat4 projection;
     mat4 view;
-    mat4 model;
-} constants;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+} camera;
 
 layout(set = 0, binding = 0) uniform sampler2D gridImage;
 layout(set = 1, binding = 0) uniform LightsUBO {
-    Light lights[NUM_LIGHTS];
+    uint count;
+    Light lights[MAX_LIGHTS];
 } ubo;
 
-layout(set = 2, binding = 0) uniform sampler2D shadowMap[NUM_LIGHTS];
+// the slots past the light count repeat the first shadow map
+layout(set = 2, binding = 0) uniform sampler2D shadowMap[MAX_LIGHTS];
 
 layout(location = 0) out vec4 out_color;
+// screen uv this fragment moved since the previous frame, only has an attachment with TAA
+layout(location = 1) out vec2 out_velocity;
 
 const float ambientStrength = 0.1;
 const float specularStrength = 0.5;
@@ -83,15 +99,15 @@ float PCFShadow(vec4 fragPosLightSpace, int lightIndex)
     float shadow = 0.0;
 
     vec2 texelSize = 1.0 / textureSize(shadowMap[lightIndex], 0);
-    for (int x = -1; x <= 1; ++x)
+    for (int x = -PCF_RADIUS; x <= PCF_RADIUS; ++x)
     {
-        for (int y = -1; y <= 1; ++y)
+        for (int y = -PCF_RADIUS; y <= PCF_RADIUS; ++y)
         {
             float pcfDepth = texture(shadowMap[lightIndex], projCoords.xy + vec2(x, y) * texelSize).r;
             shadow += currentDepth > pcfDepth ? 1.0 : 0.0;
         }
     }
-    shadow /= 9.0;
+    shadow /= float((2 * PCF_RADIUS + 1) * (2 * PCF_RADIUS + 1));
 
     // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
     if (projCoords.z > 1.0 || projCoords.z < -1.0f) {
@@ -106,12 +122,13 @@ float PCFShadow(vec4 fragPosLightSpace, int lightIndex)
 void main() {
     vec4 objectColor = texture(gridImage, in_uv);
     vec3 norm = normalize(in_normal);
-    vec3 viewDir = normalize(constants.cameraPosition - in_fragPos);
+    vec3 viewDir = normalize(camera.position.xyz - in_fragPos);
 
     vec3 totalDiffuse = vec3(0.0);
     vec3 totalSpecular = vec3(0.0);
 
-    for (int i = 0; i < NUM_LIGHTS; i++){
+    // the light count is fixed for the run, the loop has a constant trip count
+    for (int i = 0; i < LIGHT_COUNT; i++){
         vec3 pos = ubo.lights[i].position;
         vec3 col = ubo.lights[i].color;
 
@@ -127,8 +144,8 @@ void main() {
 
         vec4 fragPosLightSpace = ubo.lights[i].projection * ubo.lights[i].view * vec4(in_fragPos, 1.0);
 
-        float shadow = SimpleShadow(fragPosLightSpace, i);
-//        float shadow = PCFShadow(fragPosLightSpace, i);
+        float shadow = SHADOW_FILTER == SHADOW_FILTER_PCF ? PCFShadow(fragPosLightSpace, i)
+                                                         : SimpleShadow(fragPosLightSpace, i);
 
         totalDiffuse  += (1.0 - shadow) * (diff * col * attenuation);
         totalSpecular += (1.0 - shadow) * (spec * col * specularStrength * attenuation);
@@ -139,4 +156,8 @@ void main() {
     vec3 result = (ambient + totalDiffuse) * objectColor.rgb + totalSpecular;
 
     out_color = vec4(result, 1.0);
+
+    vec2 currNdc = in_currClip.xy / in_currClip.w;
+    vec2 prevNdc = in_prevClip.xy / in_prevClip.w;
+    out_velocity = (currNdc - prevNdc) * 0.5;
 }
\ No newline at end of file
@@ -1,27 +1,61 @@
 #version 450
 
+// the formats are picked by VertexFormat, the fetch turns all of them into floats
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec2 in_uv;
 layout(location = 2) in vec3 in_normal;
 
+// 1 when the normals are octahedral, only their first two components are fetched then
+layout(constant_id = 0) const uint NORMAL_ENCODING = 0u;
+
 layout(push_constant) uniform PushConstants {
-    vec3 cameraPosition;
-    mat4 projection;
-    mat4 view;
     mat4 model;
+    mat4 prevModel;
+    // dequantization of the positions of the mesh
+    vec4 positionScale;
+    vec4 positionOffset;
 } constants;
 
+layout(set = 3, binding = 0) uniform CameraUBO {
+    vec4 position;
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+} camera;
+
 layout(location = 0) out vec2 out_uv;
 layout(location = 1) out vec3 out_normal;
 layout(location = 2) out vec3 out_fragPos;
-//layout(location = 3) out vec3 camera_pos;
+// unjittered clip positions of this and the previous frame for the motion vectors
+layout(location = 3) out vec4 out_currClip;
+layout(location = 4) out vec4 out_prevClip;
+
+// has to match depth_prepass.vert bit for bit
+invariant gl_Position;
+
+vec3 DecodeNormal(vec3 encoded) {
+    if (NORMAL_ENCODING == 1u) {
+        // unfolds the lower half of the octahedron, see OctahedralDecode in vertex_format.cpp
+        vec3 normal = vec3(encoded.xy, 1.0f - abs(encoded.x) - abs(encoded.y));
+        float t = max(-normal.z, 0.0f);
+        normal.x += normal.x >= 0.0f ? -t : t;
+        normal.y += normal.y >= 0.0f ? -t : t;
+        return normalize(normal);
+    }
+    return encoded;
+}
 
 void main() {
-    gl_Position = constants.projection * constants.view * constants.model * vec4(in_position, 1.0f);
+    vec3 position = in_position * constants.positionScale.xyz + constants.positionOffset.xyz;
+
+    gl_Position = camera.projection * camera.view * constants.model * vec4(position, 1.0f);
+
+    out_currClip = camera.viewProjection * constants.model * vec4(position, 1.0f);
+    out_prevClip = camera.prevViewProjection * constants.prevModel * vec4(position, 1.0f);
 
-//    camera_pos = constants.cameraPosition;
     out_uv = in_uv;
 
-    out_normal = mat3(transpose(inverse(constants.model))) * in_normal;
-    out_fragPos = vec3(constants.model * vec4(in_position, 1.0f));
+    out_normal = mat3(transpose(inverse(constants.model))) * DecodeNormal(in_normal);
+    out_fragPos = vec3(constants.model * vec4(position, 1.0f));
 }
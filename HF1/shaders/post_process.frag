@@ -6,18 +6,90 @@ layout(binding = 0) uniform sampler2D samplerColor;
 
 layout(location = 0) out vec4 out_color;
 
+#define MODE_NONE  0u
+#define MODE_EDGES 1u
+#define MODE_BLUR  2u
+#define MODE_SEPIA 3u
+#define MODE_GRAIN 4u
+
+// see PostProcessPass::SetMode, every used mode is its own pipeline
+layout(constant_id = 0) const uint MODE = MODE_GRAIN;
+
 layout(push_constant) uniform PushConstants {
-    uint mode;
+    float renderScale; // part of the input that was rendered, see DynamicResolution
 } constants;
 
 float rand(vec2 co){
     return fract(sin(dot(co, vec2(12.9898, 78.233))) * 43758.5453);
 }
 
+// the rendered part of the input in texture coordinates, half a texel in so bilinear taps don't read outside of it
+vec2 renderedMin() {
+    return 0.5 / vec2(textureSize(samplerColor, 0));
+}
+
+vec2 renderedMax() {
+    vec2 size = vec2(textureSize(samplerColor, 0));
+    // the lighting pass rounds its render extent down
+    return (floor(size * constants.renderScale) - 0.5) / size;
+}
+
+// one texel of the rendered image in screen uv
+vec2 sceneTexelSize() {
+    return 1.0 / (vec2(textureSize(samplerColor, 0)) * constants.renderScale);
+}
+
+vec4 sampleSceneBilinear(vec2 uv) {
+    return texture(samplerColor, clamp(uv * constants.renderScale, renderedMin(), renderedMax()));
+}
+
+// Catmull-Rom upsampling with 9 bilinear taps instead of 16 point samples,
+// the middle two weights of each axis are merged into a single linear tap.
+vec4 sampleScene(vec2 uv) {
+    if (constants.renderScale >= 1.0) {
+        return texture(samplerColor, uv);
+    }
+
+    vec2 texSize   = vec2(textureSize(samplerColor, 0));
+    vec2 samplePos = uv * constants.renderScale * texSize;
+    vec2 texPos1   = floor(samplePos - 0.5) + 0.5;
+    vec2 f         = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12      = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 lo = renderedMin();
+    vec2 hi = renderedMax();
+    vec2 texPos0  = clamp((texPos1 - 1.0) / texSize, lo, hi);
+    vec2 texPos3  = clamp((texPos1 + 2.0) / texSize, lo, hi);
+    vec2 texPos12 = clamp((texPos1 + offset12) / texSize, lo, hi);
+
+    vec4 result = vec4(0.0);
+    result += texture(samplerColor, vec2(texPos0.x, texPos0.y)) * w0.x * w0.y;
+    result += texture(samplerColor, vec2(texPos12.x, texPos0.y)) * w12.x * w0.y;
+    result += texture(samplerColor, vec2(texPos3.x, texPos0.y)) * w3.x * w0.y;
+
+    result += texture(samplerColor, vec2(texPos0.x, texPos12.y)) * w0.x * w12.y;
+    result += texture(samplerColor, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+    result += texture(samplerColor, vec2(texPos3.x, texPos12.y)) * w3.x * w12.y;
+
+    result += texture(samplerColor, vec2(texPos0.x, texPos3.y)) * w0.x * w3.y;
+    result += texture(samplerColor, vec2(texPos12.x, texPos3.y)) * w12.x * w3.y;
+    result += texture(samplerColor, vec2(texPos3.x, texPos3.y)) * w3.x * w3.y;
+
+    // the negative lobes can overshoot
+    return max(result, vec4(0.0));
+}
+
 vec4 doLaplace() {
     vec4 result = vec4(0.0f);
 
-    vec2 texelSize = 1.0 / textureSize(samplerColor, 0);
+    vec2 texelSize = sceneTexelSize();
 
     mat3 laplace = mat3(
             0.0f, -1.0f, 0.0f,
@@ -27,7 +99,7 @@ vec4 doLaplace() {
 
     for (int x = -1; x <= 1; x++) {
         for (int y = -1; y <= 1; y++) {
-            vec4 otherPixel = texture(samplerColor, in_uv + (vec2(x, y) * texelSize));
+            vec4 otherPixel = sampleSceneBilinear(in_uv + (vec2(x, y) * texelSize));
             result += laplace[x + 1][y + 1] * otherPixel;
         }
     }
@@ -38,11 +110,11 @@ vec4 doLaplace() {
 vec4 doBlur() {
     vec4 result = vec4(0.0f);
 
-    vec2 texelSize = 1.0 / textureSize(samplerColor, 0);
+    vec2 texelSize = sceneTexelSize();
 
     for (int x = -1; x <= 1; x++) {
         for (int y = -1; y <= 1; y++) {
-            vec4 otherPixel = texture(samplerColor, in_uv + (vec2(x, y) * texelSize));
+            vec4 otherPixel = sampleSceneBilinear(in_uv + (vec2(x, y) * texelSize));
             result += otherPixel;
         }
     }
@@ -52,7 +124,7 @@ vec4 doBlur() {
 }
 
 vec4 doSepia() {
-    vec4 pixel = texture(samplerColor, in_uv);
+    vec4 pixel = sampleScene(in_uv);
 
     vec4 sepia = vec4(112, 66, 20, 255) / 255.0f;
 
@@ -60,7 +132,7 @@ vec4 doSepia() {
 }
 
 vec3 doMyShit(){
-    vec4 pixel = texture(samplerColor, in_uv);
+    vec4 pixel = sampleScene(in_uv);
 
     if(pixel.r + pixel.g + pixel.g < 0.001) {
         float r = rand(in_uv * 1);
@@ -71,7 +143,7 @@ vec3 doMyShit(){
 }
 
 vec3 doMyShit2(){
-    vec4 pixel = texture(samplerColor, in_uv);
+    vec4 pixel = sampleScene(in_uv);
     vec3 color = pixel.rgb;
 
     float dist = distance(in_uv, vec2(0.5));
@@ -93,26 +165,26 @@ vec3 doMyShit2(){
 void main() {
     vec4 result = vec4(1.0);
 
-    switch (constants.mode) {
-        case 0:
+    switch (MODE) {
+        case MODE_NONE:
         {
-            vec4 pixel = texture(samplerColor, in_uv);
+            vec4 pixel = sampleScene(in_uv);
             result = pixel;
             break;
         }
-        case 1:
+        case MODE_EDGES:
         {
-            vec4 pixel = texture(samplerColor, in_uv);
+            vec4 pixel = sampleScene(in_uv);
             result = mix(pixel, doLaplace(), 0.8f);
             break;
         }
-        case 2:
+        case MODE_BLUR:
         result = doBlur();
         break;
-        case 3:
+        case MODE_SEPIA:
         result = doSepia();
         break;
-        case 4:
+        case MODE_GRAIN:
         result = vec4(doMyShit().rgb,1.0f);
         break;
     }
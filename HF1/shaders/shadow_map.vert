@@ -6,10 +6,13 @@ layout(push_constant) uniform PushConstants {
     mat4 projection;
     mat4 view;
     mat4 model;
+    // dequantization of the positions of the mesh
+    vec4 positionScale;
+    vec4 positionOffset;
 } constants;
 
 void main() {
-    vec3 current_pos = in_position;
+    vec3 current_pos = in_position * constants.positionScale.xyz + constants.positionOffset.xyz;
     mat4 lightProjection = constants.projection;
     mat4 lightView = constants.view;
 
@@ -0,0 +1,59 @@
+#version 450
+
+layout(location = 0) in vec2 in_uv;
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+layout(set = 0, binding = 1) uniform sampler2D sceneVelocity;
+layout(set = 0, binding = 2) uniform sampler2D history;
+
+layout(location = 0) out vec4 out_color;
+
+layout(push_constant) uniform PushConstants {
+    float renderScale;  // part of the scene that was rendered, see DynamicResolution
+    uint  historyValid; // 0 right after the history was (re)created
+    float feedback;     // weight of the history
+} constants;
+
+// same as in post_process.frag, keeps the taps inside the rendered part of the scene
+vec2 renderedMin() {
+    return 0.5 / vec2(textureSize(sceneColor, 0));
+}
+
+vec2 renderedMax() {
+    vec2 size = vec2(textureSize(sceneColor, 0));
+    return (floor(size * constants.renderScale) - 0.5) / size;
+}
+
+void main() {
+    vec2 texelSize = 1.0 / vec2(textureSize(sceneColor, 0));
+    vec2 sceneUv   = in_uv * constants.renderScale;
+    vec2 lo        = renderedMin();
+    vec2 hi        = renderedMax();
+
+    vec3 current = texture(sceneColor, clamp(sceneUv, lo, hi)).rgb;
+
+    // the history is only trusted as long as it looks like something in the current neighbourhood,
+    // this is what keeps disocclusions and moving objects from ghosting
+    vec3 boxMin = current;
+    vec3 boxMax = current;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            vec3 neighbour = texture(sceneColor, clamp(sceneUv + vec2(x, y) * texelSize, lo, hi)).rgb;
+            boxMin = min(boxMin, neighbour);
+            boxMax = max(boxMax, neighbour);
+        }
+    }
+
+    vec2 velocity  = texture(sceneVelocity, clamp(sceneUv, lo, hi)).xy;
+    vec2 historyUv = in_uv - velocity;
+
+    bool offscreen = any(lessThan(historyUv, vec2(0.0))) || any(greaterThan(historyUv, vec2(1.0)));
+    if (constants.historyValid == 0 || offscreen) {
+        out_color = vec4(current, 1.0);
+        return;
+    }
+
+    vec3 previous = clamp(texture(history, historyUv).rgb, boxMin, boxMax);
+
+    out_color = vec4(mix(current, previous, constants.feedback), 1.0);
+}
@@ -0,0 +1,53 @@
+#version 450
+
+// Terrain chunks have no vertex buffer, the index is the vertex on the full resolution grid of the chunk and the
+// height comes from the layer of the chunk. Shares the fragment shader and its inputs with lightning_pass.vert.
+#define CHUNK_QUADS 64
+
+layout(push_constant) uniform PushConstants {
+    // world x and z of the first vertex, the quad size and the heightmap layer
+    vec4 chunk;
+} constants;
+
+layout(set = 3, binding = 0) uniform CameraUBO {
+    vec4 position;
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+} camera;
+
+// every layer has a one texel border around the vertices of its chunk
+layout(set = 4, binding = 0) uniform sampler2DArray heightmap;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec3 out_normal;
+layout(location = 2) out vec3 out_fragPos;
+layout(location = 3) out vec4 out_currClip;
+layout(location = 4) out vec4 out_prevClip;
+
+float Height(ivec2 vertex) {
+    return texelFetch(heightmap, ivec3(vertex + 1, int(constants.chunk.w)), 0).r;
+}
+
+void main() {
+    ivec2 vertex   = ivec2(gl_VertexIndex % (CHUNK_QUADS + 1), gl_VertexIndex / (CHUNK_QUADS + 1));
+    float quadSize = constants.chunk.z;
+
+    vec3 position = vec3(constants.chunk.x + vertex.x * quadSize, Height(vertex),
+                         constants.chunk.y + vertex.y * quadSize);
+
+    gl_Position = camera.projection * camera.view * vec4(position, 1.0f);
+
+    // the terrain never moves, only the camera does
+    out_currClip = camera.viewProjection * vec4(position, 1.0f);
+    out_prevClip = camera.prevViewProjection * vec4(position, 1.0f);
+
+    out_uv = vec2(vertex) / CHUNK_QUADS;
+
+    // central differences, the chunks on both sides of an edge read the same heights for it
+    float dx = Height(vertex + ivec2(1, 0)) - Height(vertex - ivec2(1, 0));
+    float dz = Height(vertex + ivec2(0, 1)) - Height(vertex - ivec2(0, 1));
+    out_normal  = normalize(vec3(-dx, 2.0f * quadSize, -dz));
+    out_fragPos = position;
+}
@@ -0,0 +1,74 @@
+#include "Simulation.h"
+#include "TransformStore.h"
+
+#include <utility>
+
+namespace {
+// after a long stall (debugger, window drag) the simulation jumps ahead instead of ticking forever
+constexpr uint32_t MAX_TICKS_PER_WAKE = 8;
+} // namespace
+
+Simulation::Simulation(const double tickRate, TickFn tick)
+    : m_tick(std::move(tick))
+    , m_step(1.0 / tickRate)
+{
+}
+
+void Simulation::Start()
+{
+    // the state after setup is the first snapshot, so the first frame has something to show
+    TransformStore::Get().Publish(0.0);
+
+    m_startTime   = Clock::now();
+    m_skippedTime = 0.0;
+    m_running     = true;
+    m_thread    = std::thread(&Simulation::Loop, this);
+}
+
+void Simulation::Stop()
+{
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+double Simulation::Interpolate() const
+{
+    const double elapsed = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+    return TransformStore::Get().Interpolate(elapsed - m_skippedTime.load() - m_step);
+}
+
+void Simulation::Loop()
+{
+    const auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_step));
+
+    Clock::time_point next    = m_startTime + step;
+    double            simTime = 0.0;
+
+    while (m_running) {
+        const Clock::time_point now = Clock::now();
+
+        uint32_t ticks = 0;
+        while (now >= next && ticks < MAX_TICKS_PER_WAKE) {
+            const Clock::time_point tickStart = Clock::now();
+
+            m_tick(static_cast<float>(m_step));
+            simTime += m_step;
+            TransformStore::Get().Publish(simTime);
+
+            m_lastTickMs = std::chrono::duration<float, std::milli>(Clock::now() - tickStart).count();
+            next += step;
+            ticks++;
+        }
+
+        if (now >= next) {
+            const uint64_t dropped = (now - next) / step + 1;
+            m_droppedTicks += dropped;
+            m_skippedTime  = m_skippedTime.load() + dropped * m_step;
+            next += dropped * step;
+        }
+
+        std::this_thread::sleep_until(next);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// Runs the tick function at a fixed rate on its own thread and publishes the transforms after every tick.
+// The renderer draws one tick in the past, so it always has two snapshots to interpolate between.
+class Simulation {
+public:
+    using TickFn = std::function<void(float deltaTime)>;
+
+    Simulation(double tickRate, TickFn tick);
+
+    // can be started again after a stop, the time starts from zero again
+    void Start();
+    void Stop();
+
+    // moves every transformable to the current render time, returns the interpolated simulation time
+    double Interpolate() const;
+
+    double   tickRate() const { return 1.0 / m_step; }
+    float    lastTickMs() const { return m_lastTickMs.load(); }
+    uint64_t droppedTicks() const { return m_droppedTicks.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void Loop();
+
+    TickFn m_tick;
+    double m_step;
+
+    std::thread       m_thread;
+    std::atomic<bool> m_running{false};
+    Clock::time_point m_startTime;
+
+    // time the simulation could not keep up with, the render clock skips it as well
+    std::atomic<double>   m_skippedTime{0.0};
+    std::atomic<uint64_t> m_droppedTicks{0};
+    std::atomic<float>    m_lastTickMs{0.0f};
+};
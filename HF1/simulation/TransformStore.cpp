@@ -0,0 +1,225 @@
+#include "TransformStore.h"
+#include "../primitives/ITransformable.h"
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+// the kernels read the local transforms straight from the glm arrays, as packed xyz and xyzw
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
+static_assert(sizeof(glm::quat) == 4 * sizeof(float));
+
+namespace {
+glm::mat4 ToMat4(const Affine3x4& affine)
+{
+    // the rows of the affine matrix are the columns of the transposed one
+    return glm::transpose(glm::mat4(glm::make_vec4(affine.rows[0]), glm::make_vec4(affine.rows[1]),
+                                    glm::make_vec4(affine.rows[2]), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+} // namespace
+
+TransformStore& TransformStore::Get()
+{
+    static TransformStore store;
+    return store;
+}
+
+uint32_t TransformStore::Register(ITransformable* object)
+{
+    m_layoutDirty = true;
+
+    if (!m_freeSlots.empty()) {
+        const uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        m_objects[slot]     = object;
+        m_parentSlots[slot] = NO_PARENT;
+        return slot;
+    }
+
+    m_objects.push_back(object);
+    m_parentSlots.push_back(NO_PARENT);
+    return static_cast<uint32_t>(m_objects.size() - 1);
+}
+
+void TransformStore::Unregister(const uint32_t slot)
+{
+    m_layoutDirty = true;
+
+    m_objects[slot]     = nullptr;
+    m_parentSlots[slot] = NO_PARENT;
+    m_freeSlots.push_back(slot);
+}
+
+void TransformStore::SetParent(const uint32_t slot, const uint32_t parentSlot)
+{
+    m_layoutDirty       = true;
+    m_parentSlots[slot] = parentSlot;
+}
+
+void TransformStore::RebuildLayout()
+{
+    const uint32_t slotCount = static_cast<uint32_t>(m_objects.size());
+
+    // children of every slot, a parent that is gone makes the node a root
+    std::vector<std::vector<uint32_t>> children(slotCount);
+    std::vector<uint32_t>              roots;
+    for (uint32_t slot = 0; slot < slotCount; slot++) {
+        if (m_objects[slot] == nullptr) {
+            continue;
+        }
+
+        const uint32_t parent = m_parentSlots[slot];
+        if (parent != NO_PARENT && m_objects[parent] != nullptr) {
+            children[parent].push_back(slot);
+        } else {
+            roots.push_back(slot);
+        }
+    }
+
+    // depth first, so a subtree is also next to each other in memory
+    m_slotOfNode.clear();
+    m_parentNodes.clear();
+    m_nodeOfSlot.assign(slotCount, NO_PARENT);
+
+    std::vector<uint32_t> stack(roots.rbegin(), roots.rend());
+    while (!stack.empty()) {
+        const uint32_t slot = stack.back();
+        stack.pop_back();
+
+        const uint32_t parent = m_parentSlots[slot];
+        const uint32_t node   = static_cast<uint32_t>(m_slotOfNode.size());
+        m_nodeOfSlot[slot]    = node;
+        m_slotOfNode.push_back(slot);
+        m_parentNodes.push_back(parent != NO_PARENT && m_objects[parent] != nullptr ? m_nodeOfSlot[parent]
+                                                                                      : NO_PARENT);
+
+        stack.insert(stack.end(), children[slot].rbegin(), children[slot].rend());
+    }
+
+    const size_t nodeCount = m_slotOfNode.size();
+    m_localPositions.assign(nodeCount, glm::vec3(0.0f));
+    m_localRotations.assign(nodeCount, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    m_localScales.assign(nodeCount, glm::vec3(1.0f));
+    m_dirty.assign(nodeCount, 1);
+    m_moved.assign(nodeCount, 0);
+    m_localAffine.resize(nodeCount);
+    m_worldAffine.resize(nodeCount);
+    m_world.assign(nodeCount, glm::mat4(1.0f));
+    m_prevWorld.assign(nodeCount, glm::mat4(1.0f));
+
+    m_freshLayout = true;
+    m_layoutDirty = false;
+}
+
+void TransformStore::Publish(const double simTime)
+{
+    if (m_layoutDirty) {
+        RebuildLayout();
+
+        // the older snapshots are in the old node order
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_published = 0;
+    }
+
+    const size_t nodeCount = m_slotOfNode.size();
+
+    Snapshot& snapshot = m_snapshots[m_write];
+    snapshot.positions.resize(nodeCount);
+    snapshot.rotations.resize(nodeCount);
+    snapshot.scales.resize(nodeCount);
+    snapshot.time = simTime;
+
+    for (size_t node = 0; node < nodeCount; node++) {
+        const ITransformable* object = m_objects[m_slotOfNode[node]];
+        snapshot.positions[node]     = object->m_position;
+        snapshot.rotations[node]     = object->m_rotation;
+        snapshot.scales[node]        = object->m_scale;
+    }
+
+    // the oldest snapshot is the only one the renderer won't need anymore
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint32_t oldest = m_prev;
+    m_prev                = m_curr;
+    m_curr                = m_write;
+    m_write               = oldest;
+    m_published++;
+}
+
+double TransformStore::Interpolate(const double renderTime)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_published == 0) {
+        return 0.0;
+    }
+
+    const Snapshot& curr = m_snapshots[m_curr];
+    const Snapshot& prev = (m_published > 1) ? m_snapshots[m_prev] : curr;
+
+    double alpha = 1.0;
+    if (curr.time > prev.time) {
+        alpha = std::clamp((renderTime - prev.time) / (curr.time - prev.time), 0.0, 1.0);
+    }
+    const float t = static_cast<float>(alpha);
+
+    // parents come first, so their dirty flag is final by the time the children get there
+    const uint32_t nodeCount  = static_cast<uint32_t>(m_slotOfNode.size());
+    uint32_t       firstDirty = nodeCount;
+    uint32_t       lastDirty  = 0;
+    for (uint32_t node = 0; node < nodeCount; node++) {
+        const glm::vec3 position = glm::mix(prev.positions[node], curr.positions[node], t);
+        const glm::quat rotation = glm::slerp(prev.rotations[node], curr.rotations[node], t);
+        const glm::vec3 scale    = glm::mix(prev.scales[node], curr.scales[node], t);
+
+        const uint32_t parent = m_parentNodes[node];
+
+        bool dirty = m_freshLayout || position != m_localPositions[node] || rotation != m_localRotations[node] ||
+                     scale != m_localScales[node];
+        if (parent != NO_PARENT) {
+            dirty = dirty || m_dirty[parent];
+        }
+        m_dirty[node] = dirty;
+
+        if (!dirty) {
+            // standing still for the second frame, the motion vectors go back to zero
+            if (m_moved[node]) {
+                m_prevWorld[node] = m_world[node];
+                m_moved[node]     = 0;
+            }
+            continue;
+        }
+
+        m_localPositions[node] = position;
+        m_localRotations[node] = rotation;
+        m_localScales[node]    = scale;
+
+        firstDirty = std::min(firstDirty, node);
+        lastDirty  = node + 1;
+    }
+
+    if (firstDirty < lastDirty) {
+        // the clean nodes in between are composed again, that is cheaper than splitting up the batch
+        m_kernels.compose(glm::value_ptr(m_localPositions[firstDirty]), glm::value_ptr(m_localRotations[firstDirty]),
+                          glm::value_ptr(m_localScales[firstDirty]), lastDirty - firstDirty,
+                          m_localAffine.data() + firstDirty);
+        m_kernels.chain(m_parentNodes.data(), m_dirty.data(), m_localAffine.data(), m_worldAffine.data(), firstDirty,
+                        lastDirty);
+
+        for (uint32_t node = firstDirty; node < lastDirty; node++) {
+            if (!m_dirty[node]) {
+                continue;
+            }
+
+            m_prevWorld[node] = m_world[node];
+            m_world[node]     = ToMat4(m_worldAffine[node]);
+            m_moved[node]     = 1;
+
+            // nothing was rendered before, there is no motion to show
+            if (m_freshLayout) {
+                m_prevWorld[node] = m_world[node];
+            }
+        }
+    }
+    m_freshLayout = false;
+
+    return prev.time + (curr.time - prev.time) * alpha;
+}
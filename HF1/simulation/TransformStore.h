@@ -0,0 +1,87 @@
+#pragma once
+#include "glm_config.h"
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <transform_kernels.h>
+#include <vector>
+
+class ITransformable;
+
+// Hands the transforms from the simulation thread to the renderer. The simulation copies every object into
+// the snapshot nobody reads and publishes it, the renderer interpolates between the two newest snapshots.
+//
+// The hierarchy is flattened: every node is stored in parent order (a parent always comes before its children)
+// in structure of arrays, so the world matrices are one linear pass per frame that every render pass shares.
+// Nodes whose local transform did not change and whose parent did not move keep their world matrix.
+// The matrix math runs in batches with the SIMD kernels of TransformKernels.
+//
+// Objects may only be registered, unregistered or reparented while the simulation is not running,
+// the new layout is built by the next Publish (Simulation::Start publishes the first snapshot).
+class TransformStore {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    static TransformStore& Get();
+
+    uint32_t Register(ITransformable* object);
+    void     Unregister(uint32_t slot);
+    void     SetParent(uint32_t slot, uint32_t parentSlot);
+
+    // simulation thread: the current state of every object becomes the snapshot of simTime
+    void Publish(double simTime);
+
+    // render thread: moves every object to renderTime between the last two snapshots and updates the world
+    // matrices, returns the sim time that was actually used
+    double Interpolate(double renderTime);
+
+    // render thread, valid until the next Interpolate
+    const glm::mat4& World(uint32_t slot) const { return m_world[m_nodeOfSlot[slot]]; }
+    const glm::mat4& PrevWorld(uint32_t slot) const { return m_prevWorld[m_nodeOfSlot[slot]]; }
+
+    uint32_t nodeCount() const { return static_cast<uint32_t>(m_slotOfNode.size()); }
+
+private:
+    // the local transforms of every node, in node order
+    struct Snapshot {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+        double                 time = 0.0;
+    };
+
+    void RebuildLayout();
+
+    std::vector<ITransformable*> m_objects; // indexed by slot, nullptr for free slots
+    std::vector<uint32_t>        m_parentSlots;
+    std::vector<uint32_t>        m_freeSlots;
+    bool                         m_layoutDirty = true;
+
+    // the flattened hierarchy, nodes are in parent order
+    std::vector<uint32_t> m_slotOfNode;
+    std::vector<uint32_t> m_nodeOfSlot;
+    std::vector<uint32_t> m_parentNodes; // NO_PARENT for the roots
+
+    // render thread state of every node
+    std::vector<glm::vec3> m_localPositions;
+    std::vector<glm::quat> m_localRotations;
+    std::vector<glm::vec3> m_localScales;
+    std::vector<uint8_t>   m_dirty; // the world matrix changed this frame
+    std::vector<uint8_t>   m_moved; // the world matrix changed last frame, the previous one still has to catch up
+    std::vector<Affine3x4> m_localAffine;
+    std::vector<Affine3x4> m_worldAffine;
+    std::vector<glm::mat4> m_world; // expanded for the push constants
+    std::vector<glm::mat4> m_prevWorld;
+    bool                   m_freshLayout = true;
+
+    const TransformKernels& m_kernels = TransformKernels::Best();
+
+    // the renderer reads m_prev and m_curr while holding the mutex, the simulation writes m_write without it
+    std::mutex m_mutex;
+    Snapshot   m_snapshots[3];
+    uint32_t   m_prev      = 0;
+    uint32_t   m_curr      = 1;
+    uint32_t   m_write     = 2;
+    uint64_t   m_published = 0;
+};
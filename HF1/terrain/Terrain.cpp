@@ -0,0 +1,544 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <context.h>
+#include <cstdio>
+#include <cstring>
+#include <descriptors.h>
+#include <mesh_optimizer.h>
+#include <texture.h>
+
+#include "../managers/TextureManager.h"
+#include "../primitives/Grid.h"
+#include "../render_passes/SceneInterface.h"
+
+namespace {
+constexpr uint32_t GRID_VERTICES = (Terrain::CHUNK_QUADS + 1) * (Terrain::CHUNK_QUADS + 1);
+constexpr uint32_t TILE_BYTES    = Terrain::TILE_SIZE * Terrain::TILE_SIZE * sizeof(float);
+static_assert(GRID_VERTICES <= 65536, "the shared index buffer is 16 bit");
+
+// bits of the variant, set where the neighbour on that side is drawn with a coarser level
+constexpr uint32_t EDGE_MIN_X = 1;
+constexpr uint32_t EDGE_MAX_X = 2;
+constexpr uint32_t EDGE_MIN_Z = 4;
+constexpr uint32_t EDGE_MAX_Z = 8;
+constexpr uint32_t EDGE_MASKS = 16;
+
+// fBm of value noise, the octaves halve the wavelength and the amplitude
+constexpr uint32_t OCTAVES         = 6;
+constexpr float    BASE_WAVELENGTH = 512.0f;
+constexpr float    BASE_AMPLITUDE  = 60.0f;
+
+// the scene stands on a flat patch around the origin, just below its floor
+constexpr float FLAT_HEIGHT = -0.05f;
+constexpr float FLAT_RADIUS = 20.0f;
+constexpr float FLAT_BLEND  = 100.0f;
+
+uint64_t ChunkKey(const int32_t x, const int32_t z)
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(z);
+}
+
+uint32_t Hash(const int32_t x, const int32_t z, const uint32_t seed)
+{
+    uint32_t hash = (seed * 0x9E3779B9u) ^ (uint32_t(x) * 0x85EBCA6Bu) ^ (uint32_t(z) * 0xC2B2AE35u);
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// in [-1, 1], smoothly interpolated between random values on the integer lattice
+float ValueNoise(const float x, const float z, const uint32_t seed)
+{
+    const float   floorX   = std::floor(x);
+    const float   floorZ   = std::floor(z);
+    const int32_t latticeX = int32_t(floorX);
+    const int32_t latticeZ = int32_t(floorZ);
+
+    const auto corner = [&](int32_t dx, int32_t dz) {
+        return Hash(latticeX + dx, latticeZ + dz, seed) * (2.0f / float(UINT32_MAX)) - 1.0f;
+    };
+
+    float tx = x - floorX;
+    float tz = z - floorZ;
+    tx       = tx * tx * (3.0f - 2.0f * tx);
+    tz       = tz * tz * (3.0f - 2.0f * tz);
+
+    const float near = corner(0, 0) + (corner(1, 0) - corner(0, 0)) * tx;
+    const float far  = corner(0, 1) + (corner(1, 1) - corner(0, 1)) * tx;
+    return near + (far - near) * tz;
+}
+
+// Only depends on the grid point, so the chunks on both sides of an edge get the exact same heights for it.
+float TerrainHeight(const int32_t gridX, const int32_t gridZ, const uint32_t seed)
+{
+    const float x = gridX * Terrain::QUAD_SIZE;
+    const float z = gridZ * Terrain::QUAD_SIZE;
+
+    float height     = 0.0f;
+    float amplitude  = BASE_AMPLITUDE;
+    float wavelength = BASE_WAVELENGTH;
+    for (uint32_t octave = 0; octave < OCTAVES; octave++) {
+        height += amplitude * ValueNoise(x / wavelength, z / wavelength, seed + octave);
+        amplitude *= 0.5f;
+        wavelength *= 0.5f;
+    }
+
+    float blend = std::clamp((std::sqrt(x * x + z * z) - FLAT_RADIUS) / FLAT_BLEND, 0.0f, 1.0f);
+    blend       = blend * blend * (3.0f - 2.0f * blend);
+    return FLAT_HEIGHT + (height - FLAT_HEIGHT) * blend;
+}
+
+// horizontal distance from the position to the closest point of the chunk
+float ChunkDistance(const int32_t x, const int32_t z, const glm::vec3& position)
+{
+    const float minX = x * Terrain::CHUNK_SIZE;
+    const float minZ = z * Terrain::CHUNK_SIZE;
+    const float dx   = std::max({minX - position.x, 0.0f, position.x - (minX + Terrain::CHUNK_SIZE)});
+    const float dz   = std::max({minZ - position.z, 0.0f, position.z - (minZ + Terrain::CHUNK_SIZE)});
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+uint32_t LodLevel(const float distance)
+{
+    if (distance < Terrain::LOD0_DISTANCE) {
+        return 0;
+    }
+    const uint32_t level = 1 + uint32_t(std::log2(distance / Terrain::LOD0_DISTANCE));
+    return std::min(level, Terrain::LOD_COUNT - 1);
+}
+
+// Gribb-Hartmann, the depth range is zero to one
+void FrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row],
+                              viewProjection[3][row]);
+    }
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[2];
+    planes[5] = rows[3] - rows[2];
+}
+
+bool BoxVisible(const glm::vec4 planes[6], const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    for (int idx = 0; idx < 6; idx++) {
+        const glm::vec4& plane = planes[idx];
+        // the corner furthest along the plane normal
+        const glm::vec3 corner(plane.x > 0.0f ? boxMax.x : boxMin.x, plane.y > 0.0f ? boxMax.y : boxMin.y,
+                               plane.z > 0.0f ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+Terrain::Terrain(Context&               context,
+                 JobSystem&             jobSystem,
+                 TextureManager&        textureManager,
+                 const TerrainSettings& settings,
+                 const uint32_t         framesInFlight)
+    : m_device(context.device())
+    , m_jobSystem(jobSystem)
+    , m_settings(settings)
+{
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(context.physicalDevice(), &properties);
+
+    const uint64_t budgetBytes = uint64_t(settings.budgetMB) * 1024 * 1024;
+    m_capacity = uint32_t(std::min<uint64_t>(budgetBytes / TILE_BYTES, properties.limits.maxImageArrayLayers));
+    if (m_capacity == 0) {
+        printf("[ERROR] A terrain budget of %u MB does not fit a single chunk\n", settings.budgetMB);
+        exit(-1);
+    }
+
+    m_heightmap = Texture::Create2DArray(context.physicalDevice(), m_device, VK_FORMAT_R32_SFLOAT,
+                                         {TILE_SIZE, TILE_SIZE}, m_capacity,
+                                         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    for (uint32_t layer = m_capacity; layer > 0; layer--) {
+        m_freeLayers.push_back(layer - 1);
+    }
+
+    m_descSetLayout = SceneInterface::CreateSetLayout(context, SceneInterface::HEIGHTMAP_SET);
+    m_descSet       = context.descriptorPool().CreateSet(m_descSetLayout);
+
+    DescriptorSetMgmt setMgmt(m_descSet);
+    setMgmt.SetImage(0, m_heightmap->view(), m_heightmap->sampler(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    setMgmt.Update(m_device);
+
+    m_textureSet = textureManager.DescriptorSet("white");
+
+    // coherent, so the writes need no flush before the submit
+    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+        BufferInfo staging = BufferInfo::Create(context.physicalDevice(), m_device, MAX_UPLOADS * TILE_BYTES,
+                                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_stagingMapped.push_back(static_cast<uint8_t*>(staging.Map(m_device)));
+        m_staging.push_back(staging);
+    }
+
+    CreateIndexBuffer(context);
+
+    m_stats.capacity = m_capacity;
+    printf("Terrain: %u chunk layers in %.1f MB, %.0f m view distance\n", m_capacity,
+           double(m_capacity) * TILE_BYTES / (1024.0 * 1024.0), settings.viewDistance);
+}
+
+void Terrain::CreateIndexBuffer(Context& context)
+{
+    std::vector<uint16_t> indices;
+
+    std::vector<float>        vertices;
+    std::vector<float>        normals;
+    std::vector<float>        texCoords;
+    std::vector<unsigned int> gridIndices;
+    std::vector<uint32_t>     variantIndices;
+
+    for (uint32_t level = 0; level < LOD_COUNT; level++) {
+        const uint32_t step  = 1u << level;
+        const uint32_t quads = CHUNK_QUADS >> level;
+        const uint32_t side  = quads + 1;
+
+        // the topology of the level, the positions come from the vertex index in the shader
+        vertices.clear();
+        normals.clear();
+        texCoords.clear();
+        gridIndices.clear();
+        buildGrid(1.0f, 1.0f, side, side, vertices, normals, texCoords, gridIndices);
+
+        for (uint32_t edges = 0; edges < EDGE_MASKS; edges++) {
+            variantIndices.clear();
+            for (size_t idx = 0; idx + 2 < gridIndices.size(); idx += 3) {
+                uint32_t triangle[3];
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    uint32_t column = gridIndices[idx + corner] % side;
+                    uint32_t row    = gridIndices[idx + corner] / side;
+
+                    // the coarser neighbour only has the even vertices of the shared edge
+                    if ((column == 0 && (edges & EDGE_MIN_X)) || (column == quads && (edges & EDGE_MAX_X))) {
+                        row &= ~1u;
+                    }
+                    if ((row == 0 && (edges & EDGE_MIN_Z)) || (row == quads && (edges & EDGE_MAX_Z))) {
+                        column &= ~1u;
+                    }
+                    triangle[corner] = row * step * (CHUNK_QUADS + 1) + column * step;
+                }
+
+                // the triangles between an odd vertex and the one it moved onto are gone
+                if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+                    continue;
+                }
+                variantIndices.insert(variantIndices.end(), triangle, triangle + 3);
+            }
+
+            OptimizeVertexCache(variantIndices.data(), variantIndices.size(), GRID_VERTICES);
+
+            m_variants.push_back({uint32_t(indices.size()), uint32_t(variantIndices.size())});
+            indices.insert(indices.end(), variantIndices.begin(), variantIndices.end());
+        }
+    }
+
+    const VkDeviceSize size = indices.size() * sizeof(uint16_t);
+    m_indexBuffer           = BufferInfo::Create(context.physicalDevice(), m_device, size,
+                                                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_indexBuffer.Update(m_device, indices.data(), size);
+}
+
+void Terrain::StartGeneration(const int32_t x, const int32_t z)
+{
+    std::unique_ptr<Pending> pending = std::make_unique<Pending>();
+    pending->x                       = x;
+    pending->z                       = z;
+
+    Pending*       chunk = pending.get();
+    const uint32_t seed  = m_settings.seed;
+    m_jobSystem.Run(
+        [chunk, seed]() {
+            chunk->heights.resize(TILE_SIZE * TILE_SIZE);
+            chunk->minHeight = INFINITY;
+            chunk->maxHeight = -INFINITY;
+
+            // the first texel is the border, one quad before the first vertex
+            const int32_t firstX = chunk->x * int32_t(CHUNK_QUADS) - 1;
+            const int32_t firstZ = chunk->z * int32_t(CHUNK_QUADS) - 1;
+            for (uint32_t row = 0; row < TILE_SIZE; row++) {
+                for (uint32_t column = 0; column < TILE_SIZE; column++) {
+                    const float height = TerrainHeight(firstX + int32_t(column), firstZ + int32_t(row), seed);
+                    chunk->heights[row * TILE_SIZE + column] = height;
+                    chunk->minHeight                         = std::min(chunk->minHeight, height);
+                    chunk->maxHeight                         = std::max(chunk->maxHeight, height);
+                }
+            }
+        },
+        &chunk->counter);
+
+    // with a single worker nothing runs in the background, the render thread generates the chunk itself
+    if (m_jobSystem.workerCount() == 1) {
+        m_jobSystem.Wait(chunk->counter);
+    }
+
+    m_pending.emplace(ChunkKey(x, z), std::move(pending));
+}
+
+void Terrain::Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection)
+{
+    m_frame++;
+
+    // the chunks in reach, only as many of the nearest ones as there are layers
+    const int32_t centerX = int32_t(std::floor(cameraPosition.x / CHUNK_SIZE));
+    const int32_t centerZ = int32_t(std::floor(cameraPosition.z / CHUNK_SIZE));
+    const int32_t radius  = int32_t(std::ceil(m_settings.viewDistance / CHUNK_SIZE));
+
+    m_inReach.clear();
+    for (int32_t z = centerZ - radius; z <= centerZ + radius; z++) {
+        for (int32_t x = centerX - radius; x <= centerX + radius; x++) {
+            const float distance = ChunkDistance(x, z, cameraPosition);
+            if (distance <= m_settings.viewDistance) {
+                m_inReach.push_back({x, z, distance});
+            }
+        }
+    }
+    std::sort(m_inReach.begin(), m_inReach.end(),
+              [](const InReach& a, const InReach& b) { return a.distance < b.distance; });
+    if (m_inReach.size() > m_capacity) {
+        m_inReach.resize(m_capacity);
+    }
+
+    // the missing ones are generated nearest first
+    m_inReachKeys.clear();
+    for (const InReach& chunk : m_inReach) {
+        const uint64_t key = ChunkKey(chunk.x, chunk.z);
+        m_inReachKeys.insert(key);
+
+        auto resident = m_resident.find(key);
+        if (resident != m_resident.end()) {
+            resident->second.lastUsed = m_frame;
+        } else if (m_pending.size() < MAX_PENDING && m_pending.find(key) == m_pending.end()) {
+            StartGeneration(chunk.x, chunk.z);
+        }
+    }
+
+    glm::vec4 planes[6];
+    FrustumPlanes(viewProjection, planes);
+
+    m_draws.clear();
+    m_stats.triangles = 0;
+    for (const InReach& chunk : m_inReach) {
+        auto resident = m_resident.find(ChunkKey(chunk.x, chunk.z));
+        if (resident == m_resident.end()) {
+            continue;
+        }
+
+        const glm::vec3 boxMin(chunk.x * CHUNK_SIZE, resident->second.minHeight, chunk.z * CHUNK_SIZE);
+        const glm::vec3 boxMax(boxMin.x + CHUNK_SIZE, resident->second.maxHeight, boxMin.z + CHUNK_SIZE);
+        if (!BoxVisible(planes, boxMin, boxMax)) {
+            continue;
+        }
+
+        // the neighbours pick their level the same way, drawn or not
+        const uint32_t level = LodLevel(chunk.distance);
+        const auto     coarser = [&](int32_t dx, int32_t dz) {
+            return LodLevel(ChunkDistance(chunk.x + dx, chunk.z + dz, cameraPosition)) > level;
+        };
+
+        uint32_t edges = 0;
+        edges |= coarser(-1, 0) ? EDGE_MIN_X : 0;
+        edges |= coarser(1, 0) ? EDGE_MAX_X : 0;
+        edges |= coarser(0, -1) ? EDGE_MIN_Z : 0;
+        edges |= coarser(0, 1) ? EDGE_MAX_Z : 0;
+
+        const uint32_t variant = level * EDGE_MASKS + edges;
+        m_draws.push_back({
+            .push    = {glm::vec4(boxMin.x, boxMin.z, QUAD_SIZE, float(resident->second.layer))},
+            .variant = variant,
+        });
+        m_stats.triangles += m_variants[variant].indexCount / 3;
+    }
+
+    m_stats.drawn         = uint32_t(m_draws.size());
+    m_stats.resident      = uint32_t(m_resident.size());
+    m_stats.pending       = uint32_t(m_pending.size());
+    m_stats.residentBytes = uint64_t(m_resident.size()) * TILE_BYTES;
+}
+
+bool Terrain::AcquireLayer(uint32_t& layer)
+{
+    if (!m_freeLayers.empty()) {
+        layer = m_freeLayers.back();
+        m_freeLayers.pop_back();
+        return true;
+    }
+
+    // the chunks in reach are drawn this frame, the others can go
+    auto oldest = m_resident.end();
+    for (auto it = m_resident.begin(); it != m_resident.end(); it++) {
+        if (it->second.lastUsed == m_frame) {
+            continue;
+        }
+        if (oldest == m_resident.end() || it->second.lastUsed < oldest->second.lastUsed) {
+            oldest = it;
+        }
+    }
+    if (oldest == m_resident.end()) {
+        return false;
+    }
+
+    layer = oldest->second.layer;
+    m_resident.erase(oldest);
+    return true;
+}
+
+void Terrain::CmdUpload(VkCommandBuffer cmdBuffer, const uint32_t frameSlot)
+{
+    VkImageMemoryBarrier2 barrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+        .dstAccessMask       = VK_ACCESS_2_NONE,
+        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = m_heightmap->image(),
+        .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, m_capacity},
+    };
+    VkDependencyInfo dependency = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 1,
+        .pImageMemoryBarriers     = &barrier,
+    };
+
+    // the descriptor covers every layer, they all have to be in its layout before the first draw
+    if (!m_initialized) {
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+        m_initialized = true;
+    }
+
+    std::vector<VkBufferImageCopy> copies;
+    for (auto it = m_pending.begin(); it != m_pending.end() && copies.size() < MAX_UPLOADS;) {
+        Pending& chunk = *it->second;
+        if (!chunk.counter.IsDone()) {
+            it++;
+            continue;
+        }
+
+        // the camera moved on while it was generated
+        uint32_t layer = 0;
+        if (m_inReachKeys.count(it->first) == 0 || !AcquireLayer(layer)) {
+            it = m_pending.erase(it);
+            continue;
+        }
+
+        const VkDeviceSize offset = copies.size() * TILE_BYTES;
+        memcpy(m_stagingMapped[frameSlot] + offset, chunk.heights.data(), TILE_BYTES);
+        copies.push_back({
+            .bufferOffset      = offset,
+            .bufferRowLength   = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1},
+            .imageOffset       = {0, 0, 0},
+            .imageExtent       = {TILE_SIZE, TILE_SIZE, 1},
+        });
+
+        // drawn from the next Update on
+        m_resident[it->first] = {
+            .layer     = layer,
+            .minHeight = chunk.minHeight,
+            .maxHeight = chunk.maxHeight,
+            .lastUsed  = m_frame,
+        };
+        it = m_pending.erase(it);
+    }
+
+    if (copies.empty()) {
+        return;
+    }
+
+    // the layers may have belonged to chunks an earlier frame still draws, the old contents are not needed
+    std::vector<VkImageMemoryBarrier2> barriers(copies.size(), barrier);
+    for (size_t idx = 0; idx < copies.size(); idx++) {
+        barriers[idx].srcStageMask     = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+        barriers[idx].dstStageMask     = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        barriers[idx].dstAccessMask    = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barriers[idx].newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[idx].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, copies[idx].imageSubresource.baseArrayLayer,
+                                          1};
+    }
+    dependency.imageMemoryBarrierCount = uint32_t(barriers.size());
+    dependency.pImageMemoryBarriers    = barriers.data();
+    vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+
+    vkCmdCopyBufferToImage(cmdBuffer, m_staging[frameSlot].buffer, m_heightmap->image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(copies.size()), copies.data());
+
+    for (VkImageMemoryBarrier2& layerBarrier : barriers) {
+        layerBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        layerBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        layerBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+        layerBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        layerBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        layerBarrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+}
+
+void Terrain::Record(VkCommandBuffer          cmdBuffer,
+                     VkPipeline               pipeline,
+                     VkPipelineLayout         pipelineLayout,
+                     const VkShaderStageFlags pushConstantStages) const
+{
+    if (m_draws.empty()) {
+        return;
+    }
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SceneInterface::TEXTURE_SET, 1,
+                            &m_textureSet, 0, nullptr);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SceneInterface::HEIGHTMAP_SET,
+                            1, &m_descSet, 0, nullptr);
+    vkCmdBindIndexBuffer(cmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+    for (const Draw& draw : m_draws) {
+        const Variant& variant = m_variants[draw.variant];
+        vkCmdPushConstants(cmdBuffer, pipelineLayout, pushConstantStages, 0, sizeof(PushConstant), &draw.push);
+        vkCmdDrawIndexed(cmdBuffer, variant.indexCount, 1, variant.firstIndex, 0, 0);
+    }
+}
+
+void Terrain::Destroy()
+{
+    for (auto& [key, pending] : m_pending) {
+        m_jobSystem.Wait(pending->counter);
+    }
+    m_pending.clear();
+
+    for (BufferInfo& staging : m_staging) {
+        staging.Unmap(m_device);
+        staging.Destroy(m_device);
+    }
+    m_indexBuffer.Destroy(m_device);
+
+    m_heightmap->Destroy(m_device);
+    delete m_heightmap;
+    m_heightmap = nullptr;
+}
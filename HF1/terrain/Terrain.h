@@ -0,0 +1,158 @@
+#pragma once
+#include "glm_config.h"
+
+#include <buffer.h>
+#include <cstdint>
+#include <job_system.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class Context;
+class Texture;
+class TextureManager;
+
+struct TerrainSettings {
+    // chunks further away than this are not drawn, the camera far plane is moved out to it
+    float    viewDistance = 1000.0f;
+    // resident heightmap memory, every chunk takes one layer of TILE_SIZE * TILE_SIZE floats
+    uint32_t budgetMB = 32;
+    uint32_t seed     = 1;
+};
+
+// Ground of any size made of square chunks around the camera. The chunks have no vertex buffer: all of them draw
+// with one shared 16 bit index buffer that addresses the vertices of the full resolution chunk grid, the vertex
+// shader takes the position from the vertex index and the height from the layer of the chunk in the heightmap.
+//
+// A chunk is drawn at a level of detail picked from its distance, every level skips every other vertex of the one
+// before. Where a neighbour is coarser, the odd vertices of the shared edge are moved onto the even ones, so the
+// edge has the same vertices on both sides. The index buffer has a variant for every level and every combination
+// of coarser neighbours.
+//
+// The heights are generated on the job system as the camera moves and uploaded a few chunks per frame. The
+// heightmap has a fixed number of layers that the budget allows, the chunks that are out of reach give their
+// layer to the new ones, the one out of reach for the longest first.
+class Terrain {
+public:
+    static constexpr uint32_t CHUNK_QUADS = 64; // has to match terrain.vert
+    static constexpr float    QUAD_SIZE   = 1.0f;
+    static constexpr float    CHUNK_SIZE  = CHUNK_QUADS * QUAD_SIZE;
+    static constexpr uint32_t LOD_COUNT   = 4;
+    // one more texel on every side, the normals of the edge vertices need their neighbours in the next chunk
+    static constexpr uint32_t TILE_SIZE = CHUNK_QUADS + 3;
+
+    // chunks closer than this are drawn with level 0, every further level doubles it. A level spans at least a
+    // chunk, so neighbouring chunks never differ by more than one level.
+    static constexpr float LOD0_DISTANCE = 128.0f;
+    static_assert(LOD0_DISTANCE >= CHUNK_SIZE);
+
+    // generation jobs in flight and generated chunks waiting for the upload
+    static constexpr uint32_t MAX_PENDING = 32;
+    static constexpr uint32_t MAX_UPLOADS = 8; // per frame
+
+    struct PushConstant {
+        glm::vec4 chunk; // world x and z of the first vertex, the quad size and the heightmap layer
+    };
+
+    struct Stats {
+        uint32_t drawn;
+        uint32_t resident;
+        uint32_t capacity;
+        uint32_t pending;
+        uint64_t triangles;
+        uint64_t residentBytes;
+    };
+
+    Terrain(Context&               context,
+            JobSystem&             jobSystem,
+            TextureManager&        textureManager,
+            const TerrainSettings& settings,
+            uint32_t               framesInFlight);
+
+    // Starts the generation of the chunks the camera reaches and picks the drawn ones with their levels,
+    // render thread, once per frame before the recording.
+    void Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection);
+
+    // copies up to MAX_UPLOADS generated chunks into their layers, before the lighting pass
+    void CmdUpload(VkCommandBuffer cmdBuffer, uint32_t frameSlot);
+
+    // inside the lighting pass, the lighting, shadow and camera sets of the pipeline layout are already bound
+    void Record(VkCommandBuffer    cmdBuffer,
+                VkPipeline         pipeline,
+                VkPipelineLayout   pipelineLayout,
+                VkShaderStageFlags pushConstantStages) const;
+
+    // waits for the generation jobs that are still running
+    void Destroy();
+
+    VkDescriptorSetLayout DescriptorSetLayout() const { return m_descSetLayout; }
+    const Stats&          stats() const { return m_stats; }
+
+private:
+    struct Variant {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
+    struct Resident {
+        uint32_t layer;
+        float    minHeight;
+        float    maxHeight;
+        uint64_t lastUsed; // frame the chunk was last in reach
+    };
+
+    // generated on the job system, uploaded once the counter is done
+    struct Pending {
+        int32_t            x;
+        int32_t            z;
+        std::vector<float> heights;
+        float              minHeight;
+        float              maxHeight;
+        JobCounter         counter;
+    };
+
+    struct InReach {
+        int32_t x;
+        int32_t z;
+        float   distance;
+    };
+
+    struct Draw {
+        PushConstant push;
+        uint32_t     variant;
+    };
+
+    void CreateIndexBuffer(Context& context);
+    void StartGeneration(int32_t x, int32_t z);
+    bool AcquireLayer(uint32_t& layer);
+
+    VkDevice        m_device;
+    JobSystem&      m_jobSystem;
+    TerrainSettings m_settings;
+    uint32_t        m_capacity;
+
+    BufferInfo           m_indexBuffer = {};
+    std::vector<Variant> m_variants; // LOD_COUNT * 16, the low 4 bits are the coarser edges
+
+    Texture*              m_heightmap     = nullptr;
+    VkDescriptorSetLayout m_descSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet       m_descSet       = VK_NULL_HANDLE;
+    VkDescriptorSet       m_textureSet    = VK_NULL_HANDLE;
+    bool                  m_initialized   = false; // every layer is in the shader read layout
+
+    // one persistently mapped buffer per frame in flight, MAX_UPLOADS tiles each
+    std::vector<BufferInfo> m_staging;
+    std::vector<uint8_t*>   m_stagingMapped;
+
+    uint64_t                                               m_frame = 0;
+    std::unordered_map<uint64_t, Resident>                 m_resident;
+    std::unordered_map<uint64_t, std::unique_ptr<Pending>> m_pending;
+    std::vector<uint32_t>                                  m_freeLayers;
+    std::vector<InReach>                                   m_inReach; // nearest first, at most m_capacity
+    std::unordered_set<uint64_t>                           m_inReachKeys;
+
+    std::vector<Draw> m_draws;
+    Stats             m_stats = {};
+};
@@ -12,7 +12,7 @@ static uint32_t FindMemoryTypeIndex(const VkPhysicalDevice phyDevice, const VkMe
             const VkMemoryType& memoryType = memoryProperties.memoryTypes[idx];
             // TODO: add size check?
 
-            if (memoryType.propertyFlags & flags) {
+            if ((memoryType.propertyFlags & flags) == flags) {
                 return idx;
             }
         }
@@ -25,7 +25,8 @@ BufferInfo BufferInfo::Create(
     const VkPhysicalDevice  phyDevice,
     const VkDevice          device,
     VkDeviceSize            size,
-    VkBufferUsageFlags      usageFlags) {
+    VkBufferUsageFlags      usageFlags,
+    VkMemoryPropertyFlags   memoryFlags) {
 
     VkBufferCreateInfo createInfo = {
         .sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -46,7 +47,7 @@ BufferInfo BufferInfo::Create(
     VkMemoryRequirements requirements = {};
     vkGetBufferMemoryRequirements(device, result.buffer, &requirements);
 
-    const uint32_t memoryTypeIdx = FindMemoryTypeIndex(phyDevice, requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    const uint32_t memoryTypeIdx = FindMemoryTypeIndex(phyDevice, requirements, memoryFlags);
     // TODO: check for error
 
     VkMemoryAllocateInfo allocInfo = {
@@ -7,7 +7,12 @@ struct BufferInfo {
     VkBuffer       buffer;
     VkDeviceMemory memory;
 
-    static BufferInfo Create(const VkPhysicalDevice phyDevice, const VkDevice device, VkDeviceSize size, VkBufferUsageFlags usageFlags);
+    // host visible by default, device local buffers can only be filled with transfers
+    static BufferInfo Create(const VkPhysicalDevice phyDevice,
+                             const VkDevice         device,
+                             VkDeviceSize           size,
+                             VkBufferUsageFlags     usageFlags,
+                             VkMemoryPropertyFlags  memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
     void* Map(const VkDevice device);
     void Unmap(const VkDevice device);
@@ -143,6 +143,8 @@ VkDevice Context::CreateDevice(const std::vector<const char*>& extensions)
     {
         {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 100},
         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 32},
     },
     100);
 
@@ -12,7 +12,7 @@ size_t descriptorSetLayoutBindingVectorHash(const std::vector<VkDescriptorSetLay
     std::stringstream stream;
     for (const auto binding : bindings) {
         stream << std::to_string(binding.binding) << "," << std::to_string(binding.descriptorCount) << ","
-               << std::to_string(binding.descriptorType) << ","
+               << std::to_string(binding.descriptorType) << "," << std::to_string(binding.stageFlags) << ","
                << std::to_string(reinterpret_cast<uint64_t>(binding.pImmutableSamplers)) << ";";
     }
     return std::hash<std::string>()(stream.str());
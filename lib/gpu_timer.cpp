@@ -0,0 +1,95 @@
+#include "gpu_timer.h"
+
+#include <cassert>
+#include <vector>
+
+GpuTimer::GpuTimer(const VkPhysicalDevice phyDevice,
+                   const VkDevice         device,
+                   const uint32_t         queueFamilyIdx,
+                   const uint32_t         frameSlotCount)
+    : m_device(device)
+    , m_frameSlotCount(frameSlotCount)
+{
+    assert(frameSlotCount <= 32);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &familyCount, families.data());
+    assert(queueFamilyIdx < familyCount);
+
+    // timestampComputeAndGraphics still allows a queue family without any valid bits
+    const uint32_t validBits = families[queueFamilyIdx].timestampValidBits;
+    m_validMask              = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    m_supported = properties.limits.timestampComputeAndGraphics == VK_TRUE &&
+                  properties.limits.timestampPeriod > 0 && validBits > 0;
+    m_nsPerTick = properties.limits.timestampPeriod;
+    if (!m_supported) {
+        return;
+    }
+
+    const VkQueryPoolCreateInfo createInfo = {
+        .sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .queryType          = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount         = 2 * frameSlotCount,
+        .pipelineStatistics = 0,
+    };
+
+    VkResult result = vkCreateQueryPool(m_device, &createInfo, nullptr, &m_queryPool);
+    assert(result == VK_SUCCESS);
+}
+
+void GpuTimer::CmdBegin(const VkCommandBuffer       cmdBuffer,
+                        const uint32_t              frameSlot,
+                        const VkPipelineStageFlags2 stage)
+{
+    assert(frameSlot < m_frameSlotCount);
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdResetQueryPool(cmdBuffer, m_queryPool, 2 * frameSlot, 2);
+    vkCmdWriteTimestamp2(cmdBuffer, stage, m_queryPool, 2 * frameSlot);
+}
+
+void GpuTimer::CmdEnd(const VkCommandBuffer cmdBuffer, const uint32_t frameSlot)
+{
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_queryPool, 2 * frameSlot + 1);
+    m_writtenSlots |= 1u << frameSlot;
+}
+
+bool GpuTimer::Read(const uint32_t frameSlot, double& outMs)
+{
+    if (!m_supported || (m_writtenSlots & (1u << frameSlot)) == 0) {
+        return false;
+    }
+
+    uint64_t       timestamps[2] = {};
+    const VkResult result        = vkGetQueryPoolResults(m_device, m_queryPool, 2 * frameSlot, 2, sizeof(timestamps),
+                                                         timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    // VK_NOT_READY if the frame is still running, the caller is expected to wait for its fence first
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    // the bits above the valid ones are undefined, the difference stays right over a wrap of the counter
+    const uint64_t ticks = ((timestamps[1] & m_validMask) - (timestamps[0] & m_validMask)) & m_validMask;
+    outMs                = double(ticks) * m_nsPerTick * 1e-6;
+    return true;
+}
+
+void GpuTimer::Destroy()
+{
+    vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+    m_queryPool = VK_NULL_HANDLE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan_core.h>
+
+// Measures the GPU time between two points of a command buffer with timestamp queries.
+// Every frame slot has its own pair of queries, a slot is only read back after the fence of its frame.
+class GpuTimer {
+public:
+    // the timestamps are written on queues of queueFamilyIdx
+    GpuTimer(VkPhysicalDevice phyDevice, VkDevice device, uint32_t queueFamilyIdx, uint32_t frameSlotCount);
+
+    // the begin timestamp is written once every earlier command finished stage
+    void CmdBegin(VkCommandBuffer       cmdBuffer,
+                  uint32_t              frameSlot,
+                  VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT);
+    void CmdEnd(VkCommandBuffer cmdBuffer, uint32_t frameSlot);
+
+    // False until the slot has been written and finished at least once.
+    bool Read(uint32_t frameSlot, double& outMs);
+
+    void Destroy();
+
+    bool supported() const { return m_supported; }
+
+private:
+    VkDevice    m_device;
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    uint32_t    m_frameSlotCount;
+    uint32_t    m_writtenSlots = 0; // bit per slot
+    uint64_t    m_validMask    = ~0ull; // timestampValidBits of the queue family
+    double      m_nsPerTick    = 1.0;
+    bool        m_supported    = false;
+};
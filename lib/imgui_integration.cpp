@@ -1,5 +1,7 @@
 #include "imgui_integration.h"
 
+#include <algorithm>
+
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <imgui.h>
@@ -40,6 +42,9 @@ bool IMGUIIntegration::CreateContext(const Context& context, const Swapchain& sw
     m_descriptorPool = CreateSimpleDescriptorPool(context.device());
 
     const VkFormat swapchainFormat = swapchain.format();
+    // imgui keeps vertex buffers per image, it needs at least two
+    const uint32_t minImageCount = std::max(swapchain.minImageCount(), 2u);
+    const uint32_t imageCount    = std::max(static_cast<uint32_t>(swapchain.images().size()), minImageCount);
 
     ImGui_ImplVulkan_InitInfo imguiInfo = {
         .Instance            = context.instance(),
@@ -49,8 +54,8 @@ bool IMGUIIntegration::CreateContext(const Context& context, const Swapchain& sw
         .Queue               = context.queue(),
         .DescriptorPool      = m_descriptorPool,
         .RenderPass          = VK_NULL_HANDLE,
-        .MinImageCount       = 2,
-        .ImageCount          = 2,
+        .MinImageCount       = minImageCount,
+        .ImageCount          = imageCount,
         // .MSAASamples         = context.sampleCountFlagBits(), TODO
         .MSAASamples         = VK_SAMPLE_COUNT_1_BIT,
         .PipelineCache       = VK_NULL_HANDLE,
@@ -77,6 +82,11 @@ bool IMGUIIntegration::CreateContext(const Context& context, const Swapchain& sw
     return true;
 }
 
+void IMGUIIntegration::UpdateImageCount(const Swapchain& swapchain)
+{
+    ImGui_ImplVulkan_SetMinImageCount(std::max(swapchain.minImageCount(), 2u));
+}
+
 void IMGUIIntegration::NewFrame()
 {
     ImGui_ImplVulkan_NewFrame();
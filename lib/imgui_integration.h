@@ -15,6 +15,8 @@ public:
 
     bool Init(GLFWwindow* window);
     bool CreateContext(const Context& context, const Swapchain& swapchain);
+    // has to be called after the swapchain is recreated
+    void UpdateImageCount(const Swapchain& swapchain);
     void NewFrame();
     void Draw(const VkCommandBuffer cmdBuffer);
 
@@ -0,0 +1,222 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+namespace {
+thread_local const JobSystem* t_owner     = nullptr;
+thread_local uint32_t         t_workerIdx = UINT32_MAX;
+} // namespace
+
+JobSystem::JobSystem(const uint32_t workerCount)
+    : m_workerCount(workerCount != 0 ? workerCount : std::max(std::thread::hardware_concurrency(), 1u))
+{
+    for (uint32_t idx = 0; idx < m_workerCount; idx++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    t_owner     = this;
+    t_workerIdx = 0;
+
+    for (uint32_t idx = 1; idx < m_workerCount; idx++) {
+        m_threads.emplace_back(&JobSystem::WorkerLoop, this, idx);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_sleepCondition.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+
+    if (t_owner == this) {
+        t_owner     = nullptr;
+        t_workerIdx = UINT32_MAX;
+    }
+}
+
+uint32_t JobSystem::CurrentWorkerIdx() const
+{
+    return t_owner == this ? t_workerIdx : UINT32_MAX;
+}
+
+void JobSystem::Run(JobFn job, JobCounter* counter, JobCounter* dependency)
+{
+    if (counter != nullptr) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (dependency != nullptr) {
+        // the last job of the dependency takes the continuations under the same lock, see Execute
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        if (!dependency->IsDone()) {
+            dependency->m_continuations.push_back({std::move(job), counter});
+            return;
+        }
+    }
+
+    Schedule({std::move(job), counter});
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    const uint32_t workerIdx = CurrentWorkerIdx();
+
+    while (!counter.IsDone()) {
+        if (!TryRunOne(workerIdx)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // the job finishing the counter may still hold its lock, the counter must outlive that
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::ParallelFor(const uint32_t count, uint32_t batchSize, const RangeFn& fn)
+{
+    batchSize = std::max(batchSize, 1u);
+
+    if (count <= batchSize || m_workerCount == 1) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t first = batchSize; first < count; first += batchSize) {
+        const uint32_t last = std::min(first + batchSize, count);
+        Run([&fn, first, last] { fn(first, last); }, &counter);
+    }
+
+    // the caller takes the first batch instead of just waiting
+    fn(0, batchSize);
+    Wait(counter);
+}
+
+void JobSystem::Schedule(Job job)
+{
+    // counted before it is visible, so a worker never sleeps while there is a job to take
+    m_queuedJobs.fetch_add(1);
+
+    const uint32_t workerIdx = CurrentWorkerIdx();
+    if (workerIdx != UINT32_MAX) {
+        Worker&                     worker = *m_workers[workerIdx];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(std::move(job));
+    } else {
+        std::lock_guard<std::mutex> lock(m_injectMutex);
+        m_injected.push_back(std::move(job));
+    }
+
+    if (m_sleepingWorkers.load() > 0) {
+        // taking the lock makes sure the worker is either waiting already or sees the new job count
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_sleepCondition.notify_one();
+    }
+}
+
+bool JobSystem::TryRunOne(const uint32_t workerIdx)
+{
+    Job job;
+    if (!PopJob(workerIdx, job)) {
+        return false;
+    }
+
+    Execute(job);
+    return true;
+}
+
+bool JobSystem::PopJob(const uint32_t workerIdx, Job& outJob)
+{
+    // own jobs newest first, they are the most likely to be in the cache
+    if (workerIdx != UINT32_MAX) {
+        Worker&                     worker = *m_workers[workerIdx];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty()) {
+            outJob = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_injectMutex);
+        if (!m_injected.empty()) {
+            outJob = std::move(m_injected.front());
+            m_injected.pop_front();
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // threads outside of the system don't steal, jobs pushed by a worker only ever run on workers
+    if (workerIdx == UINT32_MAX) {
+        return false;
+    }
+
+    // steal the oldest job of someone else, starting with the next worker so thieves spread out
+    const uint32_t start = workerIdx + 1;
+    for (uint32_t offset = 0; offset < m_workerCount; offset++) {
+        const uint32_t victimIdx = (start + offset) % m_workerCount;
+        if (victimIdx == workerIdx) {
+            continue;
+        }
+
+        Worker&                     victim = *m_workers[victimIdx];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            outJob = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+    job.fn();
+
+    JobCounter* counter = job.counter;
+    if (counter == nullptr) {
+        return;
+    }
+
+    std::vector<JobCounter::Continuation> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations.swap(counter->m_continuations);
+        }
+    }
+
+    for (JobCounter::Continuation& continuation : continuations) {
+        Schedule({std::move(continuation.job), continuation.counter});
+    }
+}
+
+void JobSystem::WorkerLoop(const uint32_t workerIdx)
+{
+    t_owner     = this;
+    t_workerIdx = workerIdx;
+
+    while (!m_quit) {
+        if (TryRunOne(workerIdx)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkers++;
+        m_sleepCondition.wait(lock, [this] { return m_quit || m_queuedJobs.load() > 0; });
+        m_sleepingWorkers--;
+    }
+}
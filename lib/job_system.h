@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Number of unfinished jobs of a group. Jobs can be made to wait for a counter with JobSystem::Run.
+class JobCounter {
+public:
+    bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    struct Continuation {
+        std::function<void()> job;
+        JobCounter*           counter;
+    };
+
+    std::atomic<uint32_t>     m_pending{0};
+    std::mutex                m_mutex;
+    std::vector<Continuation> m_continuations;
+};
+
+// Work stealing job system. Every worker owns a deque: it pushes and pops its own jobs at the back,
+// idle workers steal from the front of the others. Threads that are not workers push into a shared queue.
+// The thread creating the system is worker 0, it only runs jobs while waiting in Wait/ParallelFor.
+// Jobs never leave the workers once a worker scheduled them, so per worker resources can be indexed
+// with CurrentWorkerIdx() inside a job.
+class JobSystem {
+public:
+    using JobFn   = std::function<void()>;
+    using RangeFn = std::function<void(uint32_t first, uint32_t last)>;
+
+    // workerCount includes the creating thread, 0 means one worker per hardware thread
+    explicit JobSystem(uint32_t workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&)            = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // counter is incremented now and decremented when the job is finished,
+    // the job is not started before dependency is done
+    void Run(JobFn job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+    // runs other jobs until the counter is done
+    void Wait(JobCounter& counter);
+
+    // calls fn with [first, last) ranges of at most batchSize elements and waits for all of them
+    void ParallelFor(uint32_t count, uint32_t batchSize, const RangeFn& fn);
+
+    uint32_t workerCount() const { return m_workerCount; }
+
+    // index of the calling thread or UINT32_MAX if it is not a worker of this system
+    uint32_t CurrentWorkerIdx() const;
+
+private:
+    struct Job {
+        JobFn       fn;
+        JobCounter* counter;
+    };
+
+    struct Worker {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Schedule(Job job);
+    bool TryRunOne(uint32_t workerIdx);
+    bool PopJob(uint32_t workerIdx, Job& outJob);
+    void Execute(Job& job);
+    void WorkerLoop(uint32_t workerIdx);
+
+    uint32_t                             m_workerCount;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread>             m_threads;
+
+    // jobs from threads outside of the system
+    std::mutex      m_injectMutex;
+    std::deque<Job> m_injected;
+
+    std::atomic<uint32_t>   m_queuedJobs{0};
+    std::atomic<uint32_t>   m_sleepingWorkers{0};
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    std::atomic<bool>       m_quit{false};
+};
@@ -0,0 +1,370 @@
+#include "json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+const JsonValue NULL_VALUE;
+
+// deep enough for any sane document, a hostile one would run out of stack
+constexpr uint32_t MAX_DEPTH = 128;
+} // namespace
+
+// Recursive descent, every Parse* expects the current character to be the start of its value.
+class JsonParser {
+public:
+    JsonParser(const char* text, size_t size)
+        : m_begin(text)
+        , m_cur(text)
+        , m_end(text + size)
+    {
+    }
+
+    bool ParseDocument(JsonValue& out, std::string& error)
+    {
+        SkipSpace();
+        if (!ParseValue(out, 0)) {
+            return Fail(error);
+        }
+
+        SkipSpace();
+        if (m_cur != m_end) {
+            m_error = "garbage after the document";
+            return Fail(error);
+        }
+        return true;
+    }
+
+private:
+    bool Fail(std::string& error) const
+    {
+        // the line is all that helps with a big file
+        uint32_t line = 1;
+        for (const char* it = m_begin; it < m_cur; it++) {
+            line += (*it == '\n') ? 1 : 0;
+        }
+
+        char location[32];
+        snprintf(location, sizeof(location), "line %u: ", line);
+        error = location + m_error;
+        return false;
+    }
+
+    bool Error(const char* message)
+    {
+        m_error = message;
+        return false;
+    }
+
+    void SkipSpace()
+    {
+        while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\n' || *m_cur == '\r')) {
+            m_cur++;
+        }
+    }
+
+    bool Literal(const char* literal)
+    {
+        const size_t length = strlen(literal);
+        if (static_cast<size_t>(m_end - m_cur) < length || memcmp(m_cur, literal, length) != 0) {
+            return Error("unknown literal");
+        }
+        m_cur += length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& out, const uint32_t depth)
+    {
+        if (depth >= MAX_DEPTH) {
+            return Error("nested too deep");
+        }
+        if (m_cur == m_end) {
+            return Error("unexpected end");
+        }
+
+        switch (*m_cur) {
+        case '{':
+            return ParseObject(out, depth);
+        case '[':
+            return ParseArray(out, depth);
+        case '"':
+            out.m_type = JsonValue::Type::String;
+            return ParseString(out.m_string);
+        case 't':
+            out.m_type = JsonValue::Type::Bool;
+            out.m_bool = true;
+            return Literal("true");
+        case 'f':
+            out.m_type = JsonValue::Type::Bool;
+            out.m_bool = false;
+            return Literal("false");
+        case 'n':
+            out.m_type = JsonValue::Type::Null;
+            return Literal("null");
+        default:
+            return ParseNumber(out);
+        }
+    }
+
+    bool ParseObject(JsonValue& out, const uint32_t depth)
+    {
+        out.m_type = JsonValue::Type::Object;
+        m_cur++;
+
+        SkipSpace();
+        if (m_cur < m_end && *m_cur == '}') {
+            m_cur++;
+            return true;
+        }
+
+        while (true) {
+            SkipSpace();
+            if (m_cur == m_end || *m_cur != '"') {
+                return Error("expected a member name");
+            }
+
+            out.m_keys.emplace_back();
+            if (!ParseString(out.m_keys.back())) {
+                return false;
+            }
+
+            SkipSpace();
+            if (m_cur == m_end || *m_cur != ':') {
+                return Error("expected ':' after the member name");
+            }
+            m_cur++;
+
+            SkipSpace();
+            out.m_items.emplace_back();
+            if (!ParseValue(out.m_items.back(), depth + 1)) {
+                return false;
+            }
+
+            SkipSpace();
+            if (m_cur < m_end && *m_cur == ',') {
+                m_cur++;
+            } else if (m_cur < m_end && *m_cur == '}') {
+                m_cur++;
+                return true;
+            } else {
+                return Error("expected ',' or '}' in the object");
+            }
+        }
+    }
+
+    bool ParseArray(JsonValue& out, const uint32_t depth)
+    {
+        out.m_type = JsonValue::Type::Array;
+        m_cur++;
+
+        SkipSpace();
+        if (m_cur < m_end && *m_cur == ']') {
+            m_cur++;
+            return true;
+        }
+
+        while (true) {
+            SkipSpace();
+            out.m_items.emplace_back();
+            if (!ParseValue(out.m_items.back(), depth + 1)) {
+                return false;
+            }
+
+            SkipSpace();
+            if (m_cur < m_end && *m_cur == ',') {
+                m_cur++;
+            } else if (m_cur < m_end && *m_cur == ']') {
+                m_cur++;
+                return true;
+            } else {
+                return Error("expected ',' or ']' in the array");
+            }
+        }
+    }
+
+    bool ParseHex4(uint32_t& out)
+    {
+        if (m_end - m_cur < 4) {
+            return Error("unexpected end in an escape");
+        }
+
+        out = 0;
+        for (int idx = 0; idx < 4; idx++) {
+            const char c = *m_cur++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') {
+                out |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                out |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                out |= c - 'A' + 10;
+            } else {
+                return Error("broken \\u escape");
+            }
+        }
+        return true;
+    }
+
+    static void AppendUtf8(std::string& out, const uint32_t codePoint)
+    {
+        if (codePoint < 0x80) {
+            out += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codePoint >> 18));
+            out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool ParseString(std::string& out)
+    {
+        m_cur++;
+
+        while (true) {
+            // the plain part is copied in one go
+            const char* start = m_cur;
+            while (m_cur < m_end && *m_cur != '"' && *m_cur != '\\') {
+                if (static_cast<unsigned char>(*m_cur) < 0x20) {
+                    return Error("control character in a string");
+                }
+                m_cur++;
+            }
+            out.append(start, m_cur);
+
+            if (m_cur == m_end) {
+                return Error("unterminated string");
+            }
+            if (*m_cur++ == '"') {
+                return true;
+            }
+
+            if (m_cur == m_end) {
+                return Error("unterminated string");
+            }
+            const char escape = *m_cur++;
+            switch (escape) {
+            case '"':
+            case '\\':
+            case '/':
+                out += escape;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u': {
+                uint32_t codePoint = 0;
+                if (!ParseHex4(codePoint)) {
+                    return false;
+                }
+
+                // a surrogate pair is two escapes for one code point
+                if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                    uint32_t low = 0;
+                    if (m_end - m_cur < 2 || m_cur[0] != '\\' || m_cur[1] != 'u') {
+                        return Error("lone surrogate in a string");
+                    }
+                    m_cur += 2;
+                    if (!ParseHex4(low)) {
+                        return false;
+                    }
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        return Error("lone surrogate in a string");
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return Error("unknown escape in a string");
+            }
+        }
+    }
+
+    bool ParseNumber(JsonValue& out)
+    {
+        // strtod needs a terminated string, the text may be a mapped file without one
+        char        buffer[64];
+        size_t      length = 0;
+        const char* start  = m_cur;
+        while (m_cur < m_end && strchr("+-.0123456789eE", *m_cur) != nullptr) {
+            if (length == sizeof(buffer) - 1) {
+                return Error("number is too long");
+            }
+            buffer[length++] = *m_cur++;
+        }
+        buffer[length] = '\0';
+
+        char* end = nullptr;
+        if (length == 0 || (out.m_number = strtod(buffer, &end), end != buffer + length)) {
+            m_cur = start;
+            return Error("expected a value");
+        }
+        out.m_type = JsonValue::Type::Number;
+        return true;
+    }
+
+    const char* m_begin;
+    const char* m_cur;
+    const char* m_end;
+    std::string m_error;
+};
+
+bool JsonValue::Parse(const char* text, const size_t size, JsonValue& out, std::string& error)
+{
+    out = JsonValue();
+    JsonParser parser(text, size);
+    return parser.ParseDocument(out, error);
+}
+
+const JsonValue& JsonValue::operator[](const size_t idx) const
+{
+    return (m_type == Type::Array && idx < m_items.size()) ? m_items[idx] : NULL_VALUE;
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+    if (m_type != Type::Object) {
+        return NULL_VALUE;
+    }
+
+    // the objects of a glTF have a handful of members, a map would cost more than it saves
+    for (size_t idx = 0; idx < m_keys.size(); idx++) {
+        if (m_keys[idx] == key) {
+            return m_items[idx];
+        }
+    }
+    return NULL_VALUE;
+}
+
+bool JsonValue::has(const char* key) const
+{
+    return &(*this)[key] != &NULL_VALUE;
+}
+
+int64_t JsonValue::integer(const char* key, const int64_t fallback) const
+{
+    const JsonValue& value = (*this)[key];
+    return value.isNumber() ? static_cast<int64_t>(value.m_number) : fallback;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Just enough JSON for the glTF files: the whole document is parsed into a tree of values.
+// Missing members and wrong types read as the fallback, so the loaders can check only what matters to them.
+class JsonValue {
+public:
+    enum class Type : uint8_t {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    // the text does not have to be zero terminated, false with the position of the problem in error
+    static bool Parse(const char* text, size_t size, JsonValue& out, std::string& error);
+
+    Type type() const { return m_type; }
+    bool isNumber() const { return m_type == Type::Number; }
+    bool isString() const { return m_type == Type::String; }
+    bool isArray() const { return m_type == Type::Array; }
+    bool isObject() const { return m_type == Type::Object; }
+
+    bool               asBool(bool fallback = false) const { return m_type == Type::Bool ? m_bool : fallback; }
+    double             asNumber(double fallback = 0.0) const { return isNumber() ? m_number : fallback; }
+    const std::string& asString() const { return m_string; }
+
+    // items of an array, zero for anything else
+    size_t           size() const { return m_type == Type::Array ? m_items.size() : 0; }
+    const JsonValue& operator[](size_t idx) const;
+
+    // member of an object, the null value if there is no such member
+    const JsonValue& operator[](const char* key) const;
+    bool             has(const char* key) const;
+
+    // shortcuts for the members
+    double   number(const char* key, double fallback = 0.0) const { return (*this)[key].asNumber(fallback); }
+    int64_t  integer(const char* key, int64_t fallback = -1) const;
+    uint32_t count(const char* key) const { return static_cast<uint32_t>((*this)[key].size()); }
+
+private:
+    friend class JsonParser;
+
+    Type        m_type   = Type::Null;
+    bool        m_bool   = false;
+    double      m_number = 0.0;
+    std::string m_string;
+
+    // array items, or the member values of an object with their names in m_keys
+    std::vector<JsonValue>   m_items;
+    std::vector<std::string> m_keys;
+};
@@ -0,0 +1,92 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(file, &fileSize);
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void*  data    = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+
+    m_fileHandle    = file;
+    m_mappingHandle = mapping;
+    m_size          = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps the file alive on its own
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+    m_data = data;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+    m_mappingHandle = nullptr;
+    m_fileHandle    = nullptr;
+#else
+    munmap(m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// Read only view of a whole file, the pages are only loaded when touched.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file can't be opened or is empty
+    bool Open(const char* path);
+    void Close();
+
+    bool        isOpen() const { return m_data != nullptr; }
+    const void* data() const { return m_data; }
+    size_t      size() const { return m_size; }
+
+private:
+    void*  m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_fileHandle    = nullptr;
+    void* m_mappingHandle = nullptr;
+#endif
+};
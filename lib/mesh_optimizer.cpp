@@ -0,0 +1,164 @@
+#include "mesh_optimizer.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace {
+constexpr uint32_t NO_VERTEX = UINT32_MAX;
+} // namespace
+
+uint64_t CountCacheMisses(const uint32_t* indices,
+                          const size_t    indexCount,
+                          const uint32_t  vertexCount,
+                          const uint32_t  cacheSize)
+{
+    // a vertex is in the cache while fewer than cacheSize misses happened since it was put in
+    std::vector<uint64_t> insertedAt(vertexCount, 0);
+    uint64_t              misses = 0;
+
+    for (size_t idx = 0; idx < indexCount; idx++) {
+        const uint32_t vertex = indices[idx];
+        assert(vertex < vertexCount);
+        if (insertedAt[vertex] == 0 || misses + 1 - insertedAt[vertex] >= cacheSize) {
+            misses++;
+            insertedAt[vertex] = misses;
+        }
+    }
+    return misses;
+}
+
+void OptimizeVertexCache(uint32_t*      indices,
+                         const size_t   indexCount,
+                         const uint32_t vertexCount,
+                         const uint32_t cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // the triangles of every vertex, packed one vertex after the other
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t idx = 0; idx < triangleCount * 3; idx++) {
+        adjacencyStart[indices[idx] + 1]++;
+    }
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        adjacencyStart[vertex + 1] += adjacencyStart[vertex];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t idx = 0; idx < triangleCount * 3; idx++) {
+        adjacency[fill[indices[idx]]++] = static_cast<uint32_t>(idx / 3);
+    }
+
+    // triangles of the vertex that are not emitted yet
+    std::vector<uint32_t> live(vertexCount);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        live[vertex] = adjacencyStart[vertex + 1] - adjacencyStart[vertex];
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool>     emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds; // the vertices of the emitted triangles, most recent last
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t time   = cacheSize + 1;
+    uint32_t cursor = 0; // where the search for a vertex with live triangles continues
+    uint32_t fan    = indices[0];
+
+    while (fan != NO_VERTEX) {
+        // every triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t adj = adjacencyStart[fan]; adj < adjacencyStart[fan + 1]; adj++) {
+            const uint32_t triangle = adjacency[adj];
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if (time - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // The next fan is the candidate that stays in the cache while its triangles are emitted, preferring
+        // the oldest one so it is used before it falls out.
+        uint32_t next     = NO_VERTEX;
+        int64_t  priority = -1;
+        for (const uint32_t vertex : candidates) {
+            if (live[vertex] == 0) {
+                continue;
+            }
+
+            int64_t candidatePriority = 0;
+            if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize) {
+                candidatePriority = time - cacheTime[vertex];
+            }
+            if (candidatePriority > priority) {
+                priority = candidatePriority;
+                next     = vertex;
+            }
+        }
+
+        // a dead end, back to the last vertex with something left or the next one in index order
+        while (next == NO_VERTEX && !deadEnds.empty()) {
+            const uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[vertex] > 0) {
+                next = vertex;
+            }
+        }
+        while (next == NO_VERTEX && cursor < vertexCount) {
+            if (live[cursor] > 0) {
+                next = cursor;
+            }
+            cursor++;
+        }
+        fan = next;
+    }
+
+    assert(output.size() == triangleCount * 3);
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void OptimizeVertexFetch(uint32_t*              indices,
+                         const size_t           indexCount,
+                         const uint32_t         vertexCount,
+                         std::vector<uint32_t>& order)
+{
+    std::vector<uint32_t> remap(vertexCount, NO_VERTEX);
+    order.clear();
+    order.reserve(vertexCount);
+
+    for (size_t idx = 0; idx < indexCount; idx++) {
+        uint32_t& newVertex = remap[indices[idx]];
+        if (newVertex == NO_VERTEX) {
+            newVertex = static_cast<uint32_t>(order.size());
+            order.push_back(indices[idx]);
+        }
+        indices[idx] = newVertex;
+    }
+
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        if (remap[vertex] == NO_VERTEX) {
+            order.push_back(vertex);
+        }
+    }
+}
+
+void RemapVertices(const float* src, const uint32_t components, const std::vector<uint32_t>& order, float* dst)
+{
+    for (size_t idx = 0; idx < order.size(); idx++) {
+        memcpy(dst + idx * components, src + size_t(order[idx]) * components, components * sizeof(float));
+    }
+}
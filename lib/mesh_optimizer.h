@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post-processing of indexed triangle lists, done once when a mesh is added. The triangles are reordered so the
+// post-transform cache of the GPU hits more often, then the vertices so the fetches walk the buffers forward.
+
+// entries of the simulated FIFO cache, real hardware has about this much or more
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+// 16 bit indices reach every vertex, there is no primitive restart that would take 0xFFFF away
+inline bool FitsIndex16(const uint32_t vertexCount)
+{
+    return vertexCount <= 65536;
+}
+
+// Vertices a FIFO cache of cacheSize transforms for the triangle list, the ACMR is this over the triangle count.
+uint64_t CountCacheMisses(const uint32_t* indices,
+                          size_t          indexCount,
+                          uint32_t        vertexCount,
+                          uint32_t        cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al. 2007), in
+// place. Fans around one vertex at a time and picks the next one among the vertices still in the cache. Keeps
+// the winding of every triangle.
+void OptimizeVertexCache(uint32_t* indices,
+                         size_t    indexCount,
+                         uint32_t  vertexCount,
+                         uint32_t  cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers the vertices in the order the indices first use them and rewrites the indices. order gets the old
+// vertex of every new one, the unreferenced vertices go to the end.
+void OptimizeVertexFetch(uint32_t* indices, size_t indexCount, uint32_t vertexCount, std::vector<uint32_t>& order);
+
+// dst[idx] = src[order[idx]] for vertices of components floats
+void RemapVertices(const float* src, uint32_t components, const std::vector<uint32_t>& order, float* dst);
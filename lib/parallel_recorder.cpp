@@ -0,0 +1,126 @@
+#include "parallel_recorder.h"
+
+#include <cassert>
+
+#include "job_system.h"
+
+ParallelRecorder::ParallelRecorder(JobSystem&     jobSystem,
+                                   const VkDevice device,
+                                   const uint32_t queueFamilyIdx,
+                                   const uint32_t frameSlotCount)
+    : m_jobSystem(jobSystem)
+    , m_device(device)
+    , m_workerCount(jobSystem.workerCount())
+    , m_pools(frameSlotCount)
+{
+    const VkCommandPoolCreateInfo createInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx,
+    };
+
+    for (std::vector<WorkerPool>& slot : m_pools) {
+        slot.resize(m_workerCount);
+        for (WorkerPool& worker : slot) {
+            worker.pool = VK_NULL_HANDLE;
+            worker.used = 0;
+
+            VkResult result = vkCreateCommandPool(m_device, &createInfo, nullptr, &worker.pool);
+            assert(result == VK_SUCCESS);
+        }
+    }
+}
+
+void ParallelRecorder::BeginFrame(const uint32_t frameSlot)
+{
+    assert(frameSlot < m_pools.size());
+    m_frameSlot = frameSlot;
+
+    // resetting the whole pool is cheaper than resetting the buffers one by one, the buffers stay allocated
+    for (WorkerPool& worker : m_pools[m_frameSlot]) {
+        vkResetCommandPool(m_device, worker.pool, 0);
+        worker.used = 0;
+    }
+}
+
+std::vector<VkCommandBuffer> ParallelRecorder::Record(const std::vector<Job>& jobs)
+{
+    assert(m_jobSystem.CurrentWorkerIdx() != UINT32_MAX);
+
+    std::vector<VkCommandBuffer> results(jobs.size(), VK_NULL_HANDLE);
+
+    // every job writes its own element, the vector is not resized during the recording
+    m_jobSystem.ParallelFor(static_cast<uint32_t>(jobs.size()), 1, [&](uint32_t first, uint32_t last) {
+        const uint32_t workerIdx = m_jobSystem.CurrentWorkerIdx();
+        for (uint32_t jobIdx = first; jobIdx < last; jobIdx++) {
+            results[jobIdx] = RecordJob(jobs[jobIdx], workerIdx);
+        }
+    });
+
+    return results;
+}
+
+void ParallelRecorder::Destroy()
+{
+    // destroying the pool frees its command buffers too
+    for (std::vector<WorkerPool>& slot : m_pools) {
+        for (WorkerPool& worker : slot) {
+            vkDestroyCommandPool(m_device, worker.pool, nullptr);
+        }
+    }
+    m_pools.clear();
+}
+
+VkCommandBuffer ParallelRecorder::RecordJob(const Job& job, const uint32_t workerIdx)
+{
+    VkCommandBuffer cmdBuffer = AcquireBuffer(workerIdx);
+
+    const VkCommandBufferInheritanceInfo inheritanceInfo = {
+        .sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext                = &job.renderingInfo,
+        .renderPass           = VK_NULL_HANDLE,
+        .subpass              = 0,
+        .framebuffer          = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags           = 0,
+        .pipelineStatistics   = 0,
+    };
+
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo,
+    };
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+    job.record(cmdBuffer);
+    vkEndCommandBuffer(cmdBuffer);
+
+    return cmdBuffer;
+}
+
+VkCommandBuffer ParallelRecorder::AcquireBuffer(const uint32_t workerIdx)
+{
+    WorkerPool& worker = m_pools[m_frameSlot][workerIdx];
+
+    if (worker.used == worker.buffers.size()) {
+        const VkCommandBufferAllocateInfo allocInfo = {
+            .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext              = nullptr,
+            .commandPool        = worker.pool,
+            .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkResult        result    = vkAllocateCommandBuffers(m_device, &allocInfo, &cmdBuffer);
+        assert(result == VK_SUCCESS);
+
+        worker.buffers.push_back(cmdBuffer);
+    }
+
+    return worker.buffers[worker.used++];
+}
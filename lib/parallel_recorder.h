@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class JobSystem;
+
+// Records secondary command buffers as jobs. Every worker has its own command pool for each frame slot,
+// so no pool is touched by two threads and a slot can be reset while the GPU uses the others.
+class ParallelRecorder {
+public:
+    using RecordFn = std::function<void(VkCommandBuffer)>;
+
+    struct Job {
+        // the secondary continues a dynamic rendering scope with these attachment formats
+        VkCommandBufferInheritanceRenderingInfo renderingInfo;
+        RecordFn                                record;
+    };
+
+    ParallelRecorder(JobSystem& jobSystem, VkDevice device, uint32_t queueFamilyIdx, uint32_t frameSlotCount);
+
+    // Resets the pools of the slot, the GPU must be done with the command buffers recorded into it.
+    void BeginFrame(uint32_t frameSlot);
+
+    // Returns the recorded secondaries in job order, has to be called from a worker of the job system.
+    std::vector<VkCommandBuffer> Record(const std::vector<Job>& jobs);
+
+    void Destroy();
+
+    uint32_t workerCount() const { return m_workerCount; }
+
+private:
+    struct WorkerPool {
+        VkCommandPool                pool;
+        std::vector<VkCommandBuffer> buffers;
+        uint32_t                     used;
+    };
+
+    VkCommandBuffer RecordJob(const Job& job, uint32_t workerIdx);
+    VkCommandBuffer AcquireBuffer(uint32_t workerIdx);
+
+    JobSystem&                           m_jobSystem;
+    VkDevice                             m_device;
+    uint32_t                             m_workerCount;
+    uint32_t                             m_frameSlot = 0;
+    std::vector<std::vector<WorkerPool>> m_pools; // [frame slot][worker]
+};
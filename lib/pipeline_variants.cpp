@@ -0,0 +1,44 @@
+#include "pipeline_variants.h"
+
+Specialization::Specialization(const ShaderVariant& variant)
+{
+    m_entries.reserve(variant.values.size());
+    for (uint32_t id = 0; id < variant.values.size(); id++) {
+        m_entries.push_back({
+            .constantID = id,
+            .offset     = id * static_cast<uint32_t>(sizeof(uint32_t)),
+            .size       = sizeof(uint32_t),
+        });
+    }
+
+    m_info = {
+        .mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+        .pMapEntries   = m_entries.data(),
+        .dataSize      = variant.values.size() * sizeof(uint32_t),
+        .pData         = variant.values.data(),
+    };
+}
+
+VkPipeline PipelineVariantCache::Get(const ShaderVariant& variant, const CreateFn& create)
+{
+    auto it = m_pipelines.find(variant);
+    if (it != m_pipelines.end()) {
+        return it->second;
+    }
+
+    const Specialization specialization(variant);
+    const VkPipeline     pipeline = create(specialization.info());
+    // a failed creation is not cached, the next Get tries again
+    if (pipeline != VK_NULL_HANDLE) {
+        m_pipelines.emplace(variant, pipeline);
+    }
+    return pipeline;
+}
+
+void PipelineVariantCache::Clear(const VkDevice device)
+{
+    for (const auto& [variant, pipeline] : m_pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    m_pipelines.clear();
+}
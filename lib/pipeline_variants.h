@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// The values of the specialization constants of one shader variant, constant_id i gets values[i]. Every constant
+// is 32 bits, so uint, int and bool constants all fit. Ids a shader doesn't declare are ignored by it.
+struct ShaderVariant {
+    std::vector<uint32_t> values;
+
+    bool operator<(const ShaderVariant& other) const { return values < other.values; }
+    bool operator==(const ShaderVariant& other) const { return values == other.values; }
+};
+
+// The specialization info of a variant, it points into the variant, which has to outlive it.
+class Specialization {
+public:
+    explicit Specialization(const ShaderVariant& variant);
+
+    Specialization(const Specialization&)            = delete;
+    Specialization& operator=(const Specialization&) = delete;
+
+    const VkSpecializationInfo* info() const { return &m_info; }
+
+private:
+    std::vector<VkSpecializationMapEntry> m_entries;
+    VkSpecializationInfo                  m_info;
+};
+
+// The pipelines of one shader setup, one per variant that was asked for. A variant is created the first time it
+// is used and kept until Clear, so switching back and forth is only picking a handle and the pipeline of the
+// previous variant can still be in flight.
+class PipelineVariantCache {
+public:
+    using CreateFn = std::function<VkPipeline(const VkSpecializationInfo* specInfo)>;
+
+    VkPipeline Get(const ShaderVariant& variant, const CreateFn& create);
+
+    // the GPU must be done with every pipeline of the cache
+    void Clear(VkDevice device);
+
+    size_t size() const { return m_pipelines.size(); }
+
+private:
+    std::map<ShaderVariant, VkPipeline> m_pipelines;
+};
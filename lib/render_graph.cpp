@@ -0,0 +1,504 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "render_targets.h"
+#include "texture.h"
+
+namespace {
+
+struct UsageInfo {
+    VkImageLayout         layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2        readAccess;
+    VkAccessFlags2        writeAccess;
+};
+
+UsageInfo GetUsageInfo(RenderGraph::Usage usage)
+{
+    switch (usage) {
+    case RenderGraph::Usage::ColorAttachment:
+        return {
+            .layout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .stages      = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .readAccess  = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+            .writeAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        };
+    case RenderGraph::Usage::DepthAttachment:
+        // the depth test reads even when the pass only "writes" the depth
+        return {
+            .layout      = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .stages      = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            .readAccess  = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            .writeAccess = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        };
+    case RenderGraph::Usage::SampledFragment:
+        return {
+            .layout      = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .stages      = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            .readAccess  = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            .writeAccess = VK_ACCESS_2_NONE,
+        };
+    case RenderGraph::Usage::SampledCompute:
+        return {
+            .layout      = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .stages      = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .readAccess  = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            .writeAccess = VK_ACCESS_2_NONE,
+        };
+    case RenderGraph::Usage::StorageCompute:
+        return {
+            .layout      = VK_IMAGE_LAYOUT_GENERAL,
+            .stages      = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .readAccess  = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            .writeAccess = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        };
+    }
+
+    assert(false);
+    return {};
+}
+
+VkImageAspectFlags AspectFromFormat(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+bool Contains(const std::vector<RenderGraph::Access>& accesses, RenderGraph::ResourceId id)
+{
+    return std::any_of(accesses.begin(), accesses.end(),
+                       [id](const RenderGraph::Access& access) { return access.id == id; });
+}
+
+} // anonymous namespace
+
+RenderGraph::ResourceId RenderGraph::ImportTexture(const std::string& name, const Texture* texture, bool transient)
+{
+    ResourceId id = ImportImage(name, texture->image(), AspectFromFormat(texture->format()));
+
+    m_resources[id].texture   = texture;
+    m_resources[id].transient = transient;
+    return id;
+}
+
+RenderGraph::ResourceId RenderGraph::ImportImage(const std::string& name, VkImage image, VkImageAspectFlags aspect)
+{
+    m_resources.push_back({
+        .name          = name,
+        .image         = image,
+        .aspect        = aspect,
+        .texture       = nullptr,
+        .transient     = false,
+        .output        = false,
+        .finalLayout   = VK_IMAGE_LAYOUT_UNDEFINED,
+        .preserved     = false,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .firstPass     = -1,
+        .lastPass      = -1,
+    });
+
+    return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+void RenderGraph::SetImage(ResourceId id, VkImage image)
+{
+    m_resources[id].image = image;
+}
+
+void RenderGraph::MarkOutput(ResourceId id, VkImageLayout finalLayout)
+{
+    m_resources[id].output      = true;
+    m_resources[id].finalLayout = finalLayout;
+}
+
+void RenderGraph::PreserveContent(ResourceId id, VkImageLayout initialLayout)
+{
+    assert(!m_resources[id].transient);
+    m_resources[id].preserved     = true;
+    m_resources[id].initialLayout = initialLayout;
+}
+
+void RenderGraph::AddPass(const std::string&  name,
+                          std::vector<Access> reads,
+                          std::vector<Access> writes,
+                          ExecuteFn           execute)
+{
+    m_passes.push_back({
+        .name    = name,
+        .reads   = std::move(reads),
+        .writes  = std::move(writes),
+        .execute = std::move(execute),
+    });
+}
+
+std::vector<uint32_t> RenderGraph::SortPasses() const
+{
+    const uint32_t                     passCount = static_cast<uint32_t>(m_passes.size());
+    std::vector<std::vector<uint32_t>> edges(passCount);
+    std::vector<uint32_t>              inDegree(passCount, 0);
+
+    auto addEdge = [&](uint32_t from, uint32_t to) {
+        if (from == to || std::find(edges[from].begin(), edges[from].end(), to) != edges[from].end()) {
+            return;
+        }
+        edges[from].push_back(to);
+        inDegree[to]++;
+    };
+
+    // writers of a resource stay in declaration order, and every reader comes after all of them
+    for (ResourceId id = 0; id < m_resources.size(); id++) {
+        std::vector<uint32_t> writers;
+        std::vector<uint32_t> readers;
+        for (uint32_t passIdx = 0; passIdx < passCount; passIdx++) {
+            if (Contains(m_passes[passIdx].writes, id)) {
+                writers.push_back(passIdx);
+            } else if (Contains(m_passes[passIdx].reads, id)) {
+                readers.push_back(passIdx);
+            }
+        }
+
+        for (size_t idx = 1; idx < writers.size(); idx++) {
+            addEdge(writers[idx - 1], writers[idx]);
+        }
+        for (uint32_t writer : writers) {
+            for (uint32_t reader : readers) {
+                addEdge(writer, reader);
+            }
+        }
+    }
+
+    std::vector<uint32_t> order;
+    std::vector<bool>     scheduled(passCount, false);
+    while (order.size() < passCount) {
+        // the first ready pass in declaration order, keeps the result stable
+        uint32_t next = UINT32_MAX;
+        for (uint32_t passIdx = 0; passIdx < passCount; passIdx++) {
+            if (!scheduled[passIdx] && inDegree[passIdx] == 0) {
+                next = passIdx;
+                break;
+            }
+        }
+        assert(next != UINT32_MAX && "render graph has a cycle");
+        if (next == UINT32_MAX) {
+            break;
+        }
+
+        scheduled[next] = true;
+        order.push_back(next);
+        for (uint32_t to : edges[next]) {
+            inDegree[to]--;
+        }
+    }
+
+    return order;
+}
+
+std::vector<uint32_t> RenderGraph::CullPasses(const std::vector<uint32_t>& order) const
+{
+    std::vector<bool> needed(m_resources.size(), false);
+    for (ResourceId id = 0; id < m_resources.size(); id++) {
+        needed[id] = m_resources[id].output;
+    }
+
+    std::vector<uint32_t> live;
+    for (auto it = order.rbegin(); it != order.rend(); it++) {
+        const Pass& pass = m_passes[*it];
+
+        // passes without any declared output can't be reasoned about, keep them
+        bool isLive = pass.writes.empty();
+        for (const Access& write : pass.writes) {
+            isLive |= needed[write.id];
+        }
+
+        if (!isLive) {
+            printf("RenderGraph: culled pass '%s'\n", pass.name.c_str());
+            continue;
+        }
+
+        // anything written here without being read was not needed from the earlier passes
+        for (const Access& write : pass.writes) {
+            if (!Contains(pass.reads, write.id)) {
+                needed[write.id] = false;
+            }
+        }
+        for (const Access& read : pass.reads) {
+            needed[read.id] = true;
+        }
+
+        live.push_back(*it);
+    }
+
+    std::reverse(live.begin(), live.end());
+    return live;
+}
+
+void RenderGraph::Compile()
+{
+    m_compiled.clear();
+    m_finalBarriers.clear();
+    m_barrierCount = 0;
+
+    const std::vector<uint32_t> order = CullPasses(SortPasses());
+
+    for (Resource& resource : m_resources) {
+        resource.firstPass = -1;
+        resource.lastPass  = -1;
+    }
+
+    for (uint32_t idx = 0; idx < order.size(); idx++) {
+        const Pass& pass = m_passes[order[idx]];
+        for (const std::vector<Access>* accesses : {&pass.reads, &pass.writes}) {
+            for (const Access& access : *accesses) {
+                Resource& resource = m_resources[access.id];
+                if (resource.firstPass < 0) {
+                    resource.firstPass = static_cast<int32_t>(idx);
+                }
+                resource.lastPass = static_cast<int32_t>(idx);
+            }
+        }
+    }
+
+    // Stages of the last use in the frame, the first use in the next frame has to wait for these. When the last use
+    // wrote, its writes also have to be made available before a layout transition or another write. A last use
+    // that only reads was given the writes before it with a barrier already.
+    std::vector<VkPipelineStageFlags2> lastUseStages(m_resources.size(), VK_PIPELINE_STAGE_2_NONE);
+    std::vector<VkAccessFlags2>        lastUseWrites(m_resources.size(), VK_ACCESS_2_NONE);
+    for (ResourceId id = 0; id < m_resources.size(); id++) {
+        if (m_resources[id].lastPass < 0) {
+            continue;
+        }
+        const Pass& pass = m_passes[order[m_resources[id].lastPass]];
+        for (const std::vector<Access>* accesses : {&pass.reads, &pass.writes}) {
+            for (const Access& access : *accesses) {
+                if (access.id == id) {
+                    lastUseStages[id] |= GetUsageInfo(access.usage).stages;
+                }
+            }
+        }
+        for (const Access& write : pass.writes) {
+            if (write.id == id) {
+                lastUseWrites[id] |= GetUsageInfo(write.usage).writeAccess;
+            }
+        }
+    }
+
+    struct State {
+        VkImageLayout         layout;
+        VkPipelineStageFlags2 writeStages;
+        VkAccessFlags2        writeAccess;
+        VkPipelineStageFlags2 readStages;
+        VkPipelineStageFlags2 visibleStages;
+        bool                  used;
+    };
+    std::vector<State> states(m_resources.size(), {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0, false});
+
+    for (uint32_t idx = 0; idx < order.size(); idx++) {
+        const Pass&  pass     = m_passes[order[idx]];
+        CompiledPass compiled = {.passIdx = order[idx], .barriers = {}};
+
+        // a resource that is both read and written counts as a single write access
+        std::vector<std::pair<Access, bool>> accesses;
+        for (const Access& write : pass.writes) {
+            accesses.push_back({write, true});
+        }
+        for (const Access& read : pass.reads) {
+            if (!Contains(pass.writes, read.id)) {
+                accesses.push_back({read, false});
+            }
+        }
+
+        for (const auto& [access, write] : accesses) {
+            const UsageInfo info     = GetUsageInfo(access.usage);
+            const Resource& resource = m_resources[access.id];
+            State&          state    = states[access.id];
+
+            Barrier barrier = {
+                .id            = access.id,
+                .srcStageMask  = VK_PIPELINE_STAGE_2_NONE,
+                .srcAccessMask = VK_ACCESS_2_NONE,
+                .dstStageMask  = info.stages,
+                .dstAccessMask = write ? info.writeAccess : info.readAccess,
+                .oldLayout     = state.layout,
+                .newLayout     = info.layout,
+            };
+
+            bool needed = true;
+            if (!state.used && resource.preserved) {
+                // the previous frame made its writes visible already, only a layout change or an overwrite
+                // has to wait for its last use and make the writes of that available
+                barrier.oldLayout     = resource.initialLayout;
+                barrier.srcStageMask  = lastUseStages[access.id];
+                needed                = write || resource.initialLayout != info.layout;
+                barrier.srcAccessMask = needed ? lastUseWrites[access.id] : VK_ACCESS_2_NONE;
+            } else if (!state.used) {
+                // content from the previous frame is discarded, its last use has to finish and its writes have to
+                // be available before the layout transition writes the image
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+                barrier.srcStageMask  = lastUseStages[access.id];
+                barrier.srcAccessMask = lastUseWrites[access.id];
+
+                // the memory might have been used by a transient resource which is already dead, or by one living
+                // later in the previous frame, which can still be in flight
+                if (resource.transient) {
+                    for (ResourceId other = 0; other < m_resources.size(); other++) {
+                        if (other != access.id && m_resources[other].transient && m_resources[other].lastPass >= 0 &&
+                            (m_resources[other].lastPass < static_cast<int32_t>(idx) ||
+                             m_resources[other].firstPass > static_cast<int32_t>(idx))) {
+                            barrier.srcStageMask |= lastUseStages[other];
+                            barrier.srcAccessMask |= lastUseWrites[other];
+                        }
+                    }
+                }
+            } else if (state.layout != info.layout) {
+                barrier.srcStageMask  = state.writeStages | state.readStages;
+                barrier.srcAccessMask = state.writeAccess;
+            } else if (state.writeAccess != VK_ACCESS_2_NONE &&
+                       (write || (state.visibleStages & info.stages) != info.stages)) {
+                barrier.srcStageMask  = state.writeStages | (write ? state.readStages : VK_PIPELINE_STAGE_2_NONE);
+                barrier.srcAccessMask = state.writeAccess;
+            } else if (write && state.readStages != VK_PIPELINE_STAGE_2_NONE) {
+                // write after read, execution dependency is enough
+                barrier.srcStageMask = state.readStages;
+            } else {
+                needed = false;
+            }
+
+            if (needed) {
+                compiled.barriers.push_back(barrier);
+            }
+
+            state.used   = true;
+            state.layout = info.layout;
+            if (write) {
+                state.writeStages   = info.stages;
+                state.writeAccess   = info.writeAccess;
+                state.readStages    = VK_PIPELINE_STAGE_2_NONE;
+                state.visibleStages = VK_PIPELINE_STAGE_2_NONE;
+            } else {
+                state.readStages |= info.stages;
+                if (needed) {
+                    state.visibleStages |= info.stages;
+                }
+            }
+        }
+
+        m_barrierCount += static_cast<uint32_t>(compiled.barriers.size());
+        m_compiled.push_back(std::move(compiled));
+    }
+
+    for (ResourceId id = 0; id < m_resources.size(); id++) {
+        const Resource& resource = m_resources[id];
+        const State&    state    = states[id];
+        if (!resource.output || !state.used || resource.finalLayout == state.layout) {
+            continue;
+        }
+
+        m_finalBarriers.push_back({
+            .id            = id,
+            .srcStageMask  = state.writeStages | state.readStages,
+            .srcAccessMask = state.writeAccess,
+            .dstStageMask  = VK_PIPELINE_STAGE_2_NONE,
+            .dstAccessMask = VK_ACCESS_2_NONE,
+            .oldLayout     = state.layout,
+            .newLayout     = resource.finalLayout,
+        });
+    }
+    m_barrierCount += static_cast<uint32_t>(m_finalBarriers.size());
+}
+
+void RenderGraph::Execute(const VkCommandBuffer cmdBuffer) const
+{
+    for (const CompiledPass& compiled : m_compiled) {
+        EmitBarriers(compiled.barriers, cmdBuffer);
+        m_passes[compiled.passIdx].execute(cmdBuffer);
+    }
+
+    EmitBarriers(m_finalBarriers, cmdBuffer);
+}
+
+void RenderGraph::Reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_compiled.clear();
+    m_finalBarriers.clear();
+    m_barrierCount = 0;
+}
+
+void RenderGraph::ApplyLifetimes(RenderTargetAllocator& allocator) const
+{
+    for (const Resource& resource : m_resources) {
+        if (resource.transient && resource.texture != nullptr && resource.firstPass >= 0) {
+            allocator.SetLifetime(resource.texture, resource.firstPass, resource.lastPass);
+        }
+    }
+}
+
+bool RenderGraph::IsPassActive(const std::string& name) const
+{
+    return std::any_of(m_compiled.begin(), m_compiled.end(),
+                       [&](const CompiledPass& compiled) { return m_passes[compiled.passIdx].name == name; });
+}
+
+void RenderGraph::EmitBarriers(const std::vector<Barrier>& barriers, const VkCommandBuffer cmdBuffer) const
+{
+    if (barriers.empty()) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier2> imageBarriers;
+    imageBarriers.reserve(barriers.size());
+    for (const Barrier& barrier : barriers) {
+        const Resource& resource = m_resources[barrier.id];
+
+        imageBarriers.push_back({
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .pNext               = nullptr,
+            .srcStageMask        = barrier.srcStageMask,
+            .srcAccessMask       = barrier.srcAccessMask,
+            .dstStageMask        = barrier.dstStageMask,
+            .dstAccessMask       = barrier.dstAccessMask,
+            .oldLayout           = barrier.oldLayout,
+            .newLayout           = barrier.newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = resource.image,
+            .subresourceRange =
+                {
+                    .aspectMask     = resource.aspect,
+                    .baseMipLevel   = 0,
+                    .levelCount     = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount     = 1,
+                },
+        });
+    }
+
+    const VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = static_cast<uint32_t>(imageBarriers.size()),
+        .pImageMemoryBarriers     = imageBarriers.data(),
+    };
+
+    vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class Texture;
+class RenderTargetAllocator;
+
+// Small frame graph: passes declare which images they read and write, the graph sorts them,
+// drops the ones nobody consumes and records the barriers between them.
+class RenderGraph {
+public:
+    using ResourceId = uint32_t;
+    using ExecuteFn  = std::function<void(VkCommandBuffer)>;
+
+    enum class Usage {
+        ColorAttachment,
+        DepthAttachment,
+        SampledFragment,
+        SampledCompute,
+        StorageCompute,
+    };
+
+    struct Access {
+        ResourceId id;
+        Usage      usage;
+    };
+
+    // Transient resources don't keep their content between frames and may share memory with each other.
+    ResourceId ImportTexture(const std::string& name, const Texture* texture, bool transient);
+    ResourceId ImportImage(const std::string& name, VkImage image, VkImageAspectFlags aspect);
+    void       SetImage(ResourceId id, VkImage image);
+
+    // Outputs keep the passes writing them alive and are moved into finalLayout at the end of the frame.
+    void MarkOutput(ResourceId id, VkImageLayout finalLayout);
+
+    // The content of the previous frame is kept, the image has to be in initialLayout when the frame starts.
+    // For history buffers that are read before they are written, like the ones of a temporal resolve.
+    void PreserveContent(ResourceId id, VkImageLayout initialLayout);
+
+    void AddPass(const std::string&   name,
+                 std::vector<Access> reads,
+                 std::vector<Access> writes,
+                 ExecuteFn           execute);
+
+    void Compile();
+    void Execute(VkCommandBuffer cmdBuffer) const;
+    void Reset();
+
+    // Hands the computed lifetimes of the transient textures to the allocator, call after Compile().
+    void ApplyLifetimes(RenderTargetAllocator& allocator) const;
+
+    bool     IsPassActive(const std::string& name) const;
+    uint32_t barrierCount() const { return m_barrierCount; }
+
+private:
+    struct Resource {
+        std::string        name;
+        VkImage            image;
+        VkImageAspectFlags aspect;
+        const Texture*     texture;
+        bool               transient;
+        bool               output;
+        VkImageLayout      finalLayout;
+        bool               preserved;
+        VkImageLayout      initialLayout;
+
+        // filled by Compile
+        int32_t firstPass;
+        int32_t lastPass;
+    };
+
+    struct Pass {
+        std::string         name;
+        std::vector<Access> reads;
+        std::vector<Access> writes;
+        ExecuteFn           execute;
+    };
+
+    struct Barrier {
+        ResourceId            id;
+        VkPipelineStageFlags2 srcStageMask;
+        VkAccessFlags2        srcAccessMask;
+        VkPipelineStageFlags2 dstStageMask;
+        VkAccessFlags2        dstAccessMask;
+        VkImageLayout         oldLayout;
+        VkImageLayout         newLayout;
+    };
+
+    struct CompiledPass {
+        uint32_t             passIdx;
+        std::vector<Barrier> barriers;
+    };
+
+    std::vector<uint32_t> SortPasses() const;
+    std::vector<uint32_t> CullPasses(const std::vector<uint32_t>& order) const;
+    void                  EmitBarriers(const std::vector<Barrier>& barriers, VkCommandBuffer cmdBuffer) const;
+
+    std::vector<Resource>     m_resources;
+    std::vector<Pass>         m_passes;
+    std::vector<CompiledPass> m_compiled;
+    std::vector<Barrier>      m_finalBarriers;
+    uint32_t                  m_barrierCount = 0;
+};
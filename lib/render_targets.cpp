@@ -0,0 +1,289 @@
+#include "render_targets.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "../HF1/debug.h"
+#include "texture.h"
+
+namespace {
+constexpr VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                               VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+// only these can have TRANSIENT_ATTACHMENT usage and lazily allocated memory
+bool IsAttachmentOnly(const VkImageUsageFlags usage)
+{
+    return (usage & ~ATTACHMENT_USAGE) == 0;
+}
+} // namespace
+
+RenderTargetAllocator::RenderTargetAllocator(const VkPhysicalDevice phyDevice, const VkDevice device)
+    : m_phyDevice(phyDevice)
+    , m_device(device)
+    , m_memoryProperties{}
+{
+    vkGetPhysicalDeviceMemoryProperties(m_phyDevice, &m_memoryProperties);
+}
+
+Texture* RenderTargetAllocator::Create(const RenderTargetDesc& desc)
+{
+    Target target = {
+        .texture      = nullptr,
+        .desc         = desc,
+        .requirements = {},
+        .block        = -1,
+        .bound        = false,
+    };
+
+    if (!desc.transient) {
+        target.texture = Texture::Create2D(m_phyDevice, m_device, desc.format, desc.extent, desc.usage, desc.samples);
+        target.bound   = true;
+        vkGetImageMemoryRequirements(m_device, target.texture->image(), &target.requirements);
+        debug::SetDebugObjectName(m_device, VK_OBJECT_TYPE_IMAGE, (uint64_t)target.texture->image(), desc.name.c_str());
+
+        m_targets.push_back(target);
+        return target.texture;
+    }
+
+    const VkImageUsageFlags usage =
+        IsAttachmentOnly(desc.usage) ? desc.usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : desc.usage;
+
+    target.texture  = new Texture(desc.format, desc.extent.width, desc.extent.height);
+    VkResult result = target.texture->CreateImageHandle(m_device, usage, desc.samples, 1);
+    assert(result == VK_SUCCESS);
+
+    vkGetImageMemoryRequirements(m_device, target.texture->m_image, &target.requirements);
+    debug::SetDebugObjectName(m_device, VK_OBJECT_TYPE_IMAGE, (uint64_t)target.texture->m_image, desc.name.c_str());
+
+    m_targets.push_back(target);
+    return target.texture;
+}
+
+void RenderTargetAllocator::SetLifetime(const Texture* target, uint32_t firstPass, uint32_t lastPass)
+{
+    for (Target& entry : m_targets) {
+        if (entry.texture == target) {
+            // a graph rebuilt without recreating the target gives it the range it is bound with
+            if (entry.desc.firstPass == firstPass && entry.desc.lastPass == lastPass) {
+                return;
+            }
+            // changing the lifetime after binding could make two live targets share memory
+            assert(!entry.bound || !entry.desc.transient);
+            entry.desc.firstPass = firstPass;
+            entry.desc.lastPass  = lastPass;
+            return;
+        }
+    }
+}
+
+VkResult RenderTargetAllocator::Allocate()
+{
+    std::vector<uint32_t> pending;
+    for (uint32_t idx = 0; idx < m_targets.size(); idx++) {
+        if (!m_targets[idx].bound) {
+            pending.push_back(idx);
+        }
+    }
+
+    // biggest first, so the smaller ones can fit into the blocks created by them
+    std::sort(pending.begin(), pending.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return m_targets[lhs].requirements.size > m_targets[rhs].requirements.size;
+    });
+
+    for (uint32_t idx : pending) {
+        Target& target = m_targets[idx];
+
+        const uint32_t lazyTypeIdx =
+            IsAttachmentOnly(target.desc.usage)
+                ? FindMemoryType(target.requirements.memoryTypeBits,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+                : UINT32_MAX;
+
+        if (lazyTypeIdx != UINT32_MAX) {
+            // tilers keep these in on-chip memory, sharing would only complicate things
+            target.block = AllocateBlock(target.requirements.size, lazyTypeIdx, true, target.desc.name);
+        } else {
+            target.block = -1;
+            for (uint32_t blockIdx = 0; blockIdx < m_blocks.size(); blockIdx++) {
+                if (CanShare(m_blocks[blockIdx], blockIdx, target)) {
+                    target.block = static_cast<int32_t>(blockIdx);
+                    break;
+                }
+            }
+
+            if (target.block < 0) {
+                const uint32_t typeIdx =
+                    FindMemoryType(target.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                target.block = AllocateBlock(target.requirements.size, typeIdx, false, target.desc.name);
+            }
+        }
+
+        if (target.block < 0) {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+
+        MemoryBlock& block = m_blocks[target.block];
+        block.users++;
+
+        // every user of a block sits at offset 0, this is fine as long as their lifetimes don't overlap
+        VkResult result = vkBindImageMemory(m_device, target.texture->m_image, block.memory, 0);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        target.bound = true;
+        CreateViews(target);
+    }
+
+    if (!pending.empty()) {
+        printf("Render targets: %zu targets, %.2f MiB requested, %.2f MiB allocated\n", m_targets.size(),
+               requestedBytes() / (1024.0 * 1024.0), allocatedBytes() / (1024.0 * 1024.0));
+    }
+
+    return VK_SUCCESS;
+}
+
+void RenderTargetAllocator::Release(Texture* target)
+{
+    for (auto it = m_targets.begin(); it != m_targets.end(); it++) {
+        if (it->texture != target) {
+            continue;
+        }
+
+        it->texture->Destroy(m_device);
+        delete it->texture;
+
+        if (it->block >= 0) {
+            MemoryBlock& block = m_blocks[it->block];
+            if (--block.users == 0) {
+                vkFreeMemory(m_device, block.memory, nullptr);
+                block.memory = VK_NULL_HANDLE;
+            }
+        }
+
+        m_targets.erase(it);
+        return;
+    }
+}
+
+void RenderTargetAllocator::Destroy()
+{
+    for (Target& target : m_targets) {
+        target.texture->Destroy(m_device);
+        delete target.texture;
+    }
+    m_targets.clear();
+
+    for (MemoryBlock& block : m_blocks) {
+        vkFreeMemory(m_device, block.memory, nullptr);
+    }
+    m_blocks.clear();
+}
+
+VkDeviceSize RenderTargetAllocator::requestedBytes() const
+{
+    VkDeviceSize size = 0;
+    for (const Target& target : m_targets) {
+        size += target.requirements.size;
+    }
+    return size;
+}
+
+VkDeviceSize RenderTargetAllocator::allocatedBytes() const
+{
+    VkDeviceSize size = 0;
+    for (const Target& target : m_targets) {
+        if (target.block < 0) {
+            size += target.requirements.size;
+        }
+    }
+
+    for (const MemoryBlock& block : m_blocks) {
+        if (block.memory != VK_NULL_HANDLE && !block.lazy) {
+            size += block.size;
+        }
+    }
+    return size;
+}
+
+uint32_t RenderTargetAllocator::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const
+{
+    for (uint32_t idx = 0; idx < m_memoryProperties.memoryTypeCount; idx++) {
+        if ((typeBits & (1u << idx)) && (m_memoryProperties.memoryTypes[idx].propertyFlags & flags) == flags) {
+            return idx;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+bool RenderTargetAllocator::CanShare(const MemoryBlock& block, uint32_t blockIdx, const Target& target) const
+{
+    if (block.memory == VK_NULL_HANDLE || block.lazy || block.size < target.requirements.size) {
+        return false;
+    }
+
+    if ((target.requirements.memoryTypeBits & (1u << block.memoryTypeIdx)) == 0) {
+        return false;
+    }
+
+    for (const Target& other : m_targets) {
+        if (!other.bound || other.block != static_cast<int32_t>(blockIdx)) {
+            continue;
+        }
+
+        const bool disjoint =
+            other.desc.lastPass < target.desc.firstPass || target.desc.lastPass < other.desc.firstPass;
+        if (!disjoint) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int32_t RenderTargetAllocator::AllocateBlock(VkDeviceSize      size,
+                                             uint32_t          memoryTypeIdx,
+                                             bool              lazy,
+                                             const std::string& name)
+{
+    if (memoryTypeIdx == UINT32_MAX) {
+        return -1;
+    }
+
+    const VkMemoryAllocateInfo allocInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext           = nullptr,
+        .allocationSize  = size,
+        .memoryTypeIndex = memoryTypeIdx,
+    };
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        return -1;
+    }
+
+    const std::string memoryName = "RenderTarget memory (" + name + ")";
+    debug::SetDebugObjectName(m_device, VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)memory, memoryName.c_str());
+
+    m_blocks.push_back({
+        .memory        = memory,
+        .size          = size,
+        .memoryTypeIdx = memoryTypeIdx,
+        .lazy          = lazy,
+        .users         = 0,
+    });
+
+    return static_cast<int32_t>(m_blocks.size() - 1);
+}
+
+void RenderTargetAllocator::CreateViews(Target& target)
+{
+    target.texture->m_view = Create2DImageView(m_device, target.desc.format, target.texture->m_image);
+    // like Texture::Create2D does for a persistent one
+    if ((target.desc.usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0) {
+        target.texture->Create2DSampler(m_device, false);
+    }
+}
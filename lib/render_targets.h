@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class Texture;
+
+struct RenderTargetDesc {
+    std::string           name;
+    VkFormat              format;
+    VkExtent2D            extent;
+    VkImageUsageFlags     usage;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Transient targets are only alive between firstPass and lastPass (inclusive) of a frame.
+    // They get TRANSIENT_ATTACHMENT usage and lazily allocated memory where the device has it,
+    // otherwise they share memory with other transient targets whose pass ranges don't overlap.
+    // Transient targets that are also sampled or storage images keep their usage and only share.
+    // The range is usually filled in by RenderGraph::ApplyLifetimes.
+    bool     transient = false;
+    uint32_t firstPass = 0;
+    uint32_t lastPass  = 0;
+};
+
+// Owns every attachment of the frame. Render targets are always single mip level.
+class RenderTargetAllocator {
+public:
+    RenderTargetAllocator(VkPhysicalDevice phyDevice, VkDevice device);
+
+    // Persistent targets are usable right away, transient ones only after Allocate().
+    Texture* Create(const RenderTargetDesc& desc);
+    void     SetLifetime(const Texture* target, uint32_t firstPass, uint32_t lastPass);
+    VkResult Allocate();
+    void     Release(Texture* target);
+    void     Destroy();
+
+    VkDeviceSize requestedBytes() const;
+    VkDeviceSize allocatedBytes() const;
+
+private:
+    struct Target {
+        Texture*             texture;
+        RenderTargetDesc     desc;
+        VkMemoryRequirements requirements;
+        int32_t              block;
+        bool                 bound;
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory;
+        VkDeviceSize   size;
+        uint32_t       memoryTypeIdx;
+        bool           lazy;
+        uint32_t       users;
+    };
+
+    uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const;
+    bool     CanShare(const MemoryBlock& block, uint32_t blockIdx, const Target& target) const;
+    int32_t  AllocateBlock(VkDeviceSize size, uint32_t memoryTypeIdx, bool lazy, const std::string& name);
+    void     CreateViews(Target& target);
+
+    VkPhysicalDevice                 m_phyDevice;
+    VkDevice                         m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+
+    std::vector<Target>      m_targets;
+    std::vector<MemoryBlock> m_blocks;
+};
@@ -0,0 +1,190 @@
+#include "shader_hot_reload.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#ifdef VKCOURSE_GLSLANG
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#endif
+
+namespace {
+// editors write a file in more than one go, a half written one fails and the next write compiles again
+constexpr std::chrono::milliseconds POLL_INTERVAL(250);
+
+const char* const SOURCE_EXTENSIONS[] = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"};
+
+bool IsShaderSource(const std::filesystem::path& path)
+{
+    const std::string extension = path.extension().string();
+    for (const char* sourceExtension : SOURCE_EXTENSIONS) {
+        if (extension == sourceExtension) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef VKCOURSE_GLSLANG
+EShLanguage StageOf(const std::filesystem::path& path)
+{
+    const std::string extension = path.extension().string();
+    if (extension == ".vert") {
+        return EShLangVertex;
+    } else if (extension == ".frag") {
+        return EShLangFragment;
+    } else if (extension == ".geom") {
+        return EShLangGeometry;
+    } else if (extension == ".tesc") {
+        return EShLangTessControl;
+    } else if (extension == ".tese") {
+        return EShLangTessEvaluation;
+    }
+    return EShLangCompute;
+}
+#endif
+} // namespace
+
+bool ShaderHotReload::Available()
+{
+#ifdef VKCOURSE_GLSLANG
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ShaderHotReload::Compile(const std::string& path, std::vector<uint32_t>& outSpirv, std::string& outLog)
+{
+#ifdef VKCOURSE_GLSLANG
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        outLog = "Failed to open " + path + "\n";
+        return false;
+    }
+    const std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // the environment of glslangValidator -V, the one the shaders compiled into the binary got
+    const EShLanguage stage     = StageOf(path);
+    const char*       sources[] = {source.c_str()};
+    const char*       names[]   = {path.c_str()};
+
+    glslang::TShader shader(stage);
+    shader.setStringsWithLengthsAndNames(sources, nullptr, names, 1);
+    shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, 100);
+    shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
+    shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+
+    const EShMessages messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+    if (!shader.parse(GetDefaultResources(), 100, false, messages)) {
+        outLog = shader.getInfoLog();
+        return false;
+    }
+
+    glslang::TProgram program;
+    program.addShader(&shader);
+    if (!program.link(messages)) {
+        outLog = program.getInfoLog();
+        return false;
+    }
+
+    std::vector<unsigned int> spirv;
+    glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
+    outSpirv.assign(spirv.begin(), spirv.end());
+    return true;
+#else
+    (void)path;
+    (void)outSpirv;
+    outLog = "Built without glslang\n";
+    return false;
+#endif
+}
+
+ShaderHotReload::ShaderHotReload(std::string directory)
+    : m_directory(std::move(directory))
+{
+#ifdef VKCOURSE_GLSLANG
+    glslang::InitializeProcess();
+#endif
+    Scan();
+    m_thread = std::thread(&ShaderHotReload::Run, this);
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_stopSignal.notify_one();
+    m_thread.join();
+#ifdef VKCOURSE_GLSLANG
+    glslang::FinalizeProcess();
+#endif
+}
+
+std::vector<ShaderHotReload::Result> ShaderHotReload::TakeCompiled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::exchange(m_compiled, {});
+}
+
+void ShaderHotReload::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopSignal.wait_for(lock, POLL_INTERVAL, [this] { return m_stop; })) {
+        // the main thread can take the earlier results while this one compiles
+        lock.unlock();
+
+        std::vector<Result> results;
+        for (const std::string& name : Scan()) {
+            const auto start = std::chrono::steady_clock::now();
+
+            Result result = {.name = name, .spirv = {}, .log = {}, .compileMs = 0.0};
+            if (!Compile((std::filesystem::path(m_directory) / name).string(), result.spirv, result.log)) {
+                result.spirv.clear();
+            }
+            result.compileMs =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            results.push_back(std::move(result));
+        }
+
+        lock.lock();
+        for (Result& result : results) {
+            m_compiled.push_back(std::move(result));
+        }
+    }
+}
+
+// the names of the sources written to since the last scan, the first one only records the times
+std::vector<std::string> ShaderHotReload::Scan()
+{
+    std::vector<std::string> changed;
+
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error)) {
+        // a file gone between the listing and now, like the temporary one of an editor, is skipped
+        if (!it->is_regular_file(error) || !IsShaderSource(it->path())) {
+            error.clear();
+            continue;
+        }
+
+        const std::filesystem::file_time_type writeTime = it->last_write_time(error);
+        if (error) {
+            error.clear();
+            continue;
+        }
+
+        const std::string name        = it->path().filename().string();
+        const auto [entry, firstSeen] = m_writeTimes.try_emplace(name, writeTime);
+        if (!firstSeen && entry->second != writeTime) {
+            entry->second = writeTime;
+            changed.push_back(name);
+        }
+    }
+
+    return changed;
+}
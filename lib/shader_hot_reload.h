@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches a directory of GLSL sources and compiles the ones written to on a background thread, with glslang linked
+// in as a library. The results are picked up between frames, the code goes into ShaderLibrary and the passes
+// recreate the pipelines using it. Without glslang (VKCOURSE_GLSLANG is not defined) it is not available.
+class ShaderHotReload {
+public:
+    struct Result {
+        std::string           name;  // the file name inside the directory, the key of ShaderLibrary
+        std::vector<uint32_t> spirv; // empty when the compilation failed
+        std::string           log;   // the errors of glslang
+        double                compileMs;
+    };
+
+    static bool Available();
+
+    // Compiles a GLSL file for Vulkan like glslangValidator -V, the stage comes from the extension.
+    static bool Compile(const std::string& path, std::vector<uint32_t>& outSpirv, std::string& outLog);
+
+    // the sources already there are taken as the ones compiled into the binary
+    explicit ShaderHotReload(std::string directory);
+    ~ShaderHotReload();
+
+    ShaderHotReload(const ShaderHotReload&)            = delete;
+    ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+    // the shaders compiled since the last call, the failed ones too
+    std::vector<Result> TakeCompiled();
+
+    const std::string& directory() const { return m_directory; }
+
+private:
+    void                     Run();
+    std::vector<std::string> Scan();
+
+    std::string m_directory;
+    // only touched by the watching thread after the constructor
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_writeTimes;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_stopSignal;
+    bool                    m_stop = false;
+    std::vector<Result>     m_compiled;
+    std::thread             m_thread;
+};
@@ -0,0 +1,77 @@
+#include "shader_library.h"
+
+#include "wrappers.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+ShaderLibrary& ShaderLibrary::Get()
+{
+    static ShaderLibrary library;
+    return library;
+}
+
+void ShaderLibrary::Register(const std::string& name, const uint32_t* code, const size_t sizeInBytes)
+{
+    if (!Contains(name)) {
+        m_code.emplace(name, std::vector<uint32_t>(code, code + sizeInBytes / sizeof(uint32_t)));
+    }
+}
+
+VkShaderModule ShaderLibrary::CreateModule(const VkDevice device, const std::string& name) const
+{
+    const auto it = m_code.find(name);
+    assert(it != m_code.end());
+
+    const std::vector<uint32_t>& code = it->second;
+    return CreateShaderModule(device, code.data(), static_cast<uint32_t>(code.size() * sizeof(uint32_t)));
+}
+
+PipelineReflection ShaderLibrary::Reflect(const std::initializer_list<const char*> names) const
+{
+    PipelineReflection reflection;
+
+    for (const char* name : names) {
+        const auto it = m_code.find(name);
+        assert(it != m_code.end());
+
+        const std::vector<uint32_t>& code = it->second;
+        ShaderReflection             shader;
+        std::string                  error;
+        if (!ReflectSpirv(code.data(), code.size() * sizeof(uint32_t), shader, error) ||
+            !reflection.Add(shader, error)) {
+            printf("Failed to reflect %s: %s\n", name, error.c_str());
+            exit(-1);
+        }
+    }
+
+    return reflection;
+}
+
+bool ShaderLibrary::FitsInterface(const std::string&           name,
+                                  const std::vector<uint32_t>& code,
+                                  std::string&                 error) const
+{
+    const auto it = m_code.find(name);
+    assert(it != m_code.end());
+
+    ShaderReflection current;
+    ShaderReflection replacement;
+    if (!ReflectSpirv(it->second.data(), it->second.size() * sizeof(uint32_t), current, error) ||
+        !ReflectSpirv(code.data(), code.size() * sizeof(uint32_t), replacement, error)) {
+        return false;
+    }
+    if (!replacement.FitsInto(current)) {
+        error = "its descriptor sets or push constants don't fit the pipeline layouts, restart to change them";
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> ShaderLibrary::Replace(const std::string& name, std::vector<uint32_t> code)
+{
+    std::vector<uint32_t>& current = m_code[name];
+    return std::exchange(current, std::move(code));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "spirv_reflection.h"
+
+// The SPIR-V of the shaders by the name of their source file, lightning_pass.frag and so on. The passes register
+// the code compiled into the binary and create their modules from here, so a hot reload only has to replace the
+// code and have the passes recreate their pipelines. Only used from the thread creating the pipelines.
+class ShaderLibrary {
+public:
+    static ShaderLibrary& Get();
+
+    // keeps the code it already has, a reloaded shader stays when a pass registers it again
+    void Register(const std::string& name, const uint32_t* code, size_t sizeInBytes);
+    bool Contains(const std::string& name) const { return m_code.count(name) != 0; }
+
+    VkShaderModule CreateModule(VkDevice device, const std::string& name) const;
+
+    // The interface of the stages of one pipeline, for its layout. The passes reflect the code built into the
+    // binary before any reload, so the layouts stay the ones of the embedded shaders.
+    PipelineReflection Reflect(std::initializer_list<const char*> names) const;
+
+    // False with the reason in error when the code uses a binding or push constants the shader it would replace
+    // doesn't, the pipeline layouts made for that one don't have them.
+    bool FitsInterface(const std::string& name, const std::vector<uint32_t>& code, std::string& error) const;
+
+    // returns the code it replaced, so a reload that breaks a pipeline can be undone
+    std::vector<uint32_t> Replace(const std::string& name, std::vector<uint32_t> code);
+
+private:
+    std::unordered_map<std::string, std::vector<uint32_t>> m_code;
+};
@@ -0,0 +1,439 @@
+#include "spirv_reflection.h"
+
+#include "descriptors.h"
+#include "wrappers.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+// the part of the SPIR-V specification the reflection needs
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+enum Op : uint32_t {
+    OpEntryPoint       = 15,
+    OpTypeInt          = 21,
+    OpTypeFloat        = 22,
+    OpTypeVector       = 23,
+    OpTypeMatrix       = 24,
+    OpTypeImage        = 25,
+    OpTypeSampler      = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray        = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct       = 30,
+    OpTypePointer      = 32,
+    OpConstant         = 43,
+    OpSpecConstant     = 50,
+    OpVariable         = 59,
+    OpDecorate         = 71,
+    OpMemberDecorate   = 72,
+};
+
+enum Decoration : uint32_t {
+    DecorationBufferBlock   = 3,
+    DecorationArrayStride   = 6,
+    DecorationMatrixStride  = 7,
+    DecorationBinding       = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset        = 35,
+};
+
+enum StorageClass : uint32_t {
+    StorageClassUniformConstant = 0,
+    StorageClassUniform         = 2,
+    StorageClassPushConstant    = 9,
+    StorageClassStorageBuffer   = 12,
+};
+
+constexpr uint32_t DIM_BUFFER       = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+struct Decorations {
+    uint32_t set         = UINT32_MAX;
+    uint32_t binding     = UINT32_MAX;
+    uint32_t arrayStride = 0;
+    bool     bufferBlock = false;
+};
+
+struct MemberDecorations {
+    uint32_t offset       = 0;
+    uint32_t matrixStride = 0;
+};
+
+struct Variable {
+    uint32_t id;
+    uint32_t pointerType;
+    uint32_t storageClass;
+};
+
+class Module {
+public:
+    bool Parse(const uint32_t* code, size_t wordCount, std::string& error);
+
+    bool Reflect(ShaderReflection& out, std::string& error) const;
+
+private:
+    bool DescriptorType(uint32_t typeId, uint32_t storageClass, VkDescriptorType& outType, std::string& error) const;
+    uint32_t SizeOf(uint32_t typeId, uint32_t matrixStride) const;
+
+    // the operands of the type declarations after the result id
+    std::unordered_map<uint32_t, std::pair<uint32_t, std::vector<uint32_t>>> m_types;
+    std::unordered_map<uint32_t, uint32_t>                                   m_constants;
+    std::unordered_map<uint32_t, Decorations>                                m_decorations;
+    std::unordered_map<uint32_t, std::vector<MemberDecorations>>             m_memberDecorations;
+    std::vector<Variable>                                                    m_variables;
+    VkShaderStageFlags                                                       m_stages = 0;
+};
+
+VkShaderStageFlags StageOf(const uint32_t executionModel)
+{
+    switch (executionModel) {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default: return 0;
+    }
+}
+
+bool Module::Parse(const uint32_t* code, const size_t wordCount, std::string& error)
+{
+    if (wordCount < 5 || code[0] != SPIRV_MAGIC) {
+        error = "not SPIR-V";
+        return false;
+    }
+
+    for (size_t at = 5; at < wordCount;) {
+        const uint32_t opcode = code[at] & 0xFFFF;
+        const uint32_t length = code[at] >> 16;
+        if (length == 0 || at + length > wordCount) {
+            error = "truncated instruction";
+            return false;
+        }
+        const uint32_t* operands     = code + at + 1;
+        const uint32_t  operandCount = length - 1;
+
+        switch (opcode) {
+        case OpEntryPoint:
+            m_stages |= StageOf(operands[0]);
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+            m_types[operands[0]] = {opcode, std::vector<uint32_t>(operands + 1, operands + operandCount)};
+            break;
+        case OpConstant:
+        case OpSpecConstant:
+            // array lengths, the default of a specialization constant is what the layout gets sized for
+            if (operandCount >= 3) {
+                m_constants[operands[1]] = operands[2];
+            }
+            break;
+        case OpVariable:
+            m_variables.push_back({.id = operands[1], .pointerType = operands[0], .storageClass = operands[2]});
+            break;
+        case OpDecorate: {
+            Decorations& decorations = m_decorations[operands[0]];
+            switch (operands[1]) {
+            case DecorationDescriptorSet: decorations.set = operands[2]; break;
+            case DecorationBinding: decorations.binding = operands[2]; break;
+            case DecorationArrayStride: decorations.arrayStride = operands[2]; break;
+            case DecorationBufferBlock: decorations.bufferBlock = true; break;
+            }
+            break;
+        }
+        case OpMemberDecorate: {
+            std::vector<MemberDecorations>& members = m_memberDecorations[operands[0]];
+            if (members.size() <= operands[1]) {
+                members.resize(operands[1] + 1);
+            }
+            if (operands[2] == DecorationOffset) {
+                members[operands[1]].offset = operands[3];
+            } else if (operands[2] == DecorationMatrixStride) {
+                members[operands[1]].matrixStride = operands[3];
+            }
+            break;
+        }
+        }
+
+        at += length;
+    }
+
+    return true;
+}
+
+bool Module::DescriptorType(const uint32_t    typeId,
+                            const uint32_t    storageClass,
+                            VkDescriptorType& outType,
+                            std::string&      error) const
+{
+    const auto& [opcode, operands] = m_types.at(typeId);
+
+    switch (opcode) {
+    case OpTypeSampler:
+        outType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return true;
+    case OpTypeSampledImage: {
+        const uint32_t dim = m_types.at(operands[0]).second[1];
+        outType = (dim == DIM_BUFFER) ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                                      : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return true;
+    }
+    case OpTypeImage: {
+        // sampled type, dim, depth, arrayed, multisampled, sampled
+        const uint32_t dim     = operands[1];
+        const bool     storage = (operands[5] == 2);
+        if (dim == DIM_SUBPASS_DATA) {
+            outType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        } else if (dim == DIM_BUFFER) {
+            outType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        } else {
+            outType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        return true;
+    }
+    case OpTypeStruct: {
+        const auto decorations = m_decorations.find(typeId);
+        const bool bufferBlock = (decorations != m_decorations.end() && decorations->second.bufferBlock);
+        if (storageClass == StorageClassStorageBuffer || bufferBlock) {
+            outType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        } else {
+            outType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        return true;
+    }
+    }
+
+    error = "unsupported resource type";
+    return false;
+}
+
+// the bytes a block member of the type covers, matrixStride is the decoration of the member
+uint32_t Module::SizeOf(const uint32_t typeId, const uint32_t matrixStride) const
+{
+    const auto& [opcode, operands] = m_types.at(typeId);
+
+    switch (opcode) {
+    case OpTypeInt:
+    case OpTypeFloat:
+        return operands[0] / 8;
+    case OpTypeVector:
+        return operands[1] * SizeOf(operands[0], 0);
+    case OpTypeMatrix:
+        return operands[1] * (matrixStride != 0 ? matrixStride : SizeOf(operands[0], 0));
+    case OpTypeArray: {
+        const auto     decorations = m_decorations.find(typeId);
+        const uint32_t stride      = (decorations != m_decorations.end() && decorations->second.arrayStride != 0)
+                                         ? decorations->second.arrayStride
+                                         : SizeOf(operands[0], matrixStride);
+        return m_constants.at(operands[1]) * stride;
+    }
+    case OpTypeStruct: {
+        const auto members = m_memberDecorations.find(typeId);
+        uint32_t   end     = 0;
+        for (uint32_t member = 0; member < operands.size(); member++) {
+            MemberDecorations decorations;
+            if (members != m_memberDecorations.end() && member < members->second.size()) {
+                decorations = members->second[member];
+            }
+            end = std::max(end, decorations.offset + SizeOf(operands[member], decorations.matrixStride));
+        }
+        return end;
+    }
+    }
+
+    // runtime arrays have no size, they are never in push constants
+    return 0;
+}
+
+bool Module::Reflect(ShaderReflection& out, std::string& error) const
+{
+    out       = {};
+    out.stage = m_stages;
+
+    for (const Variable& variable : m_variables) {
+        // the type the variable points to
+        uint32_t typeId = m_types.at(variable.pointerType).second[1];
+
+        if (variable.storageClass == StorageClassPushConstant) {
+            const auto members = m_memberDecorations.find(typeId);
+            uint32_t   offset  = UINT32_MAX;
+            if (members != m_memberDecorations.end()) {
+                for (const MemberDecorations& member : members->second) {
+                    offset = std::min(offset, member.offset);
+                }
+            }
+            offset = (offset == UINT32_MAX) ? 0 : offset;
+
+            // the range has to be a multiple of 4 bytes
+            const uint32_t end = (SizeOf(typeId, 0) + 3) & ~3u;
+            out.pushConstants  = {.stageFlags = m_stages, .offset = offset, .size = end - offset};
+            continue;
+        }
+
+        if (variable.storageClass != StorageClassUniformConstant && variable.storageClass != StorageClassUniform &&
+            variable.storageClass != StorageClassStorageBuffer) {
+            continue;
+        }
+
+        const auto decorations = m_decorations.find(variable.id);
+        if (decorations == m_decorations.end() || decorations->second.binding == UINT32_MAX) {
+            continue;
+        }
+
+        uint32_t count = 1;
+        while (m_types.at(typeId).first == OpTypeArray || m_types.at(typeId).first == OpTypeRuntimeArray) {
+            const auto& [opcode, operands] = m_types.at(typeId);
+            if (opcode == OpTypeRuntimeArray) {
+                error = "unbounded descriptor arrays are not supported";
+                return false;
+            }
+            count *= m_constants.at(operands[1]);
+            typeId = operands[0];
+        }
+
+        VkDescriptorType type;
+        if (!DescriptorType(typeId, variable.storageClass, type, error)) {
+            return false;
+        }
+
+        // without a set decoration it is set 0
+        const uint32_t set = (decorations->second.set == UINT32_MAX) ? 0 : decorations->second.set;
+        out.sets[set].push_back({
+            .binding            = decorations->second.binding,
+            .descriptorType     = type,
+            .descriptorCount    = count,
+            .stageFlags         = m_stages,
+            .pImmutableSamplers = nullptr,
+        });
+    }
+
+    for (auto& [set, bindings] : out.sets) {
+        std::sort(bindings.begin(), bindings.end(),
+                  [](const auto& a, const auto& b) { return a.binding < b.binding; });
+    }
+
+    return true;
+}
+
+bool SameBinding(const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+{
+    return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount;
+}
+} // namespace
+
+bool ShaderReflection::FitsInto(const ShaderReflection& other) const
+{
+    if (pushConstants.size != 0 &&
+        (pushConstants.offset < other.pushConstants.offset ||
+         pushConstants.offset + pushConstants.size > other.pushConstants.offset + other.pushConstants.size)) {
+        return false;
+    }
+
+    for (const auto& [set, bindings] : sets) {
+        const auto it = other.sets.find(set);
+        if (it == other.sets.end()) {
+            return false;
+        }
+        for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+            const auto found = std::find_if(it->second.begin(), it->second.end(),
+                                            [&](const auto& candidate) { return SameBinding(candidate, binding); });
+            if (found == it->second.end()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ReflectSpirv(const uint32_t* code, const size_t sizeInBytes, ShaderReflection& out, std::string& error)
+{
+    Module module;
+    return module.Parse(code, sizeInBytes / sizeof(uint32_t), error) && module.Reflect(out, error);
+}
+
+bool PipelineReflection::Add(const ShaderReflection& shader, std::string& error)
+{
+    for (const auto& [set, bindings] : shader.sets) {
+        std::map<uint32_t, VkDescriptorSetLayoutBinding>& merged = m_sets[set];
+
+        for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+            const auto [it, inserted] = merged.emplace(binding.binding, binding);
+            if (!inserted) {
+                if (!SameBinding(it->second, binding)) {
+                    error = "set " + std::to_string(set) + " binding " + std::to_string(binding.binding) +
+                            " is declared differently by the stages";
+                    return false;
+                }
+                it->second.stageFlags |= binding.stageFlags;
+            }
+        }
+    }
+
+    const VkPushConstantRange& push = shader.pushConstants;
+    if (push.size != 0) {
+        if (m_pushConstants.size == 0) {
+            m_pushConstants = push;
+        } else {
+            const uint32_t begin = std::min(m_pushConstants.offset, push.offset);
+            const uint32_t end   = std::max(m_pushConstants.offset + m_pushConstants.size, push.offset + push.size);
+
+            m_pushConstants.stageFlags |= push.stageFlags;
+            m_pushConstants.offset = begin;
+            m_pushConstants.size   = end - begin;
+        }
+    }
+
+    return true;
+}
+
+uint32_t PipelineReflection::setCount() const
+{
+    return m_sets.empty() ? 0 : m_sets.rbegin()->first + 1;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> PipelineReflection::SetBindings(const uint32_t set) const
+{
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+    const auto it = m_sets.find(set);
+    if (it != m_sets.end()) {
+        for (const auto& [binding, layoutBinding] : it->second) {
+            bindings.push_back(layoutBinding);
+        }
+    }
+    return bindings;
+}
+
+std::vector<VkDescriptorSetLayout> PipelineReflection::CreateSetLayouts(DescriptorPool& pool,
+                                                                        const uint32_t  setCount) const
+{
+    std::vector<VkDescriptorSetLayout> layouts;
+    for (uint32_t set = 0; set < setCount; set++) {
+        layouts.push_back(pool.CreateLayout(SetBindings(set)));
+    }
+    return layouts;
+}
+
+VkPipelineLayout PipelineReflection::CreatePipelineLayout(const VkDevice device, DescriptorPool& pool) const
+{
+    return CreatePipelineLayout(device, pool, setCount());
+}
+
+VkPipelineLayout PipelineReflection::CreatePipelineLayout(const VkDevice  device,
+                                                          DescriptorPool& pool,
+                                                          const uint32_t  setCount) const
+{
+    return ::CreatePipelineLayout(device, CreateSetLayouts(pool, setCount), m_pushConstants);
+}
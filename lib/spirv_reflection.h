@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class DescriptorPool;
+
+// The resource interface of one shader stage, read from its SPIR-V. Every binding has the stage of the shader
+// as its stage flags, arrays of resources are one binding with the product of the array lengths as its count.
+struct ShaderReflection {
+    VkShaderStageFlags stage = 0;
+    // by set, sorted by binding
+    std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> sets;
+    // the bytes of the push constant block the shader declares, size 0 without one
+    VkPushConstantRange pushConstants = {0, 0, 0};
+
+    // every binding and push constant byte of the shader is declared the same way by other, so it works with
+    // the layout other was made for
+    bool FitsInto(const ShaderReflection& other) const;
+};
+
+// False with the reason in error for code that is not SPIR-V or declares resources it can't map to descriptors.
+bool ReflectSpirv(const uint32_t* code, size_t sizeInBytes, ShaderReflection& out, std::string& error);
+
+// The interface of the stages of one or more pipelines together. A binding used by several stages gets all of
+// them, the push constants are one range over the bytes of every stage with the stages of all of them, so one
+// vkCmdPushConstants with pushConstantRange().stageFlags updates any part of it.
+class PipelineReflection {
+public:
+    // false with the reason in error when the stage declares a binding differently than the earlier ones
+    bool Add(const ShaderReflection& shader, std::string& error);
+
+    // one past the highest set any of the stages uses
+    uint32_t setCount() const;
+
+    // empty for a set none of the stages use
+    std::vector<VkDescriptorSetLayoutBinding> SetBindings(uint32_t set) const;
+
+    const VkPushConstantRange& pushConstantRange() const { return m_pushConstants; }
+
+    // The layouts of the first setCount sets from the cache of the pool, so a resource creating the layout of
+    // its set from the same bindings gets the same handle.
+    std::vector<VkDescriptorSetLayout> CreateSetLayouts(DescriptorPool& pool, uint32_t setCount) const;
+
+    VkPipelineLayout CreatePipelineLayout(VkDevice device, DescriptorPool& pool) const;
+    // only the first setCount sets, for a pipeline that is compatible with a bigger one up to there
+    VkPipelineLayout CreatePipelineLayout(VkDevice device, DescriptorPool& pool, uint32_t setCount) const;
+
+private:
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> m_sets;
+    VkPushConstantRange                                                   m_pushConstants = {0, 0, 0};
+};
@@ -0,0 +1,178 @@
+#include "staging_ring.h"
+
+#include "context.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+// keeps the memcpy destinations aligned, the copies themselves have no alignment rules
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+} // namespace
+
+StagingRing::StagingRing(const Context& context, const VkDeviceSize segmentSize, const uint32_t segmentCount)
+    : m_device(context.device())
+    , m_queue(context.queue())
+    , m_cmdPool(context.commandPool())
+    , m_segmentSize(segmentSize)
+    , m_segments(segmentCount)
+{
+    // coherent, so the writes need no flush before the submit
+    m_buffer = BufferInfo::Create(context.physicalDevice(), m_device, segmentSize * segmentCount,
+                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_mapped = static_cast<uint8_t*>(m_buffer.Map(m_device));
+
+    std::vector<VkCommandBuffer> cmdBuffers(segmentCount);
+
+    const VkCommandBufferAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = m_cmdPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = segmentCount,
+    };
+    vkAllocateCommandBuffers(m_device, &allocInfo, cmdBuffers.data());
+
+    const VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+    };
+    for (uint32_t idx = 0; idx < segmentCount; idx++) {
+        m_segments[idx].cmdBuffer = cmdBuffers[idx];
+        vkCreateFence(m_device, &fenceInfo, nullptr, &m_segments[idx].fence);
+    }
+}
+
+void StagingRing::Begin()
+{
+    Segment& segment = m_segments[m_current];
+    if (segment.inFlight) {
+        vkWaitForFences(m_device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(m_device, 1, &segment.fence);
+        segment.inFlight = false;
+    }
+
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+    vkResetCommandBuffer(segment.cmdBuffer, 0);
+    vkBeginCommandBuffer(segment.cmdBuffer, &beginInfo);
+
+    m_used      = 0;
+    m_recording = true;
+}
+
+void StagingRing::Submit()
+{
+    Segment& segment = m_segments[m_current];
+
+    // everything drawn later reads the copied data as vertices or indices
+    const VkMemoryBarrier2 barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
+        .dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT,
+    };
+    const VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr,
+    };
+    vkCmdPipelineBarrier2(segment.cmdBuffer, &dependencyInfo);
+    vkEndCommandBuffer(segment.cmdBuffer);
+
+    const VkSubmitInfo submitInfo = {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = nullptr,
+        .waitSemaphoreCount   = 0,
+        .pWaitSemaphores      = nullptr,
+        .pWaitDstStageMask    = nullptr,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = &segment.cmdBuffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores    = nullptr,
+    };
+    vkQueueSubmit(m_queue, 1, &submitInfo, segment.fence);
+
+    segment.inFlight = true;
+    m_recording      = false;
+    m_current        = (m_current + 1) % m_segments.size();
+}
+
+void* StagingRing::Reserve(const VkBuffer dst, const VkDeviceSize dstOffset, const VkDeviceSize size)
+{
+    assert(size <= m_segmentSize);
+
+    if (m_recording && m_used + size > m_segmentSize) {
+        Submit();
+    }
+    if (!m_recording) {
+        Begin();
+    }
+
+    const VkDeviceSize srcOffset = m_current * m_segmentSize + m_used;
+
+    const VkBufferCopy region = {
+        .srcOffset = srcOffset,
+        .dstOffset = dstOffset,
+        .size      = size,
+    };
+    vkCmdCopyBuffer(m_segments[m_current].cmdBuffer, m_buffer.buffer, dst, 1, &region);
+
+    m_used = std::min(m_segmentSize, (m_used + size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1));
+    m_uploadedBytes += size;
+    return m_mapped + srcOffset;
+}
+
+void StagingRing::Upload(const VkBuffer dst, const VkDeviceSize dstOffset, const void* data, const VkDeviceSize size)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (VkDeviceSize done = 0; done < size;) {
+        const VkDeviceSize chunk = std::min(m_segmentSize, size - done);
+        memcpy(Reserve(dst, dstOffset + done, chunk), src + done, chunk);
+        done += chunk;
+    }
+}
+
+void StagingRing::Flush()
+{
+    if (m_recording) {
+        Submit();
+    }
+
+    for (Segment& segment : m_segments) {
+        if (segment.inFlight) {
+            vkWaitForFences(m_device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(m_device, 1, &segment.fence);
+            segment.inFlight = false;
+        }
+    }
+}
+
+void StagingRing::Destroy()
+{
+    Flush();
+
+    for (Segment& segment : m_segments) {
+        vkFreeCommandBuffers(m_device, m_cmdPool, 1, &segment.cmdBuffer);
+        vkDestroyFence(m_device, segment.fence, nullptr);
+    }
+    m_segments.clear();
+
+    m_buffer.Unmap(m_device);
+    m_buffer.Destroy(m_device);
+}
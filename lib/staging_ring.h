@@ -0,0 +1,56 @@
+#pragma once
+
+#include "buffer.h"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class Context;
+
+// Streams data into device local buffers through one persistently mapped host buffer. The ring is cut into
+// segments, each with its own command buffer and fence: the CPU fills the next segment while the GPU copies the
+// previous ones, it only waits when it comes around to a segment that is still in flight.
+// Uses the queue and the command pool of the context, so it stays on the thread that owns those.
+class StagingRing {
+public:
+    StagingRing(const Context& context, VkDeviceSize segmentSize, uint32_t segmentCount);
+
+    // Room for a copy of size bytes into dst, the caller writes the data to the returned pointer before the
+    // next call. size can't be more than the segment size.
+    void* Reserve(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+    // any size, copied in segment sized pieces
+    void Upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // submits the pending copies and waits for every one of them, the destination buffers can be used after it
+    void Flush();
+    void Destroy();
+
+    VkDeviceSize segmentSize() const { return m_segmentSize; }
+    uint64_t     uploadedBytes() const { return m_uploadedBytes; }
+
+private:
+    struct Segment {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence         fence     = VK_NULL_HANDLE;
+        bool            inFlight  = false;
+    };
+
+    // waits for the current segment if the GPU still copies from it
+    void Begin();
+    void Submit();
+
+    VkDevice      m_device;
+    VkQueue       m_queue;
+    VkCommandPool m_cmdPool;
+
+    BufferInfo           m_buffer;
+    uint8_t*             m_mapped;
+    VkDeviceSize         m_segmentSize;
+    std::vector<Segment> m_segments;
+    uint32_t             m_current   = 0;
+    VkDeviceSize         m_used      = 0; // of the current segment
+    bool                 m_recording = false;
+
+    uint64_t m_uploadedBytes = 0;
+};
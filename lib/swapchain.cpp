@@ -1,5 +1,6 @@
 #include "swapchain.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "debug.h"
@@ -13,6 +14,14 @@ static const VkFormat g_preferredFormats[] = {
     VK_FORMAT_R8G8B8A8_UNORM,
 };
 
+// the requested mode always comes first, FIFO is the only one every surface has to support
+static const VkPresentModeKHR g_presentModeFallbacks[] = {
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_FIFO_KHR,
+};
+
 static const VkImageViewCreateInfo g_defaultImageViewCreateInfo = {
     .sType      = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
     .pNext      = nullptr,
@@ -43,6 +52,22 @@ void Swapchain::AddRequiredExtensions(std::vector<const char*>& extensions)
     extensions.insert(extensions.end(), swapchainExtensions.begin(), swapchainExtensions.end());
 }
 
+const char* Swapchain::PresentModeName(const VkPresentModeKHR presentMode)
+{
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo_relaxed";
+    default:
+        return "unknown";
+    }
+}
+
 VkResult Swapchain::Create()
 {
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_phyDevice, m_surface, &m_surfaceCapabilites);
@@ -52,7 +77,11 @@ VkResult Swapchain::Create()
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    const VkResult swapchainResult = CreateVkSwapchain();
+    m_presentMode   = SelectPresentMode();
+    m_minImageCount = SelectImageCount();
+    m_surfaceExtent = SelectExtent(m_surfaceExtent);
+
+    const VkResult swapchainResult = CreateVkSwapchain(VK_NULL_HANDLE);
     if (swapchainResult != VK_SUCCESS) {
         return swapchainResult;
     }
@@ -66,13 +95,42 @@ VkResult Swapchain::Create()
     return VK_SUCCESS;
 }
 
+VkResult Swapchain::Recreate(const VkExtent2D& surfaceExtent)
+{
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_phyDevice, m_surface, &m_surfaceCapabilites);
+
+    m_minImageCount = SelectImageCount();
+    m_surfaceExtent = SelectExtent(surfaceExtent);
+    m_swapchainIdx  = 0;
+
+    DestroyImageResources();
+
+    // the old swapchain lets the presentation engine hand over its resources, it is retired by the create
+    const VkSwapchainKHR oldSwapchain    = m_swapchain;
+    const VkResult       swapchainResult = CreateVkSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(m_device, oldSwapchain, nullptr);
+    if (swapchainResult != VK_SUCCESS) {
+        m_swapchain = VK_NULL_HANDLE;
+        return swapchainResult;
+    }
+
+    const std::vector<VkImage> images = GetVkSwapchainImages();
+    return CreateImageResources(images);
+}
+
 void Swapchain::Destroy()
 {
     vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+    DestroyImageResources();
+    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+}
+
+void Swapchain::DestroyImageResources()
+{
     for (const Swapchain::Image resource : m_swapchainImages) {
         vkDestroyImageView(m_device, resource.view, nullptr);
     }
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    m_swapchainImages.clear();
 }
 
 VkSurfaceFormatKHR Swapchain::FindSurfaceFormat()
@@ -103,7 +161,61 @@ VkSurfaceFormatKHR Swapchain::FindSurfaceFormat()
     return selectedFormat;
 }
 
-VkResult Swapchain::CreateVkSwapchain()
+VkPresentModeKHR Swapchain::SelectPresentMode()
+{
+    uint32_t modeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_phyDevice, m_surface, &modeCount, nullptr);
+
+    std::vector<VkPresentModeKHR> supportedModes(modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_phyDevice, m_surface, &modeCount, supportedModes.data());
+
+    const auto isSupported = [&supportedModes](VkPresentModeKHR mode) {
+        return std::find(supportedModes.begin(), supportedModes.end(), mode) != supportedModes.end();
+    };
+
+    if (isSupported(m_requestedPresentMode)) {
+        return m_requestedPresentMode;
+    }
+
+    for (const VkPresentModeKHR mode : g_presentModeFallbacks) {
+        if (isSupported(mode)) {
+            return mode;
+        }
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t Swapchain::SelectImageCount() const
+{
+    // with only the minimum the application can end up waiting for the presentation engine to release an image
+    uint32_t imageCount = m_requestedImageCount != 0 ? m_requestedImageCount : m_surfaceCapabilites.minImageCount + 1;
+
+    imageCount = std::max(imageCount, m_surfaceCapabilites.minImageCount);
+    // a maximum of 0 means there is no limit
+    if (m_surfaceCapabilites.maxImageCount != 0) {
+        imageCount = std::min(imageCount, m_surfaceCapabilites.maxImageCount);
+    }
+
+    return imageCount;
+}
+
+VkExtent2D Swapchain::SelectExtent(const VkExtent2D& requestedExtent) const
+{
+    // a current extent of UINT32_MAX means the surface takes the size of the swapchain
+    if (m_surfaceCapabilites.currentExtent.width != UINT32_MAX) {
+        return m_surfaceCapabilites.currentExtent;
+    }
+
+    return {
+        std::clamp(requestedExtent.width, m_surfaceCapabilites.minImageExtent.width,
+                   m_surfaceCapabilites.maxImageExtent.width),
+        std::clamp(requestedExtent.height, m_surfaceCapabilites.minImageExtent.height,
+                   m_surfaceCapabilites.maxImageExtent.height),
+    };
+}
+
+VkResult Swapchain::CreateVkSwapchain(const VkSwapchainKHR oldSwapchain)
 {
     const VkImageUsageFlags usageFlags =
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
@@ -113,7 +225,7 @@ VkResult Swapchain::CreateVkSwapchain()
         .pNext                 = 0,
         .flags                 = 0,
         .surface               = m_surface,
-        .minImageCount         = m_surfaceCapabilites.minImageCount,
+        .minImageCount         = m_minImageCount,
         .imageFormat           = m_surfaceFormat.format,
         .imageColorSpace       = m_surfaceFormat.colorSpace,
         .imageExtent           = m_surfaceExtent,
@@ -126,7 +238,7 @@ VkResult Swapchain::CreateVkSwapchain()
         .compositeAlpha        = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode           = m_presentMode,
         .clipped               = VK_TRUE,
-        .oldSwapchain          = VK_NULL_HANDLE,
+        .oldSwapchain          = oldSwapchain,
     };
 
     return vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapchain);
@@ -172,11 +284,9 @@ VkResult Swapchain::CreateImageResources(const std::vector<VkImage>& images)
     return VK_SUCCESS;
 }
 
-const Swapchain::Image& Swapchain::AquireNextImage(const VkFence imageFence)
+VkResult Swapchain::AquireNextImage(const VkSemaphore imageAvailable)
 {
-    vkAcquireNextImageKHR(m_device, m_swapchain, 1e9 * 2, VK_NULL_HANDLE, imageFence, &m_swapchainIdx);
-
-    return m_swapchainImages[m_swapchainIdx];
+    return vkAcquireNextImageKHR(m_device, m_swapchain, 1e9 * 2, imageAvailable, VK_NULL_HANDLE, &m_swapchainIdx);
 }
 
 void Swapchain::CmdTransitionToRender(const VkCommandBuffer   cmdBuffer,
@@ -257,7 +367,7 @@ void Swapchain::CmdTransitionToPresent(const VkCommandBuffer   cmdBuffer,
     vkCmdPipelineBarrier2(cmdBuffer, &startDependency);
 }
 
-void Swapchain::QueuePresent(const VkQueue queue, const VkSemaphore presentSemaphore)
+VkResult Swapchain::QueuePresent(const VkQueue queue, const VkSemaphore presentSemaphore)
 {
     VkPresentInfoKHR presentInfo = {
         .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -270,5 +380,5 @@ void Swapchain::QueuePresent(const VkQueue queue, const VkSemaphore presentSemap
         .pResults           = nullptr,
     };
 
-    vkQueuePresentKHR(queue, &presentInfo);
+    return vkQueuePresentKHR(queue, &presentInfo);
 }
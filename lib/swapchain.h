@@ -14,40 +14,61 @@ public:
         VkImage     image = VK_NULL_HANDLE;
         VkImageView view  = VK_NULL_HANDLE;
     };
+    // The requested present mode is used if the surface supports it, otherwise the first supported one of
+    // MAILBOX, IMMEDIATE, FIFO_RELAXED and FIFO. An image count of 0 means one more than the surface minimum.
     Swapchain(const VkInstance&       instance,
               const VkPhysicalDevice& phyDevice,
               const VkDevice&         device,
               const VkSurfaceKHR&     surface,
-              const VkExtent2D&       surfaceExtent)
+              const VkExtent2D&       surfaceExtent,
+              VkPresentModeKHR        requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR,
+              uint32_t                requestedImageCount  = 0)
         : m_instance(instance)
         , m_phyDevice(phyDevice)
         , m_device(device)
         , m_surface(surface)
         , m_surfaceExtent(surfaceExtent)
+        , m_requestedPresentMode(requestedPresentMode)
+        , m_requestedImageCount(requestedImageCount)
         , m_presentMode(VK_PRESENT_MODE_FIFO_KHR)
+        , m_minImageCount(0)
         , m_swapchainIdx(0)
     {
     }
 
+    static const char* PresentModeName(VkPresentModeKHR presentMode);
+
     VkResult Create();
+    // Creates a new swapchain for the current surface size from the old one, keeps the surface and present mode.
+    // None of the old images may be in use anymore.
+    VkResult Recreate(const VkExtent2D& surfaceExtent);
     void     Destroy();
 
-    const Swapchain::Image& AquireNextImage(const VkFence imageFence);
+    // imageAvailable is signaled once the presentation engine is done with the image, see currentImage.
+    // VK_ERROR_OUT_OF_DATE_KHR means nothing was acquired and the swapchain has to be recreated.
+    VkResult                AquireNextImage(const VkSemaphore imageAvailable);
+    const Swapchain::Image& currentImage() const { return m_swapchainImages[m_swapchainIdx]; }
     void                    CmdTransitionToRender(const VkCommandBuffer   cmdBuffer,
                                                   const Swapchain::Image& swapchainImage,
                                                   uint32_t                queueFamilyIdx);
     void                    CmdTransitionToPresent(const VkCommandBuffer   cmdBuffer,
                                                    const Swapchain::Image& swapchainImage,
                                                    uint32_t                queueFamilyIdx);
-    void                    QueuePresent(const VkQueue queue, const VkSemaphore presentSemaphore);
+    VkResult                QueuePresent(const VkQueue queue, const VkSemaphore presentSemaphore);
 
     VkFormat                  format() const { return m_surfaceFormat.format; }
     const std::vector<Image>& images() const { return m_swapchainImages; }
     const VkExtent2D&         surfaceExtent() const { return m_surfaceExtent; }
+    VkPresentModeKHR          presentMode() const { return m_presentMode; }
+    uint32_t                  minImageCount() const { return m_minImageCount; }
 
 protected:
     VkSurfaceFormatKHR   FindSurfaceFormat();
-    VkResult             CreateVkSwapchain();
+    VkPresentModeKHR     SelectPresentMode();
+    uint32_t             SelectImageCount() const;
+    VkExtent2D           SelectExtent(const VkExtent2D& requestedExtent) const;
+    VkResult             CreateVkSwapchain(VkSwapchainKHR oldSwapchain);
+    void                 DestroyImageResources();
     std::vector<VkImage> GetVkSwapchainImages();
     VkResult             CreateImageResources(const std::vector<VkImage>& images);
     VkResult             CreateMsaaColorResources();
@@ -56,13 +77,16 @@ protected:
     const VkPhysicalDevice& m_phyDevice;
     const VkDevice&         m_device;
     const VkSurfaceKHR&     m_surface;
-    const VkExtent2D        m_surfaceExtent;
-    const VkPresentModeKHR  m_presentMode;
+    VkExtent2D              m_surfaceExtent;
+    const VkPresentModeKHR  m_requestedPresentMode;
+    const uint32_t          m_requestedImageCount;
 
+    VkPresentModeKHR         m_presentMode;
+    uint32_t                 m_minImageCount;
     uint32_t                 m_swapchainIdx;
     VkSurfaceCapabilitiesKHR m_surfaceCapabilites;
     VkSurfaceFormatKHR       m_surfaceFormat;
-    VkSwapchainKHR           m_swapchain;
+    VkSwapchainKHR           m_swapchain = VK_NULL_HANDLE;
 
     std::vector<Swapchain::Image> m_swapchainImages;
 };
@@ -151,7 +151,9 @@ bool Texture::InitFromBuffer(
     VkImageUsageFlags       usage,
     const VkBuffer          buffer) {
 
-    CreateImage(phyDevice, device, usage);
+    // only sampled textures get a full mip chain, everything else is single level
+    const uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_width, m_height)))) + 1;
+    CreateImage(phyDevice, device, usage, VK_SAMPLE_COUNT_1_BIT, mipLevels);
 
     UploadFromBuffer(device, queue, cmdPool, buffer);
 
@@ -182,13 +184,28 @@ Texture* Texture::LoadFromFile(const VkPhysicalDevice phyDevice,
 
     printf("Loaded image: %s (%dx%d)\n", path.c_str(), width, height);
 
-    // 2) Upload image data to a staging buffer
+    Texture* texture = LoadFromData(phyDevice, device, queue, cmdPool, data, width, height, format, usage);
+
+    stbi_image_free(data);
+
+    return texture;
+}
+
+Texture* Texture::LoadFromData(const VkPhysicalDevice phyDevice,
+                               const VkDevice         device,
+                               const VkQueue          queue,
+                               const VkCommandPool    cmdPool,
+                               const uint8_t*         data,
+                               uint32_t               width,
+                               uint32_t               height,
+                               const VkFormat         format,
+                               VkImageUsageFlags      usage)
+{
+    // Upload image data to a staging buffer
     const uint32_t rawSize   = width * height * 4;
     BufferInfo     rawBuffer = BufferInfo::Create(phyDevice, device, rawSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
     rawBuffer.Update(device, data, rawSize);
 
-    stbi_image_free(data);
-
     Texture* texture = new Texture(format, width, height);
     texture->InitFromBuffer(phyDevice, device, queue, cmdPool,
                             usage | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
@@ -209,7 +226,7 @@ Texture* Texture::Create2D(const VkPhysicalDevice phyDevice,
 
     Texture *texture = new Texture(format, extent.width, extent.height);
 
-    texture->CreateImage(phyDevice, device, usage, msaaSamples);
+    texture->CreateImage(phyDevice, device, usage, msaaSamples, 1);
 
     static VkImageUsageFlags requiresView = 0
         | VK_IMAGE_USAGE_SAMPLED_BIT
@@ -230,19 +247,55 @@ Texture* Texture::Create2D(const VkPhysicalDevice phyDevice,
     return texture;
 }
 
+Texture* Texture::Create2DArray(const VkPhysicalDevice phyDevice,
+                                const VkDevice         device,
+                                const VkFormat         format,
+                                VkExtent2D             extent,
+                                uint32_t               layers,
+                                VkImageUsageFlags      usage) {
 
-VkResult Texture::CreateImage(
-    const VkPhysicalDevice  phyDevice,
-    const VkDevice          device,
-    VkImageUsageFlags       usage,
-    VkSampleCountFlagBits   msaaSamples) {
+    Texture *texture = new Texture(format, extent.width, extent.height);
+    texture->m_layers = layers;
+
+    texture->CreateImage(phyDevice, device, usage, VK_SAMPLE_COUNT_1_BIT, 1);
+
+    VkImageViewCreateInfo createInfo = {
+        .sType          = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext          = nullptr,
+        .flags          = 0,
+        .image          = texture->m_image,
+        .viewType       = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format         = format,
+        .components     = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY },
+        .subresourceRange = {
+            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel   = 0,
+            .levelCount     = 1,
+            .baseArrayLayer = 0,
+            .layerCount     = layers,
+        }
+    };
+    vkCreateImageView(device, &createInfo, nullptr, &texture->m_view);
 
-    bool texture = true;
-    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
-        texture = false;
+    if ((usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0) {
+        texture->Create2DSampler(device, false);
     }
 
-    m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_width, m_height)))) + 1;
+    return texture;
+}
+
+VkResult Texture::CreateImageHandle(
+    const VkDevice          device,
+    VkImageUsageFlags       usage,
+    VkSampleCountFlagBits   msaaSamples,
+    uint32_t                mipLevels) {
+
+    // multisampled images can't have mips
+    m_mipLevels = (msaaSamples == VK_SAMPLE_COUNT_1_BIT) ? mipLevels : 1;
 
     VkImageCreateInfo createInfo = {
         .sType                  = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -251,9 +304,9 @@ VkResult Texture::CreateImage(
         .imageType              = VK_IMAGE_TYPE_2D,
         .format                 = m_format,
         .extent                 = { m_width, m_height, 1 },
-        .mipLevels              = texture?m_mipLevels:1,
-        .arrayLayers            = 1,
-        .samples                = texture?VK_SAMPLE_COUNT_1_BIT: msaaSamples,
+        .mipLevels              = m_mipLevels,
+        .arrayLayers            = m_layers,
+        .samples                = msaaSamples,
         .tiling                 = VK_IMAGE_TILING_OPTIMAL,
         .usage                  = usage,
         .sharingMode            = VK_SHARING_MODE_EXCLUSIVE,
@@ -262,8 +315,20 @@ VkResult Texture::CreateImage(
         .initialLayout          = VK_IMAGE_LAYOUT_UNDEFINED,
     };
 
-    VkResult createResult = vkCreateImage(device, &createInfo, nullptr, &m_image);
-    (void)createResult;
+    return vkCreateImage(device, &createInfo, nullptr, &m_image);
+}
+
+VkResult Texture::CreateImage(
+    const VkPhysicalDevice  phyDevice,
+    const VkDevice          device,
+    VkImageUsageFlags       usage,
+    VkSampleCountFlagBits   msaaSamples,
+    uint32_t                mipLevels) {
+
+    VkResult createResult = CreateImageHandle(device, usage, msaaSamples, mipLevels);
+    if (createResult != VK_SUCCESS) {
+        return createResult;
+    }
 
     VkMemoryRequirements requirements = {};
     vkGetImageMemoryRequirements(device, m_image, &requirements);
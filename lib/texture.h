@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include <vulkan/vulkan_core.h>
@@ -12,6 +13,7 @@ VkImageView Create2DImageView(
 
 
 struct BufferInfo;
+class RenderTargetAllocator;
 
 class Texture {
 public:
@@ -27,16 +29,17 @@ public:
         const VkFormat          format,
         VkImageUsageFlags       usage);
 
-/*
+    // data is tightly packed RGBA8, decoding can happen on any thread but the upload uses the queue
     static Texture *LoadFromData(
         const VkPhysicalDevice  phyDevice,
         const VkDevice          device,
         const VkQueue           queue,
         const VkCommandPool     cmdPool,
-        const std::string&      path,
+        const uint8_t*          data,
+        uint32_t                width,
+        uint32_t                height,
         const VkFormat          format,
         VkImageUsageFlags       usage);
-*/
 
     static Texture* Create2D(const VkPhysicalDevice phyDevice,
                              const VkDevice         device,
@@ -45,9 +48,18 @@ public:
                              VkImageUsageFlags      usage,
                              VkSampleCountFlagBits  msaaSamples = VK_SAMPLE_COUNT_1_BIT);
 
+    // layers of the same size behind one 2D array view, single level and single sample
+    static Texture* Create2DArray(const VkPhysicalDevice phyDevice,
+                                  const VkDevice         device,
+                                  const VkFormat         format,
+                                  VkExtent2D             extent,
+                                  uint32_t               layers,
+                                  VkImageUsageFlags      usage);
+
     VkImage image() const { return m_image; }
     VkImageView view() const { return m_view; }
     VkSampler sampler() const { return m_sampler; }
+    VkFormat format() const { return m_format; }
 
     bool UploadFromBuffer(
         const VkDevice      device,
@@ -63,6 +75,7 @@ public:
 
     uint32_t Width() const { return m_width; }
     uint32_t Height() const { return m_height; }
+    uint32_t Layers() const { return m_layers; }
 
     VkExtent2D Extent2D() const { return { m_width, m_height }; }
 
@@ -77,11 +90,20 @@ private:
         , m_height(height)
     {}
 
+    friend class RenderTargetAllocator;
+
+    VkResult CreateImageHandle(
+        const VkDevice          device,
+        VkImageUsageFlags       usage,
+        VkSampleCountFlagBits   msaaSamples,
+        uint32_t                mipLevels);
+
     VkResult CreateImage(
         const VkPhysicalDevice  phyDevice,
         const VkDevice          device,
         VkImageUsageFlags       usage,
-        VkSampleCountFlagBits   msaaSamples = VK_SAMPLE_COUNT_1_BIT);
+        VkSampleCountFlagBits   msaaSamples,
+        uint32_t                mipLevels);
 
     bool InitFromBuffer(
         const VkPhysicalDevice  phyDevice,
@@ -95,11 +117,12 @@ private:
     VkFormat m_format;
     uint32_t m_width;
     uint32_t m_height;
-    uint32_t m_mipLevels;
+    uint32_t m_mipLevels = 1;
+    uint32_t m_layers    = 1;
 
-    VkImage m_image;
-    VkDeviceMemory m_memory;
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
 
-    VkImageView m_view;
-    VkSampler m_sampler;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
 };
@@ -0,0 +1,386 @@
+#include "transform_kernels.h"
+
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORM_KERNELS_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace {
+constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+void ComposeOne(const float* position, const float* rotation, const float* scale, Affine3x4& out)
+{
+    const float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+
+    const float x2 = x + x, y2 = y + y, z2 = z + z;
+    const float xx = x * x2, yy = y * y2, zz = z * z2;
+    const float xy = x * y2, xz = x * z2, yz = y * z2;
+    const float wx = w * x2, wy = w * y2, wz = w * z2;
+
+    // the columns of the rotation are scaled, the translation is the last column
+    out.rows[0][0] = (1.0f - (yy + zz)) * scale[0];
+    out.rows[0][1] = (xy - wz) * scale[1];
+    out.rows[0][2] = (xz + wy) * scale[2];
+    out.rows[0][3] = position[0];
+
+    out.rows[1][0] = (xy + wz) * scale[0];
+    out.rows[1][1] = (1.0f - (xx + zz)) * scale[1];
+    out.rows[1][2] = (yz - wx) * scale[2];
+    out.rows[1][3] = position[1];
+
+    out.rows[2][0] = (xz - wy) * scale[0];
+    out.rows[2][1] = (yz + wx) * scale[1];
+    out.rows[2][2] = (1.0f - (xx + yy)) * scale[2];
+    out.rows[2][3] = position[2];
+}
+
+void ComposeScalar(const float*   positions,
+                   const float*   rotations,
+                   const float*   scales,
+                   const uint32_t count,
+                   Affine3x4*     out)
+{
+    for (uint32_t idx = 0; idx < count; idx++) {
+        ComposeOne(positions + idx * 3, rotations + idx * 4, scales + idx * 3, out[idx]);
+    }
+}
+
+void MultiplyScalar(const Affine3x4& parent, const Affine3x4& local, Affine3x4& out)
+{
+    for (uint32_t row = 0; row < 3; row++) {
+        const float* p = parent.rows[row];
+        for (uint32_t col = 0; col < 4; col++) {
+            out.rows[row][col] = p[0] * local.rows[0][col] + p[1] * local.rows[1][col] + p[2] * local.rows[2][col];
+        }
+        out.rows[row][3] += p[3];
+    }
+}
+
+void ChainScalar(const uint32_t*  parents,
+                 const uint8_t*   mask,
+                 const Affine3x4* local,
+                 Affine3x4*       world,
+                 const uint32_t   first,
+                 const uint32_t   last)
+{
+    for (uint32_t idx = first; idx < last; idx++) {
+        if (mask != nullptr && mask[idx] == 0) {
+            continue;
+        }
+
+        if (parents[idx] == NO_PARENT) {
+            world[idx] = local[idx];
+        } else {
+            MultiplyScalar(world[parents[idx]], local[idx], world[idx]);
+        }
+    }
+}
+
+#if defined(TRANSFORM_KERNELS_X64)
+// Four nodes from packed xyz triples, the fourth lane is garbage. Reads one float past the fourth node,
+// so there has to be at least one more node after them.
+inline void LoadTriples(const float* values, __m128& x, __m128& y, __m128& z)
+{
+    __m128 v0 = _mm_loadu_ps(values);
+    __m128 v1 = _mm_loadu_ps(values + 3);
+    __m128 v2 = _mm_loadu_ps(values + 6);
+    __m128 v3 = _mm_loadu_ps(values + 9);
+    _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+    x = v0;
+    y = v1;
+    z = v2;
+}
+
+inline void LoadQuats(const float* values, __m128& x, __m128& y, __m128& z, __m128& w)
+{
+    x = _mm_loadu_ps(values);
+    y = _mm_loadu_ps(values + 4);
+    z = _mm_loadu_ps(values + 8);
+    w = _mm_loadu_ps(values + 12);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+// one row of four nodes from the columns of the row
+inline void StoreRow(__m128 c0, __m128 c1, __m128 c2, __m128 c3, Affine3x4* out, const uint32_t row)
+{
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(out[0].rows[row], c0);
+    _mm_store_ps(out[1].rows[row], c1);
+    _mm_store_ps(out[2].rows[row], c2);
+    _mm_store_ps(out[3].rows[row], c3);
+}
+
+void ComposeSSE(const float*   positions,
+                const float*   rotations,
+                const float*   scales,
+                const uint32_t count,
+                Affine3x4*     out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    // the triples are read one float too far, the last block is left for the scalar loop
+    uint32_t idx = 0;
+    for (; idx + 4 < count; idx += 4) {
+        __m128 px, py, pz, qx, qy, qz, qw, sx, sy, sz;
+        LoadTriples(positions + idx * 3, px, py, pz);
+        LoadQuats(rotations + idx * 4, qx, qy, qz, qw);
+        LoadTriples(scales + idx * 3, sx, sy, sz);
+
+        const __m128 x2 = _mm_add_ps(qx, qx), y2 = _mm_add_ps(qy, qy), z2 = _mm_add_ps(qz, qz);
+        const __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+        const __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+        const __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+
+        StoreRow(_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+                 _mm_mul_ps(_mm_add_ps(xz, wy), sz), px, out + idx, 0);
+        StoreRow(_mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+                 _mm_mul_ps(_mm_sub_ps(yz, wx), sz), py, out + idx, 1);
+        StoreRow(_mm_mul_ps(_mm_sub_ps(xz, wy), sx), _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+                 _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), pz, out + idx, 2);
+    }
+
+    ComposeScalar(positions + idx * 3, rotations + idx * 4, scales + idx * 3, count - idx, out + idx);
+}
+
+void ChainSSE(const uint32_t*  parents,
+              const uint8_t*   mask,
+              const Affine3x4* local,
+              Affine3x4*       world,
+              const uint32_t   first,
+              const uint32_t   last)
+{
+    // the implicit last row of the local matrix, picks up the translation of the parent
+    const __m128 unitW = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+    for (uint32_t idx = first; idx < last; idx++) {
+        if (mask != nullptr && mask[idx] == 0) {
+            continue;
+        }
+
+        if (parents[idx] == NO_PARENT) {
+            world[idx] = local[idx];
+            continue;
+        }
+
+        const Affine3x4& parent = world[parents[idx]];
+        const __m128     l0     = _mm_load_ps(local[idx].rows[0]);
+        const __m128     l1     = _mm_load_ps(local[idx].rows[1]);
+        const __m128     l2     = _mm_load_ps(local[idx].rows[2]);
+
+        for (uint32_t row = 0; row < 3; row++) {
+            const __m128 p = _mm_load_ps(parent.rows[row]);
+
+            __m128 result = _mm_mul_ps(_mm_shuffle_ps(p, p, 0x00), l0);
+            result        = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(p, p, 0x55), l1));
+            result        = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(p, p, 0xaa), l2));
+            result        = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(p, p, 0xff), unitW));
+            _mm_store_ps(world[idx].rows[row], result);
+        }
+    }
+}
+
+TARGET_AVX2 inline __m256 Combine(const __m128 low, const __m128 high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+}
+
+TARGET_AVX2 inline void StoreRows8(const __m256   c0,
+                                   const __m256   c1,
+                                   const __m256   c2,
+                                   const __m256   c3,
+                                   Affine3x4*     out,
+                                   const uint32_t row)
+{
+    StoreRow(_mm256_castps256_ps128(c0), _mm256_castps256_ps128(c1), _mm256_castps256_ps128(c2),
+             _mm256_castps256_ps128(c3), out, row);
+    StoreRow(_mm256_extractf128_ps(c0, 1), _mm256_extractf128_ps(c1, 1), _mm256_extractf128_ps(c2, 1),
+             _mm256_extractf128_ps(c3, 1), out + 4, row);
+}
+
+TARGET_AVX2 void ComposeAVX2(const float*   positions,
+                             const float*   rotations,
+                             const float*   scales,
+                             const uint32_t count,
+                             Affine3x4*     out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    uint32_t idx = 0;
+    for (; idx + 8 < count; idx += 8) {
+        // the loads and the transposes are 4 wide, the math runs on all 8 nodes
+        __m128 px0, py0, pz0, px1, py1, pz1;
+        LoadTriples(positions + idx * 3, px0, py0, pz0);
+        LoadTriples(positions + idx * 3 + 12, px1, py1, pz1);
+
+        __m128 qx0, qy0, qz0, qw0, qx1, qy1, qz1, qw1;
+        LoadQuats(rotations + idx * 4, qx0, qy0, qz0, qw0);
+        LoadQuats(rotations + idx * 4 + 16, qx1, qy1, qz1, qw1);
+
+        __m128 sx0, sy0, sz0, sx1, sy1, sz1;
+        LoadTriples(scales + idx * 3, sx0, sy0, sz0);
+        LoadTriples(scales + idx * 3 + 12, sx1, sy1, sz1);
+
+        const __m256 px = Combine(px0, px1), py = Combine(py0, py1), pz = Combine(pz0, pz1);
+        const __m256 qx = Combine(qx0, qx1), qy = Combine(qy0, qy1), qz = Combine(qz0, qz1), qw = Combine(qw0, qw1);
+        const __m256 sx = Combine(sx0, sx1), sy = Combine(sy0, sy1), sz = Combine(sz0, sz1);
+
+        const __m256 x2 = _mm256_add_ps(qx, qx), y2 = _mm256_add_ps(qy, qy), z2 = _mm256_add_ps(qz, qz);
+        const __m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+        const __m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+        const __m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+
+        StoreRows8(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+                   _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), px, out + idx,
+                   0);
+        StoreRows8(_mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+                   _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+                   _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), py, out + idx, 1);
+        StoreRows8(_mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+                   _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), pz, out + idx, 2);
+    }
+
+    ComposeSSE(positions + idx * 3, rotations + idx * 4, scales + idx * 3, count - idx, out + idx);
+}
+
+TARGET_AVX2 void ChainAVX2(const uint32_t*  parents,
+                           const uint8_t*   mask,
+                           const Affine3x4* local,
+                           Affine3x4*       world,
+                           const uint32_t   first,
+                           const uint32_t   last)
+{
+    const __m128 unitW   = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+    const __m256 unitW01 = _mm256_broadcast_ps(&unitW);
+
+    for (uint32_t idx = first; idx < last; idx++) {
+        if (mask != nullptr && mask[idx] == 0) {
+            continue;
+        }
+
+        if (parents[idx] == NO_PARENT) {
+            world[idx] = local[idx];
+            continue;
+        }
+
+        const Affine3x4& parent = world[parents[idx]];
+
+        // the local rows in both halves, the first two parent rows are done at once. The matrices are only
+        // 16 byte aligned, the 256 bit accesses are unaligned ones.
+        const __m128 l0 = _mm_load_ps(local[idx].rows[0]);
+        const __m128 l1 = _mm_load_ps(local[idx].rows[1]);
+        const __m128 l2 = _mm_load_ps(local[idx].rows[2]);
+
+        const __m256 l00 = _mm256_broadcast_ps(&l0);
+        const __m256 l11 = _mm256_broadcast_ps(&l1);
+        const __m256 l22 = _mm256_broadcast_ps(&l2);
+
+        const __m256 p01 = _mm256_loadu_ps(parent.rows[0]);
+
+        __m256 rows01 = _mm256_mul_ps(_mm256_permute_ps(p01, 0xff), unitW01);
+        rows01        = _mm256_fmadd_ps(_mm256_permute_ps(p01, 0xaa), l22, rows01);
+        rows01        = _mm256_fmadd_ps(_mm256_permute_ps(p01, 0x55), l11, rows01);
+        rows01        = _mm256_fmadd_ps(_mm256_permute_ps(p01, 0x00), l00, rows01);
+
+        const __m128 p2   = _mm_load_ps(parent.rows[2]);
+        __m128       row2 = _mm_mul_ps(_mm_permute_ps(p2, 0xff), unitW);
+        row2              = _mm_fmadd_ps(_mm_permute_ps(p2, 0xaa), l2, row2);
+        row2              = _mm_fmadd_ps(_mm_permute_ps(p2, 0x55), l1, row2);
+        row2              = _mm_fmadd_ps(_mm_permute_ps(p2, 0x00), l0, row2);
+
+        _mm256_storeu_ps(world[idx].rows[0], rows01);
+        _mm_store_ps(world[idx].rows[2], row2);
+    }
+}
+
+bool CpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma     = (info[2] & (1 << 12)) != 0;
+    if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+const TransformKernels SCALAR_KERNELS = {TransformKernels::Isa::Scalar, ComposeScalar, ChainScalar};
+#if defined(TRANSFORM_KERNELS_X64)
+const TransformKernels SSE_KERNELS  = {TransformKernels::Isa::SSE, ComposeSSE, ChainSSE};
+const TransformKernels AVX2_KERNELS = {TransformKernels::Isa::AVX2, ComposeAVX2, ChainAVX2};
+#endif
+} // namespace
+
+bool TransformKernels::Supported(const Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+#if defined(TRANSFORM_KERNELS_X64)
+    case Isa::SSE:
+        // part of x86-64
+        return true;
+    case Isa::AVX2: {
+        static const bool avx2 = CpuHasAVX2();
+        return avx2;
+    }
+#else
+    case Isa::SSE:
+    case Isa::AVX2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+const TransformKernels& TransformKernels::ForIsa(const Isa isa)
+{
+    assert(Supported(isa));
+
+#if defined(TRANSFORM_KERNELS_X64)
+    switch (isa) {
+    case Isa::AVX2:
+        return AVX2_KERNELS;
+    case Isa::SSE:
+        return SSE_KERNELS;
+    case Isa::Scalar:
+        break;
+    }
+#endif
+    return SCALAR_KERNELS;
+}
+
+const TransformKernels& TransformKernels::Best()
+{
+    static const TransformKernels& best = ForIsa(Supported(Isa::AVX2) ? Isa::AVX2
+                                                 : Supported(Isa::SSE) ? Isa::SSE
+                                                                       : Isa::Scalar);
+    return best;
+}
+
+const char* TransformKernels::IsaName(const Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::SSE:
+        return "sse";
+    case Isa::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
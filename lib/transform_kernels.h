@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// Row major affine matrix, the last row is always (0 0 0 1) and not stored. A row is one 16 byte aligned SSE load.
+struct alignas(16) Affine3x4 {
+    float rows[3][4];
+};
+
+// Batch transform math over contiguous arrays, in a scalar, an SSE and an AVX2 flavour. Best() is picked at
+// runtime from what the CPU supports, the others are there for benchmarking and validation.
+struct TransformKernels {
+    enum class Isa {
+        Scalar,
+        SSE,
+        AVX2,
+    };
+
+    // translation * rotation * scale of count nodes. positions and scales are packed xyz triples, rotations
+    // xyzw quaternions, the same layout as arrays of glm::vec3 and glm::quat.
+    using ComposeFn = void (*)(const float* positions,
+                               const float* rotations,
+                               const float* scales,
+                               uint32_t     count,
+                               Affine3x4*   out);
+
+    // world[i] = world[parents[i]] * local[i] for i in [first, last), roots (UINT32_MAX) just copy local.
+    // Parents have to come before their children. Nodes with a zero in mask keep their world matrix,
+    // a null mask updates every node.
+    using ChainFn = void (*)(const uint32_t*  parents,
+                             const uint8_t*   mask,
+                             const Affine3x4* local,
+                             Affine3x4*       world,
+                             uint32_t         first,
+                             uint32_t         last);
+
+    static const TransformKernels& Best();
+    static bool                    Supported(Isa isa);
+    // the isa has to be supported
+    static const TransformKernels& ForIsa(Isa isa);
+    static const char*             IsaName(Isa isa);
+
+    Isa       isa;
+    ComposeFn compose;
+    ChainFn   chain;
+};
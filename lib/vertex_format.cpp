@@ -0,0 +1,452 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// round to nearest even like the GPU conversions, overflows to infinity
+uint16_t FloatToHalf(const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign     = (bits >> 16) & 0x8000;
+    const uint32_t exponent = (bits >> 23) & 0xFF;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    uint32_t half;
+    uint32_t rest;
+    uint32_t halfway;
+    if (halfExponent > 0) {
+        half    = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        rest    = mantissa & 0x1FFF;
+        halfway = 0x1000;
+    } else {
+        // subnormal, the implicit one becomes part of the mantissa
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        if (shift > 24) {
+            return static_cast<uint16_t>(sign);
+        }
+        const uint32_t full = mantissa | 0x800000;
+        half                = sign | (full >> shift);
+        rest                = full & ((1u << shift) - 1);
+        halfway             = 1u << (shift - 1);
+    }
+
+    // a carry into the exponent is still the right number
+    if (rest > halfway || (rest == halfway && (half & 1) != 0)) {
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(const uint16_t half)
+{
+    const float    sign     = (half & 0x8000) != 0 ? -1.0f : 1.0f;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    if (exponent == 0) {
+        return sign * std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    if (exponent == 31) {
+        return mantissa != 0 ? NAN : sign * INFINITY;
+    }
+    return sign * std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+}
+
+int16_t ToSnorm16(const float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float FromSnorm16(const int16_t value)
+{
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+// 10 bit two's complement in the low bits
+uint32_t ToSnorm10(const float value)
+{
+    return static_cast<uint32_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f)) & 0x3FF;
+}
+
+float FromSnorm10(const uint32_t bits)
+{
+    const int32_t value = static_cast<int32_t>(bits << 22) >> 22;
+    return std::max(value / 511.0f, -1.0f);
+}
+
+float SignNotZero(const float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// The unit sphere projected onto an octahedron and the lower half folded over the upper one, two numbers in
+// [-1, 1] per normal. See "A Survey of Efficient Representations for Independent Unit Vectors".
+void OctahedralEncode(const float* normal, float out[2])
+{
+    const float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    if (length == 0.0f) {
+        out[0] = 0.0f;
+        out[1] = 0.0f;
+        return;
+    }
+
+    const float x = normal[0] / length;
+    const float y = normal[1] / length;
+    if (normal[2] >= 0.0f) {
+        out[0] = x;
+        out[1] = y;
+    } else {
+        out[0] = (1.0f - std::fabs(y)) * SignNotZero(x);
+        out[1] = (1.0f - std::fabs(x)) * SignNotZero(y);
+    }
+}
+
+// the same as DecodeNormal in the vertex shaders
+void OctahedralDecode(const float encoded[2], float out[3])
+{
+    float       x = encoded[0];
+    float       y = encoded[1];
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    const float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    const float length = std::sqrt(x * x + y * y + z * z);
+    out[0]             = x / length;
+    out[1]             = y / length;
+    out[2]             = z / length;
+}
+
+uint32_t TexCoordOffset()
+{
+    return 0;
+}
+
+uint32_t NormalOffset(const VertexFormat& format)
+{
+    return format.interleaved ? format.texCoordSize() : 0;
+}
+
+const struct {
+    const char* word;
+    void (*apply)(VertexFormat& format);
+} WORDS[] = {
+    {"float", [](VertexFormat& format) { format = VertexFormat(); }},
+    {"packed",
+     [](VertexFormat& format) {
+         format.position    = VertexFormat::Position::Snorm16;
+         format.normal      = VertexFormat::Normal::Octahedral;
+         format.texCoord    = VertexFormat::TexCoord::Half2;
+         format.interleaved = true;
+     }},
+    {"interleaved", [](VertexFormat& format) { format.interleaved = true; }},
+    {"separate", [](VertexFormat& format) { format.interleaved = false; }},
+    {"snorm16", [](VertexFormat& format) { format.position = VertexFormat::Position::Snorm16; }},
+    {"a2b10g10r10", [](VertexFormat& format) { format.normal = VertexFormat::Normal::A2B10G10R10; }},
+    {"octahedral", [](VertexFormat& format) { format.normal = VertexFormat::Normal::Octahedral; }},
+    {"half", [](VertexFormat& format) { format.texCoord = VertexFormat::TexCoord::Half2; }},
+};
+} // namespace
+
+VkPipelineVertexInputStateCreateInfo VertexInputLayout::createInfo() const
+{
+    return {
+        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .pNext                           = nullptr,
+        .flags                           = 0,
+        .vertexBindingDescriptionCount   = bindingCount,
+        .pVertexBindingDescriptions      = bindings,
+        .vertexAttributeDescriptionCount = attributeCount,
+        .pVertexAttributeDescriptions    = attributes,
+    };
+}
+
+bool VertexFormat::Parse(const char* text, VertexFormat& out)
+{
+    VertexFormat result;
+
+    const char* word = text;
+    while (true) {
+        const char*  end    = strchr(word, ',');
+        const size_t length = end != nullptr ? static_cast<size_t>(end - word) : strlen(word);
+
+        bool known = false;
+        for (const auto& entry : WORDS) {
+            if (strlen(entry.word) == length && strncmp(entry.word, word, length) == 0) {
+                entry.apply(result);
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+
+        if (end == nullptr) {
+            break;
+        }
+        word = end + 1;
+    }
+
+    out = result;
+    return true;
+}
+
+std::string VertexFormat::Name() const
+{
+    std::string name = interleaved ? "interleaved" : "separate";
+    name += position == Position::Snorm16 ? ",snorm16" : "";
+    name += normal == Normal::A2B10G10R10 ? ",a2b10g10r10" : (normal == Normal::Octahedral ? ",octahedral" : "");
+    name += texCoord == TexCoord::Half2 ? ",half" : "";
+    return name;
+}
+
+uint32_t VertexFormat::positionSize() const
+{
+    return position == Position::Snorm16 ? 4 * sizeof(int16_t) : 3 * sizeof(float);
+}
+
+uint32_t VertexFormat::texCoordSize() const
+{
+    return texCoord == TexCoord::Half2 ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+}
+
+uint32_t VertexFormat::normalSize() const
+{
+    return normal == Normal::Float3 ? 3 * sizeof(float) : sizeof(uint32_t);
+}
+
+uint32_t VertexFormat::streamStride(const uint32_t stream) const
+{
+    if (stream == 0) {
+        return positionSize();
+    }
+    if (interleaved) {
+        return texCoordSize() + normalSize();
+    }
+    return stream == 1 ? texCoordSize() : normalSize();
+}
+
+VkFormat VertexFormat::positionVkFormat() const
+{
+    // there are three component snorm16 formats, but hardly any device fetches them
+    return position == Position::Snorm16 ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+}
+
+VkFormat VertexFormat::texCoordVkFormat() const
+{
+    return texCoord == TexCoord::Half2 ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+}
+
+VkFormat VertexFormat::normalVkFormat() const
+{
+    switch (normal) {
+    case Normal::A2B10G10R10:
+        return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+    case Normal::Octahedral:
+        return VK_FORMAT_R16G16_SNORM;
+    default:
+        return VK_FORMAT_R32G32B32_SFLOAT;
+    }
+}
+
+VertexInputLayout VertexFormat::Layout(const bool positionOnly) const
+{
+    VertexInputLayout layout = {};
+
+    const uint32_t bindingCount = positionOnly ? 1 : streamCount();
+    for (uint32_t stream = 0; stream < bindingCount; stream++) {
+        layout.bindings[stream] = {stream, streamStride(stream), VK_VERTEX_INPUT_RATE_VERTEX};
+    }
+    layout.bindingCount = bindingCount;
+
+    layout.attributes[0]  = {0, 0, positionVkFormat(), 0};
+    layout.attributeCount = 1;
+    if (!positionOnly) {
+        layout.attributes[1]  = {1, 1, texCoordVkFormat(), TexCoordOffset()};
+        layout.attributes[2]  = {2, normalStream(), normalVkFormat(), NormalOffset(*this)};
+        layout.attributeCount = 3;
+    }
+    return layout;
+}
+
+bool VertexFormat::IsSupported(const VkPhysicalDevice phyDevice) const
+{
+    for (const VkFormat format : {positionVkFormat(), texCoordVkFormat(), normalVkFormat()}) {
+        VkFormatProperties properties = {};
+        vkGetPhysicalDeviceFormatProperties(phyDevice, format, &properties);
+        if ((properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PositionDequant ComputeDequant(const VertexFormat& format, const float* positions, const uint32_t count)
+{
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t idx = 0; idx < count; idx++) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            min[axis] = std::min(min[axis], positions[idx * 3 + axis]);
+            max[axis] = std::max(max[axis], positions[idx * 3 + axis]);
+        }
+    }
+    return ComputeDequant(format, min, max);
+}
+
+PositionDequant ComputeDequant(const VertexFormat& format, const float min[3], const float max[3])
+{
+    PositionDequant dequant = {{1.0f, 1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 0.0f}};
+    if (format.position != VertexFormat::Position::Snorm16) {
+        return dequant;
+    }
+
+    // snorm is [-1, 1], so the scale is half of the extent around the center
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        if (min[axis] > max[axis]) {
+            continue; // no vertices at all
+        }
+        const float halfExtent = (max[axis] - min[axis]) * 0.5f;
+        dequant.scale[axis]    = halfExtent > 0.0f ? halfExtent : 1.0f;
+        dequant.offset[axis]   = (max[axis] + min[axis]) * 0.5f;
+    }
+    return dequant;
+}
+
+void EncodePositions(const VertexFormat&    format,
+                     const PositionDequant& dequant,
+                     const float*           positions,
+                     const uint32_t         count,
+                     void*                  stream)
+{
+    if (format.position == VertexFormat::Position::Float3) {
+        memcpy(stream, positions, size_t(count) * 3 * sizeof(float));
+        return;
+    }
+
+    int16_t* out = static_cast<int16_t*>(stream);
+    for (uint32_t idx = 0; idx < count; idx++, out += 4) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            out[axis] = ToSnorm16((positions[idx * 3 + axis] - dequant.offset[axis]) / dequant.scale[axis]);
+        }
+        out[3] = 0;
+    }
+}
+
+void EncodeTexCoords(const VertexFormat& format, const float* texCoords, const uint32_t count, void* stream)
+{
+    const uint32_t stride = format.streamStride(1);
+    uint8_t*       out    = static_cast<uint8_t*>(stream) + TexCoordOffset();
+
+    for (uint32_t idx = 0; idx < count; idx++, out += stride) {
+        if (format.texCoord == VertexFormat::TexCoord::Half2) {
+            const uint16_t half[2] = {FloatToHalf(texCoords[idx * 2]), FloatToHalf(texCoords[idx * 2 + 1])};
+            memcpy(out, half, sizeof(half));
+        } else {
+            memcpy(out, texCoords + idx * 2, 2 * sizeof(float));
+        }
+    }
+}
+
+void EncodeNormals(const VertexFormat& format, const float* normals, const uint32_t count, void* stream)
+{
+    const uint32_t stride = format.streamStride(format.normalStream());
+    uint8_t*       out    = static_cast<uint8_t*>(stream) + NormalOffset(format);
+
+    for (uint32_t idx = 0; idx < count; idx++, out += stride) {
+        const float* normal = normals + idx * 3;
+        switch (format.normal) {
+        case VertexFormat::Normal::Float3:
+            memcpy(out, normal, 3 * sizeof(float));
+            break;
+        case VertexFormat::Normal::A2B10G10R10: {
+            // red in the low bits, the two alpha bits stay zero
+            const uint32_t packed = ToSnorm10(normal[0]) | (ToSnorm10(normal[1]) << 10) | (ToSnorm10(normal[2]) << 20);
+            memcpy(out, &packed, sizeof(packed));
+            break;
+        }
+        case VertexFormat::Normal::Octahedral: {
+            float encoded[2];
+            OctahedralEncode(normal, encoded);
+            const int16_t snorm[2] = {ToSnorm16(encoded[0]), ToSnorm16(encoded[1])};
+            memcpy(out, snorm, sizeof(snorm));
+            break;
+        }
+        }
+    }
+}
+
+void DecodePosition(const VertexFormat&    format,
+                    const PositionDequant& dequant,
+                    const void*            stream,
+                    const uint32_t         idx,
+                    float                  out[3])
+{
+    const uint8_t* src = static_cast<const uint8_t*>(stream) + size_t(idx) * format.positionSize();
+    if (format.position == VertexFormat::Position::Float3) {
+        memcpy(out, src, 3 * sizeof(float));
+        return;
+    }
+
+    int16_t snorm[3];
+    memcpy(snorm, src, sizeof(snorm));
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        out[axis] = FromSnorm16(snorm[axis]) * dequant.scale[axis] + dequant.offset[axis];
+    }
+}
+
+void DecodeTexCoord(const VertexFormat& format, const void* stream, const uint32_t idx, float out[2])
+{
+    const uint8_t* src = static_cast<const uint8_t*>(stream) + size_t(idx) * format.streamStride(1) + TexCoordOffset();
+    if (format.texCoord == VertexFormat::TexCoord::Float2) {
+        memcpy(out, src, 2 * sizeof(float));
+        return;
+    }
+
+    uint16_t half[2];
+    memcpy(half, src, sizeof(half));
+    out[0] = HalfToFloat(half[0]);
+    out[1] = HalfToFloat(half[1]);
+}
+
+void DecodeNormal(const VertexFormat& format, const void* stream, const uint32_t idx, float out[3])
+{
+    const uint32_t stride = format.streamStride(format.normalStream());
+    const uint8_t* src    = static_cast<const uint8_t*>(stream) + size_t(idx) * stride + NormalOffset(format);
+
+    switch (format.normal) {
+    case VertexFormat::Normal::Float3:
+        memcpy(out, src, 3 * sizeof(float));
+        break;
+    case VertexFormat::Normal::A2B10G10R10: {
+        uint32_t packed;
+        memcpy(&packed, src, sizeof(packed));
+        out[0] = FromSnorm10(packed & 0x3FF);
+        out[1] = FromSnorm10((packed >> 10) & 0x3FF);
+        out[2] = FromSnorm10((packed >> 20) & 0x3FF);
+        break;
+    }
+    case VertexFormat::Normal::Octahedral: {
+        int16_t snorm[2];
+        memcpy(snorm, src, sizeof(snorm));
+        const float encoded[2] = {FromSnorm16(snorm[0]), FromSnorm16(snorm[1])};
+        OctahedralDecode(encoded, out);
+        break;
+    }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vulkan/vulkan_core.h>
+
+// position = decoded * scale + offset, the identity for float positions
+struct PositionDequant {
+    float scale[4];
+    float offset[4];
+};
+
+// The vertex input state of one pipeline, createInfo points into the struct so it has to outlive the pipeline
+// creation.
+struct VertexInputLayout {
+    VkVertexInputBindingDescription   bindings[3];
+    VkVertexInputAttributeDescription attributes[3];
+    uint32_t                          bindingCount;
+    uint32_t                          attributeCount;
+
+    VkPipelineVertexInputStateCreateInfo createInfo() const;
+};
+
+// How the meshes keep their vertices on the GPU. The positions are always a stream of their own, the shadow pass
+// and the depth pre-pass read nothing else. The texture coordinates and the normals are two more streams or one
+// interleaved stream, so the lighting reads two streams per vertex instead of three.
+//
+// The locations are the same for every format: 0 position, 1 texture coordinate, 2 normal.
+struct VertexFormat {
+    static constexpr uint32_t MAX_STREAMS = 3;
+
+    enum class Position : uint8_t {
+        Float3,
+        Snorm16, // 4 x 16 bit in the bounds of the mesh, the shader applies the PositionDequant of the mesh
+    };
+    enum class Normal : uint8_t {
+        Float3,
+        A2B10G10R10, // snorm, fetching it is optional in Vulkan
+        Octahedral,  // 2 x 16 bit snorm, unfolded in the shader
+    };
+    enum class TexCoord : uint8_t {
+        Float2,
+        Half2,
+    };
+
+    Position position    = Position::Float3;
+    Normal   normal      = Normal::Float3;
+    TexCoord texCoord    = TexCoord::Float2;
+    bool     interleaved = false;
+
+    // Comma separated words, see the usage of --vertex-format. Returns false on anything unknown.
+    static bool Parse(const char* text, VertexFormat& out);
+    std::string Name() const;
+
+    // the vertex shaders unfold octahedral normals, the value of their specialization constant 0
+    uint32_t normalEncoding() const { return normal == Normal::Octahedral ? 1 : 0; }
+
+    uint32_t positionSize() const;
+    uint32_t texCoordSize() const;
+    uint32_t normalSize() const;
+    // everything the lighting fetches for one vertex
+    uint32_t vertexSize() const { return positionSize() + texCoordSize() + normalSize(); }
+
+    // the buffers of a mesh, the position stream is the first one and the texture coordinates the second
+    uint32_t streamCount() const { return interleaved ? 2 : 3; }
+    uint32_t normalStream() const { return interleaved ? 1 : 2; }
+    uint32_t streamStride(uint32_t stream) const;
+
+    VkFormat positionVkFormat() const;
+    VkFormat texCoordVkFormat() const;
+    VkFormat normalVkFormat() const;
+
+    // the shadow pass and the pre-pass only get the position stream
+    VertexInputLayout Layout(bool positionOnly) const;
+
+    // false if the device can't fetch one of the formats as a vertex attribute
+    bool IsSupported(VkPhysicalDevice phyDevice) const;
+};
+
+// Min and max of count float3 positions turned into the dequantization, the identity for float positions.
+PositionDequant ComputeDequant(const VertexFormat& format, const float* positions, uint32_t count);
+PositionDequant ComputeDequant(const VertexFormat& format, const float min[3], const float max[3]);
+
+// Write count vertices of one attribute from floats into the format. stream points at the first vertex of the
+// stream of the attribute, the texture coordinates and the normals skip each other when interleaved.
+void EncodePositions(const VertexFormat&    format,
+                     const PositionDequant& dequant,
+                     const float*           positions,
+                     uint32_t               count,
+                     void*                  stream);
+void EncodeTexCoords(const VertexFormat& format, const float* texCoords, uint32_t count, void* stream);
+void EncodeNormals(const VertexFormat& format, const float* normals, uint32_t count, void* stream);
+
+// One vertex back to floats, for measuring what the encoding loses.
+void DecodePosition(const VertexFormat&    format,
+                    const PositionDequant& dequant,
+                    const void*            stream,
+                    uint32_t               idx,
+                    float                  out[3]);
+void DecodeTexCoord(const VertexFormat& format, const void* stream, uint32_t idx, float out[2]);
+void DecodeNormal(const VertexFormat& format, const void* stream, uint32_t idx, float out[3]);
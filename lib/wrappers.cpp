@@ -101,13 +101,20 @@ VkPipelineLayout CreatePipelineLayout(const VkDevice
         .size       = pushConstantSize,
     };
 
+    return CreatePipelineLayout(device, layouts, pushConstantRange);
+}
+
+VkPipelineLayout CreatePipelineLayout(const VkDevice                            device,
+                                      const std::vector<VkDescriptorSetLayout>& layouts,
+                                      const VkPushConstantRange&                pushConstantRange)
+{
     const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
         .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext                  = nullptr,
         .flags                  = 0,
         .setLayoutCount         = (uint32_t)layouts.size(),
         .pSetLayouts            = layouts.data(),
-        .pushConstantRangeCount = (pushConstantSize > 0) ? 1u : 0u,
+        .pushConstantRangeCount = (pushConstantRange.size > 0) ? 1u : 0u,
         .pPushConstantRanges    = &pushConstantRange,
     };
 
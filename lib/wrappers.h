@@ -17,3 +17,7 @@ VkShaderModule CreateShaderModule(VkDevice device, const uint32_t* SPIRVBinary,
 
 VkPipelineLayout
 CreatePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& layouts, uint32_t pushConstantSize = 0);
+// a range of size 0 is no push constants
+VkPipelineLayout CreatePipelineLayout(VkDevice                                  device,
+                                      const std::vector<VkDescriptorSetLayout>& layouts,
+                                      const VkPushConstantRange&                pushConstantRange);